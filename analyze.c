@@ -729,7 +729,7 @@ static void set_convertd_type(TreeNode * t, TypeInfo type)
 	  //ERROR_UNLESS(left->type.typekind != Func || !isStructFunction(left->attr.name),
 		//  "funtion bind to struct cannot be assigned");
 	  ERROR_UNLESS(isExp(right,FuncallK) || isStructFunction(right->attr.name) == false, "struct function should not be assiged to others");
-	  ERROR_UNLESS(left->type.is_const == false, "const cannot be assigned");
+	  ERROR_UNLESS(isStmt(t, DeclareK) || left->type.is_const == false, "const cannot be assigned");// const int x = 1 is an initializer
 	  ERROR_UNLESS(right->nodekind == ExpK,"const variable cannot be assigned");
 	  ERROR_UNLESS(!is_basic_type(left->type, Array), "Array canot be assigned");
 	  TypeInfo exp_type = right->converted_type;
@@ -0,0 +1,34 @@
+/*
+ structs are copied with MEMCPY
+*/
+
+struct vec
+{
+	int a
+	int b
+	int c
+	int d
+}
+
+typedef struct vec vec
+
+vec make(int base)
+{
+	vec v
+	v.a = base
+	v.b = base + 1
+	v.c = base + 2
+	v.d = base + 3
+	return v
+}
+
+void main()
+{
+	vec x = make(1)
+	vec y = x
+	y.b = 20
+	write x.b
+	write y.a + y.b + y.c + y.d
+	x = y
+	write x.b
+}
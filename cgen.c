@@ -7,13 +7,20 @@
 #include "assert.h"
 #include "analyze.h"
 #include "compile.h"
+#include "fold.h"
 
 #define checkInAdressMode() (in_adress_mode)
+#define MAX_DISPLAY 32  /* levels of the display, see enterDisplay */
+#define DISPLAY_SAVE -2 /* frame slot of the replaced display entry, under the return adress */
 
 
 typedef void(*emitFunc)(int, int, int);
 static bool in_adressMode = FALSE;
 static char * current_function = NULL;
+static bool tail_call_ok = FALSE;// no local of current_function may be pointed to
+static bool frame_private = FALSE;// and no nested function may write them through the env
+static int inlineNum = 0;// functions that can be inlined, see cgenInline
+static int display_level = -1;// display entry current_function publishes its frame in, -1 if none
 
 static int  genLabel();
 static void emitLabel(int);
@@ -30,15 +37,40 @@ static int get_function_level(char * name){
 	return st_lookup_level(name); 
 }
 static void cgen_assign(TreeNode *,TreeNode *,int);
-static void cGenPushTemp(int size, int tar, int ori, int adress_reg);
+static void cGenPushTemp(int size, Type tar, Type ori, int adress_reg);
 
 static void __cGenST(int , int , int );
 static void __cGenPUSH(int ,int, int );
-static void __cgenPopFromTemp(int, int, int,int, emitFunc);
+static void __cgenPopFromTemp(Type, Type, int,int, emitFunc);
 static void cgenOp(TreeNode*, TreeNode*, TokenType, int, int, int);
-
-static void cgenCopyObj(int origin_reg, int target_reg, int offset, int target_adress_reg);
-static void cgenPushObj(int origin_reg, int target_reg, int offset);
+static bool cgenOpInRegs(TreeNode*);
+static int cgenValueInTmp(TreeNode*);
+static bool cgenValueInReg(TreeNode*, Type);
+static void freeTmp(int r);
+static void cgenBranch(TreeNode * t, bool jumpIf, int label, Type type, int scope);
+static OPCODE compareJump(TokenType op, bool negate, bool flt);
+static void cgenLogicValue(TreeNode * t, int scope);
+static void cgenSwitch(TreeNode * tree, int scope, int start_label, int end_label);
+static bool cgenTailCall(TreeNode * call, int scope);
+static bool takesLocalAdress(TreeNode * t);
+static void pushEnv(int current_level, int call_level);
+static bool declaresFunction(TreeNode * t);
+static void countCalls(TreeNode * t);
+static void addInline(TreeNode * decl, int scope);
+static bool inlinable(TreeNode * call);
+static bool cgenInline(TreeNode * call, int scope);
+static bool nestedReadsFrame(TreeNode * t, TreeNode * decl);
+static bool isOuterId(char * name);
+static bool inDisplay(char * name);
+static int loadIdBase(char * name);
+static bool enterDisplay(void);
+static void leaveDisplay(bool last_owner);
+static void restoreDisplay(void);
+
+static void cgenCopyObj(Type origin_type, Type target_type, int offset, int target_adress_reg);
+static void cgenPushObj(Type origin_type, Type target_type, int offset);
+static void cgenPushBlock(int vsize, int adress_reg);
+static void cgenPopBlock(int vsize, int adress_reg);
 static void cgenCodeForInsertNode(TreeNode*,int);
 
 
@@ -48,6 +80,9 @@ static void cGenInValueMode(TreeNode * tree, int scope, int start_label, int end
 /*function used to get the relative register of specific type  */
 static int get_reg(Type type);
 static int get_reg1(Type type);
+/*the opcode of an op or a move on values of the given types*/
+static OPCODE arithOp(OPCODE op, Type type);
+static OPCODE moveOp(Type from, Type to);
 /*get the current env's stack*/
 static int get_stack_bottom(int scope);
 static void pushParam(TreeNode * t,ParamNode * p, int scope);
@@ -76,10 +111,7 @@ static void genStmt( TreeNode * tree,int scope,int start_label,int end_label, bo
 			int if_end_label = genLabel();
 
 			/* generate code for test expression */
-			cGenInValueMode(tree->child[0], scope + 1, -1, -1);
-			emitRM("POP", ac, 0, mp, "pop from the mp");
-			emitRO("JNE", ac, 1, pc, "true case:, execute if part");
-			emitGoto(else_label);// ֱӽelseж
+			cgenBranch(tree->child[0], FALSE, else_label, ErrorType, scope + 1);// ֱӽelseж
 			cGenInValueMode(tree->child[1], scope + 1, start_label, end_label);//ִif
 			emitGoto(if_end_label);// if ֱִ֮ӽλ
 			
@@ -91,60 +123,8 @@ static void genStmt( TreeNode * tree,int scope,int start_label,int end_label, bo
             if (TraceCode)  emitComment("<- if") ;
             break; /* if_k */
 		case SwitchK:
-			{
-				/*todo:
-					ʵthrough,ֱһͺ
-				*/
-				int switch_end_label = genLabel();// the label before repeat
-				TreeNode * case_seq = tree->child[1]->child[0];
-
-				while (case_seq != NULL)
-				{
-					int case_start_label = genLabel();
-					int case_end_label = genLabel();
-					if (case_seq->child[1] == NULL){
-						// case
-						while (case_seq != NULL && case_seq->child[1] == NULL)
-						{
-							cGenInValueMode(tree->child[0], scope + 1, start_label, end_label);
-							cGenInValueMode(case_seq->child[0], scope + 1, start_label, end_label);// case exp;
-							emitRO("POP", ac, 0, mp, "pop case exp");
-							emitRO("POP", ac1, 0, mp, "pop switch exp");
-							emitRO("SUB", ac, ac, ac1, "op ==, convertd_type");
-							emitRM("JNE", ac, 1, pc, "skip if not statisfy");
-							emitGoto(case_start_label);// case : go to caseڲ							
-							case_seq = case_seq->sibling;
-						}
-						assert(case_seq != NULL);// һǿ
-					}
-
-
-					if (case_seq->kind.stmt == DefaultK){
-						emitGoto(case_start_label);// case : go to caseڲ
-						goto create_label;
-					}
-
-					cGenInValueMode(tree->child[0], scope + 1, start_label, end_label);
-					cGenInValueMode(case_seq->child[0], scope + 1, start_label, end_label);// case exp;
-					emitRO("POP", ac, 0, mp, "pop case exp");
-					emitRO("POP", ac1, 0, mp, "pop switch exp");
-					emitRO("SUB", ac, ac, ac1, "op ==, convertd_type");
-					emitRM("JEQ", ac, 1, pc, "go to case if statisfy");
-					emitGoto(case_end_label);// case ,go to caseλ
-					//emitRM("LDA", pc, 1, pc, "unconditional jmp");
-					emitGoto(case_start_label);// case : go to caseڲ
-					
-					create_label:;
-					emitLabel(case_start_label);// generate start label
-					cGenInValueMode(case_seq->child[1], scope + 1, start_label, switch_end_label);// case stmt;
-					emitGoto(switch_end_label);
-					emitLabel(case_end_label);// generate start label
-					deleteVarOfField(case_seq->child[1], scope + 1);// еľֲ
-					case_seq = case_seq->sibling;
-				}
-				emitLabel(switch_end_label);// generate switch end label
-				break;
-			}
+			cgenSwitch(tree, scope, start_label, end_label);
+			break;
         case RepeatK:/*gen code for while statement*/
             if (TraceCode) emitComment("-> repeat");
 			int new_start_label = genLabel();// the label before repeat
@@ -155,10 +135,7 @@ static void genStmt( TreeNode * tree,int scope,int start_label,int end_label, bo
 			emitComment("while stmt:");
 			emitLabel(new_start_label);// generate start label
 
-			cGenInValueMode(test, scope + 1, -1, -1);// test condition code
-			emitRM("POP", ac, 0, mp, "pop from the mp");
-			emitRO("JNE", ac, 1, pc, "true case:, skip the break, execute the block code");
-			emitGoto(new_end_label);
+			cgenBranch(test, FALSE, new_end_label, ErrorType, scope + 1);// while(1) needs no test
 
 			/* generate code for body */
 			cGenInValueMode(body, scope, new_start_label, new_end_label);
@@ -181,8 +158,8 @@ static void genStmt( TreeNode * tree,int scope,int start_label,int end_label, bo
             loc = st_lookup(tree->attr.name);
 			type = st_lookup_type(tree->attr.name);
 			//todo, optimize follow code. DRY
-			emitRO("IN", get_reg(getBasicType(type)), 0, 0, "read integer/float value");
-			emitRM("ST", get_reg(getBasicType(type)), loc, get_stack_bottom(scope), "assign: store value");//mem[reg[gp]+loc] =  reg[ac]
+			emitRO(opIN, get_reg(getBasicType(type)), 0, 0, "read integer/float value");
+			emitRM(opST, get_reg(getBasicType(type)), loc, get_stack_bottom(scope), "assign: store value");//mem[reg[gp]+loc] =  reg[ac]
 			break;
     
 		case WriteK:
@@ -191,33 +168,38 @@ static void genStmt( TreeNode * tree,int scope,int start_label,int end_label, bo
 			{
 				int a = 0;
 			}
-			cGenInValueMode(tree->child[0], scope, start_label, end_label);
 			type = tree->child[0]->type;
+			if (!cgenValueInReg(tree->child[0], getBasicType(type)))
+			{
+				cGenInValueMode(tree->child[0], scope, start_label, end_label);
+				emitRM(opPOP, get_reg(getBasicType(type)), 0, mp, "move result to register");
+			}
 			const char * name = tree->child[0]->attr.name;
 		
 			int mode = 0;// 0,1ַ,2ַ
-			emitRM("POP", get_reg(getBasicType(type)), 0, mp, "move result to register");
 			if (is_basic_type(type, Char)) mode = 1;
 			else if (is_basic_type(type, String)) mode = 2;
-			emitRO("OUT", get_reg(getBasicType(type)), mode, 0, "output value in register[ac / fac]");
+			emitRO(opOUT, get_reg(getBasicType(type)), mode, 0, "output value in register[ac / fac]");
             break;
 		case AsmK:
 			if (strcmp(tree->attr.name, "malloc") == 0)
 			{	
 				// malloc(n)
 				cGen(tree->child[0], scope, start_label, end_label, 0);// n
-				emitRM("POP", ac, 0, mp, "get malloc parameters");
-				emitSYS("MALLOC", 0, 0, 0, "system call for malloc");
+				emitRM(opPOP, ac, 0, mp, "get malloc parameters");
+				emitSYS(opMALLOC, 0, 0, 0, "system call for malloc");
 			}
 			else if (strcmp(tree->attr.name, "free") == 0)
 			{
 				// free(p)
 				cGen(tree->child[0], scope, start_label, end_label, 0);// p
-				emitRM("POP", ac, 0, mp, "get free parameters");
-				emitSYS("FREE", 0, 0, 0, "system call for free");
+				emitRM(opPOP, ac, 0, mp, "get free parameters");
+				emitSYS(opFREE, 0, 0, 0, "system call for free");
 			}
 			break;
 		case ReturnK:
+			if (tree->child[0] != NULL && cgenTailCall(tree->child[0], scope))
+				break;
 			if (tree->child[0] != NULL) 
 			{ 
 				cGenInValueMode(tree->child[0], scope, start_label, end_label);
@@ -227,15 +209,16 @@ static void genStmt( TreeNode * tree,int scope,int start_label,int end_label, bo
 				int origin_reg = get_reg(getBasicType(ctype));
 				int target_reg = get_reg(getBasicType(return_type));
 				if (vsize == 1 && origin_reg != target_reg){
-					emitRM("POP",origin_reg,  0, mp, "op: POP left");
-					emitRO("MOV", target_reg,origin_reg, 0, "move register reg(s) tp reg(r)");
-					emitRM("PUSH", target_reg, 0, mp, "op: push left");
+					emitRM(opPOP,origin_reg,  0, mp, "op: POP left");
+					emitRO(moveOp(getBasicType(ctype), getBasicType(return_type)), target_reg,origin_reg, 0, "move register reg(s) tp reg(r)");
+					emitRM(opPUSH, target_reg, 0, mp, "op: push left");
 				}
 			}
 
-			emitRO("MOV", sp, fp, 0, "restore the caller sp");// restore the sp;reg[sp] = reg[fp]
-			emitRM("LD", fp, 0, fp, "resotre the caller fp");//resotre the fp;reg[fp] = dMem[reg[fp]]
-			emitRO("RETURN", 0, -1, sp, "return to the caller");
+			restoreDisplay();
+			emitRO(opMOV, sp, fp, 0, "restore the caller sp");// restore the sp;reg[sp] = reg[fp]
+			emitRM(opLD, fp, 0, fp, "resotre the caller fp");//resotre the fp;reg[fp] = dMem[reg[fp]]
+			emitRO(opRETURN, 0, -1, sp, "return to the caller");
 			break;
 		
 		case DeclareK:
@@ -243,18 +226,25 @@ static void genStmt( TreeNode * tree,int scope,int start_label,int end_label, bo
 			if (is_basic_type(tree->type,Func)) 
 			{
 				char * last_current = current_function;
+				bool last_tail_call_ok = tail_call_ok;
+				bool last_frame_private = frame_private;
+				int last_display_level = display_level;
+				int inline_mark = inlineNum;
 				current_function = tree->attr.name;
-				emitComment("function entry:");
-				emitComment(current_function);
+				tail_call_ok = !takesLocalAdress(tree->child[0]) && !takesLocalAdress(tree->child[1]);
+				frame_private = tail_call_ok && !declaresFunction(tree->child[1]);
+				emitFunction(current_function);
 
 				if (scope > 0) { 
 					stInsertVar(tree, scope);
 				}
 
+				// a function whose nested functions read its variables publishes its frame
+				display_level = nestedReadsFrame(tree->child[1], tree) ? get_function_level(current_function) + 1 : -1;
 				int old_stack = stack_offset;
-				stack_offset = -2;
+				stack_offset = display_level == -1 ? -2 : DISPLAY_SAVE - 1;
 				if (strcmp(current_function, "main") != 0){
-					emitRM("LDA", sp, -1, sp, "stack expand for function variable");
+					emitRM(opLDA, sp, -1, sp, "stack expand for function variable");
 				}
 				// setNestedFunction˳Ҫ
 				setNestedFunction(1);
@@ -263,23 +253,32 @@ static void genStmt( TreeNode * tree,int scope,int start_label,int end_label, bo
 				setFunctionAdress(tree->attr.name, setStructInfo(NULL, 0), scope);
 				// assume the caller move return adress in reg[ac]
 				emitGoto(func_end);
-				emitRO("MOV", ac1, fp, 0,"store the caller fp temporarily");// store the caller fp
-				emitRO("MOV", fp,  sp, 0, "exchang the stack(context)");//reg[fp] = reg[sp]
+				emitRO(opMOV, ac1, fp, 0,"store the caller fp temporarily");// store the caller fp
+				emitRO(opMOV, fp,  sp, 0, "exchang the stack(context)");//reg[fp] = reg[sp]
 
-				emitRM("PUSH", ac1, 0, sp, "push the caller fp");//dMem[reg[sp]--] = ac1 
-				emitRM("PUSH", ac,  0, sp, "push the return adress");// dMem[reg[sp]--] = return adress;assume the caller sotre the return adress reg[pc] in reg[ac]
+				emitRM(opPUSH, ac1, 0, sp, "push the caller fp");//dMem[reg[sp]--] = ac1 
+				emitRM(opPUSH, ac,  0, sp, "push the return adress");// dMem[reg[sp]--] = return adress;assume the caller sotre the return adress reg[pc] in reg[ac]
+				bool last_display_owner = enterDisplay();
 				
 				cGenInValueMode(tree->child[1], scope + 1, start_label, end_label);// generate code for the function body,insert local variable
 				stack_offset = old_stack;
 				deleteParams(tree->child[0], scope + 1);
 				deleteVarOfFunction(tree->child[1], scope + 1);
 				//todo this should be moved to return node
-				emitRO("MOV", sp, fp, 0, "restore the caller sp");// restore the sp;reg[sp] = reg[fp]
-				emitRM("LD", fp, 0, fp, "resotre the caller fp");//resotre the fp;reg[fp] = dMem[reg[fp]]
-				emitRO("RETURN", 0, -1, sp, "return to adress : reg[fp]+1");// execute reg[pc] = return adress
-				emitComment("function end:");
+				restoreDisplay();
+				emitRO(opMOV, sp, fp, 0, "restore the caller sp");// restore the sp;reg[sp] = reg[fp]
+				emitRM(opLD, fp, 0, fp, "resotre the caller fp");//resotre the fp;reg[fp] = dMem[reg[fp]]
+				emitRO(opRETURN, 0, -1, sp, "return to adress : reg[fp]+1");// execute reg[pc] = return adress
+				emitFunctionEnd();
 				emitLabel(func_end);
+				// the nested functions go out of scope, this one is known after its body
+				inlineNum = inline_mark;
+				addInline(tree, scope);
+				leaveDisplay(last_display_owner);
 				current_function = last_current;
+				tail_call_ok = last_tail_call_ok;
+				frame_private = last_frame_private;
+				display_level = last_display_level;
 				setNestedFunction(-1);
 
 			}
@@ -297,7 +296,7 @@ static void genStmt( TreeNode * tree,int scope,int start_label,int end_label, bo
 			setDirectStructEnv(true);
 			cGenInValueMode(tree->child[0], scope + 1, start_label, end_label);// will insert all function
             deleteVarOfField(tree->child[0],scope + 1 );
-            //emitRO("MOV",sp,fp,0,"resotre stack in struct");
+            //emitRO(opMOV,sp,fp,0,"resotre stack in struct");
 			setDirectStructEnv(false);
             setStructInfo(last_sname, 1);//restore
 			break;
@@ -325,32 +324,29 @@ static void genExp( TreeNode * tree,int scope,int start_label,int end_label,bool
             switch (getBasicType(type)) 
 			{
 			case Integer:
+			case Boolean:// a folded condition
 				 integer = integer_from_node(tree);
-				 emitRM("LDC", ac, integer, 0, "load integer const");// reg[ac] = tree->ttr.val.integer
-				 emitRM("PUSH", ac, 0, mp,"store exp");
+				 emitRM(opLDC, ac, integer, 0, "load integer const");// reg[ac] = tree->ttr.val.integer
+				 emitRM(opPUSH, ac, 0, mp,"store exp");
 				 break;
 			case Float:
 				 float_num = float_from_node(tree);
-				 emitLDCF("LDC", fac, float_num, 0, "load float const");// reg[ac] = tree->ttr.val.integer
-				 emitRM("PUSH", fac,0, mp, "store exp");
+				 emitLDCF(opLDC, fac, float_num, 0, "load float const");// reg[ac] = tree->ttr.val.integer
+				 emitRM(opPUSH, fac,0, mp, "store exp");
 				 break;
 			case Char:
-				 emitRM("LDC", ac, tree->attr.val.integer, 0, "load char const");// reg[ac] = tree->ttr.val.integer
-				 emitRM("PUSH", ac, 0, mp, "store exp");
+				 emitRM(opLDC, ac, tree->attr.val.integer, 0, "load char const");// reg[ac] = tree->ttr.val.integer
+				 emitRM(opPUSH, ac, 0, mp, "store exp");
 				break;
 			case String:
 				if (tree->attr.name != NULL){
-					char * name = tree->attr.name;
-					for (int i = 0; *name != '\0'; i++){
-						emitRM("LDC", ac, *name, 0, "load char const");// reg[ac] = tree->ttr.val.integer
-						emitRM("ST", ac, tree->attr.val.integer + i, cp, "store exp");// dMem[reg[cp] + offset] = ac
-						name++;
-					}
+					// the literal lives in the constant pool, the loader puts it at cp + offset
+					emitData(CONST_ADRESS + tree->attr.val.integer, tree->attr.name);
 					free(tree->attr.name);
 					tree->attr.name = NULL;
 				}
-				emitRM("LDA", ac, tree->attr.val.integer, cp, "load char const");// reg[ac] = tree->ttr.val.integer
-				emitRM("PUSH", ac, 0, mp, "store exp");
+				emitRM(opLDA, ac, tree->attr.val.integer, cp, "load char const");// reg[ac] = tree->ttr.val.integer
+				emitRM(opPUSH, ac, 0, mp, "store exp");
 				break;
 			default:
 				assert(!"BUG in ConstK,unknwon expression type");
@@ -365,33 +361,46 @@ static void genExp( TreeNode * tree,int scope,int start_label,int end_label,bool
 		loc = st_lookup(tree->attr.name);
 		int current_func_level = get_function_level(current_function);
 		int id_level = st_lookup_level(tree->attr.name);
+		int base = loadIdBase(tree->attr.name);// gp, fp or the frame in the display
+		bool env_chain = base == -1;
 
-		if (id_level != 0 && id_level <= current_func_level){
-			emitRM("LDA", ac1, 0, fp, "store current fp");
+		if (env_chain){
+			emitRM(opLDA, ac1, 0, fp, "store current fp");
 			int delta = current_func_level - id_level;
 			while (delta-- >= 0){
-				emitRM("LD", fp, 1, fp, "load env");// get parent fp	
+				emitRM(opLD, fp, 1, fp, "load env");// get parent fp	
 			}
+			base = get_stack_bottom(st_lookup_scope(tree->attr.name));
 		}
 
 		if (checkInAdressMode() || is_basic_type(tree->converted_type, Array))
 		{
-			emitRM("LDA", ac, loc, get_stack_bottom(st_lookup_scope(tree->attr.name)), "load id adress");// reg[ac] = Mem[reg[gp] + loc]			
-			emitRM("PUSH", ac, 0, mp, "push array adress to mp");
+			emitRM(opLDA, ac, loc, base, "load id adress");// reg[ac] = Mem[reg[gp] + loc]			
+			emitRM(opPUSH, ac, 0, mp, "push array adress to mp");
 		}
 		else
 		{
 			int vsize = var_size_of(tree);
+			if (vsize > 1)
+			{
+				emitRM(opLDA, ac, loc, base, "load id adress");
+				if (env_chain){
+					emitRM(opLDA, fp, 0, ac1, "restore fp");
+					env_chain = FALSE;
+				}
+				cgenPushBlock(vsize, ac);
+				vsize = 0;
+			}
 			for (int i = 0; i < vsize; ++i)
 			{
-				emitRM("LD", get_reg(getBasicType(tree->type)), loc + i, get_stack_bottom(st_lookup_scope(tree->attr.name)), "load id value");// reg[ac] = Mem[reg[gp] + loc]			
-				emitRO("MOV", get_reg(getBasicType(type)), get_reg(getBasicType(tree->type)), 0, "move from one reg(s) to reg(r)");// tiny machine wuold analyze the instruction 
-				emitRM("PUSH", get_reg(getBasicType(type)), 0, mp, "store exp");
+				emitRM(opLD, get_reg(getBasicType(tree->type)), loc + i, base, "load id value");// reg[ac] = Mem[reg[gp] + loc]			
+				emitRO(moveOp(getBasicType(tree->type), getBasicType(type)), get_reg(getBasicType(type)), get_reg(getBasicType(tree->type)), 0, "move from one reg(s) to reg(r)");
+				emitRM(opPUSH, get_reg(getBasicType(type)), 0, mp, "store exp");
 			}
 		}
 
-		if (id_level != 0 && id_level <= current_func_level){
-			emitRM("LDA", fp, 0, ac1, "restore fp");// get parent fp		
+		if (env_chain){
+			emitRM(opLDA, fp, 0, ac1, "restore fp");// get parent fp		
 		}
 
 		if (TraceCode)  emitComment("<- Id");
@@ -399,8 +408,9 @@ static void genExp( TreeNode * tree,int scope,int start_label,int end_label,bool
 		}
 		case FuncallK:
 		{
-			//todo :tail recursion optimize
+			// return f(...) is a tail call, see cgenTailCall; small callees are inlined, see cgenInline
 			assert(tree->attr.name != NULL);
+			if (!in_adress_mode && cgenInline(tree, scope)) break;
 			int current_fuction_level = get_function_level(current_function);
 			int call_function_level = get_function_level(tree->attr.name);
 			TreeNode *e = tree->child[0];
@@ -413,60 +423,15 @@ static void genExp( TreeNode * tree,int scope,int start_label,int end_label,bool
 			}
 
 			// ôcallĺǽṹԱ?
-			if (call_function_level == -1){
-				emitRM("LDA", ac, 0, fp, "load env");//ע⵽,ﱣfp,spڱõʱѾ
-				emitRM("PUSH", ac, 0, sp, "store env");
-			}
-			else if (current_fuction_level < call_function_level){
-				/*
-				def f #level 1
-				def g #level 2
-				end
-				g()
-				end
-				*/
-				emitRM("LDA", ac, 0, fp, "load env");
-				emitRM("PUSH", ac, 0, sp, "store env");
-			}
-			else{
-				/*
-				def f #level 1
-
-				end
-				
-				def g #level 1
-					def z #level 2
-					
-					f() # level 1
-					end
-				end
-				*/
-
-				/*
-				def f #level1
-				end
-
-				def g #level 1
-					f() # delta = 0
-				end
-				*/
-
-				int delta = current_fuction_level - call_function_level;// eg 0 or 1 or 2
-				// ĿҵӦenv, env -> env -> env ... -> fp, fp
-				emitRM("LD", ac, 1, fp, "load env");// load env,pointing to the parent fp
-				while (delta-- > 0){
-					emitRM("LD", ac, 1, ac, "load env1");// get 
-				}
-				emitRM("PUSH", ac, 0, sp, "store env");
-			}
+			pushEnv(current_fuction_level, call_function_level);
 
 			emitComment("call function: ");
 			emitComment(tree->attr.name);
 			jumpToFunction(tree, NULL, scope);
 			popParam(p);
-			emitRM("LDA", sp, 1, sp, "pop env");
+			emitRM(opLDA, sp, 1, sp, "pop env");
 			if (ftype.StructFunction){
-				emitRM("LDA", sp, 1, sp, "pop parameters");
+				emitRM(opLDA, sp, 1, sp, "pop parameters");
 			}
 			break;
 		}
@@ -480,15 +445,15 @@ static void genExp( TreeNode * tree,int scope,int start_label,int end_label,bool
 				origin_reg = get_reg(getBasicType(p1->converted_type));
 				target_reg = get_reg(getBasicType(type));
 				
-				emitRM("POP", origin_reg, 0, mp, "pop right");
-				emitRO("MOV", target_reg, origin_reg, 0, "convert type");
+				emitRM(opPOP, origin_reg, 0, mp, "pop right");
+				emitRO(moveOp(getBasicType(p1->converted_type), getBasicType(type)), target_reg, origin_reg, 0, "convert type");
 			}
 
 			switch (tree->attr.op)
 			{
                 case NEG:
-                    emitRO("NEG", target_reg, 0, 0, "single op (-)");// fac = -fac || ac = -ac
-                    emitRM("PUSH", target_reg, 0, mp, "op: load left"); //reg[ac1] = mem[reg[mp] + tmpoffset]
+                    emitRO(arithOp(opNEG, getBasicType(type)), target_reg, 0, 0, "single op (-)");// fac = -fac || ac = -ac
+                    emitRM(opPUSH, target_reg, 0, mp, "op: load left"); //reg[ac1] = mem[reg[mp] + tmpoffset]
                     break;
 				case MMINUS:
 				case PPLUS:// ++x => x = x + 1 || --x => x - 1
@@ -529,28 +494,26 @@ static void genExp( TreeNode * tree,int scope,int start_label,int end_label,bool
 					if (checkInAdressMode())
 					{
 						cGenInValueMode(p1, scope, start_label, end_label);
-						emitRM("POP", ac, 0, mp, "pop the adress");
+						emitRM(opPOP, ac, 0, mp, "pop the adress");
 					}
 					else
 					{
 						cGenInValueMode(p1, scope, start_label, end_label);
-						emitRM("POP", ac, 0, mp, "pop the adress");
+						emitRM(opPOP, ac, 0, mp, "pop the adress");
 						vsize = var_size_of(tree);
 						TypeInfo ptype = *p1->converted_type.point_type.pointKind;
 						TypeInfo ptype_ori = *p1->type.point_type.pointKind;
-						target_reg = get_reg1(ptype.typekind);
-						origin_reg = get_reg1(ptype_ori.typekind);
-						cGenPushTemp(vsize, target_reg, origin_reg, ac);
+						cGenPushTemp(vsize, ptype.typekind, ptype_ori.typekind, ac);
 					}
 					break;
 				case CONVERSION:		
-					emitRM("PUSH",target_reg,0,mp,"");
+					emitRM(opPUSH,target_reg,0,mp,"");
 					break;
 				case SIZEOF:
 					target_reg = get_reg(getBasicType(type));
-					emitRO("LDC", ac, var_size_of_type(tree->return_type), 0, "load size of exp");
-					emitRO("MOV", target_reg, ac, 0, "");
-					emitRM("PUSH",target_reg, 0,mp,"");
+					emitRO(opLDC, ac, var_size_of_type(tree->return_type), 0, "load size of exp");
+					emitRO(moveOp(Integer, getBasicType(type)), target_reg, ac, 0, "");
+					emitRM(opPUSH,target_reg, 0,mp,"");
 					break;
 				default:
                     assert(!"not implemented single op");
@@ -588,23 +551,24 @@ static void genExp( TreeNode * tree,int scope,int start_label,int end_label,bool
 				cGenInAdressMode(tree->child[0], scope, start_label, end_label);
 			}
 
-			cGenInValueMode(tree->child[1], scope,start_label,end_label);
-			emitRM("POP", ac, 0, mp, "load index value to ac");
-			emitRO("LDC", ac1, vsize, 0, "load array size");
-			emitRO("MUL", ac, ac1, ac, "compute the offset");
+			if (!cgenValueInReg(tree->child[1], Integer))
+			{
+				cGenInValueMode(tree->child[1], scope, start_label, end_label);
+				emitRM(opPOP, ac, 0, mp, "load index value to ac");
+			}
+			emitRO(opLDC, ac1, vsize, 0, "load array size");
+			emitRO(opMUL, ac, ac1, ac, "compute the offset");
 
-			emitRM("POP", ac1, 0, mp, "load lhs adress to ac1");
-			emitRO("ADD", ac, ac, ac1, "compute the real index adress a[index]");
+			emitRM(opPOP, ac1, 0, mp, "load lhs adress to ac1");
+			emitRO(opADD, ac, ac, ac1, "compute the real index adress a[index]");
 			
 			if (!adress_mode)
 			{
-				origin_reg = get_reg1(getBasicType(tree->type));
-				target_reg = get_reg1(getBasicType(tree->converted_type));
-				cGenPushTemp(vsize, target_reg, origin_reg, ac);
+				cGenPushTemp(vsize, getBasicType(tree->converted_type), getBasicType(tree->type), ac);
 			}
 			else
 			{
-				emitRM("PUSH", ac, 0, mp, "push the adress mode into mp");
+				emitRM(opPUSH, ac, 0, mp, "push the adress mode into mp");
 			}
 			break;
 		case ArrowK:
@@ -613,20 +577,10 @@ static void genExp( TreeNode * tree,int scope,int start_label,int end_label,bool
 			{
 				cGenInValueMode(tree->child[0], scope, start_label, end_label);//get pointer
 				getRealAdressBy(tree);
-				emitRM("POP", ac, 0, mp, "load adress from mp");
+				emitRM(opPOP, ac, 0, mp, "load adress from mp");
 				// now need to produce the real value rather than Adress
-				origin_reg = get_reg1(getBasicType(tree->type));
-				target_reg = get_reg1(getBasicType(tree->converted_type));
 				vsize = var_size_of(tree);
-
-				for (int i = 0; i < vsize; ++i)
-				{
-					// move bytes tmpOffset to tmpOffset
-					// todo optimize
-					emitRM("LD", origin_reg, i, ac, "copy bytes");//reg[ac] =  dMem[reg[ac]]
-					emitRO("MOV", target_reg, origin_reg, 0, "move register ");
-					emitRM("PUSH", target_reg, 0, mp, "push a.x value into tmp");
-				}
+				cGenPushTemp(vsize, getBasicType(tree->converted_type), getBasicType(tree->type), ac);
 			}
 			else
 			{
@@ -642,19 +596,10 @@ static void genExp( TreeNode * tree,int scope,int start_label,int end_label,bool
 			{
 				cGenInAdressMode(tree->child[0], scope,start_label,end_label);//generate the adress
 				getRealAdressBy(tree);
-				emitRM("POP", ac, 0, mp, "load adress from mp");
+				emitRM(opPOP, ac, 0, mp, "load adress from mp");
 				// now need to produce the real value rather than Adress
-				origin_reg = get_reg1(getBasicType(tree->type));
-				target_reg = get_reg1(getBasicType(tree->converted_type));
 				vsize = var_size_of(tree);
-				
-				for (int i = 0; i < vsize; ++i)
-				{
-					// move bytes tmpOffset to tmpOffset
-					emitRM("LD", origin_reg, i, ac, "copy bytes");//reg[ac] =  dMem[reg[ac]]
-					emitRO("MOV", target_reg, origin_reg, 0, "move register ");
-					emitRM("PUSH", target_reg, 0, mp, "push a.x value into tmp");
-				}
+				cGenPushTemp(vsize, getBasicType(tree->converted_type), getBasicType(tree->type), ac);
 			}
 			else
 			{
@@ -665,7 +610,10 @@ static void genExp( TreeNode * tree,int scope,int start_label,int end_label,bool
 			break;
 		case OpK :
             if (TraceCode) emitComment("-> Op") ;
-			cgenOp(tree->child[0],tree->child[1], tree->attr.op, scope, start_label, end_label);
+			if (tree->attr.op == AND || tree->attr.op == OR)
+				cgenLogicValue(tree, scope);
+			else if (!cgenOpInRegs(tree))
+				cgenOp(tree->child[0],tree->child[1], tree->attr.op, scope, start_label, end_label);
             if (TraceCode)  emitComment("<- Op") ;
             break; /* OpK */
             
@@ -680,6 +628,7 @@ static void genExp( TreeNode * tree,int scope,int start_label,int end_label,bool
 static void cGen( TreeNode * tree,int scope,int start_label,int end_label,bool in_adress_mode)
 { if (tree != NULL)
 	{ 
+		emitLine(tree->lineno);
 		switch (tree->nodekind) 
 		{
 			case StmtK:
@@ -703,26 +652,27 @@ void codeGen(TreeNode * syntaxTree, char * codefile)
      emitComment(s);
     /* generate st\andard prelude */
     emitComment("Standard prelude:");
-	emitRM("LDC", mp, MP_ADRESS, 0, "load mp adress");//reg[mp] = dMem[reg[ac]] 
-    emitRM("ST",ac,0,ac,"clear location 0");// dMem[reg[ac] + 0] = reg[ac]
+	emitRM(opLDC, mp, MP_ADRESS, 0, "load mp adress");//reg[mp] = dMem[reg[ac]] 
+    emitRM(opST,ac,0,ac,"clear location 0");// dMem[reg[ac] + 0] = reg[ac]
 	
-	emitRM("LDC", gp, GP_ADRESS, 0, "load gp adress from location 1");
-	emitRM("ST", ac, 1, ac, "clear location 1");
+	emitRM(opLDC, gp, GP_ADRESS, 0, "load gp adress from location 1");
+	emitRM(opST, ac, 1, ac, "clear location 1");
 
-	emitRM("LDC", cp, CONST_ADRESS, 0, "load gp adress from location 1");
+	emitRM(opLDC, cp, CONST_ADRESS, 0, "load gp adress from location 1");
 
-	emitRM("LDC", fp, FIRST_FP, 0, "load first fp from location 2");
-	emitRM("LDC", sp, FIRST_FP, 0, "load first sp from location 2");
-	emitRM("ST", ac, 2, ac, "clear location 2");
+	emitRM(opLDC, fp, FIRST_FP, 0, "load first fp from location 2");
+	emitRM(opLDC, sp, FIRST_FP, 0, "load first sp from location 2");
+	emitRM(opST, ac, 2, ac, "clear location 2");
 
     emitComment("End of standard prelude.");
+	countCalls(syntaxTree);
 	/* generate code for TINY program */
 	cGen(syntaxTree,0,-1,-1,false);
 		
 	emitComment("call main function");
 	jumpToFunction(NULL,"main", 0);
 	//todo: check if in the MainModule
-	if (st_get_node("main") != NULL)	emitRO("HALT", 0, 0, 0, "");// finish
+	if (st_get_node("main") != NULL)	emitRO(opHALT, 0, 0, 0, "");// finish
 }
 
 int genLabel(void)
@@ -734,13 +684,13 @@ int genLabel(void)
 void emitLabel(int label)
 {
 	assert(label >= 0);
-	emitRO("LABEL", label++, 0, 0, "generate label");// finish
+	emitRO(opLAEBL, label++, 0, 0, "generate label");// finish
 }
 
 void emitGoto(int label)
 {
 	assert(label >= 0 );
-	emitRO("GO", label, 0, 0, "go to label");// finish
+	emitRO(opGO, label, 0, 0, "go to label");// finish
 }
 
 int get_reg(Type type)
@@ -768,6 +718,21 @@ int get_reg1(Type type)
 	return get_reg(type) + 1;
 }
 
+/* the float form of an arithmetic op is picked from the type here,
+   the machine runs every opcode as it is written */
+OPCODE arithOp(OPCODE op, Type type)
+{
+	if (get_reg(type) != fac) return op;
+	return op == opNEG ? opNEGF : (OPCODE)(opADDF + (op - opADD));
+}
+
+/* a value of type from moved into a register of type to */
+OPCODE moveOp(Type from, Type to)
+{
+	if (get_reg(from) == get_reg(to)) return opMOV;
+	return get_reg(to) == fac ? opCVTIF : opCVTFI;
+}
+
 int get_stack_bottom(int scope)
 {
 	assert(scope >= 0);
@@ -789,11 +754,9 @@ void pushParam(TreeNode * e,ParamNode * p,int scope)
 	emitComment("push function parameters");
 	genExp(e, scope,-1,-1,false);// very important! cannot use cGen to avoid cGen generate exp list automatically
 
-	int exp_reg = get_reg(getBasicType(e->converted_type));
-	int par_reg = get_reg(getBasicType(*p->type));
 	int vsize = var_size_of(e);
 	if (is_basic_type(e->type, Array)) vsize = 1;
-	cgenPushObj(exp_reg, par_reg, vsize);
+	cgenPushObj(getBasicType(e->converted_type), getBasicType(*p->type), vsize);
 }
 /*pop parameters*/
 void popParam(ParamNode * p)
@@ -805,7 +768,7 @@ void popParam(ParamNode * p)
 		p = p->next_param;
 	}
 
-	emitRM("LDA",sp, param_size, sp, "pop parameters");
+	emitRM(opLDA,sp, param_size, sp, "pop parameters");
 }
 
 void setInAdressMode()
@@ -833,21 +796,25 @@ void getRealAdressBy( TreeNode* tree)
 	}
 	Member* member = getMember(stype, tree->attr.name);
 	int offset = member->offset;
-	emitRO("POP", ac1, 0, mp, "load adress of lhs struct");
-	emitRO("LDC", ac, offset, 0, "load offset of member");
-	emitRO("ADD", ac, ac, ac1, "compute the real adress if pointK");
-	emitRM("PUSH", ac, 0, mp, "");
+	emitRO(opPOP, ac1, 0, mp, "load adress of lhs struct");
+	emitRO(opLDC, ac, offset, 0, "load offset of member");
+	emitRO(opADD, ac, ac, ac1, "compute the real adress if pointK");
+	emitRM(opPUSH, ac, 0, mp, "");
 }
 
 void cgen_assign(TreeNode * left, TreeNode * right, int scope)
 {
-	cGenInValueMode(right, scope, -1, -1);// load value 
-
 	// emit COPY tmp to dMem[reg[(gp or fp) + loc] from tmpOffset(in reverse) vsize bytes
-	int origin_reg = get_reg(getBasicType(right->converted_type));
-	int target_reg = get_reg(getBasicType(left->converted_type));
+	Type origin_type = getBasicType(right->converted_type);
+	Type target_type = getBasicType(left->converted_type);
+	int target_reg = get_reg(target_type);
 	int vsize = var_size_of(left);
 
+	// a scalar stored to a variable waits in a temporary, its adress needs none
+	int value_reg = -1;
+	if (vsize == 1 && (isExp(left, IdK) || isStmt(left, DeclareK))) value_reg = cgenValueInTmp(right);
+	if (value_reg == -1) cGenInValueMode(right, scope, -1, -1);// load value 
+
 	if (isExp(left,IdK) || isStmt(left,DeclareK))
 	{
 		//IDKӦĴ,ΪͳһǶױ
@@ -857,14 +824,14 @@ void cgen_assign(TreeNode * left, TreeNode * right, int scope)
 		left->kind.exp = IdK;
 		left->nodekind = ExpK;
 		genExp(left, scope, -1, -1, 1);
-		emitRM("POP", ac1, 0, mp, "move the adress of ID");
+		emitRM(opPOP, ac1, 0, mp, "move the adress of ID");
 		left->kind.exp = old_kind;
 		left->nodekind = old_stmt;
 
 		/*char * name = left->attr.name;
 		int loc = st_lookup(name);// get the memory location of identifier
 		int var_stack_bottom = get_stack_bottom(st_lookup_scope(name));
-		emitRM("LDA", ac1, loc, var_stack_bottom, "move the adress of ID");*/
+		emitRM(opLDA, ac1, loc, var_stack_bottom, "move the adress of ID");*/
 	}
 	else if (isExp(left, SingleOpK))
 	{
@@ -872,15 +839,23 @@ void cgen_assign(TreeNode * left, TreeNode * right, int scope)
 		// todo run in the adress mode
 		assert(left->attr.op == UNREF || !"illegal left operand on assign");
 		genExp(left->child[0], scope, -1, -1,1);
-		emitRM("POP", ac1, 0, mp, "move the adress of referenced");
+		emitRM(opPOP, ac1, 0, mp, "move the adress of referenced");
 	}
 	else if (isExp(left, IndexK) || isExp(left,PointK) || isExp(left,ArrowK))
 	{
 		//cGenInValueMode(left, scope, -1, -1, "f");
 		genExp(left, scope, -1, -1,1);
-		emitRM("POP", ac1, 0, mp, "move the adress of referenced");
+		emitRM(opPOP, ac1, 0, mp, "move the adress of referenced");
+	}
+
+	if (value_reg != -1)
+	{
+		emitRO(moveOp(origin_type, target_type), target_reg, value_reg, 0, "convert type");
+		emitRM(opST, target_reg, 0, ac1, "assign: store value");
+		freeTmp(value_reg);
+		return;
 	}
-	cgenCopyObj(origin_reg, target_reg, vsize, ac1);
+	cgenCopyObj(origin_type, target_type, vsize, ac1);
 }
 
 void cgenOp(TreeNode * left,TreeNode * right,TokenType op, int scope,int start_label, int end_label)
@@ -901,24 +876,24 @@ void cgenOp(TreeNode * left,TreeNode * right,TokenType op, int scope,int start_l
 		case PLUS:
 		case PPLUS:
 		case PLUSASSIGN:
-			emitRM("POP", ac, 0, mp, "load index value to ac");
-			emitRO("LDC", ac1, vsize, 0, "load pointkind size");
-			emitRO("MUL", ac, ac1, ac, "compute the offset");
+			emitRM(opPOP, ac, 0, mp, "load index value to ac");
+			emitRO(opLDC, ac1, vsize, 0, "load pointkind size");
+			emitRO(opMUL, ac, ac1, ac, "compute the offset");
 
-			emitRM("POP", ac1, 0, mp, "load lhs adress to ac1");
-			emitRO("ADD", ac, ac1, ac, "compute the real index adress");
-			emitRM("PUSH", ac, 0, mp, "op: load left"); //reg[ac1] = mem[reg[mp] + tmpoffset]
+			emitRM(opPOP, ac1, 0, mp, "load lhs adress to ac1");
+			emitRO(opADD, ac, ac1, ac, "compute the real index adress");
+			emitRM(opPUSH, ac, 0, mp, "op: load left"); //reg[ac1] = mem[reg[mp] + tmpoffset]
 			return;
 		case MINUS:
 		case MMINUS:
 		case MINUSASSIGN:
-			emitRM("POP", ac, 0, mp, "load index value to ac");
-			emitRO("LDC", ac1, vsize, 0, "load pointkind size");
-			emitRO("MUL", ac, ac1, ac, "compute the offset");
+			emitRM(opPOP, ac, 0, mp, "load index value to ac");
+			emitRO(opLDC, ac1, vsize, 0, "load pointkind size");
+			emitRO(opMUL, ac, ac1, ac, "compute the offset");
 
-			emitRM("POP", ac1, 0, mp, "load lhs adress to ac1");
-			emitRO("SUB", ac, ac1, ac, "compute the real index adress");
-			emitRM("PUSH", ac, 0, mp, "op: load left"); //reg[ac1] = mem[reg[mp] + tmpoffset]
+			emitRM(opPOP, ac1, 0, mp, "load lhs adress to ac1");
+			emitRO(opSUB, ac, ac1, ac, "compute the real index adress");
+			emitRM(opPUSH, ac, 0, mp, "op: load left"); //reg[ac1] = mem[reg[mp] + tmpoffset]
 			return;
 		}
 	}
@@ -927,106 +902,1299 @@ void cgenOp(TreeNode * left,TreeNode * right,TokenType op, int scope,int start_l
 	int origin_reg1 = get_reg1(getBasicType(p2->converted_type));
 	int reg = get_reg(getBasicType(type));
 	int reg1 = get_reg1(getBasicType(type));
+	Type optype = getBasicType(type);
 
-	emitRM("POP", origin_reg1, 0, mp, "pop right");
-	emitRO("MOV", reg1, origin_reg1, 0, "convert type");
+	emitRM(opPOP, origin_reg1, 0, mp, "pop right");
+	emitRO(moveOp(getBasicType(p2->converted_type), optype), reg1, origin_reg1, 0, "convert type");
 
-	emitRM("POP", origin_reg, 0, mp, "pop left");
-	emitRO("MOV", reg, origin_reg, 0, "convert type");
+	emitRM(opPOP, origin_reg, 0, mp, "pop left");
+	emitRO(moveOp(getBasicType(p1->converted_type), optype), reg, origin_reg, 0, "convert type");
 	
 	switch (op)
 	{
 	case PPLUS:
 	case PLUSASSIGN:
 	case PLUS:
-		emitRO("ADD", reg, reg, reg1, "op +");// ac = ac1 op ac
-		emitRM("PUSH", reg, 0, mp, "op: load left"); //reg[ac1] = mem[reg[mp] + tmpoffset]
+		emitRO(arithOp(opADD, optype), reg, reg, reg1, "op +");// ac = ac1 op ac
+		emitRM(opPUSH, reg, 0, mp, "op: load left"); //reg[ac1] = mem[reg[mp] + tmpoffset]
 		break;
 	case MMINUS:
 	case MINUSASSIGN:
 	case MINUS:
-		emitRO("SUB", reg, reg, reg1, "op -");
-		emitRM("PUSH", reg, 0, mp, "op: load left"); //reg[ac1] = mem[reg[mp] + tmpoffset]
+		emitRO(arithOp(opSUB, optype), reg, reg, reg1, "op -");
+		emitRM(opPUSH, reg, 0, mp, "op: load left"); //reg[ac1] = mem[reg[mp] + tmpoffset]
 		break;
 	case TIMES:
-		emitRO("MUL", reg, reg, reg1, "op *");
-		emitRM("PUSH", reg, 0, mp, "op: load left"); //reg[ac1] = mem[reg[mp] + tmpoffset]
+		emitRO(arithOp(opMUL, optype), reg, reg, reg1, "op *");
+		emitRM(opPUSH, reg, 0, mp, "op: load left"); //reg[ac1] = mem[reg[mp] + tmpoffset]
 		break;
 	case OVER:
-		emitRO("DIV", reg, reg, reg1, "op /");
-		emitRM("PUSH", reg, 0, mp, "op: load left"); //reg[ac1] = mem[reg[mp] + tmpoffset]
+		emitRO(arithOp(opDIV, optype), reg, reg, reg1, "op /");
+		emitRM(opPUSH, reg, 0, mp, "op: load left"); //reg[ac1] = mem[reg[mp] + tmpoffset]
 		break;
 	case MOD:
-		emitRO("MOD", reg, reg, reg1, "op %");
-		emitRM("PUSH", reg, 0, mp, "op: load left"); //reg[ac1] = mem[reg[mp] + tmpoffset]
+		emitRO(arithOp(opMOD, optype), reg, reg, reg1, "op %");
+		emitRM(opPUSH, reg, 0, mp, "op: load left"); //reg[ac1] = mem[reg[mp] + tmpoffset]
 		break;
 	case LT:
 	case GT:
 	case LE:
 	case GE:
 	{
-		char op_code[4] = "JLT";
-		if (op == LT || op == LE)
+		emitRO(arithOp(opSUB, optype), reg, reg, reg1, "op <");
+		emitRM(compareJump(op, FALSE, reg == fac), reg, 2, pc, "br if true");
+		emitRM(opLDC, ac, 0, ac, "false case");
+		emitRM(opLDA, pc, 1, pc, "unconditional jmp");
+		emitRM(opLDC, ac, 1, ac, "true case");
+		emitRM(opPUSH, ac, 0, mp, ""); //reg[ac1] = mem[reg[mp] + tmpoffset]
+		break;
+	}
+	case EQ:
+	case NOTEQ:
 		{
-			emitRO("SUB", reg, reg, reg1, "op <");
-			op_code[2] = (op == LT ? 'T' : 'E');
+		emitRO(arithOp(opSUB, optype), reg, reg, reg1, "op ==, convertd_type");
+		emitRM(compareJump(op, FALSE, reg == fac), reg, 2, pc, "br if true");
+		emitRM(opLDC, ac, 0, ac, "false case");
+		emitRM(opLDA, pc, 1, pc, "unconditional jmp");
+		emitRM(opLDC, ac, 1, ac, "true case");
+		emitRM(opPUSH, ac, 0, mp, ""); //reg[ac1] = mem[reg[mp] + tmpoffset]
+		break;
 		}
-		else
+	default:
+		emitComment("BUG: Unknown operator");
+		break;
+	} /* case op */
+}
+
+/**************  register allocation of expression temporaries  **************/
+/* a tree of scalar arithmetic and compares over ids and constants is
+ * evaluated in the temporaries itmp.. and ftmp.., only its value is pushed
+ * to mp, or moved straight to the register of a consumer that takes it from
+ * one (cgenValueInReg). The operand needing more registers goes first
+ * (Sethi-Ullman); when the other one needs every free temporary the value
+ * of the first is spilled to mp meanwhile. Trees over fields, elements or
+ * calls are left to cgenOp, which still allocates their subtrees.
+ */
+static int tmpInUse[2];// bitmask of busy temporaries: int, float
+
+static bool isRegType(TypeInfo t)
+{
+	Type k = getBasicType(t);
+	return k == Integer || k == Float || k == Char || k == Boolean;
+}
+
+static int allocTmp(int cls)
+{
+	int k = (cls == fac);
+	for (int i = 0; i < NUM_TMP; ++i)
+	{
+		if (!(tmpInUse[k] & (1 << i)))
 		{
-			emitRO("SUB", reg, reg, reg1, "op <");
-			op_code[1] = 'G';
-			op_code[2] = (op == GT ? 'T' : 'E');
+			tmpInUse[k] |= 1 << i;
+			return (k ? ftmp : itmp) + i;
 		}
+	}
+	assert(!"out of temporaries");
+	return -1;
+}
+
+static void freeTmp(int r)
+{
+	if (r >= ftmp) tmpInUse[1] &= ~(1 << (r - ftmp));
+	else tmpInUse[0] &= ~(1 << (r - itmp));
+}
+
+/* temporaries still free in the busier of the two classes */
+static int freeTmps(void)
+{
+	int busy = 0;
+	for (int k = 0; k < 2; ++k)
+	{
+		int n = 0;
+		for (int i = 0; i < NUM_TMP; ++i)
+			if (tmpInUse[k] & (1 << i)) n++;
+		if (n > busy) busy = n;
+	}
+	return NUM_TMP - busy;
+}
 
-		/* now the op_code is JLE,JLT,GLE,GLT*/
-		emitRM(op_code, ac, 2, pc, "br if true");
-		emitRM("LDC", ac, 0, ac, "false case");
-		emitRM("LDA", pc, 1, pc, "unconditional jmp");
-		emitRM("LDC", ac, 1, ac, "true case");
-		emitRM("PUSH", ac, 0, mp, ""); //reg[ac1] = mem[reg[mp] + tmpoffset]
+static bool isRegLeaf(TreeNode * t)
+{
+	if (!isRegType(t->type) || !isRegType(t->converted_type)) return FALSE;
+	if (isExp(t, ConstK)) return getBasicType(t->converted_type) != Boolean;
+	if (isExp(t, IdK)) return t->attr.name != NULL && st_lookup(t->attr.name) != NOTFOUND;
+	return FALSE;
+}
+
+static bool isRegCompare(TokenType op)
+{
+	return op == LT || op == GT || op == LE || op == GE || op == EQ || op == NOTEQ;
+}
+
+/* the jump taken when the difference of a compare satisfies op,
+ * or does not when negate is set. A float difference is tested as
+ * a float (-0 is 0, NaN satisfies only NOTEQ), it is never negated:
+ * not less is not greater or equal when NaN is around
+ */
+static OPCODE compareJump(TokenType op, bool negate, bool flt)
+{
+	OPCODE jump;
+	assert(!(flt && negate));
+	switch (op)
+	{
+	case LT: jump = negate ? opJGE : opJLT; break;
+	case LE: jump = negate ? opJGT : opJLE; break;
+	case GT: jump = negate ? opJLE : opJGT; break;
+	case GE: jump = negate ? opJLT : opJGE; break;
+	case EQ: jump = negate ? opJNE : opJEQ; break;
+	default: jump = negate ? opJEQ : opJNE; break;
+	}
+	return flt ? (OPCODE)(jump - opJLT + opJLTF) : jump;
+}
+
+/* registers needed to evaluate t in temporaries, 0 if it can not be */
+static int regNeed(TreeNode * t)
+{
+	if (isRegLeaf(t)) return 1;
+	if (!isExp(t, OpK)) return 0;
+	switch (t->attr.op)
+	{
+	case PLUS: case PPLUS: case PLUSASSIGN:
+	case MINUS: case MMINUS: case MINUSASSIGN:
+	case TIMES: case OVER: case MOD:
+	case LT: case GT: case LE: case GE: case EQ: case NOTEQ:
 		break;
+	default:
+		return 0;
 	}
-	case EQ:
-	case NOTEQ:
+
+	TreeNode * l = t->child[0];
+	TreeNode * r = t->child[1];
+	if (!isRegType(l->type) || !isRegType(l->converted_type) ||
+		!isRegType(r->type) || !isRegType(r->converted_type))
+		return 0;
+
+	int nl = regNeed(l), nr = regNeed(r);
+	if (nl == 0 || nr == 0) return 0;
+
+	int need = nl == nr ? nl + 1 : (nl > nr ? nl : nr);
+	int extra = 0;
+	int cls = get_reg(getBasicType(l->converted_type));
+	if (get_reg(getBasicType(r->converted_type)) != cls) extra++;// convert the right operand
+	if (isRegCompare(t->attr.op) && cls == fac) extra++;// int result of a float compare
+	return need > 2 + extra ? need : 2 + extra;
+}
+
+static int cgenInRegs(TreeNode * t);
+
+/* evaluate first then second into temporaries, the value of first
+ * waits on mp when second needs more than the free temporaries
+ */
+static void cgenPairInRegs(TreeNode * first, TreeNode * second, int * rf, int * rs)
+{
+	*rf = cgenInRegs(first);
+	if (regNeed(second) <= freeTmps())
+	{
+		*rs = cgenInRegs(second);
+		return;
+	}
+	emitRM(opPUSH, *rf, 0, mp, "spill the operand");
+	freeTmp(*rf);
+	*rs = cgenInRegs(second);
+	*rf = allocTmp(*rf >= ftmp ? fac : ac);
+	emitRM(opPOP, *rf, 0, mp, "reload the operand");
+}
+
+/* evaluate both operands of the OpK t into temporaries,
+ * returns the class they are computed in
+ */
+static int cgenOperandsInRegs(TreeNode * t, int * rl, int * rr)
+{
+	TreeNode * p1 = t->child[0];
+	TreeNode * p2 = t->child[1];
+	if (regNeed(p2) > regNeed(p1))
+		cgenPairInRegs(p2, p1, rr, rl);
+	else
+		cgenPairInRegs(p1, p2, rl, rr);
+
+	// operands are computed in the type of the left one, like cgenOp
+	int opcls = get_reg(getBasicType(p1->converted_type));
+	if (get_reg(getBasicType(p2->converted_type)) != opcls)
+	{
+		int rc = allocTmp(opcls);
+		emitRO(moveOp(getBasicType(p2->converted_type), getBasicType(p1->converted_type)), rc, *rr, 0, "convert type");
+		freeTmp(*rr);
+		*rr = rc;
+	}
+	return opcls;
+}
+
+/* evaluate t into a fresh temporary of the class of its converted_type */
+static int cgenInRegs(TreeNode * t)
+{
+	int cls = get_reg(getBasicType(t->converted_type));
+	int rd;
+
+	if (isExp(t, ConstK))
+	{
+		rd = allocTmp(cls);
+		switch (getBasicType(t->converted_type))
 		{
-		emitRO("SUB", reg, reg, reg1, "op ==, convertd_type");
-		emitRM(op == EQ ? "JEQ" : "JNE", ac, 2, pc, "br if true");
-		emitRM("LDC", ac, 0, ac, "false case");
-		emitRM("LDA", pc, 1, pc, "unconditional jmp");
-		emitRM("LDC", ac, 1, ac, "true case");
-		emitRM("PUSH", ac, 0, mp, ""); //reg[ac1] = mem[reg[mp] + tmpoffset]
-		break;
+		case Float:
+			emitLDCF(opLDC, rd, float_from_node(t), 0, "load float const");
+			break;
+		case Char:
+			emitRM(opLDC, rd, t->attr.val.integer, 0, "load char const");
+			break;
+		default:
+			emitRM(opLDC, rd, integer_from_node(t), 0, "load integer const");
+			break;
+		}
+		return rd;
+	}
+
+	if (isExp(t, IdK))
+	{
+		int loc = st_lookup(t->attr.name);
+		int bottom = loadIdBase(t->attr.name);
+		int origin_reg = get_reg(getBasicType(t->type));
+		if (bottom == -1)
+		{
+			// walk the env chain in ac1, fp stays as it is
+			int delta = get_function_level(current_function) - st_lookup_level(t->attr.name);
+			emitRM(opLD, ac1, 1, fp, "load env");
+			while (delta-- > 0)
+				emitRM(opLD, ac1, 1, ac1, "load env");
+			bottom = ac1;
 		}
-	case AND:
-		emitRM("JEQ", reg, 3, pc, "br if false");// lhs == 0,go to false case
-		emitRM("JEQ", reg1, 2, pc, "br if false");// rhs == 0,go to false case
-		emitRM("LDC", ac, 1, ac, "true case");
-		emitRM("LDA", pc, 1, pc, "unconditional jmp");
-		emitRM("LDC", ac, 0, ac, "false case");
-		emitRM("PUSH", ac, 0, mp, ""); //reg[ac1] = mem[reg[mp] + tmpoffset]
+		rd = allocTmp(cls);
+		if (origin_reg == cls)
+		{
+			emitRM(opLD, rd, loc, bottom, "load id value");
+		}
+		else
+		{
+			emitRM(opLD, origin_reg, loc, bottom, "load id value");
+			emitRO(moveOp(getBasicType(t->type), getBasicType(t->converted_type)), rd, origin_reg, 0, "convert type");
+		}
+		return rd;
+	}
+
+	TokenType op = t->attr.op;
+	int rl, rr;
+	int opcls = cgenOperandsInRegs(t, &rl, &rr);
+	Type optype = getBasicType(t->child[0]->converted_type);
+
+	switch (op)
+	{
+	case PPLUS:
+	case PLUSASSIGN:
+	case PLUS:
+		emitRO(arithOp(opADD, optype), rl, rl, rr, "op +");
 		break;
-	case OR:
-		emitRM("JNE", reg, 3, pc, "br if true");// lhs == 1,go to true case
-		emitRM("JNE", reg1, 2, pc, "br if true");// rhs == 1,go to true case
-		emitRM("LDC", ac, 0, ac, "false case");
-		emitRM("LDA", pc, 1, pc, "unconditional jmp");
-		emitRM("LDC", ac, 1, ac, "true case");
-		emitRM("PUSH", ac, 0, mp, ""); //reg[ac1] = mem[reg[mp] + tmpoffset]
+	case MMINUS:
+	case MINUSASSIGN:
+	case MINUS:
+		emitRO(arithOp(opSUB, optype), rl, rl, rr, "op -");
+		break;
+	case TIMES:
+		emitRO(arithOp(opMUL, optype), rl, rl, rr, "op *");
+		break;
+	case OVER:
+		emitRO(arithOp(opDIV, optype), rl, rl, rr, "op /");
+		break;
+	case MOD:
+		emitRO(arithOp(opMOD, optype), rl, rl, rr, "op %");
 		break;
 	default:
-		emitComment("BUG: Unknown operator");
+	{
+		OPCODE op_code = compareJump(op, FALSE, opcls == fac);
+		// the sign of the difference is tested in its own register, float or not
+		int res = opcls == fac ? allocTmp(ac) : rl;
+		emitRO(arithOp(opSUB, optype), rl, rl, rr, "op compare");
+		emitRM(op_code, rl, 2, pc, "br if true");
+		emitRM(opLDC, res, 0, 0, "false case");
+		emitRM(opLDA, pc, 1, pc, "unconditional jmp");
+		emitRM(opLDC, res, 1, 0, "true case");
+		if (res != rl)
+		{
+			freeTmp(rl);
+			rl = res;
+		}
 		break;
-	} /* case op */
+	}
+	}
+	freeTmp(rr);
+	return rl;
+}
+
+/* evaluate t into a temporary the caller frees, -1 when t is left to genExp */
+int cgenValueInTmp(TreeNode * t)
+{
+	if (regNeed(t) == 0) return -1;
+	assert(tmpInUse[0] == 0 && tmpInUse[1] == 0);
+	return cgenInRegs(t);
+}
+
+/* evaluate t into the register of type for a consumer that takes the value
+ * from a register, returns FALSE when t is left to genExp and its value is on mp
+ */
+bool cgenValueInReg(TreeNode * t, Type type)
+{
+	int r = cgenValueInTmp(t);
+	if (r == -1) return FALSE;
+	emitRO(moveOp(getBasicType(t->converted_type), type), get_reg(type), r, 0, "move the value");
+	freeTmp(r);
+	return TRUE;
+}
+
+/* returns FALSE when the tree is left to cgenOp */
+bool cgenOpInRegs(TreeNode * tree)
+{
+	int r = cgenValueInTmp(tree);
+	if (r == -1) return FALSE;
+	emitRM(opPUSH, r, 0, mp, "store exp");
+	freeTmp(r);
+	return TRUE;
+}
+
+/**************  short-circuit conditions  **************/
+/* cgenBranch jumps to label when the truth of t is jumpIf and falls
+ * through otherwise. && and || test their right operand only when the
+ * left one does not decide, compares jump on the sign of the difference
+ * without building a 0/1 value. A plain value is tested in the register
+ * of type, or as the raw word popped into ac when type is ErrorType.
+ */
+static void cgenBranch(TreeNode * t, bool jumpIf, int label, Type type, int scope)
+{
+	int truth;
+	if (constTruth(t, &truth))
+	{
+		if (truth == jumpIf) emitGoto(label);
+		return;
+	}
+
+	if (isExp(t, OpK) && (t->attr.op == AND || t->attr.op == OR))
+	{
+		// the operands are tested in the type of the left one, like cgenOp did
+		Type optype = getBasicType(t->child[0]->converted_type);
+		bool decide = (t->attr.op == OR);// the value of the left operand that decides
+		if (decide == jumpIf)
+		{
+			cgenBranch(t->child[0], jumpIf, label, optype, scope);
+			cgenBranch(t->child[1], jumpIf, label, optype, scope);
+		}
+		else
+		{
+			int skip_label = genLabel();
+			cgenBranch(t->child[0], decide, skip_label, optype, scope);
+			cgenBranch(t->child[1], jumpIf, label, optype, scope);
+			emitLabel(skip_label);
+		}
+		return;
+	}
+
+	if (isExp(t, OpK) && isRegCompare(t->attr.op))
+	{
+		int rl, rr;
+		Type optype = getBasicType(t->child[0]->converted_type);
+		bool flt = get_reg(optype) == fac;
+		if (regNeed(t) != 0)
+		{
+			assert(tmpInUse[0] == 0 && tmpInUse[1] == 0);
+			cgenOperandsInRegs(t, &rl, &rr);
+			freeTmp(rr);
+			freeTmp(rl);
+		}
+		else
+		{
+			TreeNode * p1 = t->child[0];
+			TreeNode * p2 = t->child[1];
+			int origin_reg = get_reg(getBasicType(p1->converted_type));
+			int origin_reg1 = get_reg1(getBasicType(p2->converted_type));
+			rl = get_reg(getBasicType(p1->converted_type));
+			rr = get_reg1(getBasicType(p1->converted_type));
+
+			cGenInValueMode(p1, scope, -1, -1);
+			cGenInValueMode(p2, scope, -1, -1);
+			emitRM(opPOP, origin_reg1, 0, mp, "pop right");
+			emitRO(moveOp(getBasicType(p2->converted_type), optype), rr, origin_reg1, 0, "convert type");
+			emitRM(opPOP, origin_reg, 0, mp, "pop left");
+			emitRO(opMOV, rl, origin_reg, 0, "convert type");
+		}
+		emitRO(arithOp(opSUB, optype), rl, rl, rr, "op compare");
+		if (flt && jumpIf)
+		{
+			// no float jump is taken on NaN, so the true case jumps over the skip
+			emitRM(compareJump(t->attr.op, FALSE, TRUE), rl, 1, pc, "br if true");
+			emitRM(opLDA, pc, 1, pc, "skip the jump");
+		}
+		else
+			emitRM(compareJump(t->attr.op, jumpIf, flt), rl, 1, pc, "skip the jump");
+		emitGoto(label);
+		return;
+	}
+
+	int reg = type == ErrorType ? -1 : get_reg(type);
+	int r = cgenValueInTmp(t);
+	if (r != -1)
+	{
+		// the raw word is tested in the temporary itself
+		if (reg == -1) reg = r;
+		else emitRO(moveOp(getBasicType(t->converted_type), type), reg, r, 0, "convert type");
+		freeTmp(r);
+	}
+	else if (reg == -1)
+	{
+		cGenInValueMode(t, scope, -1, -1);
+		reg = ac;
+		emitRM(opPOP, ac, 0, mp, "pop from the mp");
+	}
+	else
+	{
+		cGenInValueMode(t, scope, -1, -1);
+		int origin_reg = get_reg(getBasicType(t->converted_type));
+		emitRM(opPOP, origin_reg, 0, mp, "pop condition");
+		emitRO(moveOp(getBasicType(t->converted_type), type), reg, origin_reg, 0, "convert type");
+	}
+	emitRM(jumpIf ? opJEQ : opJNE, reg, 1, pc, "skip the jump");
+	emitGoto(label);
+}
+
+/* the 0/1 value of && and || */
+static void cgenLogicValue(TreeNode * t, int scope)
+{
+	int false_label = genLabel();
+	int value_end_label = genLabel();
+	cgenBranch(t, FALSE, false_label, ErrorType, scope);
+	emitRM(opLDC, ac, 1, 0, "true case");
+	emitGoto(value_end_label);
+	emitLabel(false_label);
+	emitRM(opLDC, ac, 0, 0, "false case");
+	emitLabel(value_end_label);
+	emitRM(opPUSH, ac, 0, mp, "store exp");
+}
+
+/**************  switch  **************/
+/* the switch value is evaluated once. When every case in front of the
+ * default is an integer or char constant, the value in ac is dispatched
+ * by a jump table (dense cases) or a binary decision tree (sparse ones),
+ * otherwise the cases are evaluated and compared in order. The first
+ * case equal to the value wins, like the chain of tests always did.
+ */
+#define CASE_TABLE_MIN 4     /* fewer cases do not pay for a table */
+#define CASE_TABLE_DENSITY 2 /* table entries allowed per case */
+#define CASE_LINEAR_MAX 3    /* cases compared one by one at a leaf of the tree */
+
+typedef struct {
+	int value;
+	int label;
+	int order; /* position in the switch, the first of equal cases wins */
+} CASEENTRY;
+
+static bool isConstCase(TreeNode * t)
+{
+	if (!isExp(t, ConstK)) return FALSE;
+	Type k = getBasicType(t->type);
+	Type ck = getBasicType(t->converted_type);
+	return (k == Integer || k == Char || k == Boolean) && (ck == Integer || ck == Char || ck == Boolean);
+}
+
+static int compareCase(const void * a, const void * b)
+{
+	const CASEENTRY * x = (const CASEENTRY *)a;
+	const CASEENTRY * y = (const CASEENTRY *)b;
+	if (x->value != y->value) return x->value < y->value ? -1 : 1;
+	return x->order - y->order;
+}
+
+/* jump to the label of the case equal to ac, to default_label if none is.
+ * The differences can not overflow when the values span less than 2^31,
+ * otherwise every case is compared in turn
+ */
+static void cgenCaseTree(CASEENTRY * cases, int n, int default_label, bool linear)
+{
+	if (linear || n <= CASE_LINEAR_MAX)
+	{
+		for (int i = 0; i < n; ++i)
+		{
+			emitRM(opLDA, ac1, (int)(0u - (unsigned)cases[i].value), ac, "switch value - case");
+			emitRM(opJNE, ac1, 1, pc, "skip if not equal");
+			emitGoto(cases[i].label);
+		}
+		emitGoto(default_label);
+		return;
+	}
+
+	int mid = n / 2;
+	int lower_label = genLabel();
+	emitRM(opLDA, ac1, (int)(0u - (unsigned)cases[mid].value), ac, "switch value - pivot");
+	emitRM(opJGE, ac1, 1, pc, "skip if not below the pivot");
+	emitGoto(lower_label);
+	cgenCaseTree(cases + mid, n - mid, default_label, FALSE);
+	emitLabel(lower_label);
+	cgenCaseTree(cases, mid, default_label, FALSE);
+}
+
+/* index the table with ac - low, values out of the table go to default_label */
+static void cgenCaseTable(CASEENTRY * cases, int n, int range, int default_label)
+{
+	int * table = (int *)malloc(range * sizeof(int));
+	int low = cases[0].value;
+	for (int i = 0; i < range; ++i) table[i] = default_label;
+	for (int i = 0; i < n; ++i) table[(unsigned)cases[i].value - (unsigned)low] = cases[i].label;
+
+	emitRM(opLDA, ac, (int)(0u - (unsigned)low), ac, "index of the jump table");
+	emitRM(opJGE, ac, 1, pc, "skip if not below the table");
+	emitGoto(default_label);
+	emitRM(opLDA, ac1, -range, ac, "index - table size");
+	emitRM(opJLT, ac1, 1, pc, "skip if inside the table");
+	emitGoto(default_label);
+	emitJumpTable(ac, table, range, "switch jump table");
+	free(table);
+}
+
+void cgenSwitch(TreeNode * tree, int scope, int start_label, int end_label)
+{
+	int switch_end_label = genLabel();
+	int default_label = switch_end_label;
+	int n = 0, ncase = 0;
+	bool all_const = TRUE;
+	TreeNode * case_seq;
+
+	for (case_seq = tree->child[1]->child[0]; case_seq != NULL; case_seq = case_seq->sibling) n++;
+	TreeNode ** items = (TreeNode **)malloc(n * sizeof(TreeNode *));
+	int * body_label = (int *)malloc(n * sizeof(int));
+	n = 0;
+	for (case_seq = tree->child[1]->child[0]; case_seq != NULL; case_seq = case_seq->sibling)
+		items[n++] = case_seq;
+
+	/* a case without statements shares the body of the next one */
+	for (int i = n - 1; i >= 0; --i)
+	{
+		if (items[i]->child[1] != NULL || isStmt(items[i], DefaultK) || i == n - 1) body_label[i] = genLabel();
+		else body_label[i] = body_label[i + 1];
+	}
+
+	/* the default is the last one, cases are tested up to it */
+	while (ncase < n && !isStmt(items[ncase], DefaultK))
+	{
+		all_const = all_const && isConstCase(items[ncase]->child[0]);
+		ncase++;
+	}
+	if (ncase < n) default_label = body_label[ncase];
+
+	if (TraceCode) emitComment("-> switch");
+	if (all_const)
+	{
+		CASEENTRY * cases = (CASEENTRY *)malloc((ncase + 1) * sizeof(CASEENTRY));
+		int m = 0;
+		for (int i = 0; i < ncase; ++i)
+		{
+			cases[i].value = integer_from_node(items[i]->child[0]);
+			cases[i].label = body_label[i];
+			cases[i].order = i;
+		}
+		qsort(cases, ncase, sizeof(CASEENTRY), compareCase);
+		for (int i = 0; i < ncase; ++i)
+			if (m == 0 || cases[i].value != cases[m - 1].value) cases[m++] = cases[i];
+
+		if (!cgenValueInReg(tree->child[0], Integer))
+		{
+			cGenInValueMode(tree->child[0], scope + 1, start_label, end_label);
+			emitRM(opPOP, ac, 0, mp, "pop switch exp");
+		}
+		long long span = m == 0 ? 0 : (long long)cases[m - 1].value - cases[0].value + 1;
+		if (m >= CASE_TABLE_MIN && span <= (long long)CASE_TABLE_DENSITY * m)
+			cgenCaseTable(cases, m, (int)span, default_label);
+		else
+			cgenCaseTree(cases, m, default_label, span >= (1LL << 31));
+		free(cases);
+	}
+	else
+	{
+		/* the value stays on mp while the cases are evaluated */
+		cGenInValueMode(tree->child[0], scope + 1, start_label, end_label);
+		for (int i = 0; i < ncase; ++i)
+		{
+			cGenInValueMode(items[i]->child[0], scope + 1, start_label, end_label);// case exp;
+			emitRM(opPOP, ac, 0, mp, "pop case exp");
+			emitRM(opLD, ac1, 1, mp, "load switch exp");
+			emitRO(opSUB, ac, ac, ac1, "op ==, convertd_type");
+			emitRM(opJNE, ac, 2, pc, "skip if not statisfy");
+			emitRM(opLDA, mp, 1, mp, "drop switch exp");
+			emitGoto(body_label[i]);
+		}
+		emitRM(opLDA, mp, 1, mp, "drop switch exp");
+		emitGoto(default_label);
+	}
+
+	for (int i = 0; i < n; ++i)
+	{
+		if (i + 1 < n && body_label[i + 1] == body_label[i]) continue;
+		emitLabel(body_label[i]);
+		cGenInValueMode(items[i]->child[1], scope + 1, start_label, switch_end_label);// case stmt;
+		emitGoto(switch_end_label);
+		deleteVarOfField(items[i]->child[1], scope + 1);
+	}
+	emitLabel(switch_end_label);
+	if (TraceCode) emitComment("<- switch");
+
+	free(items);
+	free(body_label);
+}
+
+/**************  inlining  **************/
+/* a call of a function whose body is a single return e is replaced by a
+ * copy of e in which every parameter read is the constant or the id
+ * passed to it. e may read its parameters and globals, use self->member
+ * and call methods and global functions, so it means the same at the call
+ * site whatever the env level of the caller. An argument is read where the
+ * parameter was, so when e calls out the ids must be locals of the caller
+ * that nothing else can write. e may have InlineLimit nodes, twice as many
+ * when the function is called once in the module.
+ */
+#define MAX_INLINE 512
+#define MAX_INLINE_PARAMS 8
+#define MAX_CALL_NAMES 1024
+
+typedef struct {
+	TreeNode * decl;   /* the function, its body is return e */
+	char * sname;      /* struct of a method, NULL otherwise */
+	bool has_call;     /* e calls out */
+	bool self_arrow;   /* self is only read as self->member */
+	bool active;       /* being expanded, a call of it inside e stays a call */
+} INLINEFUNC;
+
+/* what the parameters become at one call site */
+typedef struct {
+	INLINEFUNC * f;
+	char * name[MAX_INLINE_PARAMS];
+	TreeNode * arg[MAX_INLINE_PARAMS];
+	int n;
+	TreeNode * self_struct;/* s of s.f(...), self->m is read as s.m */
+	int lineno;            /* of the call, the copy of e is on that line */
+} INLINESITE;
+
+typedef struct {
+	char * name;
+	int count;
+} CALLCOUNT;
+
+/* a method slot given another function somewhere in the module */
+typedef struct {
+	char * sname;
+	char * name;
+} METHODSLOT;
+
+static INLINEFUNC inlineTab[MAX_INLINE];
+static CALLCOUNT callCount[MAX_CALL_NAMES];
+static int callNameNum = 0;
+static METHODSLOT assignedSlot[MAX_CALL_NAMES];
+static int assignedSlotNum = 0;
+static bool assignedSlotFull = FALSE;// more than the table holds, every slot may be assigned
+
+static CALLCOUNT * findCallCount(char * name)
+{
+	for (int i = 0; i < callNameNum; ++i)
+		if (strcmp(callCount[i].name, name) == 0) return &callCount[i];
+	return NULL;
+}
+
+/* struct of the member s.m or p->m, NULL for anything else */
+static char * memberStruct(TreeNode * t)
+{
+	if (isExp(t, PointK)) return t->child[0]->type.sname;
+	if (isExp(t, ArrowK)) return t->child[0]->type.point_type.pointKind->sname;
+	return NULL;
+}
+
+static bool slotAssigned(char * sname, char * name)
+{
+	if (assignedSlotFull) return TRUE;
+	for (int i = 0; i < assignedSlotNum; ++i)
+		if (strcmp(assignedSlot[i].sname, sname) == 0 && strcmp(assignedSlot[i].name, name) == 0) return TRUE;
+	return FALSE;
+}
+
+/* a method slot that is assigned or whose adress is taken */
+static void addAssignedSlot(TreeNode * t)
+{
+	char * sname = memberStruct(t);
+	if (sname == NULL || !is_basic_type(t->type, Func) || slotAssigned(sname, t->attr.name)) return;
+	if (assignedSlotNum == MAX_CALL_NAMES)
+	{
+		assignedSlotFull = TRUE;
+		return;
+	}
+	assignedSlot[assignedSlotNum].sname = sname;
+	assignedSlot[assignedSlotNum++].name = t->attr.name;
+}
+
+static void countCallsIn(TreeNode * t)
+{
+	for (; t != NULL; t = t->sibling)
+	{
+		if (isExp(t, AssignK) || (isExp(t, SingleOpK) && t->attr.op == ADRESS))
+			addAssignedSlot(t->child[0]);
+		if (isExp(t, FuncallK) && t->attr.name != NULL)
+		{
+			CALLCOUNT * c = findCallCount(t->attr.name);
+			if (c == NULL && callNameNum < MAX_CALL_NAMES)
+			{
+				c = &callCount[callNameNum++];
+				c->name = t->attr.name;
+				c->count = 0;
+			}
+			if (c != NULL) c->count++;
+		}
+		for (int i = 0; i < MAXCHILDREN; ++i)
+			countCallsIn(t->child[i]);
+	}
+}
+
+/* calls of each name in the module, and the method slots it assigns */
+static void countCalls(TreeNode * t)
+{
+	callNameNum = 0;
+	assignedSlotNum = 0;
+	assignedSlotFull = FALSE;
+	countCallsIn(t);
+}
+
+static bool declaresFunction(TreeNode * t)
+{
+	for (; t != NULL; t = t->sibling)
+	{
+		if (t->nodekind == StmtK && t->kind.stmt == DeclareK && is_basic_type(t->type, Func)) return TRUE;
+		for (int i = 0; i < MAXCHILDREN; ++i)
+			if (declaresFunction(t->child[i])) return TRUE;
+	}
+	return FALSE;
+}
+
+static bool isParamOf(TreeNode * decl, char * name)
+{
+	for (TreeNode * p = decl->child[0]; p != NULL; p = p->sibling)
+		if (strcmp(p->attr.name, name) == 0) return TRUE;
+	return FALSE;
+}
+
+static bool isGlobalId(char * name)
+{
+	BucketList l = st_get_node(name);
+	return l != NULL && l->scope_depth == 0 && !l->struct_var;
+}
+
+/* nodes of e, -1 if it can not be inlined */
+static int inlineScan(TreeNode * t, TreeNode * parent, INLINEFUNC * f)
+{
+	int size = 0;
+	for (; t != NULL; t = t->sibling)
+	{
+		if (t->nodekind != ExpK) return -1;
+		switch (t->kind.exp)
+		{
+		case ConstK:
+			if (is_basic_type(t->type, String)) return -1;// the literal is emitted once
+			break;
+		case IdK:
+			if (!isParamOf(f->decl, t->attr.name))
+			{
+				if (!isGlobalId(t->attr.name)) return -1;
+			}
+			else if (f->sname != NULL && strcmp(t->attr.name, "self") == 0 &&
+				!(parent != NULL && isExp(parent, ArrowK) && parent->child[0] == t))
+				f->self_arrow = FALSE;
+			break;
+		case SingleOpK:
+			if (t->attr.op != NEG && t->attr.op != UNREF && t->attr.op != CONVERSION) return -1;
+			break;
+		case OpK:
+		case IndexK:
+		case PointK:
+		case ArrowK:
+			break;
+		case FuncallK:
+			if (isExp(t->child[1], IdK))
+			{
+				if (!isGlobalId(t->child[1]->attr.name)) return -1;
+			}
+			else if (!isExp(t->child[1], PointK) && !isExp(t->child[1], ArrowK)) return -1;
+			f->has_call = TRUE;
+			break;
+		default:
+			return -1;
+		}
+		for (int i = 0; i < MAXCHILDREN; ++i)
+		{
+			int k = inlineScan(t->child[i], t, f);
+			if (k == -1) return -1;
+			size += k;
+		}
+		size++;
+	}
+	return size;
+}
+
+/* called once the body of decl is generated */
+static void addInline(TreeNode * decl, int scope)
+{
+	TreeNode * body = decl->child[1];
+	INLINEFUNC f;
+	int n = 0, limit = InlineLimit;
+
+	if (InlineLimit <= 0 || inlineNum == MAX_INLINE) return;
+	if (body == NULL || body->sibling != NULL || !isStmt(body, ReturnK) || body->child[0] == NULL) return;
+	// the value is left in the class of the return type, as return does
+	TypeInfo return_type = *decl->type.func_type.return_type;
+	if (var_size_of_type(return_type) != 1 ||
+		get_reg(getBasicType(return_type)) != get_reg(getBasicType(body->child[0]->converted_type)))
+		return;
+	for (TreeNode * p = decl->child[0]; p != NULL; p = p->sibling, ++n)
+	{
+		if (n == MAX_INLINE_PARAMS || var_size_of_type(p->type) != 1 || is_basic_type(p->type, Array) ||
+			is_basic_type(p->type, Struct) || is_basic_type(p->type, Func))
+			return;
+	}
+
+	// the methods are the functions right in the struct
+	f.decl = decl;
+	f.sname = setStructInfo(NULL, 0);
+	f.has_call = FALSE;
+	f.self_arrow = TRUE;
+	f.active = FALSE;
+	if (f.sname != NULL && scope != 1) return;
+
+	CALLCOUNT * c = findCallCount(decl->attr.name);
+	if (c != NULL && c->count == 1) limit *= 2;
+	n = inlineScan(body->child[0], NULL, &f);
+	if (n == -1 || n > limit) return;
+	inlineTab[inlineNum++] = f;
+}
+
+static INLINEFUNC * findInline(TreeNode * call)
+{
+	TreeNode * callee = call->child[1];
+	BucketList l = NULL;
+	char * sname = NULL;
+
+	if (isExp(callee, IdK))
+	{
+		// the bucket of a function with a body shares its type with the declaration
+		l = st_get_node(callee->attr.name);
+		if (l == NULL || !is_basic_type(l->var_type, Func)) return NULL;
+	}
+	else if ((sname = memberStruct(callee)) == NULL) return NULL;
+	// a slot given another function calls whatever it holds
+	else if (slotAssigned(sname, callee->attr.name)) return NULL;
+
+	for (int i = inlineNum - 1; i >= 0; --i)
+	{
+		INLINEFUNC * f = &inlineTab[i];
+		if (l != NULL && f->sname == NULL &&
+			f->decl->type.func_type.return_type == l->var_type.func_type.return_type)
+			return f;
+		if (l == NULL && f->sname != NULL && sname != NULL &&
+			strcmp(f->sname, sname) == 0 && strcmp(f->decl->attr.name, callee->attr.name) == 0)
+			return f;
+	}
+	return NULL;
+}
+
+/* a local of the caller itself, only the caller writes it */
+static bool isPrivateLocal(char * name)
+{
+	int id_level = st_lookup_level(name);
+	return frame_private && st_lookup_scope(name) > 0 &&
+		!(id_level != 0 && id_level <= get_function_level(current_function));
+}
+
+/* the argument must hold the value the parameter would: no conversion on the way */
+static bool inlineArg(TreeNode * arg, TypeInfo ptype, bool has_call)
+{
+	int preg = get_reg(getBasicType(ptype));
+	if (get_reg(getBasicType(arg->type)) != preg || get_reg(getBasicType(arg->converted_type)) != preg)
+		return FALSE;
+	if (isExp(arg, ConstK))
+		return isRegType(arg->type) && getBasicType(arg->type) == getBasicType(ptype);
+	if (!isExp(arg, IdK) || st_lookup(arg->attr.name) == NOTFOUND) return FALSE;
+	if (var_size_of_type(arg->type) != 1 || is_basic_type(arg->type, Array) || is_basic_type(arg->type, Struct))
+		return FALSE;
+	return !has_call || isPrivateLocal(arg->attr.name);
+}
+
+/* the globals of e must not be hidden at the call site */
+static bool inlineNamesVisible(TreeNode * t, TreeNode * decl)
+{
+	for (; t != NULL; t = t->sibling)
+	{
+		if (isExp(t, IdK) && !isParamOf(decl, t->attr.name) && !isGlobalId(t->attr.name)) return FALSE;
+		for (int i = 0; i < MAXCHILDREN; ++i)
+			if (!inlineNamesVisible(t->child[i], decl)) return FALSE;
+	}
+	return TRUE;
+}
+
+static bool inlineSite(TreeNode * call, INLINESITE * site)
+{
+	INLINEFUNC * f = findInline(call);
+	if (f == NULL || f->active) return FALSE;
+	TreeNode * param = f->decl->child[0];
+	TreeNode * arg = call->child[0];
+
+	site->f = f;
+	site->n = 0;
+	site->self_struct = NULL;
+	site->lineno = call->lineno;
+	if (f->sname != NULL)
+	{
+		TreeNode * self = call->child[1]->child[0];
+		if (isExp(call->child[1], PointK))
+		{
+			// self would be the adress of the struct
+			if (!f->self_arrow || !isExp(self, IdK)) return FALSE;
+			site->self_struct = self;
+		}
+		else
+		{
+			if (!inlineArg(self, param->type, f->has_call)) return FALSE;
+			site->name[site->n] = param->attr.name;
+			site->arg[site->n++] = self;
+		}
+		param = param->sibling;
+	}
+	for (; param != NULL && arg != NULL; param = param->sibling, arg = arg->sibling)
+	{
+		if (!inlineArg(arg, param->type, f->has_call)) return FALSE;
+		site->name[site->n] = param->attr.name;
+		site->arg[site->n++] = arg;
+	}
+	return param == NULL && arg == NULL && inlineNamesVisible(f->decl->child[1]->child[0], f->decl);
+}
+
+static bool inlinable(TreeNode * call)
+{
+	INLINESITE site;
+	return inlineSite(call, &site);
+}
+
+static TreeNode * copyNode(TreeNode * t)
+{
+	TreeNode * c = (TreeNode *)malloc(sizeof(TreeNode));
+	*c = *t;
+	return c;
+}
+
+/* e with the parameters replaced */
+static TreeNode * inlineCopy(TreeNode * t, INLINESITE * site)
+{
+	TreeNode * c = NULL;
+	if (t == NULL) return NULL;
+	if (isExp(t, IdK))
+	{
+		for (int i = 0; i < site->n && c == NULL; ++i)
+		{
+			if (strcmp(site->name[i], t->attr.name) != 0) continue;
+			c = copyNode(site->arg[i]);
+			c->converted_type = t->converted_type;// read as the parameter was
+			if (isExp(c, ConstK) && !isRegType(c->converted_type)) c->converted_type = c->type;
+		}
+	}
+	if (c == NULL && site->self_struct != NULL && isExp(t, ArrowK) &&
+		isExp(t->child[0], IdK) && strcmp(t->child[0]->attr.name, "self") == 0)
+	{
+		c = copyNode(t);
+		c->kind.exp = PointK;
+		c->child[0] = copyNode(site->self_struct);
+		c->child[0]->sibling = NULL;
+	}
+	if (c == NULL)
+	{
+		c = copyNode(t);
+		for (int i = 0; i < MAXCHILDREN; ++i)
+			c->child[i] = inlineCopy(t->child[i], site);
+	}
+	c->lineno = site->lineno;
+	c->sibling = inlineCopy(t->sibling, site);
+	return c;
+}
+
+/* returns FALSE when the call is left to a normal call */
+static bool cgenInline(TreeNode * call, int scope)
+{
+	INLINESITE site;
+	if (!inlineSite(call, &site)) return FALSE;
+
+	TreeNode * e = inlineCopy(site.f->decl->child[1]->child[0], &site);
+	emitComment("inline call: ");
+	emitComment(call->attr.name);
+	site.f->active = TRUE;
+	cGenInValueMode(e, scope, -1, -1);
+	site.f->active = FALSE;
+	return TRUE;
+}
+
+/**************  display  **************/
+/* the display holds at cp + 1 + level the frame of the active function
+ * whose variables are at that level, next to the constants. Only the
+ * functions whose nested functions read them publish their frame: the entry
+ * they replace is kept in the frame at DISPLAY_SAVE and put back on
+ * return. A variable of an enclosing function is then one load away and
+ * so is the env of a nested function, the env chain is left for the
+ * levels no function publishes.
+ */
+static bool display_owner[MAX_DISPLAY];// the function generated at that level publishes its frame
+
+/* name is declared in the body t, the locals of nested functions aside */
+static bool declaresName(TreeNode * t, char * name)
+{
+	for (; t != NULL; t = t->sibling)
+	{
+		if (t->nodekind == StmtK && t->kind.stmt == DeclareK)
+		{
+			if (strcmp(t->attr.name, name) == 0) return TRUE;
+			if (is_basic_type(t->type, Func)) continue;
+		}
+		for (int i = 0; i < MAXCHILDREN; ++i)
+			if (declaresName(t->child[i], name)) return TRUE;
+	}
+	return FALSE;
+}
+
+static bool readsFrameOf(TreeNode * t, TreeNode * decl)
+{
+	for (; t != NULL; t = t->sibling)
+	{
+		if (isExp(t, IdK) && t->attr.name != NULL &&
+			(isParamOf(decl, t->attr.name) || declaresName(decl->child[1], t->attr.name)))
+			return TRUE;
+		for (int i = 0; i < MAXCHILDREN; ++i)
+			if (readsFrameOf(t->child[i], decl)) return TRUE;
+	}
+	return FALSE;
+}
+
+/* TRUE if a nested function in t may read a variable of decl, by name */
+static bool nestedReadsFrame(TreeNode * t, TreeNode * decl)
+{
+	for (; t != NULL; t = t->sibling)
+	{
+		if (t->nodekind == StmtK && t->kind.stmt == DeclareK && is_basic_type(t->type, Func))
+		{
+			if (readsFrameOf(t->child[1], decl)) return TRUE;
+			continue;
+		}
+		for (int i = 0; i < MAXCHILDREN; ++i)
+			if (nestedReadsFrame(t->child[i], decl)) return TRUE;
+	}
+	return FALSE;
+}
+
+/* a variable of an enclosing function */
+static bool isOuterId(char * name)
+{
+	int id_level = st_lookup_level(name);
+	return id_level != 0 && id_level <= get_function_level(current_function);
+}
+
+static bool inDisplay(char * name)
+{
+	int id_level = st_lookup_level(name);
+	return id_level < MAX_DISPLAY && display_owner[id_level];
+}
+
+/* the register name is adressed from, -1 when the env chain is needed */
+static int loadIdBase(char * name)
+{
+	if (!isOuterId(name)) return get_stack_bottom(st_lookup_scope(name));
+	if (!inDisplay(name)) return -1;
+	emitRM(opLD, ac1, st_lookup_level(name) + 1, cp, "enclosing frame from the display");
+	return ac1;
+}
+
+/* in the prologue, the frame is at fp */
+static bool enterDisplay(void)
+{
+	if (display_level == -1) return FALSE;
+	assert(display_level < MAX_DISPLAY);
+	bool last_owner = display_owner[display_level];
+	emitRM(opLD, ac1, display_level + 1, cp, "display entry of the level");
+	emitRM(opPUSH, ac1, 0, sp, "keep it in the frame");
+	emitRM(opST, fp, display_level + 1, cp, "publish the frame");
+	display_owner[display_level] = TRUE;
+	return last_owner;
+}
+
+static void leaveDisplay(bool last_owner)
+{
+	if (display_level != -1) display_owner[display_level] = last_owner;
+}
+
+/* before the frame is dropped */
+static void restoreDisplay(void)
+{
+	if (display_level == -1) return;
+	emitRM(opLD, ac1, DISPLAY_SAVE, fp, "display entry of the caller");
+	emitRM(opST, ac1, display_level + 1, cp, "restore the display");
+}
+
+/**************  tail calls  **************/
+/* return f(...) reuses the frame of the current function g: the env
+ * and the parameters of f are pushed as for a call, moved over those
+ * of g, the frame is dropped and f is entered with the return adress
+ * of g, so f returns straight to the caller of g. The caller pops the
+ * parameters of g, so only calls with the same parameter size qualify,
+ * and nothing may still point into the frame of g.
+ */
+static bool takesLocalAdress(TreeNode * t)
+{
+	for (; t != NULL; t = t->sibling)
+	{
+		if (isExp(t, SingleOpK) && t->attr.op == ADRESS) return TRUE;
+		if (t->nodekind == StmtK && (t->kind.stmt == DeclareK || t->kind.stmt == ParamK) &&
+			(is_basic_type(t->type, Array) || is_basic_type(t->type, Struct)))
+			return TRUE;
+		for (int i = 0; i < MAXCHILDREN; ++i)
+			if (takesLocalAdress(t->child[i])) return TRUE;
+	}
+	return FALSE;
+}
+
+/* words the caller pops after the call, -1 when an array is passed */
+static int paramSize(ParamNode * p)
+{
+	int size = 0;
+	for (; p != NULL; p = p->next_param)
+	{
+		if (is_basic_type(*p->type, Array)) return -1;
+		size += var_size_of_type(*p->type);
+	}
+	return size;
+}
+
+/* push the env of a function at call_level called from current_level */
+static void pushEnv(int current_level, int call_level)
+{
+	if (call_level == -1){
+		emitRM(opLDA, ac, 0, fp, "load env");//ע⵽,ﱣfp,spڱõʱѾ
+		emitRM(opPUSH, ac, 0, sp, "store env");
+	}
+	else if (current_level < call_level){
+		/*
+		def f #level 1
+		def g #level 2
+		end
+		g()
+		end
+		*/
+		emitRM(opLDA, ac, 0, fp, "load env");
+		emitRM(opPUSH, ac, 0, sp, "store env");
+	}
+	else if (call_level == 0){
+		// a global function never reads its env
+		emitRM(opLDA, ac, 0, fp, "load env");
+		emitRM(opPUSH, ac, 0, sp, "store env");
+	}
+	else if (call_level < MAX_DISPLAY && display_owner[call_level]){
+		emitRM(opLD, ac, call_level + 1, cp, "load env from the display");
+		emitRM(opPUSH, ac, 0, sp, "store env");
+	}
+	else{
+		/*
+		def f #level 1
+
+		end
+		
+		def g #level 1
+			def z #level 2
+			
+			f() # level 1
+			end
+		end
+		*/
+
+		/*
+		def f #level1
+		end
+
+		def g #level 1
+			f() # delta = 0
+		end
+		*/
+
+		int delta = current_level - call_level;// eg 0 or 1 or 2
+		// ĿҵӦenv, env -> env -> env ... -> fp, fp
+		emitRM(opLD, ac, 1, fp, "load env");// load env,pointing to the parent fp
+		while (delta-- > 0){
+			emitRM(opLD, ac, 1, ac, "load env1");// get 
+		}
+		emitRM(opPUSH, ac, 0, sp, "store env");
+	}
+}
+
+/* returns FALSE when the call is left to a normal call and return */
+static bool cgenTailCall(TreeNode * call, int scope)
+{
+	if (!tail_call_ok || !isExp(call, FuncallK) || strcmp(current_function, "main") == 0) return FALSE;
+	if (inlinable(call)) return FALSE;// cheaper still
+	int current_level = get_function_level(current_function);
+	int call_level = get_function_level(call->attr.name);
+	// an env made from the current fp would point into the dropped frame
+	if (current_level == -1 || call_level == -1 || current_level < call_level) return FALSE;
+
+	FuncType gtype = st_lookup_type(current_function).func_type;
+	FuncType ftype = call->child[1]->type.func_type;
+	if (ftype.StructFunction || gtype.StructFunction) return FALSE;
+	int psize = paramSize(ftype.params);
+	if (psize == -1 || psize != paramSize(gtype.params)) return FALSE;
+
+	// the value of f must need no conversion to the return type of g
+	TypeInfo return_type = *gtype.return_type;
+	if (var_size_of_type(return_type) == 1 &&
+		get_reg(getBasicType(call->converted_type)) != get_reg(getBasicType(return_type)))
+		return FALSE;
+
+	emitComment("tail call: ");
+	emitComment(call->attr.name);
+	pushParam(call->child[0], ftype.params, scope + 1);
+	pushEnv(current_level, call_level);
+	cGenInValueMode(call->child[1], scope, -1, -1);// now value in mp
+	if (psize > 0)
+	{
+		// the frames are adjacent, the words move as a whole
+		emitRM(opLDA, ac, 1, fp, "adress of the current env");
+		emitRM(opLDA, ac1, 1, sp, "adress of the new env");
+		emitSYS(opMEMMOVE, ac, psize + 1, ac1, "move env and parameters over the current ones");
+	}
+	else
+	{
+		emitRM(opLD, ac1, 1, sp, "move env");
+		emitRM(opST, ac1, 1, fp, "over the current one");
+	}
+	restoreDisplay();
+	emitRM(opLD, ac, -1, fp, "return adress of the caller");
+	emitRO(opMOV, sp, fp, 0, "drop the frame");
+	emitRM(opLD, fp, 0, fp, "resotre the caller fp");
+	emitRM(opPOP, pc, 0, mp, "ujp to the function body");
+	return TRUE;
 }
 
 // ڴݴ adress_regصorigin_reg,Ȼorigin_reg->target_reg,Ȼѹmp
-void cGenPushTemp(int vsize, int target_reg, int origin_reg, int adress_reg)
+void cGenPushTemp(int vsize, Type target_type, Type origin_type, int adress_reg)
 {
+	int origin_reg = get_reg1(origin_type);
+	int target_reg = get_reg1(target_type);
+	if (vsize > 1)
+	{
+		cgenPushBlock(vsize, adress_reg);
+		return;
+	}
 	for (int loc = 0; loc < vsize; ++loc)
 	{
-		emitRM("LD", origin_reg, loc, adress_reg, "load bytes");//
-		emitRO("MOV", target_reg, origin_reg, 0, "move between reg");
-		emitRM("PUSH", target_reg, 0, mp, "push bytes ");
+		emitRM(opLD, origin_reg, loc, adress_reg, "load bytes");//
+		emitRO(moveOp(origin_type, target_type), target_reg, origin_reg, 0, "move between reg");
+		emitRM(opPUSH, target_reg, 0, mp, "push bytes ");
 	}
 }
 
@@ -1043,9 +2211,14 @@ void cGenInValueMode(TreeNode * tree, int scope, int start_label, int end_label)
    target_adress_reg ʼĵط
    ( origin_reg -> target_regת)		
 */
- void cgenCopyObj(int origin_reg, int target_reg, int offset, int target_adress_reg)
+ void cgenCopyObj(Type origin_type, Type target_type, int offset, int target_adress_reg)
 {
-	__cgenPopFromTemp(origin_reg, target_reg, offset, target_adress_reg, __cGenST);
+	if (offset > 1)
+	{
+		cgenPopBlock(offset, target_adress_reg);
+		return;
+	}
+	__cgenPopFromTemp(origin_type, target_type, offset, target_adress_reg, __cGenST);
 }
 
  //  pop from mp and push to sp
@@ -1053,30 +2226,59 @@ void cGenInValueMode(TreeNode * tree, int scope, int start_label, int end_label)
 	 target_adress_reg ʼĵط
 	 ( origin_reg->target_regת)
  */
-void cgenPushObj(int origin_reg, int target_reg, int offset)
+void cgenPushObj(Type origin_type, Type target_type, int offset)
 {
-	__cgenPopFromTemp(origin_reg, target_reg, offset, sp, __cGenPUSH);
+	if (offset > 1)
+	{
+		emitRM(opLDA, sp, -offset, sp, "stack expand");
+		emitRM(opLDA, ac, 1, sp, "adress of the copy");
+		cgenPopBlock(offset, ac);
+		return;
+	}
+	__cgenPopFromTemp(origin_type, target_type, offset, sp, __cGenPUSH);
+}
+
+/* a value of several words is a struct, it sits on mp in the order
+   of the memory (word k at k+1(mp)) and is moved by one MEMCPY,
+   the words need no conversion between the register classes
+*/
+void cgenPushBlock(int vsize, int adress_reg)
+{
+	int dst = adress_reg == ac1 ? ac : ac1;
+	emitRM(opLDA, mp, -vsize, mp, "reserve the value on mp");
+	emitRM(opLDA, dst, 1, mp, "adress of the value on mp");
+	emitSYS(opMEMCPY, dst, vsize, adress_reg, "copy the value to mp");
+}
+
+void cgenPopBlock(int vsize, int adress_reg)
+{
+	int src = adress_reg == ac1 ? ac : ac1;
+	emitRM(opLDA, src, 1, mp, "adress of the value on mp");
+	emitSYS(opMEMCPY, adress_reg, vsize, src, "copy the value from mp");
+	emitRM(opLDA, mp, vsize, mp, "pop the value");
 }
 
  //pop and do something
- void __cgenPopFromTemp(int origin_reg, int target_reg, int offset, int adress_reg, emitFunc f)
+ void __cgenPopFromTemp(Type origin_type, Type target_type, int offset, int adress_reg, emitFunc f)
  {
+	 int origin_reg = get_reg(origin_type);
+	 int target_reg = get_reg(target_type);
 	 while (offset-- > 0)
 	 {
-		 emitRM("POP", origin_reg, 0, mp, "copy bytes");//reg[ac] =  dMem[reg[mp] + (++tmpOffset) ]
-		 emitRO("MOV", target_reg, origin_reg, 0, "copy bytes");
+		 emitRM(opPOP, origin_reg, 0, mp, "copy bytes");//reg[ac] =  dMem[reg[mp] + (++tmpOffset) ]
+		 emitRO(moveOp(origin_type, target_type), target_reg, origin_reg, 0, "copy bytes");
 		 f(target_reg, offset, adress_reg);// do something
 	 }
  }
 
  void __cGenST(int target_reg, int offset, int target_adress_reg)
  {
-	 emitRM("ST", target_reg, offset, target_adress_reg, "copy bytes");
+	 emitRM(opST, target_reg, offset, target_adress_reg, "copy bytes");
  }
 
  void __cGenPUSH(int target_reg, int offset, int target_adress_reg)
  {
-	 emitRM("PUSH", target_reg, 0, target_adress_reg, "PUSH bytes");
+	 emitRM(opPUSH, target_reg, 0, target_adress_reg, "PUSH bytes");
  }
 
  void setFunctionAdress(char * fname, char * struct_name,  int scope)
@@ -1098,8 +2300,8 @@ void cgenPushObj(int origin_reg, int target_reg, int offset)
 	 else{
 		 int entry_adress = emitSkip(0) + 3;
 		 int loc = st_lookup(fname);
-		 emitRM("LDC", ac, entry_adress, 0, "get function adress");
-		 emitRM("ST", ac, loc, get_stack_bottom(scope), "set function adress");
+		 emitLDC_Code(ac, entry_adress, "get function adress");
+		 emitRM(opST, ac, loc, get_stack_bottom(scope), "set function adress");
 	 }
 
  }
@@ -1111,45 +2313,81 @@ void cgenPushObj(int origin_reg, int target_reg, int offset)
 		 //ģ
 		 if (st_get_node(main_func) == NULL) return;
 		 int loc = st_lookup(main_func);
-		 emitRM("LD",ac1,loc,gp,"get main function adress");
-		 emitRM("LDC", ac, emitSkip(0) + 2, 0, "store the return adress");
-		 emitRM("LDA", pc, 0, ac1, "ujp to the function body");
+		 emitRM(opLD,ac1,loc,gp,"get main function adress");
+		 emitLDC_Code(ac, emitSkip(0) + 2, "store the return adress");
+		 emitRM(opLDA, pc, 0, ac1, "ujp to the function body");
 	 }
 	 else{
 		 cGenInValueMode(tree->child[1], scope, -1, -1);// now value in mp
-		 emitRM("LDC", ac, emitSkip(0) + 2, 0, "store the return adress");
+		 emitLDC_Code(ac, emitSkip(0) + 2, "store the return adress");
 		 if (strcmp(tree->attr.name, "free") == 0){
 			 int x = 111;
 		 }
-		 emitRM("POP", pc, 0, mp, "ujp to the function body");
+		 emitRM(opPOP, pc, 0, mp, "ujp to the function body");
 	 }
  }
 
-void initStructInstance(TreeNode * t,int scope)
- {
-     StructType stype = getStructType(t->type.sname);
-     Member * members = stype.members;
-     for(Member * mem = members; mem != NULL; mem = mem->next_member)
-     {
-         if(is_basic_type(mem->typeinfo, Func ))
-         {
-             int offset = mem->offset;
-             emitRM("LDC",ac1, mem->typeinfo.func_type.adress, 0,"get function adress from struct");
-             emitRM("ST", ac1, offset + 1,sp,"Init Struct Instance");
-         }
-     }
- }
+/* TRUE if an instance of t holds method adresses, in itself,
+   in a struct member or in the elements of an array
+*/
+static bool hasMethods(TypeInfo t)
+{
+	if (is_basic_type(t, Array)) return hasMethods(*t.array_type.ele_type);
+	if (!is_basic_type(t, Struct)) return FALSE;
+	StructType stype = getStructType(t.sname);
+	for (Member * mem = stype.members; mem != NULL; mem = mem->next_member)
+	{
+		if (is_basic_type(mem->typeinfo, Func) || hasMethods(mem->typeinfo)) return TRUE;
+	}
+	return FALSE;
+}
+
+/* store the method adresses of the instance at offset(sp), the first
+   element of an array is set up and then doubled by MEMCPY
+*/
+void initStructInstance(TypeInfo t, int offset)
+{
+	if (is_basic_type(t, Array))
+	{
+		TypeInfo ele = *t.array_type.ele_type;
+		int esize = var_size_of_type(ele);
+		int n = t.array_type.ele_num;
+		initStructInstance(ele, offset);
+		for (int done = 1; done < n; done *= 2)
+		{
+			int k = done < n - done ? done : n - done;
+			emitRM(opLDA, ac, offset, sp, "adress of the initialized elements");
+			emitRM(opLDA, ac1, offset + done * esize, sp, "adress of the next elements");
+			emitSYS(opMEMCPY, ac1, k * esize, ac, "Init Struct Instance");
+		}
+		return;
+	}
+
+	StructType stype = getStructType(t.sname);
+	for (Member * mem = stype.members; mem != NULL; mem = mem->next_member)
+	{
+		if (is_basic_type(mem->typeinfo, Func))
+		{
+			emitLDC_Code(ac1, mem->typeinfo.func_type.adress, "get function adress from struct");
+			emitRM(opST, ac1, offset + mem->offset, sp, "Init Struct Instance");
+		}
+		else if (hasMethods(mem->typeinfo))
+		{
+			initStructInstance(mem->typeinfo, offset + mem->offset);
+		}
+	}
+}
 
 void cgenCodeForInsertNode(TreeNode * t, int scope)
 {
     if(scope > 0) insertNode(t,scope);
     
     int vsize = var_size_of(t);
-    emitRM("LDA",sp,-vsize,sp,"stack expand");
+    emitRM(opLDA,sp,-vsize,sp,"stack expand");
 
-    if(is_basic_type(t->type,Struct))
+    if(hasMethods(t->type))
     {
-        initStructInstance(t,scope);
+        initStructInstance(t->type, 1);
     }
 }
 
@@ -1167,8 +2405,8 @@ void pushSelfParam(TreeNode * tree,int scope)
 	if (kind == PointK) { cGenInAdressMode(struct_node, scope, -1, -1); }
 	else if (kind == ArrowK) { cGenInValueMode(struct_node, scope, -1, -1); }
 	else{ assert(0);}
-	emitRM("POP", ac, 0, mp, "");
-	emitRM("PUSH", ac, 0, sp, "");
+	emitRM(opPOP, ac, 0, mp, "");
+	emitRM(opPUSH, ac, 0, sp, "");
 }
 void clearGode(){
 	emitBackup(0);
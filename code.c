@@ -1,20 +1,109 @@
-
 #include "globals.h"
 #include "code.h"
 #include "symtable.h"
+#include "util.h"
+#include "tm.h"
+#include "assert.h"
 /* TM location number for current instruction emission */
 char labelTable[211][6];
 static int emitLoc = 0 ;// the first location is for jump to main function adress
 
 static int highEmitLoc = 0;/*the highest EmitLocation the instruction has been created */
 static int labNum = 0;
+static int lastLine = -1;/* the source line of the last .LINE directive */
+
+/* words of a .DATA directive per line, keeps lines short for the loader */
+#define DATA_WORDS_PER_LINE 16
+
+/* the code of the whole program is buffered until emitFlush,
+ * the peephole pass works on the buffer and the locations are
+ * renumbered when it is written, as text or as a TM object
+ */
+typedef enum { ciINSTR, ciTEXT, ciLINE, ciDATA, ciFILE, ciFUNC, ciFUNCEND } CODEKIND;
+typedef enum { fmRO, fmRM, fmSYS, fmLDCF } CODEFORM;
+
+typedef struct {
+	CODEKIND kind;
+	CODEFORM form; /* how the operands are printed */
+	int op;        /* OPCODE */
+	int a[3];      /* r,s,t or r,d(s), same positions for both forms */
+	float f;       /* the constant of a float LDC */
+	int loc;       /* location when it was emitted */
+	bool reloc;    /* a[1] is an absolute code adress */
+	bool dead;     /* removed by the peephole pass */
+	bool target;   /* a jump or a code adress may lead here */
+	bool fixed;    /* an entry of a jump table, it keeps its place */
+	bool hole;     /* skipped by emitSkip and not written yet */
+	char * text;   /* comment of the instruction, the whole line or a name */
+	int * words;   /* ciDATA: a[1] words placed at a[0] */
+} CODEITEM;
+
+static CODEITEM * items = NULL;
+static int itemSize = 0, itemCap = 0;
+static int codeBase = 0;/* location of the first buffered item */
+
+static CODEITEM * newItem(CODEKIND kind)
+{
+	CODEITEM * x;
+	if (itemSize == 0) codeBase = emitLoc;
+	if (itemSize == itemCap)
+	{
+		itemCap = itemCap == 0 ? 1024 : itemCap * 2;
+		items = (CODEITEM *)realloc(items, itemCap * sizeof(CODEITEM));
+	}
+	x = &items[itemSize++];
+	memset(x, 0, sizeof(CODEITEM));
+	x->kind = kind;
+	x->loc = emitLoc;
+	return x;
+}
+
+/* the buffered instruction of location loc, NULL if there is none */
+static CODEITEM * bufferedAt(int loc)
+{
+	int i;
+	for (i = itemSize - 1; i >= 0 && items[i].loc >= loc; i--)
+	{
+		if (items[i].kind == ciINSTR && items[i].loc == loc) return &items[i];
+	}
+	return NULL;
+}
+
+static CODEITEM * emitInstr(CODEFORM form, OPCODE op, int r, int s, int t, char * c)
+{
+	/* after emitBackup the instruction is written in place */
+	CODEITEM * x = emitLoc < highEmitLoc ? bufferedAt(emitLoc) : NULL;
+	if (x == NULL) x = newItem(ciINSTR);
+	else
+	{
+		int loc = x->loc;
+		free(x->text);
+		memset(x, 0, sizeof(CODEITEM));
+		x->kind = ciINSTR;
+		x->loc = loc;
+	}
+	x->form = form;
+	x->op = op;
+	x->a[0] = r;
+	x->a[1] = s;
+	x->a[2] = t;
+	x->text = copyString(c);
+	emitLoc++;
+	if (highEmitLoc < emitLoc)  highEmitLoc = emitLoc;
+	return x;
+}
+
 /* Procedure emitComment prints a comment line
  * with comment c in the code file
  *
  */
 
 void emitComment( char * c )
-{  fprintf(code,"* %s\n",c);}
+{
+	char * line = (char *)malloc(strlen(c) + 3);
+	sprintf(line, "* %s", c);
+	newItem(ciTEXT)->text = line;
+}
 
 /* Procedure emitRO emits a register-only
  * TM instruction
@@ -24,16 +113,12 @@ void emitComment( char * c )
  * t = 2nd source register
  * c = a comment to be printed if TraceCode is TRUE
  */
-void emitRO( char *op, int r, int s, int t, char *c)
+void emitRO(OPCODE op, int r, int s, int t, char *c)
 {  
-	if (strcmp(op, "MOV") == 0 && (r == s)) {
+	if (op == opMOV && (r == s)) {
 		return;//optimize
 	}
-
-	fprintf(code,"%3d:  %5s  %d,%d,%d ",emitLoc++,op,r,s,t);
-    fprintf(code,"\t%s",c) ;
-    fprintf(code,"\n") ;
-    if (highEmitLoc < emitLoc) highEmitLoc = emitLoc ;
+	emitInstr(fmRO, op, r, s, t, c);
 } /* emitRO */
 
 /* Procedure emitRM emits a register-to-memory
@@ -44,29 +129,43 @@ void emitRO( char *op, int r, int s, int t, char *c)
  * s = the base register
  * c = a comment to be printed if TraceCode is TRUE
  */
-void emitRM( char * op, int r, int d, int s, char *c )
+void emitRM(OPCODE op, int r, int d, int s, char *c )
 {
-
-	fprintf(code, "%3d:  %5s  %d,%d(%d) ", emitLoc++, op, r, d, s);
-    fprintf(code,"\t%s",c) ;
-    fprintf(code,"\n") ;
-    if (highEmitLoc < emitLoc)  highEmitLoc = emitLoc ;
+	emitInstr(fmRM, op, r, d, s, c);
 } /* emitRM */
 
-void emitSYS(char * op, int r, int d, int s, char *c)
+void emitSYS(OPCODE op, int r, int d, int s, char *c)
 {
-
-	fprintf(code, "%3d:  %s  %d,%d(%d) ", emitLoc++, op, r, d, s);
-	fprintf(code, "\t%s", c);
-	fprintf(code, "\n");
-	if (highEmitLoc < emitLoc)  highEmitLoc = emitLoc;
-
+	emitInstr(fmSYS, op, r, d, s, c);
 } /* emitSYS */
 
-void emitLDCF(char * op, int r, float d, int s, char *c){
-	fprintf(code, "%3d:  %5s  %d,%f(%d)\n ", emitLoc++, op, r, d, s);
+void emitLDCF(OPCODE op, int r, float d, int s, char *c){
+	emitInstr(fmLDCF, op, r, 0, s, c)->f = d;
 }
 
+/* Procedure emitLDC_Code loads the absolute code
+ * adress a into register r, the adress follows the
+ * instruction when the peephole pass moves it
+ */
+void emitLDC_Code(int r, int a, char * c)
+{
+	emitInstr(fmRM, opLDC, r, a, 0, c)->reloc = TRUE;
+} /* emitLDC_Code */
+
+
+/* Procedure emitJumpTable emits JIDX r followed by
+ * the GO of the n labels, register r (0 <= r < n)
+ * selects one of them. The entries are never removed
+ * so that the index keeps pointing at the right one
+ */
+void emitJumpTable(int r, int * labels, int n, char * c)
+{
+	int i;
+	emitInstr(fmRM, opJIDX, r, 0, pc, c);
+	for (i = 0; i < n; i++)
+		emitInstr(fmRO, opGO, labels[i], 0, 0, "jump table entry")->fixed = TRUE;
+} /* emitJumpTable */
+
 
 /* Function emitSkip skips "howMany" code
  * locations for later backpatch. It also
@@ -76,7 +175,16 @@ void emitLDCF(char * op, int r, float d, int s, char *c){
 
 int emitSkip( int howMany)
 {  int i = emitLoc;
-    emitLoc += howMany ;
+	/* the new locations are held by holes until they are written */
+	for (; howMany > 0; howMany--)
+	{
+		if (bufferedAt(emitLoc) == NULL)
+		{
+			CODEITEM * x = newItem(ciINSTR);
+			x->hole = x->dead = TRUE;
+		}
+		emitLoc++;
+	}
     if (highEmitLoc < emitLoc)  highEmitLoc = emitLoc ;
     return i;
 } /* emitSkip */
@@ -108,16 +216,579 @@ void emitRestore(void)
  * a = the absolute location in memory
  * c = a comment to be printed if TraceCode is TRUE
  */
-void emitRM_Abs( char *op, int r, int a, char * c)
-{ fprintf(code,"%3d:  %5s  %d,%d(%d) ",
-          emitLoc,op,r,a-(emitLoc+1),pc);
-    ++emitLoc ;
-    fprintf(code,"\t%s",c) ;
-    fprintf(code,"\n") ;
-    if (highEmitLoc < emitLoc) highEmitLoc = emitLoc ;
+void emitRM_Abs(OPCODE op, int r, int a, char * c)
+{
+	emitInstr(fmRM, op, r, a - (emitLoc + 1), pc, c);
 } /* emitRM_Abs */
 
 
+/* Procedure emitData emits the constant pool entry
+ * of a string literal, the loader copies it into dMem
+ * starting at the absolute adress addr (the trailing
+ * '\0' included) so no code is needed to build it
+ */
+void emitData(int addr, char * str)
+{
+	CODEITEM * x = newItem(ciDATA);
+	int i, len = (int)strlen(str) + 1;
+	x->a[0] = addr;
+	x->a[1] = len;
+	x->words = (int *)malloc(len * sizeof(int));
+	for (i = 0; i < len; i++) x->words[i] = str[i];
+} /* emitData */
+
+/* Procedure emitFile starts the debug information
+ * of a new source module
+ */
+void emitFile(char * filename)
+{
+	newItem(ciFILE)->text = copyString(filename);
+	lastLine = -1;
+} /* emitFile */
+
+/* Procedure emitLine records that the next
+ * instructions come from source line lineno
+ */
+void emitLine(int lineno)
+{
+	if (lineno == lastLine) return;
+	newItem(ciLINE)->a[0] = lineno;
+	lastLine = lineno;
+} /* emitLine */
+
+/* Procedures emitFunction and emitFunctionEnd mark
+ * the code of a function for the function table
+ */
+void emitFunction(char * name)
+{
+	newItem(ciFUNC)->text = copyString(name);
+} /* emitFunction */
+
+void emitFunctionEnd(void)
+{
+	newItem(ciFUNCEND);
+} /* emitFunctionEnd */
+
+/**************  peephole pass  **************/
+/* the rules look at neighbouring instructions of the buffer,
+ * an instruction some jump may land on is never merged into
+ * the one before it. Removed instructions are only marked,
+ * emitFlush renumbers the rest and fixes the pc-relative
+ * displacements and the code adresses.
+ */
+#define LIVE_BUDGET 64 /* instructions looked at to prove a register dead */
+#define PEEP_ROUNDS 8
+
+static int * locItem = NULL;  /* loc - codeBase -> item */
+static int * labelItem = NULL;/* label -> item of its LABEL */
+static int labelCount = 0;
+static int liveBudget;
+
+static bool isJump(CODEITEM * x)
+{
+	return x->op >= opJLT && x->op <= opJNEF;
+}
+
+/* location an instruction branches to when it is pc-relative, -1 otherwise */
+static int relTarget(CODEITEM * x)
+{
+	if (opClass(x->op) != opclRM && opClass(x->op) != opclRA) return -1;
+	if (x->op == opLDC || x->op == opRETURN || x->a[2] != pc) return -1;
+	return x->loc + 1 + x->a[1];
+}
+
+static int itemOfLoc(int loc)
+{
+	if (loc < codeBase || loc >= highEmitLoc) return -1;
+	return locItem[loc - codeBase];
+}
+
+/* next live instruction after item i, -1 at the end */
+static int nextInstr(int i)
+{
+	for (i++; i < itemSize; i++)
+		if (items[i].kind == ciINSTR && !items[i].dead) return i;
+	return -1;
+}
+
+/* the instruction after i, unless something may jump to it */
+static int nextPlain(int i)
+{
+	int n = nextInstr(i);
+	if (n < 0 || items[n].target || items[n].op == opLAEBL) return -1;
+	return n;
+}
+
+static void killItem(int i)
+{
+	items[i].dead = TRUE;
+	if (items[i].target)
+	{
+		int n = nextInstr(i);
+		if (n >= 0) items[n].target = TRUE;
+	}
+}
+
+static bool readsReg(CODEITEM * x, int r)
+{
+	switch (x->op)
+	{
+	case opHALT: case opIN: case opLAEBL: case opGO: case opLDC:
+		return FALSE;
+	case opOUT: case opNEG: case opNEGF:
+		return x->a[0] == r;
+	case opMOV: case opCVTIF: case opCVTFI:
+		return x->a[1] == r;
+	case opADD: case opSUB: case opMUL: case opDIV: case opMOD:
+	case opADDF: case opSUBF: case opMULF: case opDIVF: case opMODF:
+		return x->a[1] == r || x->a[2] == r;
+	case opLD: case opLDA: case opPOP: case opRETURN:
+		return x->a[2] == r;
+	case opST: case opPUSH: case opJLT: case opJLE: case opJGT: case opJGE: case opJEQ: case opJNE:
+	case opJLTF: case opJLEF: case opJGTF: case opJGEF: case opJEQF: case opJNEF:
+		return x->a[0] == r || x->a[2] == r;
+	case opMEMCPY: case opMEMSET: case opMEMMOVE:
+		return x->a[0] == r || x->a[2] == r;
+	default:
+		return TRUE;/* MALLOC, FREE */
+	}
+}
+
+static bool writesReg(CODEITEM * x, int r)
+{
+	switch (x->op)
+	{
+	case opIN: case opMOV: case opNEG: case opADD: case opSUB: case opMUL: case opDIV: case opMOD:
+	case opCVTIF: case opCVTFI: case opNEGF: case opADDF: case opSUBF: case opMULF: case opDIVF: case opMODF:
+	case opLD: case opLDA: case opLDC:
+		return x->a[0] == r;
+	case opPOP:
+		return x->a[0] == r || x->a[2] == r;
+	case opPUSH:
+		return x->a[2] == r;
+	default:
+		return FALSE;
+	}
+}
+
+/* may the value of register r in front of item i still be read,
+ * TRUE whenever it can not be proven otherwise
+ */
+static bool regLive(int r, int i)
+{
+	for (; i >= 0 && i < itemSize; i++)
+	{
+		CODEITEM * x = &items[i];
+		if (x->kind != ciINSTR || x->dead) continue;
+		if (--liveBudget < 0) return TRUE;
+		if (readsReg(x, r)) return TRUE;
+		if (x->op == opHALT) return FALSE;
+		if (x->op == opGO)
+		{
+			if (x->a[0] < 0 || x->a[0] >= labelCount || labelItem[x->a[0]] < 0) return TRUE;
+			i = labelItem[x->a[0]];
+			continue;
+		}
+		if (isJump(x))
+		{
+			int t = itemOfLoc(relTarget(x));
+			if (t < 0 || regLive(r, t)) return TRUE;
+			continue;
+		}
+		if (x->op == opRETURN || writesReg(x, pc) || x->a[0] == pc)
+		{
+			/* only a jump over the next instructions is followed */
+			if (x->op != opLDA || x->a[2] != pc) return TRUE;
+			i = itemOfLoc(relTarget(x));
+			if (i < 0) return TRUE;
+			i--;
+			continue;
+		}
+		if (writesReg(x, r)) return FALSE;
+	}
+	return TRUE;
+}
+
+static bool regDeadAfter(int r, int i)
+{
+	if (reg_type(r) == -1) return FALSE;/* fp, sp ... hold the machine state */
+	liveBudget = LIVE_BUDGET;
+	return !regLive(r, i + 1);
+}
+
+/* a plain register copy, MOV between registers of one kind or LDA r,0(s) */
+static bool isCopy(CODEITEM * x)
+{
+	if (x->op == opMOV) return reg_type(x->a[0]) == reg_type(x->a[1]) && x->a[0] != pc;
+	return x->op == opLDA && x->a[1] == 0 && x->a[0] != pc && x->a[2] != pc;
+}
+
+static int copySource(CODEITEM * x)
+{
+	return x->op == opMOV ? x->a[1] : x->a[2];
+}
+
+static void setCopy(CODEITEM * x, int r, int s)
+{
+	x->op = opLDA;
+	x->form = fmRM;
+	x->a[0] = r;
+	x->a[1] = 0;
+	x->a[2] = s;
+}
+
+/* PUSH a,0(x) POP b,0(x): the value does not need the memory */
+static int peepPushPop(int i)
+{
+	CODEITEM * x = &items[i];
+	int n;
+	if (x->op != opPUSH || x->a[1] != 0 || x->a[0] == x->a[2]) return 0;
+	if ((n = nextPlain(i)) < 0) return 0;
+	CODEITEM * y = &items[n];
+	if (y->op != opPOP || y->a[1] != 0 || y->a[2] != x->a[2] || y->a[0] == y->a[2]) return 0;
+
+	if (x->a[0] == y->a[0])
+	{
+		killItem(i);
+		killItem(n);
+		return 2;
+	}
+	setCopy(x, y->a[0], x->a[0]);
+	killItem(n);
+	return 1;
+}
+
+/* LDC c,k ADD r,b,c: the constant becomes the displacement of LDA */
+static int peepLdcAdd(int i)
+{
+	CODEITEM * x = &items[i];
+	int n, c, b, k;
+	if (x->op != opLDC || x->form == fmLDCF || x->reloc || reg_type(x->a[0]) != ac) return 0;
+	if ((n = nextPlain(i)) < 0) return 0;
+	CODEITEM * y = &items[n];
+	c = x->a[0];
+	k = x->a[1];
+	if (y->op == opADD && y->a[2] == c && y->a[1] != c) b = y->a[1];
+	else if (y->op == opADD && y->a[1] == c && y->a[2] != c) b = y->a[2];
+	else if (y->op == opSUB && y->a[2] == c && y->a[1] != c) { b = y->a[1]; k = -k; }
+	else return 0;
+
+	if (reg_type(b) != ac || reg_type(y->a[0]) != ac) return 0;
+	if (y->a[0] != c && !regDeadAfter(c, n)) return 0;
+	y->op = opLDA;
+	y->form = fmRM;
+	y->a[1] = k;
+	y->a[2] = b;
+	killItem(i);
+	return 1;
+}
+
+/* copies nobody reads, copies undone by the next instruction
+ * and copies of a value computed just before
+ */
+static int peepMoves(int i)
+{
+	CODEITEM * x = &items[i];
+	int n;
+	if (isCopy(x) && regDeadAfter(x->a[0], i))
+	{
+		killItem(i);
+		return 1;
+	}
+	if ((n = nextPlain(i)) < 0) return 0;
+	CODEITEM * y = &items[n];
+	if (!isCopy(y)) return 0;
+	int r = y->a[0], s = copySource(y);
+
+	if (isCopy(x) && x->a[0] == s && copySource(x) == r && reg_type(r) == reg_type(s))
+	{
+		killItem(n);
+		return 1;
+	}
+	switch (x->op)
+	{
+	case opLD: case opLDA: case opLDC: case opMOV: case opCVTIF: case opCVTFI:
+	case opADD: case opSUB: case opMUL: case opDIV: case opMOD:
+	case opADDF: case opSUBF: case opMULF: case opDIVF: case opMODF:
+		break;
+	default:
+		return 0;
+	}
+	if (x->a[0] != s || reg_type(s) == -1 || reg_type(s) != reg_type(r)) return 0;
+	if (!regDeadAfter(s, n)) return 0;
+	x->a[0] = r;
+	killItem(n);
+	return 1;
+}
+
+/* GO to the next instruction, GO to another GO */
+static int peepJumps(int i, int * threaded)
+{
+	CODEITEM * x = &items[i];
+	int n, hops;
+	if (x->op != opGO) return 0;
+	for (n = nextInstr(i); !x->fixed && n >= 0 && items[n].op == opLAEBL; n = nextInstr(n))
+	{
+		if (items[n].a[0] == x->a[0])
+		{
+			killItem(i);
+			return 1;
+		}
+	}
+	for (hops = 0; hops < PEEP_ROUNDS; hops++)
+	{
+		int label = x->a[0];
+		if (label < 0 || label >= labelCount || labelItem[label] < 0) break;
+		for (n = labelItem[label]; n >= 0 && items[n].op == opLAEBL; n = nextInstr(n));
+		if (n < 0 || items[n].op != opGO || items[n].a[0] == label) break;
+		x->a[0] = items[n].a[0];
+		(*threaded)++;
+	}
+	return 0;
+}
+
+static void markTargets(void)
+{
+	int i, t, size = highEmitLoc - codeBase;
+	locItem = (int *)realloc(locItem, (size + 1) * sizeof(int));
+	for (i = 0; i <= size; i++) locItem[i] = -1;
+
+	labelCount = 0;
+	for (i = 0; i < itemSize; i++)
+	{
+		if (items[i].kind != ciINSTR) continue;
+		locItem[items[i].loc - codeBase] = i;
+		if (items[i].op == opLAEBL && items[i].a[0] >= labelCount) labelCount = items[i].a[0] + 1;
+	}
+	labelItem = (int *)realloc(labelItem, (labelCount + 1) * sizeof(int));
+	for (i = 0; i < labelCount; i++) labelItem[i] = -1;
+
+	for (i = 0; i < itemSize; i++)
+	{
+		CODEITEM * x = &items[i];
+		if (x->kind != ciINSTR) continue;
+		if (x->op == opLAEBL) labelItem[x->a[0]] = i;
+		t = x->reloc ? itemOfLoc(x->a[1]) : itemOfLoc(relTarget(x));
+		if (t >= 0) items[t].target = TRUE;
+	}
+}
+
+static void peephole(int removed[4], int * threaded)
+{
+	int round, i, changed;
+	markTargets();
+	for (round = 0; round < PEEP_ROUNDS; round++)
+	{
+		changed = 0;
+		for (i = 0; i < itemSize; i++)
+		{
+			int k;
+			if (items[i].kind != ciINSTR || items[i].dead) continue;
+			if ((Peephole & PEEP_PUSHPOP) && (k = peepPushPop(i)) > 0) { removed[0] += k; changed = 1; continue; }
+			if ((Peephole & PEEP_LDCADD) && (k = peepLdcAdd(i)) > 0) { removed[1] += k; changed = 1; continue; }
+			if ((Peephole & PEEP_MOVES) && (k = peepMoves(i)) > 0) { removed[2] += k; changed = 1; continue; }
+			if ((Peephole & PEEP_JUMPS) && (k = peepJumps(i, threaded)) > 0) { removed[3] += k; changed = 1; continue; }
+		}
+		if (!changed) break;
+	}
+}
+
+/* the locations after the peephole pass: removed instructions
+ * take the location of the next one kept
+ */
+static int * newLoc = NULL;
+static int newSize = 0;
+
+static int renumber(void)
+{
+	int i, next = codeBase;
+	newSize = highEmitLoc - codeBase;
+	newLoc = (int *)realloc(newLoc, (newSize + 1) * sizeof(int));
+	for (i = 0; i <= newSize; i++) newLoc[i] = -1;
+	for (i = 0; i < itemSize; i++)
+	{
+		if (items[i].kind == ciINSTR && !items[i].dead)
+			newLoc[items[i].loc - codeBase] = next++;
+	}
+	newLoc[newSize] = next;
+	for (i = newSize - 1; i >= 0; i--)
+		if (newLoc[i] < 0) newLoc[i] = newLoc[i + 1];
+	return next;
+}
+
+static int newLocOf(int l)
+{
+	return l >= codeBase && l <= codeBase + newSize ? newLoc[l - codeBase] : l;
+}
+
+/* the displacement of a kept instruction at its new location */
+static int newDisp(CODEITEM * x, int loc)
+{
+	if (x->reloc) return newLocOf(x->a[1]);
+	if (relTarget(x) >= 0) return newLocOf(relTarget(x)) - loc - 1;
+	return x->a[1];
+}
+
+static void writeText(int removed[4], int threaded)
+{
+	int i, j;
+	for (i = 0; i < itemSize; i++)
+	{
+		CODEITEM * x = &items[i];
+		switch (x->kind)
+		{
+		case ciTEXT:
+			fprintf(code, "%s\n", x->text);
+			break;
+		case ciLINE:
+			fprintf(code, ".LINE %d %d\n", newLocOf(x->loc), x->a[0]);
+			break;
+		case ciFILE:
+			fprintf(code, ".FILE %s\n", x->text);
+			break;
+		case ciFUNC:
+			fprintf(code, "* function entry:\n* %s\n", x->text);
+			break;
+		case ciFUNCEND:
+			fprintf(code, "* function end:\n");
+			break;
+		case ciDATA:
+			for (j = 0; j < x->a[1]; j++)
+			{
+				if (j % DATA_WORDS_PER_LINE == 0)
+					fprintf(code, "%s.DATA %d", j == 0 ? "" : "\n", x->a[0] + j);
+				fprintf(code, " %d", x->words[j]);
+			}
+			fprintf(code, "\n");
+			break;
+		case ciINSTR:
+		{
+			int loc, d;
+			if (x->dead) break;
+			loc = newLocOf(x->loc);
+			d = newDisp(x, loc);
+			switch (x->form)
+			{
+			case fmRO:
+				fprintf(code, "%3d:  %5s  %d,%d,%d ", loc, opCodeTab[x->op].name, x->a[0], d, x->a[2]);
+				break;
+			case fmRM:
+				fprintf(code, "%3d:  %5s  %d,%d(%d) ", loc, opCodeTab[x->op].name, x->a[0], d, x->a[2]);
+				break;
+			case fmSYS:
+				fprintf(code, "%3d:  %s  %d,%d(%d) ", loc, opCodeTab[x->op].name, x->a[0], d, x->a[2]);
+				break;
+			case fmLDCF:
+				fprintf(code, "%3d:  %5s  %d,%f(%d) ", loc, opCodeTab[x->op].name, x->a[0], x->f, x->a[2]);
+				break;
+			}
+			fprintf(code, "\t%s\n", x->text);
+			break;
+		}
+		}
+	}
+
+	if (Peephole)
+	{
+		fprintf(code, "* peephole: push/pop %d, ldc+add %d, moves %d, jumps %d removed, %d jumps threaded\n",
+			removed[0], removed[1], removed[2], removed[3], threaded);
+		if (TraceCode)
+			fprintf(listing, "peephole: push/pop %d, ldc+add %d, moves %d, jumps %d removed, %d jumps threaded\n",
+				removed[0], removed[1], removed[2], removed[3], threaded);
+	}
+}
+
+/* the constant of an LDC into a float register as the
+ * loader reads it back from the text
+ */
+static int floatBits(CODEITEM * x, int d)
+{
+	char num[64];
+	float f;
+	if (x->form == fmLDCF) sprintf(num, "%f", x->f);
+	else sprintf(num, "%d", d);
+	f = (float)atof(num);
+	memcpy(&d, &f, sizeof(int));
+	return d;
+}
+
+/* the buffer put into a machine of its own and saved as
+ * the object the assembler would make of the text
+ */
+static int writeTM(char * objFile)
+{
+	int i, j, ok;
+	TMContext * tm = tm_create();
+	if (tm == NULL) return FALSE;
+	tm_beginCode(tm);
+	for (i = 0; i < itemSize; i++)
+	{
+		CODEITEM * x = &items[i];
+		switch (x->kind)
+		{
+		case ciTEXT:
+			break;
+		case ciLINE:
+			objAddLine(tm, newLocOf(x->loc), x->a[0]);
+			break;
+		case ciFILE:
+			objSetFile(tm, x->text);
+			break;
+		case ciFUNC:
+			objBeginFunc(tm, x->text);
+			break;
+		case ciFUNCEND:
+			objEndFunc(tm);
+			break;
+		case ciDATA:
+			for (j = 0; j < x->a[1]; j += DATA_WORDS_PER_LINE)
+				objAddData(tm, x->a[0] + j, x->words + j,
+					x->a[1] - j < DATA_WORDS_PER_LINE ? x->a[1] - j : DATA_WORDS_PER_LINE);
+			break;
+		case ciINSTR:
+		{
+			int loc, d;
+			if (x->dead) break;
+			loc = newLocOf(x->loc);
+			d = newDisp(x, loc);
+			if (x->op == opLDC && reg_type(x->a[0]) == fac) d = floatBits(x, d);
+			tm_putInstr(tm, loc, x->op, x->a[0], d, x->a[2]);
+			break;
+		}
+		}
+	}
+	ok = tm_endCode(tm) && writeObject(tm, objFile);
+	tm_destroy(tm);
+	return ok;
+}
+
+/* Procedure emitFlush runs the peephole pass over
+ * the buffered program and writes it to the code file,
+ * and to the object file objFile unless it is NULL
+ */
+int emitFlush(char * objFile)
+{
+	int removed[4] = { 0, 0, 0, 0 };
+	int threaded = 0;
+	int i, next, ok = TRUE;
+
+	if (itemSize == 0) return TRUE;
+	if (Peephole) peephole(removed, &threaded);
+
+	next = renumber();
+	writeText(removed, threaded);
+	if (objFile != NULL) ok = writeTM(objFile);
+
+	for (i = 0; i < itemSize; i++)
+	{
+		free(items[i].text);
+		free(items[i].words);
+	}
+	emitLoc = highEmitLoc = next;
+	itemSize = 0;
+	return ok;
+} /* emitFlush */
+
 // generate a lab
 char* genLab()
 {
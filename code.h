@@ -1,6 +1,8 @@
 #ifndef code_h
 #define code_h
 
+#include "tm.h"
+
 /* pc = program counter  */
 #define  pc 7
 
@@ -17,6 +19,13 @@
 #define fac 9
 #define fac1 10
 
+/* expression temporaries of the register allocator:
+ * NUM_TMP int registers from itmp, NUM_TMP float registers from ftmp
+ */
+#define itmp 12
+#define ftmp 16
+#define NUM_TMP 4
+
 /* code emitting utilities */
 /* Procedure emitComment prints a comment line
  * with comment c in the code file
@@ -29,13 +38,13 @@ void emitComment( char * c );
 
 /* Procedure emitRO emits a register-only
  * TM instruction
- * op = the opcode
+ * op = the opcode, from the table shared with the TM
  * r = target register
  * s = 1st source register
  * t = 2nd source register
  * c = a comment to be printed if TraceCode is TRUE
  */
-void emitRO( char *op, int r, int s, int t, char *c);
+void emitRO(OPCODE op, int r, int s, int t, char *c);
 
 /* Procedure emitRM emits a register-to-memory
  * TM instruction
@@ -45,7 +54,7 @@ void emitRO( char *op, int r, int s, int t, char *c);
  * s = the base register
  * c = a comment to be printed if TraceCode is TRUE
  */
-void emitRM(char * op, int r, int d, int s, char *c);
+void emitRM(OPCODE op, int r, int d, int s, char *c);
 
 /* Function emitSkip skips "howMany" code
  * locations for later backpatch. It also
@@ -72,7 +81,7 @@ void emitRestore(void);
  * a = the absolute location in memory
  * c = a comment to be printed if TraceCode is TRUE
  */
-void emitRM_Abs( char *op, int r, int a, char * c);
+void emitRM_Abs(OPCODE op, int r, int a, char * c);
 
 /*
     the section 8.4 talked about how to use lab to control code
@@ -81,9 +90,58 @@ void emitRM_Abs( char *op, int r, int a, char * c);
     when we execute the code, we need labeltable.
  */
 
-void emitSYS(char *op, int r, int a, char * c);
+void emitSYS(OPCODE op, int r, int d, int s, char * c);
 
 // emit LDC code specifically
-void emitLDCF(char * op, int r, float d, int s, char *c);
+void emitLDCF(OPCODE op, int r, float d, int s, char *c);
+
+/* Procedure emitData emits a constant pool entry:
+ * the string str is placed at the absolute adress
+ * addr of dMem when the program is loaded
+ */
+void emitData(int addr, char * str);
+
+/* Procedures emitFile and emitLine emit the debug
+ * line table: the current module and the source line
+ * of the instructions that follow
+ */
+void emitFile(char * filename);
+void emitLine(int lineno);
+
+/* Procedures emitFunction and emitFunctionEnd mark the
+ * code of the function name for the function table
+ * of the object, nested functions end first
+ */
+void emitFunction(char * name);
+void emitFunctionEnd(void);
+
+/* Procedure emitLDC_Code loads the absolute code
+ * adress a into register r, every code adress kept
+ * in a register or in dMem must be loaded with it
+ * so that the peephole pass can relocate it
+ */
+void emitLDC_Code(int r, int a, char * c);
+
+/* Procedure emitJumpTable emits the indexed jump
+ * JIDX r and a table of n GO labels[i] after it,
+ * reg[r] must already be checked to be in 0..n-1
+ */
+void emitJumpTable(int r, int * labels, int n, char * c);
+
+/* the rules of the peephole pass, see Peephole */
+#define PEEP_PUSHPOP 1 /* PUSH r / POP r pairs */
+#define PEEP_LDCADD  2 /* LDC + ADD folded into LDA */
+#define PEEP_MOVES   4 /* dead and redundant register copies */
+#define PEEP_JUMPS   8 /* GO to the next instruction, GO chains */
+#define PEEP_ALL     (PEEP_PUSHPOP | PEEP_LDCADD | PEEP_MOVES | PEEP_JUMPS)
+
+/* Procedure emitFlush runs the peephole pass over
+ * the buffered program and writes it to the code file,
+ * and as a TM object to objFile unless it is NULL,
+ * the instructions are only buffered until then.
+ * An emitBackup into the buffer rewrites the buffered
+ * instruction, FALSE if the object was not written
+ */
+int emitFlush(char * objFile);
 
 #endif /* code_h */
@@ -7,10 +7,13 @@
 #include "util.h"
 #include "compile.h"
 #include "assert.h"
+#include "code.h"
+#include "fold.h"
 
 void compile(char *, char *);
 static int modules_imported = -1;
 static char * imported_modules[1000];
+static int compile_depth = 0;// imports are compiled inside the module importing them
 
 // ǷѾimport
 bool isAlreadyImported(char * file_name){
@@ -36,14 +39,11 @@ void clearImport(){
 void import(char * filename)
 {
 	
-	char buf[BUFSIZ];
 	if (isAlreadyImported(filename)) return;
-	source = fopen(filename, "r");
-	setbuf(source, buf);
-	
 	listing = stdout;
 
-	if (source == NULL)
+	// the scanner reads the whole module at once
+	if (!openSource(filename))
 	{
 		perror("1");
 		printf("open error\n");
@@ -58,6 +58,7 @@ void import(char * filename)
 void compile(char *filename, char * targetFileName)
 {
 
+	compile_depth++;
 	TreeNode *t = parse();
 	if(TraceParse) printTree(t);
 
@@ -66,10 +67,19 @@ void compile(char *filename, char * targetFileName)
 		if (TraceAnalyze) fprintf(listing, "\nBuilding Symbol Table...\n");
 		buildSymtab(t);
 		if (TraceAnalyze) fprintf(listing, "\nType Checking Finished\n");
+		foldConstants(t);
 	}
 
 	code = fopen(targetFileName, "a+");
+	emitFile(filename);
 	codeGen(t, targetFileName);
+	// the code of all modules is buffered, the program is optimized and written once
+	if (--compile_depth == 0)
+	{
+		char * objFileName = createObjFileName(targetFileName);
+		emitFlush(objFileName);
+		free(objFileName);
+	}
 	fclose(code);
 }
 
@@ -83,6 +93,16 @@ char * createTmFileName(char * filename)
 	return codeFile;
 }
 
+char * createObjFileName(char * filename)
+{
+	/**compute the length of filename before .tmo **/
+	int len = (int)strcspn(filename, "//.");
+	char * objFile = (char *)calloc(len + 5, sizeof(char));
+	strncpy(objFile, filename, len);
+	strcat(objFile, ".tmo");
+	return objFile;
+}
+
 // moduleļ PYB => PYB.p
 char * createSrcFileNameFromModule(char * module)
 {
@@ -4,4 +4,5 @@
 void import(char *);
 char * createSrcFileNameFromModule(char * module);
 char * createTmFileName(char * filename);
+char * createObjFileName(char * filename);
 #endif
\ No newline at end of file
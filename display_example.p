@@ -0,0 +1,60 @@
+/*
+ the variables of enclosing functions are reached through the
+ display, which follows recursion of the enclosing function
+*/
+
+int outer(int n)
+{
+	int total = 0
+	void add(int v)
+	{
+		void deeper(int w)
+		{
+			total += w * n
+		}
+		deeper(v)
+		deeper(v + 1)
+	}
+	int i = 0
+	while (i < n)
+	{
+		add(i)
+		i += 1
+	}
+	return total
+}
+
+int fact(int n)
+{
+	int r = 1
+	void step(int k)
+	{
+		if (k > 1)
+		{
+			r = r * k
+			step(k - 1)
+		}
+	}
+	step(n)
+	return r
+}
+
+int depth(int n)
+{
+	int mine = n * 10
+	int peek()
+	{
+		int seen = mine
+		return seen
+	}
+	if (n == 0) return peek()
+	int below = depth(n - 1)
+	return below + peek()
+}
+
+void main()
+{
+	write outer(3)
+	write fact(5)
+	write depth(3)
+}
@@ -0,0 +1,51 @@
+/*
+ expressions kept in registers: ids of every scope,
+ operands spilled when the temporaries run out
+*/
+
+int g = 7
+float h = 1.5
+
+int deep(int a, int b, int c, int d)
+{
+	return ((a + b) * (c + d) - (a - b) * (c - d)) + ((a * c + b * d) - (a * d - b * c)) * (((a + 1) * (b + 2) + (c + 3) * (d + 4)) - ((a + 5) * (b + 6) - (c + 7) * (d + 8)))
+}
+
+void outer()
+{
+	int x = 3
+	float y = 2.5
+	void mid(){
+		int z = 4
+		void inner(){
+			write x * 10 + z * g + (x + z) * (x - z)
+			write y * x + h
+			if (x + z > g - 1) write 1 else write 0
+			x = x * z + g
+		}
+		inner()
+	}
+	mid()
+	write x
+}
+
+void main()
+{
+	int a[10]
+	int i = 2
+	a[i * 2 + 1] = g * 3
+	write a[5]
+	write deep(1, 2, 3, 4)
+	write deep(-3, 5, 7, -2)
+	switch (i * 3 - 1)
+	{
+	case 5:
+		write 55
+		break
+	default:
+		write 0
+	}
+	if (g > 0) write 70
+	outer()
+	write (g + 1) * (g + 2) * h
+}
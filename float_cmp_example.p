@@ -0,0 +1,51 @@
+/*
+ a float compare tests the difference as a float: -0.0 is equal
+ to 0.0 and NaN is neither less, equal nor greater than anything
+*/
+
+float id(float x)
+{
+	return x
+}
+
+float grow(float x)
+{
+	int i = 0
+	while (i < 8)
+	{
+		x = x * 100000.0
+		i += 1
+	}
+	return x
+}
+
+void main()
+{
+	float one = 1.0
+	float z = id(0.0) * (0.0 - one)
+	float inf = grow(one)
+	float nan = inf - inf
+	int b = 0
+	// in registers
+	b = (z < 0.0)
+	write b
+	b = (z == 0.0)
+	write b
+	b = (nan < one)
+	write b
+	b = (nan >= one)
+	write b
+	b = (nan != nan)
+	write b
+	// on the stack
+	write (id(z) < 0.0)
+	write (id(z) <= 0.0)
+	write (id(nan) > 0.0)
+	write (id(nan) == id(nan))
+	// branches, jumping when false and when true
+	if (z < 0.0) write 1 else write 0
+	if (z >= 0.0) write 1 else write 0
+	if (nan < one || nan > one || nan == one) write 1 else write 0
+	if (nan <= one && one < 2.0) write 1 else write 0
+	if (inf > one) write 1 else write 0
+}
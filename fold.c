@@ -0,0 +1,391 @@
+/****************************************************/
+/* File: fold.c                                     */
+/* constant folding of the checked syntax tree: a   */
+/* folded node computes at compile time exactly the */
+/* value the generated code would have pushed       */
+/****************************************************/
+#include "fold.h"
+#include "symtable.h"
+#include "analyze.h"
+#include "util.h"
+#include "assert.h"
+#include <limits.h>
+
+/* a constant as it sits in a register: int or float */
+typedef struct {
+	bool flt;
+	int i;
+	float f;
+} CONSTVAL;
+
+/* names of the local variables in scope, they hide the const globals */
+#define MAX_LOCALS 1024
+static char * locals[MAX_LOCALS];
+static int localNum = 0;
+
+static void foldSeq(TreeNode * t, bool global);
+static void foldStmt(TreeNode * t, bool global);
+static void foldExp(TreeNode * t);
+
+static bool isScalar(TypeInfo t)
+{
+	Type k = getBasicType(t);
+	return k == Integer || k == Float || k == Char || k == Boolean;
+}
+
+static bool isFltClass(TypeInfo t)
+{
+	return is_basic_type(t, Float);
+}
+
+static bool isConst(TreeNode * t)
+{
+	return t != NULL && isExp(t, ConstK) && isScalar(t->type) && isScalar(t->converted_type);
+}
+
+/* the value a ConstK node pushes, in the register class of its converted_type */
+static CONSTVAL constValue(TreeNode * t)
+{
+	CONSTVAL v;
+	v.flt = isFltClass(t->converted_type);
+	v.i = 0;
+	v.f = 0;
+	if (v.flt) v.f = float_from_node(t);
+	else v.i = integer_from_node(t);
+	return v;
+}
+
+/* MOV between the register classes */
+static CONSTVAL convertValue(CONSTVAL v, bool flt)
+{
+	if (v.flt == flt) return v;
+	if (flt) v.f = (float)v.i;
+	else v.i = (int)v.f;
+	v.flt = flt;
+	return v;
+}
+
+/* turn t into a ConstK holding v, converted_type is kept */
+static void setConst(TreeNode * t, CONSTVAL v, Type kind)
+{
+	int i;
+	t->nodekind = ExpK;
+	t->kind.exp = ConstK;
+	t->attr.name = NULL;
+	for (i = 0; i < MAXCHILDREN; i++) t->child[i] = NULL;
+	if (v.flt)
+	{
+		t->type = createTypeFromBasic(Float);
+		t->attr.val.flt = v.f;
+	}
+	else
+	{
+		t->type = createTypeFromBasic(kind == Float ? Integer : kind);
+		t->attr.val.integer = v.i;
+	}
+}
+
+bool constTruth(TreeNode * t, int * truth)
+{
+	CONSTVAL v;
+	if (!isConst(t)) return FALSE;
+	v = constValue(t);
+	if (v.flt) memcpy(&v.i, &v.f, sizeof(int));// JNE tests the bits
+	*truth = v.i != 0;
+	return TRUE;
+}
+
+/********************************************/
+static bool isLocal(char * name)
+{
+	int i;
+	for (i = localNum - 1; i >= 0; i--)
+		if (strcmp(locals[i], name) == 0) return TRUE;
+	return FALSE;
+}
+
+static void addLocal(char * name)
+{
+	assert(localNum < MAX_LOCALS);
+	if (name != NULL) locals[localNum++] = name;
+}
+
+/* a use of a const global becomes its value */
+static void foldId(TreeNode * t)
+{
+	BucketList l;
+	if (t->attr.name == NULL || isLocal(t->attr.name)) return;
+	l = st_get_node(t->attr.name);
+	if (l == NULL || l->scope_depth != 0 || l->const_value == NULL) return;
+	if (!isScalar(t->converted_type)) return;
+
+	t->kind.exp = ConstK;
+	t->type = l->const_value->type;
+	t->attr.val = l->const_value->attr.val;
+	t->attr.name = NULL;
+}
+
+/* const int X = exp: remember the value stored into X */
+static void recordConst(TreeNode * t)
+{
+	TreeNode * init = t->child[2];
+	BucketList l;
+	if (!t->type.is_const || !isScalar(t->type) || !isConst(init)) return;
+	l = st_get_node(t->attr.name);
+	if (l == NULL || l->scope_depth != 0) return;
+
+	TreeNode * value = newExpNode(ConstK);
+	value->converted_type = t->type;
+	setConst(value, convertValue(constValue(init), isFltClass(t->type)), getBasicType(t->type));
+	l->const_value = value;
+}
+
+static void foldOp(TreeNode * t)
+{
+	TreeNode * l = t->child[0];
+	TreeNode * r = t->child[1];
+	TokenType op = t->attr.op;
+	CONSTVAL lv, rv, res;
+	bool flt;
+
+	if (!isConst(l) || !isConst(r) || !isScalar(t->converted_type)) return;
+	/* the operands are computed in the class of the left one */
+	flt = isFltClass(l->converted_type);
+	lv = convertValue(constValue(l), flt);
+	rv = convertValue(constValue(r), flt);
+	res.flt = flt;
+	res.i = 0;
+	res.f = 0;
+
+	switch (op)
+	{
+	case PLUS: case PPLUS: case PLUSASSIGN:
+	case MINUS: case MMINUS: case MINUSASSIGN:
+	case TIMES: case OVER: case MOD:
+		/* the parent reads the result in the class of converted_type */
+		if (isFltClass(t->converted_type) != flt) return;
+		if ((op == OVER || op == MOD) && (flt ? rv.f == 0 : rv.i == 0)) return;
+		/* INT_MIN / -1 traps on the host, the machine gives it a result */
+		if ((op == OVER || op == MOD) && !flt && lv.i == INT_MIN && rv.i == -1) return;
+		if (op == MOD && flt) return;
+		if (flt)
+		{
+			switch (op)
+			{
+			case PLUS: case PPLUS: case PLUSASSIGN: res.f = lv.f + rv.f; break;
+			case MINUS: case MMINUS: case MINUSASSIGN: res.f = lv.f - rv.f; break;
+			case TIMES: res.f = lv.f * rv.f; break;
+			default: res.f = lv.f / rv.f; break;
+			}
+		}
+		else
+		{
+			switch (op)
+			{
+			case PLUS: case PPLUS: case PLUSASSIGN: res.i = (int)((unsigned)lv.i + (unsigned)rv.i); break;
+			case MINUS: case MMINUS: case MINUSASSIGN: res.i = (int)((unsigned)lv.i - (unsigned)rv.i); break;
+			case TIMES: res.i = (int)((unsigned)lv.i * (unsigned)rv.i); break;
+			case OVER: res.i = lv.i / rv.i; break;
+			default: res.i = lv.i % rv.i; break;
+			}
+		}
+		setConst(t, res, getBasicType(t->type));
+		break;
+	case LT: case GT: case LE: case GE: case EQ: case NOTEQ:
+	{
+		/* the sign of the difference is tested like the J instructions do */
+		int diff;
+		if (isFltClass(t->converted_type)) return;
+		if (flt)
+		{
+			float d = lv.f - rv.f;
+			memcpy(&diff, &d, sizeof(int));
+		}
+		else diff = (int)((unsigned)lv.i - (unsigned)rv.i);
+		switch (op)
+		{
+		case LT: res.i = diff < 0; break;
+		case GT: res.i = diff > 0; break;
+		case LE: res.i = diff <= 0; break;
+		case GE: res.i = diff >= 0; break;
+		case EQ: res.i = diff == 0; break;
+		default: res.i = diff != 0; break;
+		}
+		res.flt = FALSE;
+		setConst(t, res, Boolean);
+		break;
+	}
+	case AND:
+	case OR:
+		if (flt || isFltClass(t->converted_type)) return;
+		res.i = op == AND ? (lv.i != 0 && rv.i != 0) : (lv.i != 0 || rv.i != 0);
+		setConst(t, res, Boolean);
+		break;
+	default:
+		break;
+	}
+}
+
+static void foldSingle(TreeNode * t)
+{
+	TreeNode * p1 = t->child[0];
+	bool flt = isFltClass(t->converted_type);
+	CONSTVAL v;
+
+	if (!isScalar(t->type) || !isScalar(t->converted_type)) return;
+	switch (t->attr.op)
+	{
+	case NEG:
+		if (!isConst(p1)) return;
+		v = convertValue(constValue(p1), flt);
+		if (flt) v.f = -v.f;
+		else v.i = (int)(0u - (unsigned)v.i);
+		setConst(t, v, getBasicType(t->type));
+		break;
+	case CONVERSION:
+		if (!isConst(p1)) return;
+		setConst(t, convertValue(constValue(p1), flt), getBasicType(t->type));
+		break;
+	case SIZEOF:
+		v.flt = FALSE;
+		v.f = 0;
+		v.i = var_size_of_type(t->return_type);
+		setConst(t, convertValue(v, flt), Integer);
+		break;
+	default:
+		break;
+	}
+}
+
+/********************************************/
+static void foldExp(TreeNode * t)
+{
+	TreeNode * arg;
+	if (t == NULL || t->nodekind != ExpK) return;
+	switch (t->kind.exp)
+	{
+	case AssignK:
+		/* the left side is a place, not a value */
+		if (!isExp(t->child[0], IdK)) foldExp(t->child[0]);
+		foldExp(t->child[1]);
+		break;
+	case SingleOpK:
+		if (t->attr.op == ADRESS || t->attr.op == PPLUS || t->attr.op == MMINUS)
+		{
+			if (!isExp(t->child[0], IdK)) foldExp(t->child[0]);
+			break;
+		}
+		if (t->attr.op != SIZEOF) foldExp(t->child[0]);
+		foldSingle(t);
+		break;
+	case OpK:
+		foldExp(t->child[0]);
+		foldExp(t->child[1]);
+		foldOp(t);
+		break;
+	case IdK:
+		foldId(t);
+		break;
+	case FuncallK:
+		for (arg = t->child[0]; arg != NULL; arg = arg->sibling)
+			foldExp(arg);
+		break;
+	case IndexK:
+		foldExp(t->child[0]);
+		foldExp(t->child[1]);
+		break;
+	case PointK:
+	case ArrowK:
+		foldExp(t->child[0]);
+		break;
+	default:
+		break;
+	}
+}
+
+/* a statement whose test is known becomes a block of the branch taken */
+static void toBlock(TreeNode * t, TreeNode * body)
+{
+	t->kind.stmt = BlockK;
+	t->child[0] = body;
+	t->child[1] = NULL;
+	t->child[2] = NULL;
+}
+
+static void foldStmt(TreeNode * t, bool global)
+{
+	int mark, truth;
+	TreeNode * p;
+	if (t->nodekind == ExpK)
+	{
+		foldExp(t);
+		return;
+	}
+
+	switch (t->kind.stmt)
+	{
+	case DeclareK:
+		if (is_basic_type(t->type, Func))
+		{
+			if (!global) addLocal(t->attr.name);
+			mark = localNum;
+			for (p = t->child[0]; p != NULL; p = p->sibling)
+				addLocal(p->attr.name);
+			foldSeq(t->child[1], FALSE);
+			localNum = mark;
+			break;
+		}
+		foldExp(t->child[2]);
+		if (global) recordConst(t);
+		else addLocal(t->attr.name);
+		break;
+	case IfK:
+		foldExp(t->child[0]);
+		foldSeq(t->child[1], FALSE);
+		foldSeq(t->child[2], FALSE);
+		if (constTruth(t->child[0], &truth))
+			toBlock(t, truth ? t->child[1] : t->child[2]);
+		break;
+	case RepeatK:
+		foldExp(t->child[0]);
+		foldSeq(t->child[1], FALSE);
+		if (constTruth(t->child[0], &truth) && !truth)
+			toBlock(t, NULL);
+		break;
+	case SwitchK:
+		foldExp(t->child[0]);
+		foldStmt(t->child[1], FALSE);
+		break;
+	case CaseK:
+	case DefaultK:
+		foldExp(t->child[0]);
+		foldSeq(t->child[1], FALSE);
+		break;
+	case BlockK:
+	case StructDefineK:
+		foldSeq(t->child[0], FALSE);
+		break;
+	case WriteK:
+	case ReturnK:
+	case AsmK:
+		foldExp(t->child[0]);
+		break;
+	default:
+		break;
+	}
+}
+
+/* the locals of a sequence are visible until its end */
+static void foldSeq(TreeNode * t, bool global)
+{
+	int mark = localNum;
+	for (; t != NULL; t = t->sibling)
+		foldStmt(t, global);
+	localNum = mark;
+}
+
+void foldConstants(TreeNode * tree)
+{
+	localNum = 0;
+	foldSeq(tree, TRUE);
+}
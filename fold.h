@@ -0,0 +1,23 @@
+#ifndef FOLD_HEAD
+#define FOLD_HEAD
+/****************************************************/
+/* File: fold.h                                     */
+/* constant folding of the checked syntax tree      */
+/****************************************************/
+#include "globals.h"
+#include "tinytype.h"
+
+/* Procedure foldConstants rewrites constant expressions
+ * of the tree into ConstK nodes, replaces the uses of
+ * const globals by their value and removes the branches
+ * of if/while statements whose test is constant.
+ * It runs after buildSymtab, the types are known
+ */
+void foldConstants(TreeNode * tree);
+
+/* TRUE if t is a scalar constant, its truth value
+ * (as tested by JNE) is stored through truth
+ */
+bool constTruth(TreeNode * t, int * truth);
+
+#endif
@@ -0,0 +1,21 @@
+/*
+ constant expressions and const globals are computed by the compiler
+*/
+
+const int N = 111
+const float HALF = 0.5
+
+int overflow()
+{
+	// not folded: INT_MIN / -1 is INT_MIN and INT_MIN % -1 is 0 at run time
+	return (0 - 2147483647 - 1) / (0 - 1) + (0 - 2147483647 - 1) % (0 - 1)
+}
+
+void main()
+{
+	write N * N + 24
+	write (100 / 7) % 5
+	write HALF * 12
+	if (N > 100) write 1 else write 0
+	write overflow()
+}
@@ -1,3 +1,4 @@
+.FILE function_example.p
 * File: function_example.tm
 * Standard prelude:
   0:    LDC  6,65535(0) 	load mp adress
@@ -9,806 +10,703 @@
   6:    LDC  3,60000(0) 	load first sp from location 2
   7:     ST  0,2(0) 	clear location 2
 * End of standard prelude.
+.LINE 8 1
 * function entry:
 * f
   8:    LDA  3,-1(3) 	stack expand for function variable
   9:    LDC  0,12(0) 	get function adress
- 10:     ST  0,-103(5) 	set function adress
- 11:     GO  100,0,0 	go to label
+ 10:     ST  0,-1162(5) 	set function adress
+ 11:     GO  1679,0,0 	go to label
  12:    MOV  1,2,0 	store the caller fp temporarily
  13:    MOV  2,3,0 	exchang the stack(context)
  14:   PUSH  1,0(3) 	push the caller fp
  15:   PUSH  0,0(3) 	push the return adress
- 16:     LD  0,2(2) 	load id value
- 17:   PUSH  0,0(6) 	store exp
- 18:    LDC  0,2(0) 	load integer const
- 19:   PUSH  0,0(6) 	store exp
- 20:    POP  1,0(6) 	pop right
- 21:    POP  0,0(6) 	pop left
- 22:    SUB  0,0,1 	op <
- 23:    JLE  0,2(7) 	br if true
- 24:    LDC  0,0(0) 	false case
- 25:    LDA  7,1(7) 	unconditional jmp
- 26:    LDC  0,1(0) 	true case
- 27:   PUSH  0,0(6) 	
- 28:    POP  0,0(6) 	pop from the mp
- 29:    JNE  0,1,7 	true case:, execute if part
- 30:     GO  101,0,0 	go to label
- 31:    LDC  0,1(0) 	load integer const
- 32:   PUSH  0,0(6) 	store exp
- 33:    POP  0,0(6) 	op: POP left
- 34:    MOV  9,0,0 	move register reg(s) tp reg(r)
- 35:   PUSH  9,0(6) 	op: push left
- 36:    MOV  3,2,0 	restore the caller sp
- 37:     LD  2,0(2) 	resotre the caller fp
- 38:  RETURN  0,-1,3 	return to the caller
- 39:     GO  102,0,0 	go to label
- 40:  LABEL  101,0,0 	generate label
+.LINE 16 3
+ 16:     LD  12,2(2) 	load id value
+ 17:    LDC  13,2(0) 	load integer const
+ 18:    SUB  12,12,13 	op compare
+ 19:    JLE  12,1(7) 	skip the jump
+ 20:     GO  1680,0,0 	go to label
+.LINE 21 4
+ 21:    LDC  0,1(0) 	load integer const
+ 22:  CVTIF  9,0,0 	move register reg(s) tp reg(r)
+ 23:   PUSH  9,0(6) 	op: push left
+ 24:    MOV  3,2,0 	restore the caller sp
+ 25:     LD  2,0(2) 	resotre the caller fp
+ 26:  RETURN  0,-1,3 	return to the caller
+ 27:     GO  1681,0,0 	go to label
+ 28:  LABEL  1680,0,0 	generate label
 * if: jump to else
+.LINE 29 6
 * push function parameters
- 41:     LD  0,2(2) 	load id value
- 42:   PUSH  0,0(6) 	store exp
- 43:    LDC  0,1(0) 	load integer const
- 44:   PUSH  0,0(6) 	store exp
- 45:    POP  1,0(6) 	pop right
- 46:    POP  0,0(6) 	pop left
- 47:    SUB  0,0,1 	op -
- 48:   PUSH  0,0(6) 	op: load left
- 49:    POP  0,0(6) 	copy bytes
- 50:   PUSH  0,0(3) 	PUSH bytes
- 51:     LD  0,1(2) 	load env
- 52:   PUSH  0,0(3) 	store env
+ 29:     LD  12,2(2) 	load id value
+ 30:    LDC  13,1(0) 	load integer const
+ 31:    SUB  12,12,13 	op -
+ 32:    LDA  0,0(12) 	store exp
+ 33:   PUSH  0,0(3) 	PUSH bytes
+ 34:    LDA  0,0(2) 	load env
+ 35:   PUSH  0,0(3) 	store env
 * call function: 
 * f
- 53:     LD  0,-103(5) 	load id value
- 54:   PUSH  0,0(6) 	store exp
- 55:    LDC  0,57(0) 	store the return adress
- 56:    POP  7,0(6) 	ujp to the function body
- 57:    LDA  3,1(3) 	pop parameters
- 58:    LDA  3,1(3) 	pop env
+ 36:     LD  0,-1162(5) 	load id value
+ 37:   PUSH  0,0(6) 	store exp
+ 38:    LDC  0,40(0) 	store the return adress
+ 39:    POP  7,0(6) 	ujp to the function body
+ 40:    LDA  3,1(3) 	pop parameters
+ 41:    LDA  3,1(3) 	pop env
 * push function parameters
- 59:     LD  0,2(2) 	load id value
- 60:   PUSH  0,0(6) 	store exp
- 61:    LDC  0,2(0) 	load integer const
- 62:   PUSH  0,0(6) 	store exp
- 63:    POP  1,0(6) 	pop right
- 64:    POP  0,0(6) 	pop left
- 65:    SUB  0,0,1 	op -
- 66:   PUSH  0,0(6) 	op: load left
- 67:    POP  0,0(6) 	copy bytes
- 68:   PUSH  0,0(3) 	PUSH bytes
- 69:     LD  0,1(2) 	load env
- 70:   PUSH  0,0(3) 	store env
+ 42:     LD  12,2(2) 	load id value
+ 43:    LDC  13,2(0) 	load integer const
+ 44:    SUB  12,12,13 	op -
+ 45:    LDA  0,0(12) 	store exp
+ 46:   PUSH  0,0(3) 	PUSH bytes
+ 47:    LDA  0,0(2) 	load env
+ 48:   PUSH  0,0(3) 	store env
 * call function: 
 * f
- 71:     LD  0,-103(5) 	load id value
- 72:   PUSH  0,0(6) 	store exp
- 73:    LDC  0,75(0) 	store the return adress
- 74:    POP  7,0(6) 	ujp to the function body
- 75:    LDA  3,1(3) 	pop parameters
- 76:    LDA  3,1(3) 	pop env
- 77:    POP  10,0(6) 	pop right
- 78:    POP  9,0(6) 	pop left
- 79:    ADD  9,9,10 	op +
- 80:   PUSH  9,0(6) 	op: load left
- 81:    MOV  3,2,0 	restore the caller sp
- 82:     LD  2,0(2) 	resotre the caller fp
- 83:  RETURN  0,-1,3 	return to the caller
- 84:  LABEL  102,0,0 	generate label
- 85:    MOV  3,2,0 	restore the caller sp
- 86:     LD  2,0(2) 	resotre the caller fp
- 87:  RETURN  0,-1,3 	return to adress : reg[fp]+1
+ 49:     LD  0,-1162(5) 	load id value
+ 50:   PUSH  0,0(6) 	store exp
+ 51:    LDC  0,53(0) 	store the return adress
+ 52:    POP  7,0(6) 	ujp to the function body
+ 53:    LDA  3,1(3) 	pop parameters
+ 54:    LDA  3,1(3) 	pop env
+ 55:    POP  10,0(6) 	pop right
+ 56:    POP  9,0(6) 	pop left
+ 57:   ADDF  9,9,10 	op +
+ 58:   PUSH  9,0(6) 	op: load left
+ 59:    MOV  3,2,0 	restore the caller sp
+ 60:     LD  2,0(2) 	resotre the caller fp
+ 61:  RETURN  0,-1,3 	return to the caller
+ 62:  LABEL  1681,0,0 	generate label
+ 63:    MOV  3,2,0 	restore the caller sp
+ 64:     LD  2,0(2) 	resotre the caller fp
+ 65:  RETURN  0,-1,3 	return to adress : reg[fp]+1
 * function end:
- 88:  LABEL  100,0,0 	generate label
+ 66:  LABEL  1679,0,0 	generate label
+.LINE 67 9
 * function entry:
 * f2
- 89:    LDA  3,-1(3) 	stack expand for function variable
- 90:    LDC  0,93(0) 	get function adress
- 91:     ST  0,-104(5) 	set function adress
- 92:     GO  103,0,0 	go to label
- 93:    MOV  1,2,0 	store the caller fp temporarily
- 94:    MOV  2,3,0 	exchang the stack(context)
- 95:   PUSH  1,0(3) 	push the caller fp
- 96:   PUSH  0,0(3) 	push the return adress
- 97:     LD  0,2(2) 	load id value
- 98:    MOV  9,0,0 	move from one reg(s) to reg(r)
- 99:   PUSH  9,0(6) 	store exp
-100:     LD  0,3(2) 	load id value
-101:    MOV  9,0,0 	move from one reg(s) to reg(r)
-102:   PUSH  9,0(6) 	store exp
-103:    POP  10,0(6) 	pop right
-104:    POP  9,0(6) 	pop left
-105:    MUL  9,9,10 	op *
-106:   PUSH  9,0(6) 	op: load left
-107:     LD  9,4(2) 	load id value
-108:   PUSH  9,0(6) 	store exp
-109:    POP  10,0(6) 	pop right
-110:    POP  9,0(6) 	pop left
-111:    MUL  9,9,10 	op *
-112:   PUSH  9,0(6) 	op: load left
-113:    MOV  3,2,0 	restore the caller sp
-114:     LD  2,0(2) 	resotre the caller fp
-115:  RETURN  0,-1,3 	return to the caller
-116:    MOV  3,2,0 	restore the caller sp
-117:     LD  2,0(2) 	resotre the caller fp
-118:  RETURN  0,-1,3 	return to adress : reg[fp]+1
+ 67:    LDA  3,-1(3) 	stack expand for function variable
+ 68:    LDC  0,71(0) 	get function adress
+ 69:     ST  0,-1163(5) 	set function adress
+ 70:     GO  1682,0,0 	go to label
+ 71:    MOV  1,2,0 	store the caller fp temporarily
+ 72:    MOV  2,3,0 	exchang the stack(context)
+ 73:   PUSH  1,0(3) 	push the caller fp
+ 74:   PUSH  0,0(3) 	push the return adress
+.LINE 75 11
+ 75:     LD  0,2(2) 	load id value
+ 76:  CVTIF  16,0,0 	convert type
+ 77:     LD  0,3(2) 	load id value
+ 78:  CVTIF  17,0,0 	convert type
+ 79:   MULF  16,16,17 	op *
+ 80:     LD  17,4(2) 	load id value
+ 81:   MULF  16,16,17 	op *
+ 82:   PUSH  16,0(6) 	store exp
+ 83:    MOV  3,2,0 	restore the caller sp
+ 84:     LD  2,0(2) 	resotre the caller fp
+ 85:  RETURN  0,-1,3 	return to the caller
+ 86:    MOV  3,2,0 	restore the caller sp
+ 87:     LD  2,0(2) 	resotre the caller fp
+ 88:  RETURN  0,-1,3 	return to adress : reg[fp]+1
 * function end:
-119:  LABEL  103,0,0 	generate label
+ 89:  LABEL  1682,0,0 	generate label
+.LINE 90 14
 * function entry:
 * f3
-120:    LDA  3,-1(3) 	stack expand for function variable
-121:    LDC  0,124(0) 	get function adress
-122:     ST  0,-105(5) 	set function adress
-123:     GO  104,0,0 	go to label
-124:    MOV  1,2,0 	store the caller fp temporarily
-125:    MOV  2,3,0 	exchang the stack(context)
-126:   PUSH  1,0(3) 	push the caller fp
-127:   PUSH  0,0(3) 	push the return adress
-128:     LD  0,2(2) 	load id value
-129:   PUSH  0,0(6) 	store exp
-130:     LD  0,2(2) 	load id value
-131:   PUSH  0,0(6) 	store exp
-132:    POP  1,0(6) 	pop right
-133:    POP  0,0(6) 	pop left
-134:    ADD  0,0,1 	op +
-135:   PUSH  0,0(6) 	op: load left
-136:    MOV  3,2,0 	restore the caller sp
-137:     LD  2,0(2) 	resotre the caller fp
-138:  RETURN  0,-1,3 	return to the caller
-139:    MOV  3,2,0 	restore the caller sp
-140:     LD  2,0(2) 	resotre the caller fp
-141:  RETURN  0,-1,3 	return to adress : reg[fp]+1
+ 90:    LDA  3,-1(3) 	stack expand for function variable
+ 91:    LDC  0,94(0) 	get function adress
+ 92:     ST  0,-1164(5) 	set function adress
+ 93:     GO  1683,0,0 	go to label
+ 94:    MOV  1,2,0 	store the caller fp temporarily
+ 95:    MOV  2,3,0 	exchang the stack(context)
+ 96:   PUSH  1,0(3) 	push the caller fp
+ 97:   PUSH  0,0(3) 	push the return adress
+.LINE 98 15
+ 98:     LD  12,2(2) 	load id value
+ 99:     LD  13,2(2) 	load id value
+100:    ADD  12,12,13 	op +
+101:   PUSH  12,0(6) 	store exp
+102:    MOV  3,2,0 	restore the caller sp
+103:     LD  2,0(2) 	resotre the caller fp
+104:  RETURN  0,-1,3 	return to the caller
+105:    MOV  3,2,0 	restore the caller sp
+106:     LD  2,0(2) 	resotre the caller fp
+107:  RETURN  0,-1,3 	return to adress : reg[fp]+1
 * function end:
-142:  LABEL  104,0,0 	generate label
+108:  LABEL  1683,0,0 	generate label
+.LINE 109 19
 * function entry:
 * f4
-143:    LDA  3,-1(3) 	stack expand for function variable
-144:    LDC  0,147(0) 	get function adress
-145:     ST  0,-106(5) 	set function adress
-146:     GO  105,0,0 	go to label
-147:    MOV  1,2,0 	store the caller fp temporarily
-148:    MOV  2,3,0 	exchang the stack(context)
-149:   PUSH  1,0(3) 	push the caller fp
-150:   PUSH  0,0(3) 	push the return adress
-151:    LDA  3,-10(3) 	stack expand
-152:    LDA  3,-1(3) 	stack expand
-153:    LDC  0,101(0) 	load integer const
-154:   PUSH  0,0(6) 	store exp
-155:    LDA  0,-12(2) 	load id adress
-156:   PUSH  0,0(6) 	push array adress to mp
-157:    POP  1,0(6) 	move the adress of ID
-158:    POP  0,0(6) 	copy bytes
-159:     ST  0,0(1) 	copy bytes
+109:    LDA  3,-1(3) 	stack expand for function variable
+110:    LDC  0,113(0) 	get function adress
+111:     ST  0,-1165(5) 	set function adress
+112:     GO  1684,0,0 	go to label
+113:    MOV  1,2,0 	store the caller fp temporarily
+114:    MOV  2,3,0 	exchang the stack(context)
+115:   PUSH  1,0(3) 	push the caller fp
+116:   PUSH  0,0(3) 	push the return adress
+117:     LD  1,2(4) 	display entry of the level
+118:   PUSH  1,0(3) 	keep it in the frame
+119:     ST  2,2(4) 	publish the frame
+.LINE 120 20
+120:    LDA  3,-10(3) 	stack expand
+.LINE 121 21
+121:    LDA  3,-1(3) 	stack expand
+122:    LDC  12,101(0) 	load integer const
+123:    LDA  1,-13(2) 	load id adress
+124:    MOV  0,12,0 	convert type
+125:     ST  0,0(1) 	assign: store value
+.LINE 126 22
 * function entry:
 * f3
-160:    LDA  3,-1(3) 	stack expand for function variable
-161:    LDC  0,164(0) 	get function adress
-162:     ST  0,-13(2) 	set function adress
-163:     GO  106,0,0 	go to label
-164:    MOV  1,2,0 	store the caller fp temporarily
-165:    MOV  2,3,0 	exchang the stack(context)
-166:   PUSH  1,0(3) 	push the caller fp
-167:   PUSH  0,0(3) 	push the return adress
-168:    LDA  1,0(2) 	store current fp
-169:     LD  2,1(2) 	load env
-170:     LD  0,-12(2) 	load id value
-171:   PUSH  0,0(6) 	store exp
-172:    LDA  2,0(1) 	restore fp
-173:    POP  0,0(6) 	move result to register
-174:    OUT  0,0,0 	output value in register[ac / fac]
-175:    LDA  1,0(2) 	store current fp
-176:     LD  2,1(2) 	load env
-177:     LD  0,-12(2) 	load id value
-178:   PUSH  0,0(6) 	store exp
-179:    LDA  2,0(1) 	restore fp
-180:    LDC  0,10(0) 	load integer const
-181:   PUSH  0,0(6) 	store exp
-182:    POP  1,0(6) 	pop right
-183:    POP  0,0(6) 	pop left
-184:    ADD  0,0,1 	op +
-185:   PUSH  0,0(6) 	op: load left
-186:    LDA  1,0(2) 	store current fp
-187:     LD  2,1(2) 	load env
-188:    LDA  0,-12(2) 	load id adress
-189:   PUSH  0,0(6) 	push array adress to mp
-190:    LDA  2,0(1) 	restore fp
-191:    POP  1,0(6) 	move the adress of ID
-192:    POP  0,0(6) 	copy bytes
-193:     ST  0,0(1) 	copy bytes
-194:    LDC  0,5(0) 	load integer const
-195:   PUSH  0,0(6) 	store exp
-196:    LDA  1,0(2) 	store current fp
-197:     LD  2,1(2) 	load env
-198:    LDA  0,-11(2) 	load id adress
-199:   PUSH  0,0(6) 	push array adress to mp
-200:    LDA  2,0(1) 	restore fp
-201:    LDC  0,1(0) 	load integer const
-202:   PUSH  0,0(6) 	store exp
-203:    POP  0,0(6) 	load index value to ac
-204:    LDC  1,1,0 	load array size
-205:    MUL  0,1,0 	compute the offset
-206:    POP  1,0(6) 	load lhs adress to ac1
-207:    ADD  0,0,1 	compute the real index adress a[index]
-208:   PUSH  0,0(6) 	push the adress mode into mp
-209:    POP  1,0(6) 	move the adress of referenced
-210:    POP  0,0(6) 	copy bytes
-211:     ST  0,0(1) 	copy bytes
-212:    MOV  3,2,0 	restore the caller sp
-213:     LD  2,0(2) 	resotre the caller fp
-214:  RETURN  0,-1,3 	return to adress : reg[fp]+1
+126:    LDA  3,-1(3) 	stack expand for function variable
+127:    LDC  0,130(0) 	get function adress
+128:     ST  0,-14(2) 	set function adress
+129:     GO  1685,0,0 	go to label
+130:    MOV  1,2,0 	store the caller fp temporarily
+131:    MOV  2,3,0 	exchang the stack(context)
+132:   PUSH  1,0(3) 	push the caller fp
+133:   PUSH  0,0(3) 	push the return adress
+.LINE 134 23
+134:     LD  1,2(4) 	enclosing frame from the display
+135:     LD  0,-13(1) 	load id value
+136:    OUT  0,0,0 	output value in register[ac / fac]
+.LINE 137 24
+137:     LD  1,2(4) 	enclosing frame from the display
+138:     LD  12,-13(1) 	load id value
+139:    LDC  13,10(0) 	load integer const
+140:    ADD  12,12,13 	op +
+141:     LD  1,2(4) 	enclosing frame from the display
+142:    LDA  1,-13(1) 	load id adress
+143:    MOV  0,12,0 	convert type
+144:     ST  0,0(1) 	assign: store value
+.LINE 145 25
+145:    LDC  0,5(0) 	load integer const
+146:   PUSH  0,0(6) 	store exp
+147:     LD  1,2(4) 	enclosing frame from the display
+148:    LDA  0,-12(1) 	load id adress
+149:   PUSH  0,0(6) 	push array adress to mp
+150:    LDC  12,1(0) 	load integer const
+151:    MOV  0,12,0 	move the value
+152:    LDC  1,1,0 	load array size
+153:    MUL  0,1,0 	compute the offset
+154:    POP  1,0(6) 	load lhs adress to ac1
+155:    ADD  1,0,1 	compute the real index adress a[index]
+156:    POP  0,0(6) 	copy bytes
+157:     ST  0,0(1) 	copy bytes
+158:    MOV  3,2,0 	restore the caller sp
+159:     LD  2,0(2) 	resotre the caller fp
+160:  RETURN  0,-1,3 	return to adress : reg[fp]+1
 * function end:
-215:  LABEL  106,0,0 	generate label
-216:    LDA  0,0(2) 	load env
-217:   PUSH  0,0(3) 	store env
+161:  LABEL  1685,0,0 	generate label
+.LINE 162 27
+162:    LDA  0,0(2) 	load env
+163:   PUSH  0,0(3) 	store env
 * call function: 
 * f3
-218:     LD  0,-13(2) 	load id value
-219:   PUSH  0,0(6) 	store exp
-220:    LDC  0,222(0) 	store the return adress
-221:    POP  7,0(6) 	ujp to the function body
-222:    LDA  3,0(3) 	pop parameters
-223:    LDA  3,1(3) 	pop env
-224:    LDA  0,0(2) 	load env
-225:   PUSH  0,0(3) 	store env
+164:     LD  0,-14(2) 	load id value
+165:   PUSH  0,0(6) 	store exp
+166:    LDC  0,168(0) 	store the return adress
+167:    POP  7,0(6) 	ujp to the function body
+168:    LDA  3,0(3) 	pop parameters
+169:    LDA  3,1(3) 	pop env
+.LINE 170 28
+170:    LDA  0,0(2) 	load env
+171:   PUSH  0,0(3) 	store env
 * call function: 
 * f3
-226:     LD  0,-13(2) 	load id value
-227:   PUSH  0,0(6) 	store exp
-228:    LDC  0,230(0) 	store the return adress
-229:    POP  7,0(6) 	ujp to the function body
-230:    LDA  3,0(3) 	pop parameters
-231:    LDA  3,1(3) 	pop env
-232:     LD  0,-12(2) 	load id value
-233:   PUSH  0,0(6) 	store exp
-234:    POP  0,0(6) 	move result to register
-235:    OUT  0,0,0 	output value in register[ac / fac]
-236:    LDA  0,-11(2) 	load id adress
-237:   PUSH  0,0(6) 	push array adress to mp
-238:    LDC  0,1(0) 	load integer const
-239:   PUSH  0,0(6) 	store exp
-240:    POP  0,0(6) 	load index value to ac
-241:    LDC  1,1,0 	load array size
-242:    MUL  0,1,0 	compute the offset
-243:    POP  1,0(6) 	load lhs adress to ac1
-244:    ADD  0,0,1 	compute the real index adress a[index]
-245:     LD  1,0(0) 	load bytes
-246:   PUSH  1,0(6) 	push bytes 
-247:    POP  0,0(6) 	move result to register
-248:    OUT  0,0,0 	output value in register[ac / fac]
-249:    MOV  3,2,0 	restore the caller sp
-250:     LD  2,0(2) 	resotre the caller fp
-251:  RETURN  0,-1,3 	return to adress : reg[fp]+1
+172:     LD  0,-14(2) 	load id value
+173:   PUSH  0,0(6) 	store exp
+174:    LDC  0,176(0) 	store the return adress
+175:    POP  7,0(6) 	ujp to the function body
+176:    LDA  3,0(3) 	pop parameters
+177:    LDA  3,1(3) 	pop env
+.LINE 178 29
+178:     LD  0,-13(2) 	load id value
+179:    OUT  0,0,0 	output value in register[ac / fac]
+.LINE 180 30
+180:    LDA  0,-12(2) 	load id adress
+181:   PUSH  0,0(6) 	push array adress to mp
+182:    LDC  12,1(0) 	load integer const
+183:    MOV  0,12,0 	move the value
+184:    LDC  1,1,0 	load array size
+185:    MUL  0,1,0 	compute the offset
+186:    POP  1,0(6) 	load lhs adress to ac1
+187:    ADD  0,0,1 	compute the real index adress a[index]
+188:     LD  0,0(0) 	load bytes
+189:    OUT  0,0,0 	output value in register[ac / fac]
+190:     LD  1,-2(2) 	display entry of the caller
+191:     ST  1,2(4) 	restore the display
+192:    MOV  3,2,0 	restore the caller sp
+193:     LD  2,0(2) 	resotre the caller fp
+194:  RETURN  0,-1,3 	return to adress : reg[fp]+1
 * function end:
-252:  LABEL  105,0,0 	generate label
+195:  LABEL  1684,0,0 	generate label
+.LINE 196 35
 * function entry:
 * f5
-253:    LDA  3,-1(3) 	stack expand for function variable
-254:    LDC  0,257(0) 	get function adress
-255:     ST  0,-107(5) 	set function adress
-256:     GO  107,0,0 	go to label
-257:    MOV  1,2,0 	store the caller fp temporarily
-258:    MOV  2,3,0 	exchang the stack(context)
-259:   PUSH  1,0(3) 	push the caller fp
-260:   PUSH  0,0(3) 	push the return adress
-261:    LDA  3,-1(3) 	stack expand
-262:    LDC  0,2(0) 	load integer const
-263:   PUSH  0,0(6) 	store exp
-264:    POP  0,0(6) 	pop right
-265:    NEG  0,0,0 	single op (-)
-266:   PUSH  0,0(6) 	op: load left
-267:    LDA  0,-2(2) 	load id adress
-268:   PUSH  0,0(6) 	push array adress to mp
-269:    POP  1,0(6) 	move the adress of ID
-270:    POP  0,0(6) 	copy bytes
-271:     ST  0,0(1) 	copy bytes
+196:    LDA  3,-1(3) 	stack expand for function variable
+197:    LDC  0,200(0) 	get function adress
+198:     ST  0,-1166(5) 	set function adress
+199:     GO  1686,0,0 	go to label
+200:    MOV  1,2,0 	store the caller fp temporarily
+201:    MOV  2,3,0 	exchang the stack(context)
+202:   PUSH  1,0(3) 	push the caller fp
+203:   PUSH  0,0(3) 	push the return adress
+204:     LD  1,2(4) 	display entry of the level
+205:   PUSH  1,0(3) 	keep it in the frame
+206:     ST  2,2(4) 	publish the frame
+.LINE 207 38
+207:    LDA  3,-1(3) 	stack expand
+208:    LDC  12,-2(0) 	load integer const
+209:    LDA  1,-3(2) 	load id adress
+210:    MOV  0,12,0 	convert type
+211:     ST  0,0(1) 	assign: store value
+.LINE 212 39
 * function entry:
 * g1
-272:    LDA  3,-1(3) 	stack expand for function variable
-273:    LDC  0,276(0) 	get function adress
-274:     ST  0,-3(2) 	set function adress
-275:     GO  108,0,0 	go to label
-276:    MOV  1,2,0 	store the caller fp temporarily
-277:    MOV  2,3,0 	exchang the stack(context)
-278:   PUSH  1,0(3) 	push the caller fp
-279:   PUSH  0,0(3) 	push the return adress
-280:    LDA  3,-1(3) 	stack expand
-281:    LDC  0,1(0) 	load integer const
-282:   PUSH  0,0(6) 	store exp
-283:    POP  0,0(6) 	pop right
-284:    NEG  0,0,0 	single op (-)
-285:   PUSH  0,0(6) 	op: load left
-286:    LDA  0,-2(2) 	load id adress
-287:   PUSH  0,0(6) 	push array adress to mp
-288:    POP  1,0(6) 	move the adress of ID
-289:    POP  0,0(6) 	copy bytes
-290:     ST  0,0(1) 	copy bytes
-291:    LDA  1,0(2) 	store current fp
-292:     LD  2,1(2) 	load env
-293:     LD  0,-2(2) 	load id value
-294:   PUSH  0,0(6) 	store exp
-295:    LDA  2,0(1) 	restore fp
-296:    LDC  0,10(0) 	load integer const
-297:   PUSH  0,0(6) 	store exp
-298:    POP  1,0(6) 	pop right
-299:    POP  0,0(6) 	pop left
-300:    ADD  0,0,1 	op +
-301:   PUSH  0,0(6) 	op: load left
-302:    LDA  1,0(2) 	store current fp
-303:     LD  2,1(2) 	load env
-304:    LDA  0,-2(2) 	load id adress
-305:   PUSH  0,0(6) 	push array adress to mp
-306:    LDA  2,0(1) 	restore fp
-307:    POP  1,0(6) 	move the adress of ID
-308:    POP  0,0(6) 	copy bytes
-309:     ST  0,0(1) 	copy bytes
-310:    MOV  3,2,0 	restore the caller sp
-311:     LD  2,0(2) 	resotre the caller fp
-312:  RETURN  0,-1,3 	return to adress : reg[fp]+1
+212:    LDA  3,-1(3) 	stack expand for function variable
+213:    LDC  0,216(0) 	get function adress
+214:     ST  0,-4(2) 	set function adress
+215:     GO  1687,0,0 	go to label
+216:    MOV  1,2,0 	store the caller fp temporarily
+217:    MOV  2,3,0 	exchang the stack(context)
+218:   PUSH  1,0(3) 	push the caller fp
+219:   PUSH  0,0(3) 	push the return adress
+.LINE 220 40
+220:    LDA  3,-1(3) 	stack expand
+221:    LDC  12,-1(0) 	load integer const
+222:    LDA  1,-2(2) 	load id adress
+223:    MOV  0,12,0 	convert type
+224:     ST  0,0(1) 	assign: store value
+.LINE 225 41
+225:     LD  1,2(4) 	enclosing frame from the display
+226:     LD  12,-3(1) 	load id value
+227:    LDC  13,10(0) 	load integer const
+228:    ADD  12,12,13 	op +
+229:     LD  1,2(4) 	enclosing frame from the display
+230:    LDA  1,-3(1) 	load id adress
+231:    MOV  0,12,0 	convert type
+232:     ST  0,0(1) 	assign: store value
+233:    MOV  3,2,0 	restore the caller sp
+234:     LD  2,0(2) 	resotre the caller fp
+235:  RETURN  0,-1,3 	return to adress : reg[fp]+1
 * function end:
-313:  LABEL  108,0,0 	generate label
+236:  LABEL  1687,0,0 	generate label
+.LINE 237 44
 * function entry:
 * g2
-314:    LDA  3,-1(3) 	stack expand for function variable
-315:    LDC  0,318(0) 	get function adress
-316:     ST  0,-4(2) 	set function adress
-317:     GO  109,0,0 	go to label
-318:    MOV  1,2,0 	store the caller fp temporarily
-319:    MOV  2,3,0 	exchang the stack(context)
-320:   PUSH  1,0(3) 	push the caller fp
-321:   PUSH  0,0(3) 	push the return adress
-322:     LD  0,1(2) 	load env
-323:   PUSH  0,0(3) 	store env
+237:    LDA  3,-1(3) 	stack expand for function variable
+238:    LDC  0,241(0) 	get function adress
+239:     ST  0,-5(2) 	set function adress
+240:     GO  1688,0,0 	go to label
+241:    MOV  1,2,0 	store the caller fp temporarily
+242:    MOV  2,3,0 	exchang the stack(context)
+243:   PUSH  1,0(3) 	push the caller fp
+244:   PUSH  0,0(3) 	push the return adress
+.LINE 245 45
+245:     LD  0,2(4) 	load env from the display
+246:   PUSH  0,0(3) 	store env
 * call function: 
 * g1
-324:    LDA  1,0(2) 	store current fp
-325:     LD  2,1(2) 	load env
-326:     LD  0,-3(2) 	load id value
-327:   PUSH  0,0(6) 	store exp
-328:    LDA  2,0(1) 	restore fp
-329:    LDC  0,331(0) 	store the return adress
-330:    POP  7,0(6) 	ujp to the function body
-331:    LDA  3,0(3) 	pop parameters
-332:    LDA  3,1(3) 	pop env
-333:    LDA  1,0(2) 	store current fp
-334:     LD  2,1(2) 	load env
-335:     LD  0,-2(2) 	load id value
-336:   PUSH  0,0(6) 	store exp
-337:    LDA  2,0(1) 	restore fp
-338:    POP  0,0(6) 	move result to register
-339:    OUT  0,0,0 	output value in register[ac / fac]
-340:    MOV  3,2,0 	restore the caller sp
-341:     LD  2,0(2) 	resotre the caller fp
-342:  RETURN  0,-1,3 	return to adress : reg[fp]+1
+247:     LD  1,2(4) 	enclosing frame from the display
+248:     LD  0,-4(1) 	load id value
+249:   PUSH  0,0(6) 	store exp
+250:    LDC  0,252(0) 	store the return adress
+251:    POP  7,0(6) 	ujp to the function body
+252:    LDA  3,0(3) 	pop parameters
+253:    LDA  3,1(3) 	pop env
+.LINE 254 46
+254:     LD  1,2(4) 	enclosing frame from the display
+255:     LD  12,-3(1) 	load id value
+256:    MOV  0,12,0 	move the value
+257:    OUT  0,0,0 	output value in register[ac / fac]
+258:    MOV  3,2,0 	restore the caller sp
+259:     LD  2,0(2) 	resotre the caller fp
+260:  RETURN  0,-1,3 	return to adress : reg[fp]+1
 * function end:
-343:  LABEL  109,0,0 	generate label
-344:    LDA  0,0(2) 	load env
-345:   PUSH  0,0(3) 	store env
+261:  LABEL  1688,0,0 	generate label
+.LINE 262 49
+262:    LDA  0,0(2) 	load env
+263:   PUSH  0,0(3) 	store env
 * call function: 
 * g2
-346:     LD  0,-4(2) 	load id value
-347:   PUSH  0,0(6) 	store exp
-348:    LDC  0,350(0) 	store the return adress
-349:    POP  7,0(6) 	ujp to the function body
-350:    LDA  3,0(3) 	pop parameters
-351:    LDA  3,1(3) 	pop env
-352:    MOV  3,2,0 	restore the caller sp
-353:     LD  2,0(2) 	resotre the caller fp
-354:  RETURN  0,-1,3 	return to adress : reg[fp]+1
+264:     LD  0,-5(2) 	load id value
+265:   PUSH  0,0(6) 	store exp
+266:    LDC  0,268(0) 	store the return adress
+267:    POP  7,0(6) 	ujp to the function body
+268:    LDA  3,0(3) 	pop parameters
+269:    LDA  3,1(3) 	pop env
+270:     LD  1,-2(2) 	display entry of the caller
+271:     ST  1,2(4) 	restore the display
+272:    MOV  3,2,0 	restore the caller sp
+273:     LD  2,0(2) 	resotre the caller fp
+274:  RETURN  0,-1,3 	return to adress : reg[fp]+1
 * function end:
-355:  LABEL  107,0,0 	generate label
+275:  LABEL  1686,0,0 	generate label
+.LINE 276 52
 * function entry:
 * f6
-356:    LDA  3,-1(3) 	stack expand for function variable
-357:    LDC  0,360(0) 	get function adress
-358:     ST  0,-108(5) 	set function adress
-359:     GO  110,0,0 	go to label
-360:    MOV  1,2,0 	store the caller fp temporarily
-361:    MOV  2,3,0 	exchang the stack(context)
-362:   PUSH  1,0(3) 	push the caller fp
-363:   PUSH  0,0(3) 	push the return adress
-364:    LDA  3,-1(3) 	stack expand
-365:    LDC  0,3(0) 	load integer const
-366:   PUSH  0,0(6) 	store exp
-367:    POP  0,0(6) 	pop right
-368:    NEG  0,0,0 	single op (-)
-369:   PUSH  0,0(6) 	op: load left
-370:    LDA  0,-2(2) 	load id adress
-371:   PUSH  0,0(6) 	push array adress to mp
-372:    POP  1,0(6) 	move the adress of ID
-373:    POP  0,0(6) 	copy bytes
-374:     ST  0,0(1) 	copy bytes
+276:    LDA  3,-1(3) 	stack expand for function variable
+277:    LDC  0,280(0) 	get function adress
+278:     ST  0,-1167(5) 	set function adress
+279:     GO  1689,0,0 	go to label
+280:    MOV  1,2,0 	store the caller fp temporarily
+281:    MOV  2,3,0 	exchang the stack(context)
+282:   PUSH  1,0(3) 	push the caller fp
+283:   PUSH  0,0(3) 	push the return adress
+284:     LD  1,2(4) 	display entry of the level
+285:   PUSH  1,0(3) 	keep it in the frame
+286:     ST  2,2(4) 	publish the frame
+.LINE 287 54
+287:    LDA  3,-1(3) 	stack expand
+288:    LDC  12,-3(0) 	load integer const
+289:    LDA  1,-3(2) 	load id adress
+290:    MOV  0,12,0 	convert type
+291:     ST  0,0(1) 	assign: store value
+.LINE 292 55
 * function entry:
 * g
-375:    LDA  3,-1(3) 	stack expand for function variable
-376:    LDC  0,379(0) 	get function adress
-377:     ST  0,-3(2) 	set function adress
-378:     GO  111,0,0 	go to label
-379:    MOV  1,2,0 	store the caller fp temporarily
-380:    MOV  2,3,0 	exchang the stack(context)
-381:   PUSH  1,0(3) 	push the caller fp
-382:   PUSH  0,0(3) 	push the return adress
-383:    LDA  1,0(2) 	store current fp
-384:     LD  2,1(2) 	load env
-385:     LD  0,-2(2) 	load id value
-386:   PUSH  0,0(6) 	store exp
-387:    LDA  2,0(1) 	restore fp
-388:    LDC  0,100(0) 	load integer const
-389:   PUSH  0,0(6) 	store exp
-390:    POP  1,0(6) 	pop right
-391:    POP  0,0(6) 	pop left
-392:    MUL  0,0,1 	op *
-393:   PUSH  0,0(6) 	op: load left
-394:    LDA  1,0(2) 	store current fp
-395:     LD  2,1(2) 	load env
-396:    LDA  0,-2(2) 	load id adress
-397:   PUSH  0,0(6) 	push array adress to mp
-398:    LDA  2,0(1) 	restore fp
-399:    POP  1,0(6) 	move the adress of ID
-400:    POP  0,0(6) 	copy bytes
-401:     ST  0,0(1) 	copy bytes
-402:    MOV  3,2,0 	restore the caller sp
-403:     LD  2,0(2) 	resotre the caller fp
-404:  RETURN  0,-1,3 	return to adress : reg[fp]+1
+292:    LDA  3,-1(3) 	stack expand for function variable
+293:    LDC  0,296(0) 	get function adress
+294:     ST  0,-4(2) 	set function adress
+295:     GO  1690,0,0 	go to label
+296:    MOV  1,2,0 	store the caller fp temporarily
+297:    MOV  2,3,0 	exchang the stack(context)
+298:   PUSH  1,0(3) 	push the caller fp
+299:   PUSH  0,0(3) 	push the return adress
+.LINE 300 56
+300:     LD  1,2(4) 	enclosing frame from the display
+301:     LD  12,-3(1) 	load id value
+302:    LDC  13,100(0) 	load integer const
+303:    MUL  12,12,13 	op *
+304:     LD  1,2(4) 	enclosing frame from the display
+305:    LDA  1,-3(1) 	load id adress
+306:    MOV  0,12,0 	convert type
+307:     ST  0,0(1) 	assign: store value
+308:    MOV  3,2,0 	restore the caller sp
+309:     LD  2,0(2) 	resotre the caller fp
+310:  RETURN  0,-1,3 	return to adress : reg[fp]+1
 * function end:
-405:  LABEL  111,0,0 	generate label
+311:  LABEL  1690,0,0 	generate label
+.LINE 312 59
 * function entry:
 * g1
-406:    LDA  3,-1(3) 	stack expand for function variable
-407:    LDC  0,410(0) 	get function adress
-408:     ST  0,-4(2) 	set function adress
-409:     GO  112,0,0 	go to label
-410:    MOV  1,2,0 	store the caller fp temporarily
-411:    MOV  2,3,0 	exchang the stack(context)
-412:   PUSH  1,0(3) 	push the caller fp
-413:   PUSH  0,0(3) 	push the return adress
-414:    LDA  3,-1(3) 	stack expand
-415:    LDC  0,40(0) 	load integer const
-416:   PUSH  0,0(6) 	store exp
-417:    LDA  0,-2(2) 	load id adress
-418:   PUSH  0,0(6) 	push array adress to mp
-419:    POP  1,0(6) 	move the adress of ID
-420:    POP  0,0(6) 	copy bytes
-421:     ST  0,0(1) 	copy bytes
-422:     LD  0,1(2) 	load env
-423:   PUSH  0,0(3) 	store env
+312:    LDA  3,-1(3) 	stack expand for function variable
+313:    LDC  0,316(0) 	get function adress
+314:     ST  0,-5(2) 	set function adress
+315:     GO  1691,0,0 	go to label
+316:    MOV  1,2,0 	store the caller fp temporarily
+317:    MOV  2,3,0 	exchang the stack(context)
+318:   PUSH  1,0(3) 	push the caller fp
+319:   PUSH  0,0(3) 	push the return adress
+.LINE 320 60
+320:    LDA  3,-1(3) 	stack expand
+321:    LDC  12,40(0) 	load integer const
+322:    LDA  1,-2(2) 	load id adress
+323:    MOV  0,12,0 	convert type
+324:     ST  0,0(1) 	assign: store value
+.LINE 325 61
+325:     LD  0,2(4) 	load env from the display
+326:   PUSH  0,0(3) 	store env
 * call function: 
 * g
-424:    LDA  1,0(2) 	store current fp
-425:     LD  2,1(2) 	load env
-426:     LD  0,-3(2) 	load id value
-427:   PUSH  0,0(6) 	store exp
-428:    LDA  2,0(1) 	restore fp
-429:    LDC  0,431(0) 	store the return adress
-430:    POP  7,0(6) 	ujp to the function body
-431:    LDA  3,0(3) 	pop parameters
-432:    LDA  3,1(3) 	pop env
-433:    LDA  1,0(2) 	store current fp
-434:     LD  2,1(2) 	load env
-435:     LD  0,-2(2) 	load id value
-436:   PUSH  0,0(6) 	store exp
-437:    LDA  2,0(1) 	restore fp
-438:    POP  0,0(6) 	move result to register
-439:    OUT  0,0,0 	output value in register[ac / fac]
-440:    MOV  3,2,0 	restore the caller sp
-441:     LD  2,0(2) 	resotre the caller fp
-442:  RETURN  0,-1,3 	return to adress : reg[fp]+1
+327:     LD  1,2(4) 	enclosing frame from the display
+328:     LD  0,-4(1) 	load id value
+329:   PUSH  0,0(6) 	store exp
+330:    LDC  0,332(0) 	store the return adress
+331:    POP  7,0(6) 	ujp to the function body
+332:    LDA  3,0(3) 	pop parameters
+333:    LDA  3,1(3) 	pop env
+.LINE 334 62
+334:     LD  1,2(4) 	enclosing frame from the display
+335:     LD  12,-3(1) 	load id value
+336:    MOV  0,12,0 	move the value
+337:    OUT  0,0,0 	output value in register[ac / fac]
+338:    MOV  3,2,0 	restore the caller sp
+339:     LD  2,0(2) 	resotre the caller fp
+340:  RETURN  0,-1,3 	return to adress : reg[fp]+1
 * function end:
-443:  LABEL  112,0,0 	generate label
+341:  LABEL  1691,0,0 	generate label
+.LINE 342 65
 * function entry:
 * g2
-444:    LDA  3,-1(3) 	stack expand for function variable
-445:    LDC  0,448(0) 	get function adress
-446:     ST  0,-5(2) 	set function adress
-447:     GO  113,0,0 	go to label
-448:    MOV  1,2,0 	store the caller fp temporarily
-449:    MOV  2,3,0 	exchang the stack(context)
-450:   PUSH  1,0(3) 	push the caller fp
-451:   PUSH  0,0(3) 	push the return adress
-452:    LDA  3,-1(3) 	stack expand
-453:    LDC  0,50(0) 	load integer const
-454:   PUSH  0,0(6) 	store exp
-455:    POP  0,0(6) 	pop right
-456:    NEG  0,0,0 	single op (-)
-457:   PUSH  0,0(6) 	op: load left
-458:    LDA  0,-2(2) 	load id adress
-459:   PUSH  0,0(6) 	push array adress to mp
-460:    POP  1,0(6) 	move the adress of ID
-461:    POP  0,0(6) 	copy bytes
-462:     ST  0,0(1) 	copy bytes
+342:    LDA  3,-1(3) 	stack expand for function variable
+343:    LDC  0,346(0) 	get function adress
+344:     ST  0,-6(2) 	set function adress
+345:     GO  1692,0,0 	go to label
+346:    MOV  1,2,0 	store the caller fp temporarily
+347:    MOV  2,3,0 	exchang the stack(context)
+348:   PUSH  1,0(3) 	push the caller fp
+349:   PUSH  0,0(3) 	push the return adress
+350:     LD  1,3(4) 	display entry of the level
+351:   PUSH  1,0(3) 	keep it in the frame
+352:     ST  2,3(4) 	publish the frame
+.LINE 353 66
+353:    LDA  3,-1(3) 	stack expand
+354:    LDC  12,-50(0) 	load integer const
+355:    LDA  1,-3(2) 	load id adress
+356:    MOV  0,12,0 	convert type
+357:     ST  0,0(1) 	assign: store value
+.LINE 358 67
 * function entry:
 * g3
-463:    LDA  3,-1(3) 	stack expand for function variable
-464:    LDC  0,467(0) 	get function adress
-465:     ST  0,-3(2) 	set function adress
-466:     GO  114,0,0 	go to label
-467:    MOV  1,2,0 	store the caller fp temporarily
-468:    MOV  2,3,0 	exchang the stack(context)
-469:   PUSH  1,0(3) 	push the caller fp
-470:   PUSH  0,0(3) 	push the return adress
-471:    LDA  1,0(2) 	store current fp
-472:     LD  2,1(2) 	load env
-473:     LD  0,-2(2) 	load id value
-474:   PUSH  0,0(6) 	store exp
-475:    LDA  2,0(1) 	restore fp
-476:    POP  0,0(6) 	move result to register
-477:    OUT  0,0,0 	output value in register[ac / fac]
-478:     LD  0,1(2) 	load env
-479:     LD  0,1(0) 	load env1
-480:   PUSH  0,0(3) 	store env
+358:    LDA  3,-1(3) 	stack expand for function variable
+359:    LDC  0,362(0) 	get function adress
+360:     ST  0,-4(2) 	set function adress
+361:     GO  1693,0,0 	go to label
+362:    MOV  1,2,0 	store the caller fp temporarily
+363:    MOV  2,3,0 	exchang the stack(context)
+364:   PUSH  1,0(3) 	push the caller fp
+365:   PUSH  0,0(3) 	push the return adress
+.LINE 366 69
+366:     LD  1,3(4) 	enclosing frame from the display
+367:     LD  12,-3(1) 	load id value
+368:    MOV  0,12,0 	move the value
+369:    OUT  0,0,0 	output value in register[ac / fac]
+.LINE 370 70
+370:     LD  0,2(4) 	load env from the display
+371:   PUSH  0,0(3) 	store env
 * call function: 
 * g
-481:    LDA  1,0(2) 	store current fp
-482:     LD  2,1(2) 	load env
-483:     LD  2,1(2) 	load env
-484:     LD  0,-3(2) 	load id value
-485:   PUSH  0,0(6) 	store exp
-486:    LDA  2,0(1) 	restore fp
-487:    LDC  0,489(0) 	store the return adress
-488:    POP  7,0(6) 	ujp to the function body
-489:    LDA  3,0(3) 	pop parameters
-490:    LDA  3,1(3) 	pop env
-491:    MOV  3,2,0 	restore the caller sp
-492:     LD  2,0(2) 	resotre the caller fp
-493:  RETURN  0,-1,3 	return to adress : reg[fp]+1
+372:     LD  1,2(4) 	enclosing frame from the display
+373:     LD  0,-4(1) 	load id value
+374:   PUSH  0,0(6) 	store exp
+375:    LDC  0,377(0) 	store the return adress
+376:    POP  7,0(6) 	ujp to the function body
+377:    LDA  3,0(3) 	pop parameters
+378:    LDA  3,1(3) 	pop env
+379:    MOV  3,2,0 	restore the caller sp
+380:     LD  2,0(2) 	resotre the caller fp
+381:  RETURN  0,-1,3 	return to adress : reg[fp]+1
 * function end:
-494:  LABEL  114,0,0 	generate label
-495:    LDA  0,0(2) 	load env
-496:   PUSH  0,0(3) 	store env
+382:  LABEL  1693,0,0 	generate label
+.LINE 383 73
+383:    LDA  0,0(2) 	load env
+384:   PUSH  0,0(3) 	store env
 * call function: 
 * g3
-497:     LD  0,-3(2) 	load id value
-498:   PUSH  0,0(6) 	store exp
-499:    LDC  0,501(0) 	store the return adress
-500:    POP  7,0(6) 	ujp to the function body
-501:    LDA  3,0(3) 	pop parameters
-502:    LDA  3,1(3) 	pop env
-503:    MOV  3,2,0 	restore the caller sp
-504:     LD  2,0(2) 	resotre the caller fp
-505:  RETURN  0,-1,3 	return to adress : reg[fp]+1
+385:     LD  0,-4(2) 	load id value
+386:   PUSH  0,0(6) 	store exp
+387:    LDC  0,389(0) 	store the return adress
+388:    POP  7,0(6) 	ujp to the function body
+389:    LDA  3,0(3) 	pop parameters
+390:    LDA  3,1(3) 	pop env
+391:     LD  1,-2(2) 	display entry of the caller
+392:     ST  1,3(4) 	restore the display
+393:    MOV  3,2,0 	restore the caller sp
+394:     LD  2,0(2) 	resotre the caller fp
+395:  RETURN  0,-1,3 	return to adress : reg[fp]+1
 * function end:
-506:  LABEL  113,0,0 	generate label
-507:    LDA  0,0(2) 	load env
-508:   PUSH  0,0(3) 	store env
+396:  LABEL  1692,0,0 	generate label
+.LINE 397 76
+397:    LDA  0,0(2) 	load env
+398:   PUSH  0,0(3) 	store env
 * call function: 
 * g1
-509:     LD  0,-4(2) 	load id value
-510:   PUSH  0,0(6) 	store exp
-511:    LDC  0,513(0) 	store the return adress
-512:    POP  7,0(6) 	ujp to the function body
-513:    LDA  3,0(3) 	pop parameters
-514:    LDA  3,1(3) 	pop env
-515:    LDA  0,0(2) 	load env
-516:   PUSH  0,0(3) 	store env
+399:     LD  0,-5(2) 	load id value
+400:   PUSH  0,0(6) 	store exp
+401:    LDC  0,403(0) 	store the return adress
+402:    POP  7,0(6) 	ujp to the function body
+403:    LDA  3,0(3) 	pop parameters
+404:    LDA  3,1(3) 	pop env
+.LINE 405 77
+405:    LDA  0,0(2) 	load env
+406:   PUSH  0,0(3) 	store env
 * call function: 
 * g2
-517:     LD  0,-5(2) 	load id value
-518:   PUSH  0,0(6) 	store exp
-519:    LDC  0,521(0) 	store the return adress
-520:    POP  7,0(6) 	ujp to the function body
-521:    LDA  3,0(3) 	pop parameters
-522:    LDA  3,1(3) 	pop env
-523:    MOV  3,2,0 	restore the caller sp
-524:     LD  2,0(2) 	resotre the caller fp
-525:  RETURN  0,-1,3 	return to adress : reg[fp]+1
+407:     LD  0,-6(2) 	load id value
+408:   PUSH  0,0(6) 	store exp
+409:    LDC  0,411(0) 	store the return adress
+410:    POP  7,0(6) 	ujp to the function body
+411:    LDA  3,0(3) 	pop parameters
+412:    LDA  3,1(3) 	pop env
+413:     LD  1,-2(2) 	display entry of the caller
+414:     ST  1,2(4) 	restore the display
+415:    MOV  3,2,0 	restore the caller sp
+416:     LD  2,0(2) 	resotre the caller fp
+417:  RETURN  0,-1,3 	return to adress : reg[fp]+1
 * function end:
-526:  LABEL  110,0,0 	generate label
+418:  LABEL  1689,0,0 	generate label
+.LINE 419 82
 * function entry:
 * main
-527:    LDC  0,530(0) 	get function adress
-528:     ST  0,-109(5) 	set function adress
-529:     GO  115,0,0 	go to label
-530:    MOV  1,2,0 	store the caller fp temporarily
-531:    MOV  2,3,0 	exchang the stack(context)
-532:   PUSH  1,0(3) 	push the caller fp
-533:   PUSH  0,0(3) 	push the return adress
-* push function parameters
-534:    LDC  0,100(0) 	load integer const
-535:   PUSH  0,0(6) 	store exp
-536:    POP  0,0(6) 	copy bytes
-537:   PUSH  0,0(3) 	PUSH bytes
-538:     LD  0,1(2) 	load env
-539:   PUSH  0,0(3) 	store env
-* call function: 
+419:    LDC  0,422(0) 	get function adress
+420:     ST  0,-1168(5) 	set function adress
+421:     GO  1694,0,0 	go to label
+422:    MOV  1,2,0 	store the caller fp temporarily
+423:    MOV  2,3,0 	exchang the stack(context)
+424:   PUSH  1,0(3) 	push the caller fp
+425:   PUSH  0,0(3) 	push the return adress
+.LINE 426 84
+* inline call: 
 * f3
-540:     LD  0,-105(5) 	load id value
-541:   PUSH  0,0(6) 	store exp
-542:    LDC  0,544(0) 	store the return adress
-543:    POP  7,0(6) 	ujp to the function body
-544:    LDA  3,1(3) 	pop parameters
-545:    LDA  3,1(3) 	pop env
-546:    POP  0,0(6) 	move result to register
-547:    OUT  0,0,0 	output value in register[ac / fac]
+426:    LDC  12,100(0) 	load integer const
+427:    LDC  13,100(0) 	load integer const
+428:    ADD  12,12,13 	op +
+429:    LDA  0,0(12) 	store exp
+430:    OUT  0,0,0 	output value in register[ac / fac]
+.LINE 431 85
 * push function parameters
 * push function parameters
-548:    LDC  0,1(0) 	load integer const
-549:   PUSH  0,0(6) 	store exp
-550:    POP  0,0(6) 	copy bytes
-551:    MOV  9,0,0 	copy bytes
-552:   PUSH  9,0(3) 	PUSH bytes
+431:    LDC  0,1(0) 	load integer const
+432:  CVTIF  9,0,0 	copy bytes
+433:   PUSH  9,0(3) 	PUSH bytes
 * push function parameters
-553:    LDC  0,1(0) 	load integer const
-554:   PUSH  0,0(6) 	store exp
-555:    POP  0,0(6) 	copy bytes
-556:   PUSH  0,0(3) 	PUSH bytes
+434:    LDC  0,1(0) 	load integer const
+435:   PUSH  0,0(3) 	PUSH bytes
 * push function parameters
 * push function parameters
-557:    LDC  9,0.400000(0)
- 558:   PUSH  9,0(6) 	store exp
-559:    POP  9,0(6) 	copy bytes
-560:   PUSH  9,0(3) 	PUSH bytes
+436:    LDC  9,0.400000(0) 	load float const
+437:   PUSH  9,0(3) 	PUSH bytes
 * push function parameters
 * push function parameters
-561:    LDC  0,4(0) 	load integer const
-562:   PUSH  0,0(6) 	store exp
-563:    POP  0,0(6) 	copy bytes
-564:   PUSH  0,0(3) 	PUSH bytes
-565:     LD  0,1(2) 	load env
-566:   PUSH  0,0(3) 	store env
+438:    LDC  0,4(0) 	load integer const
+439:   PUSH  0,0(3) 	PUSH bytes
+440:    LDA  0,0(2) 	load env
+441:   PUSH  0,0(3) 	store env
 * call function: 
 * f
-567:     LD  0,-103(5) 	load id value
-568:   PUSH  0,0(6) 	store exp
-569:    LDC  0,571(0) 	store the return adress
-570:    POP  7,0(6) 	ujp to the function body
-571:    LDA  3,1(3) 	pop parameters
-572:    LDA  3,1(3) 	pop env
-573:    POP  9,0(6) 	copy bytes
-574:    MOV  0,9,0 	copy bytes
-575:   PUSH  0,0(3) 	PUSH bytes
+442:     LD  0,-1162(5) 	load id value
+443:   PUSH  0,0(6) 	store exp
+444:    LDC  0,446(0) 	store the return adress
+445:    POP  7,0(6) 	ujp to the function body
+446:    LDA  3,1(3) 	pop parameters
+447:    LDA  3,1(3) 	pop env
+448:    POP  9,0(6) 	copy bytes
+449:  CVTFI  0,9,0 	copy bytes
+450:   PUSH  0,0(3) 	PUSH bytes
 * push function parameters
-576:    LDC  0,4(0) 	load integer const
-577:   PUSH  0,0(6) 	store exp
-578:    POP  0,0(6) 	copy bytes
-579:   PUSH  0,0(3) 	PUSH bytes
-580:     LD  0,1(2) 	load env
-581:   PUSH  0,0(3) 	store env
+451:    LDC  0,4(0) 	load integer const
+452:   PUSH  0,0(3) 	PUSH bytes
+453:    LDA  0,0(2) 	load env
+454:   PUSH  0,0(3) 	store env
 * call function: 
 * f2
-582:     LD  0,-104(5) 	load id value
-583:   PUSH  0,0(6) 	store exp
-584:    LDC  0,586(0) 	store the return adress
-585:    POP  7,0(6) 	ujp to the function body
-586:    LDA  3,3(3) 	pop parameters
-587:    LDA  3,1(3) 	pop env
-588:    POP  9,0(6) 	copy bytes
-589:    MOV  0,9,0 	copy bytes
-590:   PUSH  0,0(3) 	PUSH bytes
-591:     LD  0,1(2) 	load env
-592:   PUSH  0,0(3) 	store env
+455:     LD  0,-1163(5) 	load id value
+456:   PUSH  0,0(6) 	store exp
+457:    LDC  0,459(0) 	store the return adress
+458:    POP  7,0(6) 	ujp to the function body
+459:    LDA  3,3(3) 	pop parameters
+460:    LDA  3,1(3) 	pop env
+461:    POP  9,0(6) 	copy bytes
+462:  CVTFI  0,9,0 	copy bytes
+463:   PUSH  0,0(3) 	PUSH bytes
+464:    LDA  0,0(2) 	load env
+465:   PUSH  0,0(3) 	store env
 * call function: 
 * f2
-593:     LD  0,-104(5) 	load id value
-594:   PUSH  0,0(6) 	store exp
-595:    LDC  0,597(0) 	store the return adress
-596:    POP  7,0(6) 	ujp to the function body
-597:    LDA  3,3(3) 	pop parameters
-598:    LDA  3,1(3) 	pop env
-599:    POP  9,0(6) 	copy bytes
-600:    MOV  0,9,0 	copy bytes
-601:   PUSH  0,0(3) 	PUSH bytes
-602:     LD  0,1(2) 	load env
-603:   PUSH  0,0(3) 	store env
+466:     LD  0,-1163(5) 	load id value
+467:   PUSH  0,0(6) 	store exp
+468:    LDC  0,470(0) 	store the return adress
+469:    POP  7,0(6) 	ujp to the function body
+470:    LDA  3,3(3) 	pop parameters
+471:    LDA  3,1(3) 	pop env
+472:    POP  9,0(6) 	copy bytes
+473:  CVTFI  0,9,0 	copy bytes
+474:   PUSH  0,0(3) 	PUSH bytes
+475:    LDA  0,0(2) 	load env
+476:   PUSH  0,0(3) 	store env
 * call function: 
 * f
-604:     LD  0,-103(5) 	load id value
-605:   PUSH  0,0(6) 	store exp
-606:    LDC  0,608(0) 	store the return adress
-607:    POP  7,0(6) 	ujp to the function body
-608:    LDA  3,1(3) 	pop parameters
-609:    LDA  3,1(3) 	pop env
-610:    POP  9,0(6) 	move result to register
-611:    OUT  9,0,0 	output value in register[ac / fac]
+477:     LD  0,-1162(5) 	load id value
+478:   PUSH  0,0(6) 	store exp
+479:    LDC  0,481(0) 	store the return adress
+480:    POP  7,0(6) 	ujp to the function body
+481:    LDA  3,1(3) 	pop parameters
+482:    LDA  3,1(3) 	pop env
+483:    POP  9,0(6) 	move result to register
+484:    OUT  9,0,0 	output value in register[ac / fac]
+.LINE 485 86
 * push function parameters
-612:    LDC  0,8(0) 	load integer const
-613:   PUSH  0,0(6) 	store exp
-614:    POP  0,0(6) 	copy bytes
-615:   PUSH  0,0(3) 	PUSH bytes
-616:     LD  0,1(2) 	load env
-617:   PUSH  0,0(3) 	store env
+485:    LDC  0,8(0) 	load integer const
+486:   PUSH  0,0(3) 	PUSH bytes
+487:    LDA  0,0(2) 	load env
+488:   PUSH  0,0(3) 	store env
 * call function: 
 * f
-618:     LD  0,-103(5) 	load id value
-619:   PUSH  0,0(6) 	store exp
-620:    LDC  0,622(0) 	store the return adress
-621:    POP  7,0(6) 	ujp to the function body
-622:    LDA  3,1(3) 	pop parameters
-623:    LDA  3,1(3) 	pop env
+489:     LD  0,-1162(5) 	load id value
+490:   PUSH  0,0(6) 	store exp
+491:    LDC  0,493(0) 	store the return adress
+492:    POP  7,0(6) 	ujp to the function body
+493:    LDA  3,1(3) 	pop parameters
+494:    LDA  3,1(3) 	pop env
 * push function parameters
-624:    LDC  0,6(0) 	load integer const
-625:   PUSH  0,0(6) 	store exp
-626:    POP  0,0(6) 	copy bytes
-627:    MOV  9,0,0 	copy bytes
-628:   PUSH  9,0(3) 	PUSH bytes
+495:    LDC  0,6(0) 	load integer const
+496:  CVTIF  9,0,0 	copy bytes
+497:   PUSH  9,0(3) 	PUSH bytes
 * push function parameters
-629:    LDC  0,2(0) 	load integer const
-630:   PUSH  0,0(6) 	store exp
-631:    POP  0,0(6) 	copy bytes
-632:   PUSH  0,0(3) 	PUSH bytes
+498:    LDC  0,2(0) 	load integer const
+499:   PUSH  0,0(3) 	PUSH bytes
 * push function parameters
-633:    LDC  0,1(0) 	load integer const
-634:   PUSH  0,0(6) 	store exp
-635:    POP  0,0(6) 	copy bytes
-636:   PUSH  0,0(3) 	PUSH bytes
-637:     LD  0,1(2) 	load env
-638:   PUSH  0,0(3) 	store env
+500:    LDC  0,1(0) 	load integer const
+501:   PUSH  0,0(3) 	PUSH bytes
+502:    LDA  0,0(2) 	load env
+503:   PUSH  0,0(3) 	store env
 * call function: 
 * f2
-639:     LD  0,-104(5) 	load id value
-640:   PUSH  0,0(6) 	store exp
-641:    LDC  0,643(0) 	store the return adress
-642:    POP  7,0(6) 	ujp to the function body
-643:    LDA  3,3(3) 	pop parameters
-644:    LDA  3,1(3) 	pop env
-645:    POP  10,0(6) 	pop right
-646:    POP  9,0(6) 	pop left
-647:    ADD  9,9,10 	op +
-648:   PUSH  9,0(6) 	op: load left
-649:    POP  9,0(6) 	move result to register
-650:    OUT  9,0,0 	output value in register[ac / fac]
-* push function parameters
-651:    LDC  9,0.600000(0)
- 652:   PUSH  9,0(6) 	store exp
-653:    POP  9,0(6) 	copy bytes
-654:   PUSH  9,0(3) 	PUSH bytes
-* push function parameters
-655:    LDC  0,2(0) 	load integer const
-656:   PUSH  0,0(6) 	store exp
-657:    POP  0,0(6) 	copy bytes
-658:   PUSH  0,0(3) 	PUSH bytes
-* push function parameters
-659:    LDC  0,11(0) 	load integer const
-660:   PUSH  0,0(6) 	store exp
-661:    POP  0,0(6) 	copy bytes
-662:   PUSH  0,0(3) 	PUSH bytes
-663:     LD  0,1(2) 	load env
-664:   PUSH  0,0(3) 	store env
-* call function: 
+504:     LD  0,-1163(5) 	load id value
+505:   PUSH  0,0(6) 	store exp
+506:    LDC  0,508(0) 	store the return adress
+507:    POP  7,0(6) 	ujp to the function body
+508:    LDA  3,3(3) 	pop parameters
+509:    LDA  3,1(3) 	pop env
+510:    POP  10,0(6) 	pop right
+511:    POP  9,0(6) 	pop left
+512:   ADDF  9,9,10 	op +
+513:    OUT  9,0,0 	output value in register[ac / fac]
+.LINE 514 87
+* inline call: 
 * f2
-665:     LD  0,-104(5) 	load id value
-666:   PUSH  0,0(6) 	store exp
-667:    LDC  0,669(0) 	store the return adress
-668:    POP  7,0(6) 	ujp to the function body
-669:    LDA  3,3(3) 	pop parameters
-670:    LDA  3,1(3) 	pop env
-671:    POP  9,0(6) 	move result to register
-672:    OUT  9,0,0 	output value in register[ac / fac]
-673:     LD  0,1(2) 	load env
-674:   PUSH  0,0(3) 	store env
+514:    LDC  16,11.000000(0) 	load float const
+515:    LDC  17,2.000000(0) 	load float const
+516:   MULF  16,16,17 	op *
+517:    LDC  17,0.600000(0) 	load float const
+518:   MULF  16,16,17 	op *
+519:    LDA  9,0(16) 	store exp
+520:    OUT  9,0,0 	output value in register[ac / fac]
+.LINE 521 89
+521:    LDA  0,0(2) 	load env
+522:   PUSH  0,0(3) 	store env
 * call function: 
 * f4
-675:     LD  0,-106(5) 	load id value
-676:   PUSH  0,0(6) 	store exp
-677:    LDC  0,679(0) 	store the return adress
-678:    POP  7,0(6) 	ujp to the function body
-679:    LDA  3,0(3) 	pop parameters
-680:    LDA  3,1(3) 	pop env
-681:     LD  0,1(2) 	load env
-682:   PUSH  0,0(3) 	store env
+523:     LD  0,-1165(5) 	load id value
+524:   PUSH  0,0(6) 	store exp
+525:    LDC  0,527(0) 	store the return adress
+526:    POP  7,0(6) 	ujp to the function body
+527:    LDA  3,0(3) 	pop parameters
+528:    LDA  3,1(3) 	pop env
+.LINE 529 90
+529:    LDA  0,0(2) 	load env
+530:   PUSH  0,0(3) 	store env
 * call function: 
 * f5
-683:     LD  0,-107(5) 	load id value
-684:   PUSH  0,0(6) 	store exp
-685:    LDC  0,687(0) 	store the return adress
-686:    POP  7,0(6) 	ujp to the function body
-687:    LDA  3,0(3) 	pop parameters
-688:    LDA  3,1(3) 	pop env
-689:     LD  0,1(2) 	load env
-690:   PUSH  0,0(3) 	store env
+531:     LD  0,-1166(5) 	load id value
+532:   PUSH  0,0(6) 	store exp
+533:    LDC  0,535(0) 	store the return adress
+534:    POP  7,0(6) 	ujp to the function body
+535:    LDA  3,0(3) 	pop parameters
+536:    LDA  3,1(3) 	pop env
+.LINE 537 91
+537:    LDA  0,0(2) 	load env
+538:   PUSH  0,0(3) 	store env
 * call function: 
 * f6
-691:     LD  0,-108(5) 	load id value
-692:   PUSH  0,0(6) 	store exp
-693:    LDC  0,695(0) 	store the return adress
-694:    POP  7,0(6) 	ujp to the function body
-695:    LDA  3,0(3) 	pop parameters
-696:    LDA  3,1(3) 	pop env
-697:    MOV  3,2,0 	restore the caller sp
-698:     LD  2,0(2) 	resotre the caller fp
-699:  RETURN  0,-1,3 	return to adress : reg[fp]+1
+539:     LD  0,-1167(5) 	load id value
+540:   PUSH  0,0(6) 	store exp
+541:    LDC  0,543(0) 	store the return adress
+542:    POP  7,0(6) 	ujp to the function body
+543:    LDA  3,0(3) 	pop parameters
+544:    LDA  3,1(3) 	pop env
+545:    MOV  3,2,0 	restore the caller sp
+546:     LD  2,0(2) 	resotre the caller fp
+547:  RETURN  0,-1,3 	return to adress : reg[fp]+1
 * function end:
-700:  LABEL  115,0,0 	generate label
+548:  LABEL  1694,0,0 	generate label
 * call main function
-701:     LD  1,-109(5) 	get main function adress
-702:    LDC  0,704(0) 	store the return adress
-703:    LDA  7,0(1) 	ujp to the function body
-704:   HALT  0,0,0 	
+549:     LD  1,-1168(5) 	get main function adress
+550:    LDC  0,552(0) 	store the return adress
+551:    LDA  7,0(1) 	ujp to the function body
+552:   HALT  0,0,0 	
+* peephole: push/pop 37, ldc+add 0, moves 13, jumps 0 removed, 0 jumps threaded
@@ -0,0 +1,41 @@
+/*
+ far more is allocated than the heap holds and nothing is freed,
+ only the collector lets the program finish
+*/
+
+import pyb_example_2
+
+struct node
+{
+	struct node * next
+	int value
+}
+
+typedef struct node node
+
+void main()
+{
+	node * head = NULL
+	node * cell = NULL
+	int i = 0
+	while (i < 5000)
+	{
+		int * garbage = malloc(20)
+		garbage[0] = i
+		if (i % 500 == 0)
+		{
+			cell = malloc(sizeof(node))
+			cell->value = i
+			cell->next = head
+			head = cell
+		}
+		i += 1
+	}
+	int sum = 0
+	while (head != NULL)
+	{
+		sum += head->value
+		head = head->next
+	}
+	write sum
+}
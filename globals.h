@@ -29,7 +29,6 @@
 #define NOTFOUND    (404 * 404)
 
 extern char* MainModule;
-extern FILE* source; /* source code text file */
 extern FILE* listing; /* listing output text file */
 extern FILE* code; /* code text file for TM simulator */
 extern int lineno; /* source line number for listing */
@@ -73,6 +72,18 @@ extern int TraceAnalyze;
 */
 extern int TraceCode;
 
+/* Peephole selects the rules of the peephole pass
+ * run on the generated code (PEEP_* in code.h,
+ * -peephole=MASK), 0 writes the code as it is generated
+ */
+extern int Peephole;
+
+/* InlineLimit is the size in tree nodes up to which
+ * a function returning one expression is inlined at
+ * its calls (-inline=N), 0 disables inlining
+ */
+extern int InlineLimit;
+
 /* Error = TRUE prevents further passes if an error occurs */
 extern int Error;
 
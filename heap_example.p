@@ -0,0 +1,34 @@
+/*
+ blocks of many sizes are taken and given back, every
+ allocator has to print the same
+*/
+
+import pyb_example_2
+
+void main()
+{
+	int i = 0
+	int sum = 0
+	int * q = NULL
+	while (i < 300)
+	{
+		int n = i % 13 + 1
+		int * p = malloc(n)
+		int j = 0
+		while (j < n)
+		{
+			p[j] = i + j
+			j += 1
+		}
+		j = 0
+		while (j < n)
+		{
+			sum += p[j]
+			j += 1
+		}
+		if (q != NULL) free(q)
+		q = p
+		i += 1
+	}
+	write sum
+}
@@ -0,0 +1,44 @@
+/*
+ small functions returning one expression and struct methods
+ are inlined at their calls
+*/
+
+struct point
+{
+	int x
+	int y
+	int sum(int k)
+	{
+		return self->x + self->y + k
+	}
+}
+
+typedef struct point point
+
+int sq(int v)
+{
+	return v * v
+}
+
+float half(float f)
+{
+	return f / 2
+}
+
+void main()
+{
+	point p
+	p.x = 3
+	p.y = 4
+	int i = 0
+	int total = 0
+	while (i < 10)
+	{
+		total += p.sum(0)
+		total += sq(i)
+		i += 1
+	}
+	write total
+	write half(7)
+	write sq(sq(3))
+}
@@ -8,10 +8,13 @@
 #include "util.h"
 #include "tm.h"
 #include "test.h"
+#include "vmmemory.h"
+#include "vmgc.h"
+#include "tmbatch.h"
+#include "tm2c.h"
 
 
 int lineno = 0;
-FILE * source;
 FILE * listing;
 FILE * code;
 char * MainModule;
@@ -22,11 +25,40 @@ int TraceScan = TRUE;
 int TraceParse = TRUE;
 int TraceAnalyze = TRUE;
 int TraceCode = TRUE;
+int Peephole = 0xF;/* PEEP_ALL */
+int InlineLimit = 12;
 int Error = FALSE;
 int done = FALSE;
 
-int main()
+int main(int argc, char * argv[])
 {    
+	char * batchFile = NULL;
+	char * nativeFile = NULL;
+	int threads = 0, budget = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strncmp(argv[i], "-inline=", 8) == 0) InlineLimit = atoi(argv[i] + 8);
+		if (strncmp(argv[i], "-peephole=", 10) == 0) Peephole = (int)strtol(argv[i] + 10, NULL, 0);
+		if (strcmp(argv[i], "-heap=firstfit") == 0) HeapKind = heapFirstFit;
+		if (strcmp(argv[i], "-heap=segregated") == 0) HeapKind = heapSegregated;
+		if (strcmp(argv[i], "-gc") == 0) GcEnabled = TRUE;
+		if (strncmp(argv[i], "-batch=", 7) == 0) batchFile = argv[i] + 7;
+		if (strncmp(argv[i], "-threads=", 9) == 0) threads = atoi(argv[i] + 9);
+		if (strncmp(argv[i], "-budget=", 8) == 0) budget = atoi(argv[i] + 8);
+		if (strncmp(argv[i], "-tm2c=", 6) == 0) nativeFile = argv[i] + 6;
+	}
+	/* translate a compiled program into C: pc -tm2c=prog.tmo writes prog_tm.c */
+	if (nativeFile != NULL)
+	{
+		char cFile[256];
+		char * dot = strrchr(nativeFile, '.');
+		int n = dot == NULL ? (int)strlen(nativeFile) : (int)(dot - nativeFile);
+		sprintf(cFile, "%.*s_tm.c", n < 240 ? n : 240, nativeFile);
+		return tm2c(nativeFile, cFile) ? 0 : 1;
+	}
+	/* run compiled programs only: pc -batch=jobs.txt [-threads=n] [-budget=n] */
+	if (batchFile != NULL)
+		return runBatch(batchFile, threads, budget, stdout) == 0 ? 0 : 1;
 
 	/*MainModule = "pyb_example.p";
 	char * codeFileName = createTmFileName(MainModule);
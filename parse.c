@@ -9,11 +9,19 @@
 
 static TokenType token; /* holds current token */
 static TokenType token_array[MAX_TOKEN];// holds last token
-static char* token_string_array[MAX_TOKEN];
+static LEXEME token_lexeme_array[MAX_TOKEN];// the source text of each token
+static int token_line_array[MAX_TOKEN];// source line of each token
+static int token_column_array[MAX_TOKEN];
 static int pos = 0;// hold the current token position
+static int column = 0;// source column of the current token
 static typeDefMap type_map[MAX_TYPE_DEF];// typedef ӳ
 
 
+void clearTypeDefs()
+{
+	memset(type_map, 0, sizeof(type_map));
+}
+
 /* function prototypes for recursive calls */
 static TreeNode * stmt_sequence();
 static TreeNode * statement();
@@ -73,7 +81,7 @@ static ArrayType parseArrayType(TypeInfo eleType);
 static void syntaxError(char * message)
 {
 	fprintf(listing, "\n>>> ");
-	fprintf(listing, "Syntax error at line %d: %s", lineno, message);
+	fprintf(listing, "Syntax error at line %d, column %d: %s", lineno, column, message);
 	Error = TRUE;
 	assert(!message);
 }
@@ -436,10 +444,9 @@ TreeNode* parseOneExp()
 {
 	 token = token_array[--pos];
 	 while (token == LINEEND && pos > 0) { token = token_array[--pos]; }
-	 int i = 0;
-	 
-	 char * str = token_string_array[pos];
-	 do{ tokenString[i++] = *str; } while (*str++ != '\0');
+	 lexemeString(token_lexeme_array[pos]);
+	 lineno = token_line_array[pos];
+	 column = token_column_array[pos];
 }
 
  TokenType getLastTokenWithoutSkipLineEnd()
@@ -469,20 +476,21 @@ TreeNode* parseOneExp()
 
  TokenType  currentToken()
  {
-	 int i = 0;
-	 char * str = token_string_array[++pos];
-	 do{ tokenString[i++] = *str; } while (*str++ != '\0');
-	 
+	 lexemeString(token_lexeme_array[++pos]);
+	 lineno = token_line_array[pos];// the nodes get the line of their token
+	 column = token_column_array[pos];
 	 return token_array[pos];
  }
 
  /* init tokens and tokenStrings */
  void initTokens()
  {
-	#define addToken(token,tokenstr)  do\
+	#define addToken(token,lexeme)  do\
 	 {\
 		token_array[i] = token;\
-		token_string_array[i++] = tokenstr;\
+		token_line_array[i] = lineno;\
+		token_column_array[i] = tokenColumn;\
+		token_lexeme_array[i++] = lexeme;\
 	}while(0)\
 
 	 int i = 0;
@@ -490,18 +498,18 @@ TreeNode* parseOneExp()
 	 TokenType tok = getToken();
 	 TokenType last_tok;
 	 while (tok == LINEEND && tok != ENDFILE) tok = getToken();// skip the first LINEEND
-	 addToken(tok, copyString(tokenString));// 
+	 addToken(tok, tokenLexeme);// 
 
 	 while (tok != ENDFILE)
 	 {
 		 last_tok = tok;
 		 tok = getToken();
 		 if (tok == last_tok && last_tok == LINEEND) continue;
-		 addToken(tok, copyString(tokenString));
+		 addToken(tok, tokenLexeme);
 		 
 	 }
 
-	 addToken(ENDFILE, NULL);
+	 addToken(ENDFILE, tokenLexeme);
 	 pos = -1;
  }
 
@@ -17,6 +17,7 @@ TreeNode * parse(void);
 /* function prototypes for recursive calls */
 bool match_possible_lbracket();
 bool is_line_end();// is the end of line?
+void clearTypeDefs();// forget the typedefs of the last program
 
 /*洢typedef ӳϵ*/
 typedef struct type_def_map
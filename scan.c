@@ -3,7 +3,19 @@
 #include "scan.h"
 #include "tinytype.h"
 
-char tokenString[MAXTOKENLEN + 5];
+#ifdef _WIN32
+#define SCAN_NO_MMAP 1
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+char * tokenString = NULL;
+LEXEME tokenLexeme;
+int tokenColumn = 0;
+static int tokenCap = 0;
 /* states in scanner DFA */
 typedef enum
 {
@@ -13,26 +25,71 @@ typedef enum
 	DONE
 } StateType;
 
-/* BUFLEN = length of the input buffer for
-source code lines */
 #define setStateMinus() do{currentToken = MINUS; ungetNextChar(c); state = DONE;} while (0)
 #define SET_CUR_TOKEN(tok) do {state = DONE; currentToken = tok;}while(0)
 #define SET_CUR_TOKEN_AND_UNGET(tok) do{ungetNextChar(c);SET_CUR_TOKEN(tok);}while(0)
 
-#define BUFLEN 256
-static int EOF_flag = FALSE; /* corrects ungetNextChar behavior on EOF */
-static char lineBuf[BUFLEN]; /* holds the current line */
-static int linepos = 0; /* current position in LineBuf */
-static int bufsize = 0; /* current size of buffer string */
+/* the source module is read in one piece, mapped where there
+ * is mmap, and scanned with a position into it. A lexeme is
+ * the slice of the text its token was scanned from
+ */
+static char * srcText = NULL;
+static size_t srcLen = 0;
+static size_t srcPos = 0;     /* the next character, may run past srcLen at EOF */
+static bool srcMapped = FALSE;
+static size_t lineStart = 0;  /* offset of the current line */
+static size_t lastLineStart = 0;
 
-/* getNextChar fetches the next non-blank character
-from lineBuf, reading in a new line if lineBuf is
-exhausted */
+bool openSource(char * filename)
+{
+#ifdef SCAN_NO_MMAP
+	FILE * in = fopen(filename, "rb");
+	if (in == NULL) return FALSE;
+	fseek(in, 0, SEEK_END);
+	srcLen = (size_t)ftell(in);
+	fseek(in, 0, SEEK_SET);
+	srcText = (char *)malloc(srcLen + 1);
+	srcLen = fread(srcText, 1, srcLen, in);
+	fclose(in);
+	srcMapped = FALSE;
+#else
+	struct stat st;
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) return FALSE;
+	if (fstat(fd, &st) < 0)
+	{
+		close(fd);
+		return FALSE;
+	}
+	srcLen = (size_t)st.st_size;
+	srcText = NULL;
+	if (srcLen > 0)
+	{
+		srcText = (char *)mmap(NULL, srcLen, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (srcText == MAP_FAILED) srcText = NULL;
+	}
+	close(fd);
+	if (srcText == NULL && srcLen > 0) return FALSE;
+	srcMapped = srcText != NULL;
+#endif
+	srcPos = lineStart = lastLineStart = 0;
+	lineno = 1;
+	return TRUE;
+}
+
+/* getNextChar fetches the next character of the
+source text, EOF past its end */
 
 static int getNextChar()
 {
-	int c =  fgetc(source);
-	if (c == '\n') lineno++;
+	int c = srcPos < srcLen ? (unsigned char)srcText[srcPos] : EOF;
+	srcPos++;
+	if (c == '\n')
+	{
+		lineno++;
+		lastLineStart = lineStart;
+		lineStart = srcPos;
+	}
 	return c;
 }
 
@@ -42,14 +99,24 @@ static bool isAplhaUnderscore(char ch)
 }
 
 static void ungetNextChar(int c){
-	if (!EOF_flag) ungetc(c,source);
+	srcPos--;
+	if (c == '\n')
+	{
+		lineno--;// it will be counted again when read back
+		lineStart = lastLineStart;
+	}
 }
 
-
-//tokenstring˳һ,˵˳//ĵһ/
-static void ungetTokenstring(int *tokenstringindex)
+char * lexemeString(LEXEME lx)
 {
-	if (!EOF_flag) (*tokenstringindex)--;
+	if (lx.length + 1 > tokenCap)
+	{
+		while (lx.length + 1 > tokenCap) tokenCap = tokenCap == 0 ? 64 : tokenCap * 2;
+		tokenString = (char *)realloc(tokenString, tokenCap);
+	}
+	memcpy(tokenString, srcText + lx.offset, lx.length);
+	tokenString[lx.length] = '\0';
+	return tokenString;
 }
 
 /* lookup table of reserved words */
@@ -68,11 +135,12 @@ static struct
 
 /* lookup an identifier to see if it is a reserved word */
 /* uses linear search */
-static TokenType reservedLookup(char * s)
+static TokenType reservedLookup(LEXEME lx)
 {
 	int i;
 	for (i = 0; i<MAXRESERVED; i++)
-	if (reservedWords[i].str != NULL && !strcmp(s, reservedWords[i].str))
+	if (reservedWords[i].str != NULL && (int)strlen(reservedWords[i].str) == lx.length
+		&& !strncmp(srcText + lx.offset, reservedWords[i].str, lx.length))
 		return reservedWords[i].tok;
 	return ID;
 }
@@ -84,13 +152,14 @@ static TokenType reservedLookup(char * s)
 * next token in source file
 */
 TokenType getToken(void)
-{  /* index for storing into tokenString */
-	int tokenStringIndex = 0;
+{  /* where the lexeme starts, once a character is saved */
+	size_t start = 0;
+	bool started = FALSE;
 	/* holds current token to be returned */
 	TokenType currentToken = ERROR;
 	/* current state - always begins at START */
 	StateType state = START;
-	/* flag to indicate save to tokenString */
+	/* flag to indicate the character belongs to the lexeme */
 	int save;
 	int comment_num = 0;
 	while (state != DONE)
@@ -106,7 +175,7 @@ TokenType getToken(void)
 				state = INID;
 			else if (c == '=')
 				state = INASSIGN_OR_EQ;
-			else if ((c == ' ') || (c == '\t')){
+			else if ((c == ' ') || (c == '\t') || (c == '\r')){
 				save = FALSE;
 			}
 			else if (c == '\n'){
@@ -286,13 +355,13 @@ TokenType getToken(void)
 		case OVER_OR_COMMENT:
 			if (c == '/'){
 				state = INCOMMENT;
-				ungetTokenstring(&tokenStringIndex);
+				started = FALSE;// the '/' is no token
 				save = FALSE;
 			}
 			else if (c == '*'){
 				state = INMULCOMMENT;
 				comment_num = 1;
-				ungetTokenstring(&tokenStringIndex);
+				started = FALSE;
 				save = FALSE;
 			}
 			else {		
@@ -345,7 +414,7 @@ TokenType getToken(void)
 				SET_CUR_TOKEN(NOTEQ);
 			}
 			else{
-				SET_CUR_TOKEN(NOT);
+				SET_CUR_TOKEN_AND_UNGET(NOT);
 			}
 			
 			break;
@@ -360,21 +429,30 @@ TokenType getToken(void)
 			SET_CUR_TOKEN(ERROR);
 			break;
 		}
-		if ((save) && (tokenStringIndex <= MAXTOKENLEN))
+		if (save && !started)
 		{
-			tokenString[tokenStringIndex++] = (char)c;
-			if (c == '\n') ungetNextChar(c);// to return LINEND
+			started = TRUE;
+			start = srcPos - 1;
+			tokenColumn = (int)(start - lineStart) + 1;
 		}
-			if (state == DONE)
+		if (state == DONE)
 		{
-			tokenString[tokenStringIndex] = '\0';
+			/* the characters given back are not in the lexeme */
+			size_t end = srcPos < srcLen ? srcPos : srcLen;
+			if (!started)
+			{
+				start = end;
+				tokenColumn = (int)(end - lineStart) + 1;
+			}
+			tokenLexeme.offset = (int)start;
+			tokenLexeme.length = end > start ? (int)(end - start) : 0;
 			if (currentToken == ID)
-				currentToken = reservedLookup(tokenString);
+				currentToken = reservedLookup(tokenLexeme);
 		}
 	}
 	if (TraceScan) {
-		fprintf(listing, "\t%d: ", lineno);
-		printToken(currentToken, tokenString);
+		fprintf(listing, "\t%d:%d: ", lineno, tokenColumn);
+		printToken(currentToken, lexemeString(tokenLexeme));
 	}
 	return currentToken;
 } /* end getToken */
@@ -382,7 +460,11 @@ TokenType getToken(void)
 //scanһ֮Ҫб־Ϊʼ״̬һδģ
 void clear()
 {
-	EOF_flag = FALSE;
-	linepos = 0;
-	fclose(source);
+#ifdef SCAN_NO_MMAP
+	free(srcText);
+#else
+	if (srcMapped) munmap(srcText, srcLen);
+#endif
+	srcText = NULL;
+	srcLen = srcPos = 0;
 }
\ No newline at end of file
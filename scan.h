@@ -9,11 +9,29 @@
 #include "globals.h"
 #include "tinytype.h"
 
-/* MAXTOKENLEN is the maximum size of a token */
-#define MAXTOKENLEN 40
+/* a lexeme is the slice of the source text its token
+ * was scanned from, it is only valid until clear
+ */
+typedef struct {
+	int offset;
+	int length;
+} LEXEME;
+
+/* the lexeme of the last token and the column it starts in,
+ * lineno is its line
+ */
+extern LEXEME tokenLexeme;
+extern int tokenColumn;
+
+/* tokenString holds the lexeme made a string by lexemeString */
+extern char * tokenString;
+char * lexemeString(LEXEME lx);
+
+/* function openSource reads the source file for getToken
+ * in one piece, FALSE if it can not be read
+ */
+bool openSource(char * filename);
 
-/* tokenString array stores the lexeme of each token */
-extern char tokenString[MAXTOKENLEN + 5];
 /* function getToken returns the
 * next token in source file
 */
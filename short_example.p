@@ -0,0 +1,40 @@
+/*
+ && and || evaluate their right operand only when the left one
+ does not decide, calls counts the operands evaluated
+*/
+
+int calls = 0
+
+int touch(int v)
+{
+	calls += 1
+	return v
+}
+
+int both(int a, int b)
+{
+	return touch(a) && touch(b)
+}
+
+int any(int a, int b, int c)
+{
+	return touch(a) || touch(b) || touch(c)
+}
+
+void main()
+{
+	int x = 0
+	if (touch(0) && touch(1)) write 1 else write 0
+	write calls
+	if (touch(1) || touch(0)) write 1 else write 0
+	write calls
+	x = both(1, 0)
+	write x
+	write calls
+	x = any(0, 2, 3)
+	write x
+	write calls
+	while (x < 5 && touch(x) < 4) x += 1
+	write x
+	write calls
+}
@@ -0,0 +1,32 @@
+/*
+ a method slot can be given another function, the calls through
+ the slot are left as calls
+*/
+
+struct counter
+{
+	int n
+	int get()
+	{
+		return self->n
+	}
+}
+
+typedef struct counter counter
+
+int fixed()
+{
+	return 42
+}
+
+void main()
+{
+	counter c
+	counter * p = &c
+	c.n = 5
+	write c.get()
+	write p->get()
+	c.get = fixed
+	write c.get()
+	write p->get()
+}
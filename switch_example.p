@@ -0,0 +1,103 @@
+/*
+ switch on constant cases goes through a jump table when the
+ cases are dense and a decision tree when they are sparse,
+ other cases are compared in order
+*/
+
+int dense(int v)
+{
+	int r = -1
+	switch (v)
+	{
+	case 0:
+		r = 10
+		break
+	case 1:
+	case 2:
+		r = 12
+		break
+	case 3:
+		r = 13
+		break
+	case 4:
+		r = 14
+		break
+	case 6:
+		r = 16
+		break
+	default:
+		r = 0
+	}
+	return r
+}
+
+int sparse(int v)
+{
+	int r = -1
+	switch (v)
+	{
+	case -5:
+		r = 1
+		break
+	case 1:
+		r = 2
+		break
+	case 100:
+		r = 3
+		break
+	case 10000:
+		r = 4
+		break
+	case 1000000:
+		r = 5
+		break
+	case -2000000000:
+		r = 6
+		break
+	case 2000000000:
+		r = 7
+		break
+	default:
+		r = 0
+	}
+	return r
+}
+
+int compared(int v)
+{
+	int k = 7
+	int r = -1
+	switch (v)
+	{
+	case k:
+		r = 70
+		break
+	case 8:
+		r = 80
+		break
+	default:
+		r = 0
+	}
+	return r
+}
+
+void main()
+{
+	int v = -1
+	while (v < 8)
+	{
+		write dense(v)
+		v += 1
+	}
+	write sparse(-5)
+	write sparse(1)
+	write sparse(100)
+	write sparse(10000)
+	write sparse(1000000)
+	write sparse(-2000000000)
+	write sparse(2000000000)
+	write sparse(2)
+	write compared(7)
+	write compared(8)
+	write compared(9)
+}
@@ -95,6 +95,7 @@ BucketList construct_node(char * name, int lineno, int loc, int size,int depth,
     //int adress = (int)type.func_type.params->type;//3161504
     //int ssize = (int)(list);
 	list->var_type = type;// share some memory of type
+	list->const_value = NULL;
 	list->next = NULL;
 	return list;
 }
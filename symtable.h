@@ -12,6 +12,7 @@ typedef struct BucketListRec
 	int function_depth;// the var defined environment
 	bool struct_var;
 	TypeInfo var_type;
+	TreeNode * const_value;// value of a const global, set by foldConstants
 	struct BucketListRec * next;
 } *BucketList;
 
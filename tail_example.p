@@ -0,0 +1,35 @@
+/*
+ return f(...) reuses the frame, so the recursion below runs far
+ deeper than the stack would allow with a frame per call
+*/
+
+int sum(int n, int acc)
+{
+	if (n == 0) return acc
+	return sum(n - 1, acc + n)
+}
+
+int countdown(int n, int steps)
+{
+	if (n <= 0) return steps
+	return sum(0, 0) + countdown(n - 1, steps + 1)
+}
+
+int hop(int n, int acc)
+{
+	if (n == 0) return acc
+	return hop2(n - 1, acc + 3)
+}
+
+int hop2(int n, int acc)
+{
+	if (n == 0) return acc
+	return hop(n - 1, acc - 1)
+}
+
+void main()
+{
+	write sum(100000, 0)
+	write countdown(100, 0)
+	write hop(100001, 0)
+}
@@ -2,9 +2,23 @@
 #include <string.h>
 #include "stdlib.h"
 #include <ctype.h>
+#include <stddef.h>
 #include "globals.h"
 #include "compile.h"
+#include "tmobj.h"
+#include "tm.h"
+#include "tinytype.h"
+#include "parse.h"
+#include "vmmemory.h"
+#include "vmgc.h"
+#include "tmbatch.h"
+#include "tmprof.h"
+#include "code.h"
+#include "tm2c.h"
+#include "tmjit.h"
+#include "tmexec.h"
 #include "assert.h"
+#include <limits.h>
 
 #define AROUND_UNIT_TEST(msg,prog){\
 	test_log = msg;\
@@ -50,6 +64,7 @@ void skipInstruction();
 void testStatistic();
 void testFloat(float expected, float real);
 void testChar(char,char);
+void testString(char * expected, char * real);
 void clearFile(char * codeFileName)
 {
 	file = fopen(codeFileName, "w");//ļ
@@ -133,12 +148,14 @@ void skipInstruction()
 void initResultFile(char * procedure_file_name)
 {
 	char * codeFileName = createTmFileName(procedure_file_name);// xxx.tm
+	char * objFileName = createObjFileName(procedure_file_name);// xxx.tmo
 	clearFile(codeFileName);
 	import(procedure_file_name);
-	file = fopen(codeFileName, "r");
-	if (!readInstructions(file)){
+	// the compiler writes the object next to the text, the VM runs the mapped object
+	if (!loadObject(objFileName)){
 		exit(1);
 	}
+	file = fopen(codeFileName, "r");
 
 	listing = fopen("test_result.p","w");
 	!doCommand('g');
@@ -152,6 +169,1495 @@ void initResultFile(char * procedure_file_name)
 }
 
 
+/**************  engines  **************/
+/* a program runs on a machine of its own, what OUT prints is
+ * kept so the engines can be checked against stepTM
+ */
+typedef enum { engStep, engRun, engProfile, engJit } ENGINE;
+
+static int lastSteps;// instructions executed by the last runProgram
+
+static char * readAll(FILE * f)
+{
+	long n = ftell(f);
+	char * s = (char *)malloc(n + 1);
+	rewind(f);
+	n = (long)fread(s, 1, n, f);
+	s[n] = '\0';
+	return s;
+}
+
+// compile procedure_file_name into its .tm and .tmo
+void compileProgram(char * procedure_file_name)
+{
+	MainModule = procedure_file_name;
+	clearFile(createTmFileName(procedure_file_name));
+	clearTypeCollection();// the struct types of the last program
+	clearTypeDefs();
+	import(procedure_file_name);
+	clearSymTable();
+	clearImport();
+	clearGode();
+}
+
+/* run program (.tmo or .tm) with engine until HALT, returns what it
+ * printed, NULL if it stopped for another reason. tm is the machine
+ * after the run when it is not NULL, the caller destroys it then
+ */
+char * runProgram(char * program, ENGINE engine, TMContext ** machine)
+{
+	TMContext * tm = tm_create();
+	STEPRESULT result = srOKAY;
+	char * printed = NULL;
+	int steps = 0;
+	int loaded;
+
+	if (machine != NULL) *machine = NULL;
+	if (tm == NULL) return NULL;
+	if (strstr(program, ".tmo") != NULL)
+		loaded = tm_load(tm, program);
+	else
+	{
+		FILE * pgm = fopen(program, "r");
+		loaded = pgm != NULL && readInstructions(tm, pgm);
+		if (pgm != NULL) fclose(pgm);
+	}
+	if (!loaded)
+	{
+		tm_destroy(tm);
+		return NULL;
+	}
+	tm->out = tmpfile();
+	if (engine == engStep)
+	{
+		do {
+			result = stepTM(tm);
+			steps++;// HALT is counted like in doCommand
+		} while (result == srOKAY);
+	}
+	else
+	{
+		tm->profileflag = engine == engProfile;
+		tm->jitflag = engine == engJit;
+		result = tm_run(tm, &steps);
+	}
+	lastSteps = steps;
+	if (result == srHALT) printed = readAll(tm->out);
+	fclose(tm->out);
+	tm->out = NULL;
+	if (machine != NULL) *machine = tm;
+	else tm_destroy(tm);
+	return printed;
+}
+
+
+
+// runTM executes the instructions stepTM does and prints the same
+void testThreadedOutput()
+{
+	char * programs[] = { "function_example.p", "list_example.p", "hash_example.p", "regexp_example.p" };
+	for (int i = 0; i < 4; ++i)
+	{
+		char * tmFile = createTmFileName(programs[i]);
+		compileProgram(programs[i]);
+		char * expected = runProgram(tmFile, engStep, NULL);
+		int steps = lastSteps;
+		char * real = runProgram(tmFile, engRun, NULL);
+		SET_FAIL_SUB_LOG(programs[i]);
+		testInteger(TRUE, expected != NULL);
+		testString(expected, real);
+		testInteger(steps, lastSteps);
+		free(expected);
+		free(real);
+	}
+}
+
+void testEngines()
+{
+	AROUND_UNIT_TEST("test engines", testThreadedOutput());
+}
+
+/* the text of a program still says GO, the loaded code jumps to the
+ * label directly and GO to a label that does not exist is refused
+ */
+void testLinkedLabels()
+{
+	char * programs[] = { "function_example.p", "list_example.p" };
+	char line[256];
+	for (int i = 0; i < 2; ++i)
+	{
+		int goText = 0, goCode = 0;
+		TMContext * tm = tm_create();
+		FILE * pgm;
+		compileProgram(programs[i]);
+		pgm = fopen(createTmFileName(programs[i]), "r");
+		while (pgm != NULL && fgets(line, sizeof(line), pgm) != NULL)
+			if (strstr(line, " GO ") != NULL) goText++;
+		if (pgm != NULL) rewind(pgm);
+		SET_FAIL_SUB_LOG(programs[i]);
+		testInteger(TRUE, pgm != NULL && readInstructions(tm, pgm));
+		for (int loc = 0; loc < tm->iMemSize; ++loc)
+			if (tm->iMem[loc].iop == opGO) goCode++;
+		testInteger(TRUE, goText > 0);
+		testInteger(0, goCode);
+		if (pgm != NULL) fclose(pgm);
+		tm_destroy(tm);
+	}
+
+	TMContext * tm = tm_create();
+	FILE * broken = tmpfile();
+	fputs("  0:     GO  7,0,0\n  1:   HALT  0,0,0\n", broken);
+	rewind(broken);
+	SET_FAIL_SUB_LOG("undefined label:");
+	testInteger(FALSE, readInstructions(tm, broken));
+	fclose(broken);
+	tm_destroy(tm);
+}
+
+void testLink()
+{
+	AROUND_UNIT_TEST("test link", testLinkedLabels());
+}
+
+/* loads a copy of objFile cut to len bytes, with the int at byte
+ * offset at set to value when at is not -1
+ */
+int loadBrokenObject(char * objFile, long len, long at, int value)
+{
+	char * brokenFile = "broken_example.tmo";
+	FILE * f = fopen(objFile, "rb");
+	if (f == NULL) return FALSE;
+	fseek(f, 0, SEEK_END);
+	long n = ftell(f);
+	char * bytes = (char *)malloc(n);
+	rewind(f);
+	n = (long)fread(bytes, 1, n, f);
+	fclose(f);
+
+	if (len > n) len = n;
+	if (at != -1 && at + (long)sizeof(int) <= len) memcpy(bytes + at, &value, sizeof(int));
+	f = fopen(brokenFile, "wb");
+	fwrite(bytes, 1, len, f);
+	fclose(f);
+	free(bytes);
+
+	TMContext * tm = tm_create();
+	int ok = tm_load(tm, brokenFile);
+	tm_destroy(tm);
+	remove(brokenFile);
+	return ok;
+}
+
+/* the object runs like the text it is assembled from, the loader
+ * refuses an object whose sections do not fit the file
+ */
+void testObjectFile()
+{
+	char * programs[] = { "function_example.p", "hash_example.p" };
+	for (int i = 0; i < 2; ++i)
+	{
+		compileProgram(programs[i]);
+		char * expected = runProgram(createTmFileName(programs[i]), engStep, NULL);
+		char * real = runProgram(createObjFileName(programs[i]), engRun, NULL);
+		SET_FAIL_SUB_LOG(programs[i]);
+		testString(expected, real);
+		free(expected);
+		free(real);
+	}
+
+	char * objFile = createObjFileName("function_example.p");
+	TMOBJHEADER h;
+	compileProgram("function_example.p");
+	FILE * f = fopen(objFile, "rb");
+	if (f == NULL || fread(&h, sizeof(h), 1, f) != 1) memset(&h, 0, sizeof(h));
+	if (f != NULL) fclose(f);
+
+	SET_FAIL_SUB_LOG("broken objects:");
+	testInteger(TRUE, loadBrokenObject(objFile, 1L << 30, -1, 0));
+	testInteger(FALSE, loadBrokenObject(objFile, h.str_off / 2, -1, 0));
+	testInteger(FALSE, loadBrokenObject(objFile, 1L << 30, offsetof(TMOBJHEADER, ninstr), 1 << 28));
+	testInteger(FALSE, loadBrokenObject(objFile, 1L << 30, offsetof(TMOBJHEADER, data_off), -4));
+	testInteger(FALSE, loadBrokenObject(objFile, 1L << 30, h.instr_off + offsetof(INSTRUCTION, iop), opEND + 1));
+	testInteger(FALSE, loadBrokenObject(objFile, 1L << 30, h.instr_off + offsetof(INSTRUCTION, iop), opGO));
+	testInteger(FALSE, loadBrokenObject(objFile, 1L << 30, h.instr_off + offsetof(INSTRUCTION, iarg1), NO_REGS));
+}
+
+/* the line and function tables of an object must point into its
+ * code and names, or profBegin and the reports index out of them
+ */
+void testObjectTables()
+{
+	char * objFile = createObjFileName("function_example.p");
+	TMOBJHEADER h;
+	compileProgram("function_example.p");
+	FILE * f = fopen(objFile, "rb");
+	if (f == NULL || fread(&h, sizeof(h), 1, f) != 1) memset(&h, 0, sizeof(h));
+	if (f != NULL) fclose(f);
+	long func = h.func_off, line = h.line_off;
+
+	SET_FAIL_SUB_LOG("broken tables:");
+	testInteger(TRUE, h.nfunc > 0 && h.nline > 0);
+	testInteger(FALSE, loadBrokenObject(objFile, 1L << 30, offsetof(TMOBJHEADER, nfunc), 1 << 28));
+	testInteger(FALSE, loadBrokenObject(objFile, 1L << 30, offsetof(TMOBJHEADER, func_off), -4));
+	testInteger(FALSE, loadBrokenObject(objFile, 1L << 30, func + offsetof(TMFUNC, start), -100000));
+	testInteger(FALSE, loadBrokenObject(objFile, 1L << 30, func + offsetof(TMFUNC, start), h.ninstr + 1));
+	testInteger(FALSE, loadBrokenObject(objFile, 1L << 30, func + offsetof(TMFUNC, end), h.ninstr + 1));
+	testInteger(FALSE, loadBrokenObject(objFile, 1L << 30, func + offsetof(TMFUNC, end), -2));
+	testInteger(FALSE, loadBrokenObject(objFile, 1L << 30, func + offsetof(TMFUNC, entry), h.ninstr));
+	testInteger(FALSE, loadBrokenObject(objFile, 1L << 30, func + offsetof(TMFUNC, entry), -1));
+	testInteger(FALSE, loadBrokenObject(objFile, 1L << 30, func + offsetof(TMFUNC, name), h.nstr));
+	testInteger(FALSE, loadBrokenObject(objFile, 1L << 30, line + offsetof(TMLINE, file), -1));
+	testInteger(FALSE, loadBrokenObject(objFile, 1L << 30, line + offsetof(TMLINE, loc), h.ninstr + 1));
+	testInteger(FALSE, loadBrokenObject(objFile, 1L << 30, line + offsetof(TMLINE, loc), -1));
+}
+
+void testObject()
+{
+	AROUND_UNIT_TEST("test object", testObjectFile());
+	AROUND_UNIT_TEST("test object tables", testObjectTables());
+}
+
+/* expr_example.p keeps its expressions in the temporaries, deep()
+ * needs more of them than there are and spills
+ */
+void testRegisterAllocation()
+{
+	char * expected =
+		"OUT instruction prints int: 21\n"
+		"OUT instruction prints int: 1684\n"
+		"OUT instruction prints int: -54\n"
+		"OUT instruction prints int: 55\n"
+		"OUT instruction prints int: 70\n"
+		"OUT instruction prints int: 51\n"
+		"OUT instruction prints float: 9.000000\n"
+		"OUT instruction prints int: 1\n"
+		"OUT instruction prints int: 19\n"
+		"OUT instruction prints float: 108.000000\n";
+	char * program = createObjFileName("expr_example.p");
+	int inTmp = 0, spilled = 0;
+	TMContext * tm;
+	compileProgram("expr_example.p");
+	char * stepped = runProgram(program, engStep, NULL);
+	char * run = runProgram(program, engRun, &tm);
+	SET_FAIL_SUB_LOG("expressions in registers:");
+	testString(expected, stepped);
+	testString(expected, run);
+	for (int loc = 0; tm != NULL && loc < tm->iMemSize; ++loc)
+	{
+		int r = tm->iMem[loc].iarg1;
+		if (r >= itmp && r < ftmp + NUM_TMP) inTmp++;
+		if (tm->iMem[loc].iop == opPOP && r >= itmp && r < ftmp + NUM_TMP) spilled++;// reloaded
+	}
+	testInteger(TRUE, inTmp > 0);
+	testInteger(TRUE, spilled > 0);
+	tm_destroy(tm);
+	free(stepped);
+	free(run);
+}
+
+void testRegisters()
+{
+	AROUND_UNIT_TEST("test registers", testRegisterAllocation());
+}
+
+/* every rule alone keeps what the program prints and never makes
+ * the code longer, all of them together make it shorter
+ */
+void testPeepholeRules()
+{
+	char * programs[] = { "function_example.p", "list_example.p", "expr_example.p" };
+	int rules[] = { PEEP_PUSHPOP, PEEP_LDCADD, PEEP_MOVES, PEEP_JUMPS, PEEP_ALL };
+	int all = Peephole;
+	for (int i = 0; i < 3; ++i)
+	{
+		char * program = createTmFileName(programs[i]);
+		Peephole = 0;
+		compileProgram(programs[i]);
+		TMContext * tm;
+		char * expected = runProgram(program, engRun, &tm);
+		int size = tm != NULL ? tm->iMemSize : 0;
+		tm_destroy(tm);
+		SET_FAIL_SUB_LOG(programs[i]);
+		testInteger(TRUE, expected != NULL);
+		for (int k = 0; k < 5; ++k)
+		{
+			Peephole = rules[k];
+			compileProgram(programs[i]);
+			char * real = runProgram(program, engRun, &tm);
+			int peeped = tm != NULL ? tm->iMemSize : size + 1;
+			testString(expected, real);
+			testInteger(TRUE, rules[k] == PEEP_ALL ? peeped < size : peeped <= size);
+			tm_destroy(tm);
+			free(real);
+		}
+		free(expected);
+	}
+	Peephole = all;
+}
+
+void testPeephole()
+{
+	AROUND_UNIT_TEST("test peephole", testPeepholeRules());
+}
+
+/* the arithmetic of fold_example.p is done by the compiler, except
+ * INT_MIN / -1 and INT_MIN % -1, which are not folded
+ */
+void testFoldedConstants()
+{
+	int arith = 0;
+	TMContext * tm;
+	SET_FAIL_SUB_LOG("fold_example.p");
+	compileProgram("fold_example.p");
+	char * real = runProgram(createTmFileName("fold_example.p"), engStep, &tm);
+	testString("OUT instruction prints int: 12345\n"
+		"OUT instruction prints int: 4\n"
+		"OUT instruction prints float: 6.000000\n"
+		"OUT instruction prints int: 1\n"
+		"OUT instruction prints int: -2147483648\n", real);
+	for (int loc = 0; tm != NULL && loc < tm->iMemSize; ++loc)
+	{
+		int op = tm->iMem[loc].iop;
+		if (op == opMUL || op == opDIV || op == opMOD) arith++;
+	}
+	// only the DIV and MOD of INT_MIN by -1 are left, in overflow()
+	// and where main inlines it
+	testInteger(4, arith);
+	tm_destroy(tm);
+	free(real);
+}
+
+void testFold()
+{
+	AROUND_UNIT_TEST("test fold", testFoldedConstants());
+}
+
+/* short_example.p prints each result followed by the number of
+ * operands touched so far, a right operand is touched only when
+ * the left one does not decide
+ */
+void testShortCircuitCalls()
+{
+	int printed[] = { 0, 1, 1, 2, 0, 4, 1, 6, 4, 10 };
+	char expected[512] = "";
+	compileProgram("short_example.p");
+	for (int i = 0; i < sizeof(printed) / sizeof(int); ++i)
+		sprintf(expected + strlen(expected), "OUT instruction prints int: %d\n", printed[i]);
+	for (ENGINE engine = engStep; engine <= engRun; ++engine)
+	{
+		char * real = runProgram(createTmFileName("short_example.p"), engine, NULL);
+		SET_FAIL_SUB_LOG(engine == engStep ? "stepTM:" : "runTM:");
+		testString(expected, real);
+		free(real);
+	}
+}
+
+/* float_cmp_example.p compares -0.0 and NaN in registers, on the stack
+ * and in branches; every engine prints what C would, and the
+ * compares are all float jumps
+ */
+void testFloatCompares()
+{
+	int printed[] = { 0, 1, 0, 0, 1, 0, 1, 0, 0, 0, 1, 0, 0, 1 };
+	char expected[512] = "";
+	char * program = createObjFileName("float_cmp_example.p");
+	TMContext * tm;
+	int intJumps = 0, fltJumps = 0;
+	compileProgram("float_cmp_example.p");
+	for (int i = 0; i < sizeof(printed) / sizeof(int); ++i)
+		sprintf(expected + strlen(expected), "OUT instruction prints int: %d\n", printed[i]);
+	for (ENGINE engine = engStep; engine <= engJit; ++engine)
+	{
+		char * real = runProgram(program, engine, &tm);
+		SET_FAIL_SUB_LOG(engine == engStep ? "stepTM:" : engine == engRun ? "runTM:" : engine == engJit ? "jit:" : "profile:");
+		testString(expected, real);
+		for (int loc = 0; engine == engStep && tm != NULL && loc < tm->iMemSize; ++loc)
+		{
+			int op = tm->iMem[loc].iop;
+			if (op >= opJLTF && op <= opJNEF) fltJumps++;
+			else if (op >= opJLT && op <= opJGE) intJumps++;
+		}
+		tm_destroy(tm);
+		free(real);
+	}
+	// the only int compare left is the loop of grow()
+	testInteger(TRUE, fltJumps >= 13);
+	testInteger(1, intJumps);
+}
+
+void testShortCircuit()
+{
+	AROUND_UNIT_TEST("test short-circuit", testShortCircuitCalls());
+	AROUND_UNIT_TEST("test float compares", testFloatCompares());
+}
+
+/* the dense switch of switch_example.p jumps through the one table,
+ * the sparse and the compared ones give the same answers without
+ */
+void testSwitchCases()
+{
+	int expected[] = { 0, 10, 12, 12, 13, 14, 0, 16, 0, 1, 2, 3, 4, 5, 6, 7, 0, 70, 80, 0 };
+	int n = sizeof(expected) / sizeof(int);
+	int tables = 0, i = 0, value;
+	TMContext * tm;
+	compileProgram("switch_example.p");
+	char * real = runProgram(createTmFileName("switch_example.p"), engRun, &tm);
+	testInteger(TRUE, real != NULL);
+	if (real == NULL) return;
+	for (char * line = real; i < n && sscanf(line, "OUT instruction prints int: %d", &value) == 1; ++i)
+	{
+		testInteger(expected[i], value);
+		line = strchr(line, '\n') + 1;
+	}
+	testInteger(n, i);
+	for (int loc = 0; loc < tm->iMemSize; ++loc)
+		if (tm->iMem[loc].iop == opJIDX) tables++;
+	testInteger(1, tables);
+	tm_destroy(tm);
+	free(real);
+}
+
+void testSwitch()
+{
+	AROUND_UNIT_TEST("test switch", testSwitchCases());
+}
+
+/* sum and hop in tail_example.p recurse 100000 times, far more frames
+ * than dMem holds, they only finish when the tail calls reuse the frame
+ */
+void testTailRecursion()
+{
+	char expected[256];
+	sprintf(expected, "OUT instruction prints int: %d\n"
+		"OUT instruction prints int: %d\n"
+		"OUT instruction prints int: %d\n",
+		(int)(unsigned)(100000LL * 100001 / 2), 100, 100003);
+	compileProgram("tail_example.p");
+	char * stepped = runProgram(createTmFileName("tail_example.p"), engStep, NULL);
+	int steps = lastSteps;
+	char * ran = runProgram(createTmFileName("tail_example.p"), engRun, NULL);
+	testString(expected, stepped);
+	testString(expected, ran);
+	testInteger(steps, lastSteps);
+	free(stepped);
+	free(ran);
+}
+
+void testTailCall()
+{
+	AROUND_UNIT_TEST("test tail call", testTailRecursion());
+}
+
+/* inline_example.p prints the same with inlining off, the calls
+ * left in place only take more steps
+ */
+void testInlinedCalls()
+{
+	int limit = InlineLimit;
+	int steps[2];
+	char * printed[2];
+	for (int off = 0; off < 2; ++off)
+	{
+		InlineLimit = off ? 0 : limit;
+		compileProgram("inline_example.p");
+		printed[off] = runProgram(createTmFileName("inline_example.p"), engRun, NULL);
+		steps[off] = lastSteps;
+	}
+	InlineLimit = limit;
+	testString("OUT instruction prints int: 355\n"
+		"OUT instruction prints float: 3.500000\n"
+		"OUT instruction prints int: 81\n", printed[0]);
+	testString(printed[0], printed[1]);
+	testInteger(TRUE, steps[0] < steps[1]);
+	free(printed[0]);
+	free(printed[1]);
+}
+
+/* slot_example.p gives the slot of a method another function, its
+ * calls go through the slot with inlining on and off
+ */
+void testReassignedMethod()
+{
+	int limit = InlineLimit;
+	char * printed[2];
+	for (int off = 0; off < 2; ++off)
+	{
+		InlineLimit = off ? 0 : limit;
+		compileProgram("slot_example.p");
+		printed[off] = runProgram(createTmFileName("slot_example.p"), engRun, NULL);
+	}
+	InlineLimit = limit;
+	SET_FAIL_SUB_LOG("slot_example.p");
+	testString("OUT instruction prints int: 5\n"
+		"OUT instruction prints int: 5\n"
+		"OUT instruction prints int: 42\n"
+		"OUT instruction prints int: 42\n", printed[1]);
+	testString(printed[1], printed[0]);
+	free(printed[0]);
+	free(printed[1]);
+}
+
+void testInline()
+{
+	AROUND_UNIT_TEST("test inline", testInlinedCalls());
+	AROUND_UNIT_TEST("test reassigned method", testReassignedMethod());
+}
+
+/* the nested functions of display_example.p reach total, n, r and mine
+ * from the display, none of them walks the env chain
+ */
+void testDisplayAccess()
+{
+	int chained = 0;
+	TMContext * tm;
+	compileProgram("display_example.p");
+	char * real = runProgram(createTmFileName("display_example.p"), engStep, &tm);
+	testString("OUT instruction prints int: 27\n"
+		"OUT instruction prints int: 120\n"
+		"OUT instruction prints int: 60\n", real);
+	for (int loc = 0; tm != NULL && loc < tm->iMemSize; ++loc)
+	{
+		INSTRUCTION in = tm->iMem[loc];
+		if (in.iop == opLD && in.iarg1 == ac1 && in.iarg2 == 1 && in.iarg3 == ac1) chained++;
+	}
+	testInteger(0, chained);
+	tm_destroy(tm);
+	free(real);
+}
+
+void testDisplay()
+{
+	AROUND_UNIT_TEST("test display", testDisplayAccess());
+}
+
+/* a hand written MEMSET, MEMMOVE over its own block and MEMCPY
+ * at address at, dMem[at..at+7] ends as 1 1 7 7 1 1 7 7
+ */
+STEPRESULT runBlockOps(TMContext * tm, int at, ENGINE engine)
+{
+	INSTRUCTION code[] = {
+		{ opLDC, 1, at, 0 },
+		{ opLDC, 2, 7, 0 },
+		{ opMEMSET, 1, 4, 2 },
+		{ opLDC, 2, 1, 0 },
+		{ opST, 2, 0, 1 },
+		{ opLDA, 3, 1, 1 },
+		{ opMEMMOVE, 3, 3, 1 },
+		{ opLDA, 2, 4, 1 },
+		{ opMEMCPY, 2, 4, 1 },
+		{ opHALT, 0, 0, 0 },
+	};
+	STEPRESULT result;
+	int steps = 0;
+	resetMachine(tm);
+	tm->iMem = code;
+	tm->iMemSize = sizeof(code) / sizeof(INSTRUCTION);
+	if (engine == engRun) result = runTM(tm, &steps);
+	else while ((result = stepTM(tm)) == srOKAY);
+	tm->iMem = NULL;
+	tm->iMemSize = 0;
+	return result;
+}
+
+void testBlockInstructions()
+{
+	int expected[] = { 1, 1, 7, 7, 1, 1, 7, 7 };
+	TMContext * tm = tm_create();
+	SET_FAIL_SUB_LOG("block_example.p");
+	compileProgram("block_example.p");
+	char * real = runProgram(createObjFileName("block_example.p"), engRun, NULL);
+	testString("OUT instruction prints int: 2\n"
+		"OUT instruction prints int: 28\n"
+		"OUT instruction prints int: 20\n", real);
+	free(real);
+
+	for (ENGINE engine = engStep; engine <= engRun; ++engine)
+	{
+		SET_FAIL_SUB_LOG(engine == engStep ? "stepTM blocks" : "runTM blocks");
+		testInteger(srHALT, runBlockOps(tm, 100, engine));
+		for (int i = 0; i < 8; ++i) testInteger(expected[i], tm->dMem[100 + i]);
+		// the block would run past the end of dMem
+		testInteger(srDMEM_ERR, runBlockOps(tm, DADDR_SIZE - 2, engine));
+	}
+	tm_destroy(tm);
+}
+
+void testBlock()
+{
+	AROUND_UNIT_TEST("test block", testBlockInstructions());
+}
+
+/* heap_example.p takes 300 blocks of 1 to 13 words and gives each
+ * back after the next one is taken, both allocators see the same
+ * calls and the program prints the same sum
+ */
+void testAllocatorCounters()
+{
+	int kind = HeapKind;
+	HEAPSTATS stats[2];
+	char * printed[2];
+	compileProgram("heap_example.p");
+	for (int k = heapFirstFit; k <= heapSegregated; ++k)
+	{
+		HeapKind = k;
+		TMContext * tm;
+		printed[k] = runProgram(createObjFileName("heap_example.p"), engRun, &tm);
+		memset(&stats[k], 0, sizeof(HEAPSTATS));
+		if (tm != NULL) heapStats(tm, &stats[k]);
+		tm_destroy(tm);
+	}
+	HeapKind = kind;
+	testString("OUT instruction prints int: 324714\n", printed[heapFirstFit]);
+	testString(printed[heapFirstFit], printed[heapSegregated]);
+	for (int k = heapFirstFit; k <= heapSegregated; ++k)
+	{
+		testInteger(300, stats[k].nmalloc);
+		testInteger(299, stats[k].nfree);
+		// only the last block is left
+		testInteger(TRUE, stats[k].live > 0 && stats[k].live < stats[k].peak);
+		free(printed[k]);
+	}
+}
+
+void testAllocator()
+{
+	AROUND_UNIT_TEST("test allocator", testAllocatorCounters());
+}
+
+/* gc_example.p allocates far more than the heap holds and frees
+ * nothing, it needs the collector on both runs; the programs that
+ * do free print the same with it off (runTM) and on (stepTM)
+ */
+void testCollector()
+{
+	int enabled = GcEnabled;
+	char * programs[] = { "gc_example.p", "list_example.p", "heap_example.p" };
+	char * printed[2];
+	for (int i = 0; i < 3; ++i)
+	{
+		compileProgram(programs[i]);
+		SET_FAIL_SUB_LOG(programs[i]);
+		for (int on = 0; on < 2; ++on)
+		{
+			GcEnabled = on || i == 0;
+			printed[on] = runProgram(createObjFileName(programs[i]), on ? engStep : engRun, NULL);
+		}
+		if (i == 0) testString("OUT instruction prints int: 22500\n", printed[0]);
+		testInteger(TRUE, printed[0] != NULL);
+		testString(printed[0], printed[1]);
+		free(printed[0]);
+		free(printed[1]);
+	}
+	GcEnabled = enabled;
+}
+
+void testGc()
+{
+	AROUND_UNIT_TEST("test gc", testCollector());
+}
+
+/* two machines stepped in turn, one instruction each, print what
+ * each of them prints alone
+ */
+void testInterleavedMachines()
+{
+	char * programs[] = { "function_example.p", "hash_example.p" };
+	char * alone[2];
+	TMContext * tm[2];
+	STEPRESULT result[2] = { srOKAY, srOKAY };
+	for (int i = 0; i < 2; ++i)
+	{
+		compileProgram(programs[i]);
+		alone[i] = runProgram(createObjFileName(programs[i]), engRun, NULL);
+		tm[i] = tm_create();
+		testInteger(TRUE, tm[i] != NULL && tm_load(tm[i], createObjFileName(programs[i])));
+		if (tm[i] == NULL) return;
+		tm[i]->out = tmpfile();
+	}
+	while (result[0] == srOKAY || result[1] == srOKAY)
+	{
+		for (int i = 0; i < 2; ++i)
+			if (result[i] == srOKAY) result[i] = stepTM(tm[i]);
+	}
+	for (int i = 0; i < 2; ++i)
+	{
+		char * together = readAll(tm[i]->out);
+		SET_FAIL_SUB_LOG(programs[i]);
+		testInteger(srHALT, result[i]);
+		testString(alone[i], together);
+		fclose(tm[i]->out);
+		tm[i]->out = NULL;
+		tm_destroy(tm[i]);
+		free(alone[i]);
+		free(together);
+	}
+}
+
+/* run the n instructions of code on a fresh machine with engine,
+ * the registers it stopped with are copied to regs when not NULL
+ */
+STEPRESULT runCode(INSTRUCTION * code, int n, ENGINE engine, int * regs)
+{
+	TMContext * tm = tm_create();
+	STEPRESULT result;
+	int steps = 0;
+	tm->iMem = code;
+	tm->iMemSize = n;
+	tm->out = tmpfile();
+	tm->jitflag = engine == engJit;
+	if (engine == engStep)
+		while ((result = stepTM(tm)) == srOKAY);
+	else
+		result = tm_run(tm, &steps);
+	if (regs != NULL) memcpy(regs, tm->reg, sizeof(tm->reg));
+	fclose(tm->out);
+	tm->out = NULL;
+	tm->iMem = NULL;
+	tm_destroy(tm);
+	return result;
+}
+
+// the last word of dMem can be used, the word after it can not
+void testMemoryBounds()
+{
+	INSTRUCTION lastWord[] = { { opST, 1, DADDR_SIZE - 1, 0 }, { opHALT, 0, 0, 0 } };
+	INSTRUCTION store[] = { { opST, 1, DADDR_SIZE, 0 }, { opHALT, 0, 0, 0 } };
+	INSTRUCTION load[] = { { opLD, 1, DADDR_SIZE, 0 }, { opHALT, 0, 0, 0 } };
+	INSTRUCTION pop[] = { { opLDC, 3, DADDR_SIZE - 1, 0 }, { opPOP, 1, 0, 3 }, { opHALT, 0, 0, 0 } };
+	INSTRUCTION ret[] = { { opRETURN, 0, DADDR_SIZE, 0 }, { opHALT, 0, 0, 0 } };
+	for (ENGINE engine = engStep; engine <= engRun; ++engine)
+	{
+		SET_FAIL_SUB_LOG(engine == engRun ? "runTM bounds:" : "stepTM bounds:");
+		testInteger(srHALT, runCode(lastWord, 2, engine, NULL));
+		testInteger(srDMEM_ERR, runCode(store, 2, engine, NULL));
+		testInteger(srDMEM_ERR, runCode(load, 2, engine, NULL));
+		testInteger(srDMEM_ERR, runCode(pop, 3, engine, NULL));
+		testInteger(srDMEM_ERR, runCode(ret, 2, engine, NULL));
+	}
+}
+
+/* code as the text a .tm file holds */
+void writeCode(char * file, INSTRUCTION * code, int n)
+{
+	FILE * f = fopen(file, "w");
+	for (int i = 0; i < n; ++i)
+	{
+		if (code[i].iop == opLDC && reg_type(code[i].iarg1) == fac)
+		{
+			float x = *(float *)&code[i].iarg2;
+			fprintf(f, "%3d: %6s  %d,%f(%d)\n", i, "LDC", code[i].iarg1, x, code[i].iarg3);
+		}
+		else if (opClass(code[i].iop) == opclRR)
+			fprintf(f, "%3d: %6s  %d,%d,%d\n", i, opCodeTab[code[i].iop].name, code[i].iarg1, code[i].iarg2, code[i].iarg3);
+		else
+			fprintf(f, "%3d: %6s  %d,%d(%d)\n", i, opCodeTab[code[i].iop].name, code[i].iarg1, code[i].iarg2, code[i].iarg3);
+	}
+	fclose(f);
+}
+
+/* INT_MIN / -1 is INT_MIN and INT_MIN % -1 is 0, in a loop hot enough
+ * to be compiled, then a zero divisor of MOD or MODF stops the machine;
+ * the interpreters, the machine code and the translated C all agree
+ */
+void testDivision()
+{
+	INSTRUCTION code[] = {
+		{ opLDC, itmp, INT_MIN, 0 },
+		{ opLDC, itmp + 1, -1, 0 },
+		{ opLDC, ftmp, -822083584, 0 },     // -2147483648.0f
+		{ opLDC, ftmp + 1, -1082130432, 0 }, // -1.0f
+		{ opLDC, cp, 50, 0 },
+		{ opDIV, ac, itmp, itmp + 1 },
+		{ opMOD, ac1, itmp, itmp + 1 },
+		{ opMODF, itmp + 2, ftmp, ftmp + 1 },
+		{ opLDA, cp, -1, cp },
+		{ opJNE, cp, -5, PC_REG },
+		{ opOUT, ac, 0, 0 },
+		{ opOUT, ac1, 0, 0 },
+		{ opOUT, itmp + 2, 0, 0 },
+		{ opMOD, itmp + 3, itmp, cp },
+		{ opOUT, itmp + 3, 0, 0 },
+		{ opHALT, 0, 0, 0 },
+	};
+	int n = sizeof(code) / sizeof(INSTRUCTION);
+	for (int zero = opMOD; zero != -1; zero = zero == opMOD ? opMODF : -1)
+	{
+		int regs[NO_REGS];
+		code[13].iop = zero;
+		for (ENGINE engine = engStep; engine <= engJit; ++engine)
+		{
+			if (engine == engProfile) continue;
+			SET_FAIL_SUB_LOG(engine == engStep ? "stepTM division:" : engine == engRun ? "runTM division:" : "jit division:");
+			testInteger(srZERODIVIDE, runCode(code, n, engine, regs));
+			testInteger(INT_MIN, regs[ac]);
+			testInteger(0, regs[ac1]);
+			testInteger(0, regs[itmp + 2]);
+			testInteger(14, regs[PC_REG]);
+		}
+#ifndef _WIN32
+		writeCode("div_example.tm", code, n);
+		SET_FAIL_SUB_LOG("native division:");
+		testInteger(TRUE, tm2c("div_example.tm", "native_example.c"));
+		testInteger(0, system("cc -O1 -w -DTM_NATIVE_MAIN -o native_example native_example.c"
+			" tm.c tmexec.c tmjit.c tmobj.c tmprof.c vmmemory.c vmgc.c -lm"));
+		testInteger(TRUE, system("./native_example < /dev/null > native_example.txt") != 0);
+		FILE * f = fopen("native_example.txt", "r");
+		char * real = NULL;
+		if (f != NULL)
+		{
+			fseek(f, 0, SEEK_END);
+			real = readAll(f);
+			fclose(f);
+		}
+		testString("OUT instruction prints int: -2147483648\n"
+			"OUT instruction prints int: 0\n"
+			"OUT instruction prints int: 0\n", real);
+		free(real);
+		remove("native_example");
+		remove("native_example.txt");
+		remove("native_example.c");
+		remove("div_example.tm");
+#endif
+	}
+}
+
+void testContext()
+{
+	AROUND_UNIT_TEST("test context", testInterleavedMachines());
+	AROUND_UNIT_TEST("test memory bounds", testMemoryBounds());
+	AROUND_UNIT_TEST("test division", testDivision());
+}
+
+/* every program three times on three machines, each job prints what
+ * the program prints alone; a job stops at its budget
+ */
+void testBatchJobs()
+{
+	char * names[4] = { "function_example.p", "list_example.p", "hash_example.p", "regexp_example.p" };
+	char * alone[4];
+	TMJOB jobs[13];
+	memset(jobs, 0, sizeof(jobs));
+	for (int i = 0; i < 4; ++i)
+	{
+		compileProgram(names[i]);
+		alone[i] = runProgram(createObjFileName(names[i]), engStep, NULL);
+		for (int k = 0; k < 3; ++k) jobs[i + 4 * k].program = createObjFileName(names[i]);
+	}
+	jobs[12].program = createObjFileName("hash_example.p");
+	jobs[12].budget = 1000;
+	runJobs(jobs, 13, 3);
+	for (int j = 0; j < 12; ++j)
+	{
+		SET_FAIL_SUB_LOG(names[j % 4]);
+		testInteger(srHALT, jobs[j].result);
+		testString(alone[j % 4], jobs[j].output);
+	}
+	SET_FAIL_SUB_LOG("budget:");
+	testInteger(srBUDGET, jobs[12].result);
+	testInteger(TRUE, jobs[12].steps >= 1000);// checked at the jumps only
+	for (int j = 0; j < 13; ++j) free(jobs[j].output);
+	for (int i = 0; i < 4; ++i) free(alone[i]);
+
+	// a job file, the missing program and the budget fail
+	char * jobFile = "batch_example.txt";
+	FILE * f = fopen(jobFile, "w");
+	fprintf(f, "# program input budget\n%s\n%s -\nno_such_example.tmo\n\n%s - 1000\n",
+		createObjFileName("list_example.p"), createObjFileName("function_example.p"),
+		createObjFileName("hash_example.p"));
+	fclose(f);
+	FILE * report = tmpfile();
+	SET_FAIL_SUB_LOG("job file:");
+	testInteger(2, runBatch(jobFile, 2, 0, report));
+	char * text = readAll(report);
+	testInteger(TRUE, strstr(text, "4 jobs, 2 failed") != NULL);
+	free(text);
+	fclose(report);
+	remove(jobFile);
+}
+
+/* IN of a job reads its input file, a job without one finds the
+ * end of input instead of waiting on the runner's stdin
+ */
+void testBatchInput()
+{
+	TMJOB jobs[2];
+	FILE * f = fopen("in_example.tm", "w");
+	fputs("  0:     IN  0,0,0\n  1:    OUT  0,0,0\n  2:   HALT  0,0,0\n", f);
+	fclose(f);
+	f = fopen("in_example.txt", "w");
+	fputs("42\n", f);
+	fclose(f);
+	memset(jobs, 0, sizeof(jobs));
+	jobs[0].program = jobs[1].program = "in_example.tm";
+	jobs[0].input = "in_example.txt";
+	runJobs(jobs, 2, 2);
+	SET_FAIL_SUB_LOG("job input:");
+	testInteger(srHALT, jobs[0].result);
+	testString("OUT instruction prints int: 42\n", jobs[0].output);
+	testInteger(srIN_EOF, jobs[1].result);
+	free(jobs[0].output);
+	free(jobs[1].output);
+	remove("in_example.tm");
+	remove("in_example.txt");
+}
+
+/* a job that runs out of heap and one that divides by zero fail on
+ * their own, the jobs around them still halt with their output
+ */
+void testBatchFaults()
+{
+	int enabled = GcEnabled;
+	TMJOB jobs[3];
+	FILE * f = fopen("zero_example.tm", "w");
+	fputs("  0:    LDC  0,7(0)\n  1:    MOD  0,0,1\n  2:    OUT  0,0,0\n  3:   HALT  0,0,0\n", f);
+	fclose(f);
+	compileProgram("gc_example.p");
+	compileProgram("function_example.p");
+	char * alone = runProgram(createObjFileName("function_example.p"), engRun, NULL);
+	memset(jobs, 0, sizeof(jobs));
+	jobs[0].program = createObjFileName("gc_example.p");
+	jobs[1].program = "zero_example.tm";
+	jobs[2].program = createObjFileName("function_example.p");
+	GcEnabled = FALSE;
+	runJobs(jobs, 3, 1);
+	GcEnabled = enabled;
+	SET_FAIL_SUB_LOG("job faults:");
+	testInteger(srDMEM_ERR, jobs[0].result);
+	testInteger(srZERODIVIDE, jobs[1].result);
+	testString("", jobs[1].output);
+	testInteger(srHALT, jobs[2].result);
+	testString(alone, jobs[2].output);
+	for (int i = 0; i < 3; ++i) free(jobs[i].output);
+	free(alone);
+	remove("zero_example.tm");
+}
+
+void testBatch()
+{
+	AROUND_UNIT_TEST("test batch", testBatchJobs());
+	AROUND_UNIT_TEST("test batch input", testBatchInput());
+	AROUND_UNIT_TEST("test batch faults", testBatchFaults());
+}
+
+/* heap_example.p takes blocks from the heap; after each run,
+ * stepped or threaded, tm_restore gives back the dMem and registers
+ * it had when loaded, and the next run prints the same again
+ */
+void testSnapshotRestore()
+{
+	char * program = createObjFileName("heap_example.p");
+	TMContext * tm = tm_create();
+	int * loaded = (int *)malloc(sizeof(tm->dMem));
+	int loadedReg[NO_REGS];
+	compileProgram("heap_example.p");
+	char * expected = runProgram(program, engStep, NULL);
+	testInteger(TRUE, tm_load(tm, program));
+	memcpy(loaded, tm->dMem, sizeof(tm->dMem));
+	memcpy(loadedReg, tm->reg, sizeof(loadedReg));
+	tm_snapshot(tm);
+	for (int run = 0; run < 4; ++run)
+	{
+		STEPRESULT result;
+		int steps = 0;
+		tm->out = tmpfile();
+		if (run % 2 == 0)
+			while ((result = stepTM(tm)) == srOKAY);
+		else
+			result = tm_run(tm, &steps);
+		char * real = result == srHALT ? readAll(tm->out) : NULL;
+		fclose(tm->out);
+		tm->out = NULL;
+		SET_FAIL_SUB_LOG(run % 2 == 0 ? "stepTM run:" : "runTM run:");
+		testString(expected, real);
+		free(real);
+		testInteger(TRUE, tm_restore(tm));
+		testInteger(0, memcmp(loaded, tm->dMem, sizeof(tm->dMem)));
+		testInteger(0, memcmp(loadedReg, tm->reg, sizeof(loadedReg)));
+	}
+	tm_destroy(tm);
+	free(loaded);
+	free(expected);
+}
+
+void testSnapshot()
+{
+	AROUND_UNIT_TEST("test snapshot", testSnapshotRestore());
+}
+
+/* short_example.p calls touch once per operand it evaluates, ten
+ * times in all (both and any are inlined); the call counts, the call tree and the folded stacks
+ * account every instruction of the run exactly once
+ */
+void testProfileCalls()
+{
+	int calls[2] = { -1, -1 };
+	char * names[2] = { "touch", "main" };
+	int expected[2] = { 10, 1 };
+	long long self = 0, folded = 0, n;
+	char line[1024];
+	TMContext * tm;
+	compileProgram("short_example.p");
+	char * plain = runProgram(createObjFileName("short_example.p"), engRun, NULL);
+	char * real = runProgram(createObjFileName("short_example.p"), engProfile, &tm);
+	testString(plain, real);
+	testInteger(TRUE, tm != NULL && tm->prof != NULL);
+	if (tm == NULL || tm->prof == NULL) return;
+
+	TMPROF * prof = tm->prof;
+	for (int f = 0; f < prof->nfunc; ++f)
+		for (int i = 0; i < 2; ++i)
+			if (strcmp(tm->obj.fileTab + tm->obj.funcTab[f].name, names[i]) == 0) calls[i] = (int)prof->calls[f];
+	for (int i = 0; i < 2; ++i)
+	{
+		SET_FAIL_SUB_LOG(names[i]);
+		testInteger(expected[i], calls[i]);
+	}
+
+	SET_FAIL_SUB_LOG("instructions:");
+	for (int i = 0; i < prof->nodeNum; ++i) self += prof->nodes[i].self;
+	FILE * f = tmpfile();
+	writeFoldedStacks(tm, f);
+	rewind(f);
+	while (fgets(line, sizeof(line), f) != NULL)
+		if (sscanf(strrchr(line, ' '), "%lld", &n) == 1) folded += n;
+	fclose(f);
+	testInteger(TRUE, prof->clock == lastSteps);
+	testInteger(TRUE, self == prof->clock);
+	testInteger(TRUE, folded == prof->clock);
+	tm_destroy(tm);
+	free(plain);
+	free(real);
+}
+
+void testProfile()
+{
+	AROUND_UNIT_TEST("test profile", testProfileCalls());
+}
+
+/* the float arithmetic and the conversions of expr_example.p have
+ * opcodes of their own, every opcode agrees with its registers
+ */
+void testTypedInstructions()
+{
+	int floats = 0, conversions = 0, mismatched = 0;
+	TMContext * tm;
+	compileProgram("expr_example.p");
+	char * stepped = runProgram(createObjFileName("expr_example.p"), engStep, NULL);
+	char * real = runProgram(createObjFileName("expr_example.p"), engRun, &tm);
+	testString(stepped, real);
+	for (int loc = 0; tm != NULL && loc < tm->iMemSize; ++loc)
+	{
+		INSTRUCTION in = tm->iMem[loc];
+		int r = reg_type(in.iarg1), s = reg_type(in.iarg2);
+		if (in.iop >= opADDF && in.iop <= opNEGF)
+		{
+			floats++;
+			if (r != fac) mismatched++;
+		}
+		else if (in.iop == opCVTIF || in.iop == opCVTFI)
+		{
+			conversions++;
+			if (in.iop == opCVTIF ? r != fac || s != ac : r != ac || s != fac) mismatched++;
+		}
+		else if ((in.iop >= opNEG && in.iop <= opMOD) && r == fac) mismatched++;
+		else if (in.iop == opMOV && r != -1 && s != -1 && r != s) mismatched++;
+	}
+	testInteger(TRUE, floats > 0);
+	testInteger(TRUE, conversions > 0);
+	testInteger(0, mismatched);
+	tm_destroy(tm);
+	free(stepped);
+	free(real);
+}
+
+/* the loader takes the opcodes as they are written, an ADD or a MOV
+ * on the float registers is not turned into ADDF or CVTIF
+ */
+void testWrittenOpcodes()
+{
+	TMContext * tm = tm_create();
+	FILE * f = fopen("typed_example.tm", "w");
+	fprintf(f, "  0:    LDC  9,2.5(0)\n  1:    LDC  10,1.5(0)\n  2:    ADD  9,9,10\n"
+		"  3:   ADDF  9,9,10\n  4:    MOV  9,0,0\n  5:    NEG  10,0,0\n  6:   HALT  0,0,0\n");
+	fclose(f);
+	f = fopen("typed_example.tm", "r");
+	testInteger(TRUE, readInstructions(tm, f));
+	fclose(f);
+	testInteger(opADD, tm->iMem[2].iop);
+	testInteger(opADDF, tm->iMem[3].iop);
+	testInteger(opMOV, tm->iMem[4].iop);
+	testInteger(opNEG, tm->iMem[5].iop);
+	tm_destroy(tm);
+	remove("typed_example.tm");
+}
+
+void testTyped()
+{
+	AROUND_UNIT_TEST("test typed", testTypedInstructions());
+	AROUND_UNIT_TEST("test written opcodes", testWrittenOpcodes());
+}
+
+/* tail_example.p from its text and heap_example.p from its object
+ * are translated into C, built by the system compiler and run as
+ * programs of their own, they print what stepTM prints
+ */
+void testTranslatedPrograms()
+{
+	char * programs[2] = { createTmFileName("tail_example.p"), createObjFileName("heap_example.p") };
+	char * sources[2] = { "tail_example.p", "heap_example.p" };
+	for (int i = 0; i < 2; ++i)
+	{
+		char * real = NULL;
+		compileProgram(sources[i]);
+		char * expected = runProgram(programs[i], engStep, NULL);
+		SET_FAIL_SUB_LOG(programs[i]);
+		testInteger(TRUE, tm2c(programs[i], "native_example.c"));
+#ifndef _WIN32
+		testInteger(0, system("cc -O1 -w -DTM_NATIVE_MAIN -o native_example native_example.c"
+			" tm.c tmexec.c tmjit.c tmobj.c tmprof.c vmmemory.c vmgc.c -lm"));
+		testInteger(0, system("./native_example < /dev/null > native_example.txt"));
+		FILE * f = fopen("native_example.txt", "r");
+		if (f != NULL)
+		{
+			fseek(f, 0, SEEK_END);
+			real = readAll(f);
+			fclose(f);
+		}
+		testString(expected, real);
+		remove("native_example");
+		remove("native_example.txt");
+#endif
+		remove("native_example.c");
+		free(expected);
+		free(real);
+	}
+}
+
+/* the translated CHECK_MEM stops a store at DADDR_SIZE and a POP of
+ * the last word the way stepTM does, before anything is printed
+ */
+void testTranslatedBounds()
+{
+	char * programs[2] = {
+		"  0:    LDC  1,%d(0)\n  1:     ST  0,0(1)\n  2:    OUT  0,0,0\n  3:   HALT  0,0,0\n",
+		"  0:    LDC  1,%d(0)\n  1:    POP  0,0(1)\n  2:    OUT  0,0,0\n  3:   HALT  0,0,0\n",
+	};
+	int addresses[2] = { DADDR_SIZE, DADDR_SIZE - 1 };
+	for (int i = 0; i < 2; ++i)
+	{
+		FILE * f = fopen("bound_example.tm", "w");
+		fprintf(f, programs[i], addresses[i]);
+		fclose(f);
+		SET_FAIL_SUB_LOG(i == 0 ? "native store bound:" : "native pop bound:");
+		testInteger(TRUE, tm2c("bound_example.tm", "native_example.c"));
+#ifndef _WIN32
+		testInteger(0, system("cc -O1 -w -DTM_NATIVE_MAIN -o native_example native_example.c"
+			" tm.c tmexec.c tmjit.c tmobj.c tmprof.c vmmemory.c vmgc.c -lm"));
+		testInteger(TRUE, system("./native_example < /dev/null > native_example.txt") != 0);
+		f = fopen("native_example.txt", "r");
+		char * real = NULL;
+		if (f != NULL)
+		{
+			fseek(f, 0, SEEK_END);
+			real = readAll(f);
+			fclose(f);
+		}
+		testString("", real);
+		free(real);
+		remove("native_example");
+		remove("native_example.txt");
+#endif
+		remove("native_example.c");
+		remove("bound_example.tm");
+	}
+}
+
+void testNative()
+{
+	AROUND_UNIT_TEST("test native", testTranslatedPrograms());
+	AROUND_UNIT_TEST("test native bounds", testTranslatedBounds());
+}
+
+/* the loops and recursions of these programs get hot enough to be
+ * compiled; with the machine code they print the same and count the
+ * same instructions as the interpreter, and a budget still stops them
+ */
+void testJitRegions()
+{
+	char * programs[3] = { "tail_example.p", "switch_example.p", "heap_example.p" };
+	for (int i = 0; i < 3; ++i)
+	{
+		char * object = createObjFileName(programs[i]);
+		TMContext * tm;
+		int compiled = 0, steps = 0;
+		compileProgram(programs[i]);
+		char * interpreted = runProgram(object, engRun, NULL);
+		int interpretedSteps = lastSteps;
+		char * real = runProgram(object, engJit, &tm);
+		SET_FAIL_SUB_LOG(programs[i]);
+		testString(interpreted, real);
+		testInteger(interpretedSteps, lastSteps);
+#ifdef TM_JIT
+		for (int k = 0; tm != NULL && tm->jit != NULL && k < tm->jit->size; ++k)
+			if (tm->jit->native[k] != NULL) compiled++;
+		testInteger(TRUE, compiled > 0);
+#endif
+		// the same machine again, the budget ends the compiled loops too
+		if (tm != NULL && tm_load(tm, object))
+		{
+			tm->jitflag = TRUE;
+			tm->budget = interpretedSteps / 2;
+			testInteger(srBUDGET, tm_run(tm, &steps));
+		}
+		tm_destroy(tm);
+		free(interpreted);
+		free(real);
+	}
+}
+
+/* loops hot enough to be compiled walk up to the end of dMem, the
+ * machine code hands the word past it back to runTM, which stops
+ * where stepTM stops with the same registers (reg 2 counts the
+ * stores that were done)
+ */
+void testJitBounds()
+{
+	INSTRUCTION store[] = {
+		{ opLDC, 1, DADDR_SIZE - 20, 0 },
+		{ opST, 2, 0, 1 },
+		{ opLDA, 2, 1, 2 },
+		{ opLDA, 1, 1, 1 },
+		{ opLDC, PC_REG, 1, 0 },
+		{ opHALT, 0, 0, 0 },
+	};
+	INSTRUCTION pop[] = {
+		{ opLDC, 3, DADDR_SIZE - 20, 0 },
+		{ opPOP, 1, 0, 3 },
+		{ opLDA, 2, 1, 2 },
+		{ opLDC, PC_REG, 1, 0 },
+		{ opHALT, 0, 0, 0 },
+	};
+	int stepped[NO_REGS], compiled[NO_REGS];
+	SET_FAIL_SUB_LOG("jit store bound:");
+	testInteger(srDMEM_ERR, runCode(store, 6, engStep, stepped));
+	testInteger(srDMEM_ERR, runCode(store, 6, engJit, compiled));
+	testInteger(0, memcmp(stepped, compiled, sizeof(stepped)));
+	SET_FAIL_SUB_LOG("jit pop bound:");
+	testInteger(srDMEM_ERR, runCode(pop, 5, engStep, stepped));
+	testInteger(srDMEM_ERR, runCode(pop, 5, engJit, compiled));
+	testInteger(0, memcmp(stepped, compiled, sizeof(stepped)));
+}
+
+void testJit()
+{
+	AROUND_UNIT_TEST("test jit", testJitRegions());
+	AROUND_UNIT_TEST("test jit bounds", testJitBounds());
+}
+
+/* LD then LD is a fused pair, a bad address in either half
+ * stops runTM at the location stepTM stops at
+ */
+void testFusedFault(int badFirst)
+{
+	INSTRUCTION code[] = {
+		{ opLDC, 2, -5, 0 },
+		{ opLD, 1, 0, 0 },
+		{ opLD, 3, 0, 2 },
+		{ opHALT, 0, 0, 0 },
+	};
+	int stopped[2], steps = 0;
+	STEPRESULT result[2];
+	if (badFirst)
+	{
+		code[1].iarg1 = 3; code[1].iarg3 = 2;
+		code[2].iarg1 = 1; code[2].iarg3 = 0;
+	}
+	for (int e = 0; e < 2; ++e)
+	{
+		TMContext * tm = tm_create();
+		tm->iMem = code;
+		tm->iMemSize = sizeof(code) / sizeof(INSTRUCTION);
+		if (e == 0)
+			while ((result[e] = stepTM(tm)) == srOKAY);
+		else
+			result[e] = runTM(tm, &steps);
+		stopped[e] = tm->reg[PC_REG];
+		tm->iMem = NULL;
+		tm_destroy(tm);
+	}
+	testInteger(srDMEM_ERR, result[0]);
+	testInteger(srDMEM_ERR, result[1]);
+	testInteger(stopped[0], stopped[1]);
+}
+
+/* the corpus programs run fused pairs, each half is still counted
+ * as the instruction it is
+ */
+void testSuperinstructions()
+{
+	char * programs[3] = { "function_example.p", "hash_example.p", "list_example.p" };
+	for (int i = 0; i < 3; ++i)
+	{
+		TMContext * tm;
+		int fused = 0;
+		compileProgram(programs[i]);
+		char * stepped = runProgram(createObjFileName(programs[i]), engStep, NULL);
+		int steps = lastSteps;
+		char * real = runProgram(createObjFileName(programs[i]), engRun, &tm);
+		SET_FAIL_SUB_LOG(programs[i]);
+		testString(stepped, real);
+		testInteger(steps, lastSteps);
+		for (int k = 0; tm != NULL && tm->code != NULL && k < tm->addrMap[tm->iMemSize]; ++k)
+			if (tm->code[k].fused != tm->code[k].op) fused++;
+		testInteger(TRUE, fused > 0);
+		tm_destroy(tm);
+		free(stepped);
+		free(real);
+	}
+	SET_FAIL_SUB_LOG("fault in the second half:");
+	testFusedFault(FALSE);
+	SET_FAIL_SUB_LOG("fault in the first half:");
+	testFusedFault(TRUE);
+}
+
+void testSuper()
+{
+	AROUND_UNIT_TEST("test super", testSuperinstructions());
+}
+
+// the bytes of a file, n is set to its length
+static char * readBytes(char * fileName, long * n)
+{
+	FILE * f = fopen(fileName, "rb");
+	char * bytes;
+	*n = -1;
+	if (f == NULL) return NULL;
+	fseek(f, 0, SEEK_END);
+	*n = ftell(f);
+	bytes = (char *)malloc(*n + 1);
+	rewind(f);
+	*n = (long)fread(bytes, 1, *n, f);
+	fclose(f);
+	return bytes;
+}
+
+/* the object the compiler writes from its buffer is the object
+ * the assembler makes of the text it writes next to it
+ */
+void testSerializedObjects()
+{
+	char * programs[4] = { "function_example.p", "switch_example.p", "block_example.p", "regexp_example.p" };
+	for (int i = 0; i < 4; ++i)
+	{
+		long written, assembled;
+		compileProgram(programs[i]);
+		SET_FAIL_SUB_LOG(programs[i]);
+		testInteger(TRUE, assemble(createTmFileName(programs[i]), "assembled_example.tmo"));
+		char * a = readBytes(createObjFileName(programs[i]), &written);
+		char * b = readBytes("assembled_example.tmo", &assembled);
+		testInteger(TRUE, written > 0);
+		testInteger(written, assembled);
+		testInteger(TRUE, a != NULL && b != NULL && written == assembled && memcmp(a, b, written) == 0);
+		remove("assembled_example.tmo");
+		free(a);
+		free(b);
+	}
+}
+
+void testSerialize()
+{
+	AROUND_UNIT_TEST("test serialize", testSerializedObjects());
+}
+
+/* every opcode is found again by the name the text gives it, in
+ * its class (the class limits have no name), and every mnemonic
+ * the compiler writes into a .tm names an opcode
+ */
+void testOpcodeNames()
+{
+	char line[512], name[64];
+	int loc, unknown = 0, lines = 0;
+	SET_FAIL_SUB_LOG("opcode table:");
+	for (int op = opHALT; op < opEND; ++op)
+	{
+		if (op == opRRLim || op == opRMLim || op == opRALim) continue;
+		testInteger(op, opcodeOf(opCodeTab[op].name));
+		testInteger(opClass(op), opCodeTab[op].opclass);
+	}
+	testInteger(opEND, opcodeOf("NOSUCHOP"));
+
+	SET_FAIL_SUB_LOG("written mnemonics:");
+	compileProgram("hash_example.p");
+	FILE * f = fopen(createTmFileName("hash_example.p"), "r");
+	while (f != NULL && fgets(line, sizeof(line), f) != NULL)
+	{
+		if (sscanf(line, "%d: %63s", &loc, name) != 2) continue;
+		lines++;
+		if (opcodeOf(name) == opEND) unknown++;
+	}
+	if (f != NULL) fclose(f);
+	testInteger(TRUE, lines > 0);
+	testInteger(0, unknown);
+}
+
+void testOpcode()
+{
+	AROUND_UNIT_TEST("test opcode", testOpcodeNames());
+}
+
+/* a copy of each example with CRLF line ends prints the same, and
+ * its code is credited to the same source lines
+ */
+void testCrlfSources()
+{
+	char * programs[3] = { "expr_example.p", "hash_example.p", "switch_example.p" };
+	char * copy = "crlf_example.p";
+	for (int i = 0; i < 3; ++i)
+	{
+		TMContext * tm[2];
+		char * printed[2];
+		FILE * from = fopen(programs[i], "rb");
+		FILE * to = fopen(copy, "wb");
+		int c;
+		while (from != NULL && to != NULL && (c = fgetc(from)) != EOF)
+		{
+			if (c == '\n') fputc('\r', to);
+			fputc(c, to);
+		}
+		if (from != NULL) fclose(from);
+		if (to != NULL) fclose(to);
+
+		compileProgram(programs[i]);
+		printed[0] = runProgram(createObjFileName(programs[i]), engRun, &tm[0]);
+		compileProgram(copy);
+		printed[1] = runProgram(createObjFileName(copy), engRun, &tm[1]);
+		SET_FAIL_SUB_LOG(programs[i]);
+		testInteger(TRUE, printed[0] != NULL);
+		testString(printed[0], printed[1]);
+		if (tm[0] != NULL && tm[1] != NULL)
+		{
+			int moved = 0;
+			testInteger(TRUE, tm[0]->obj.lineSize > 0);
+			testInteger(tm[0]->obj.lineSize, tm[1]->obj.lineSize);
+			for (int k = 0; k < tm[0]->obj.lineSize && k < tm[1]->obj.lineSize; ++k)
+				if (tm[0]->obj.lineTab[k].line != tm[1]->obj.lineTab[k].line) moved++;
+			testInteger(0, moved);
+		}
+		remove(copy);
+		remove(createTmFileName(copy));
+		remove(createObjFileName(copy));
+		for (int k = 0; k < 2; ++k)
+		{
+			tm_destroy(tm[k]);
+			free(printed[k]);
+		}
+	}
+}
+
+void testScan()
+{
+	AROUND_UNIT_TEST("test scan", testCrlfSources());
+}
 
 void testFuntion()
 {
@@ -278,6 +1784,31 @@ void test()
 	 done = FALSE;
 
 	testRegex();
+	testEngines();
+	testLink();
+	testObject();
+	testRegisters();
+	testPeephole();
+	testFold();
+	testShortCircuit();
+	testSwitch();
+	testTailCall();
+	testInline();
+	testDisplay();
+	testBlock();
+	testAllocator();
+	testGc();
+	testContext();
+	testBatch();
+	testSnapshot();
+	testProfile();
+	testTyped();
+	testNative();
+	testJit();
+	testSuper();
+	testSerialize();
+	testOpcode();
+	testScan();
 	//testList();
 	//testHash();
 	//testFuntion();
@@ -301,6 +1832,11 @@ void testChar(char expected, char real){
 	TEST_ANY(expected, real, expected == real, printf("expected = %d, real = %d\n", expected, real));
 }
 
+void testString(char * expected, char * real){
+	TEST_ANY(expected, real, expected != NULL && real != NULL && strcmp(expected, real) == 0,
+		printf("expected = %s, real = %s\n", expected != NULL ? expected : "(no halt)", real != NULL ? real : "(no halt)"));
+}
+
 void testFloat(float expected, float real){
 	TEST_ANY(expected, real, abs(expected - real) < 0.00001, printf("expected = %f, real = %f\n", expected, real));
 }
@@ -25,6 +25,11 @@ void initTypeCollection()
 	}*/
 }
 
+void clearTypeCollection()
+{
+	memset(STypeCollection, 0, sizeof(STypeCollection));
+}
+
 /*return the func_type, which is consisted of paramNode and return type*/
 FuncType new_func_type(TreeNode * tree)
 {
@@ -123,6 +128,8 @@ int integer_from_node(TreeNode * t){
 		case Float:
 			return (int)t->attr.val.flt;
 		case Integer:
+		case Char:
+		case Boolean:
 			return t->attr.val.integer;
 		default:
 			assert(!"not defined such conversion");
@@ -140,6 +147,8 @@ float float_from_node(TreeNode * t)
 	case Float:
 		return t->attr.val.flt;
 	case Integer:
+	case Char:
+	case Boolean:
 		return (float)t->attr.val.integer;
 	default:
 		assert(!"not defined such conversion");
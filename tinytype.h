@@ -151,6 +151,8 @@ void freeParamNode(ParamNode * p);
 
 void deleteStructType(char * key);
 void initTypeCollection();
+/* forget every struct type, before another program is compiled */
+void clearTypeCollection();
 bool isStructFunction(const char *);
 bool memberExist(StructType stype, char * name);
 #endif /* tinytype_h */
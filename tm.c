@@ -1,9 +1,6 @@
 #include "tm.h"
 #include "assert.h"
 #include "code.h"
-#include "vmmemory.h"
-
-int labelLocMap[1024];// the label and location mapping
 
 #ifndef TRUE
 #define TRUE 1
@@ -17,72 +14,54 @@ const int   GP_ADRESS = 4095; /*the gp adress, global area */
 const int   FIRST_FP = 60000; /*the main fp, stack area, from 4096 -> 60000*/
 const int   CONST_ADRESS = 2000;/*the const variable area: "123"*/
 const int	MP_ADRESS = DADDR_SIZE - 1;
-/******* const *******/
-#define IADDR_SIZE 65535 /* increase for large programs */
-#define NO_REGS 12
-#define PC_REG  7
-
-#define   LINESIZE  121
-#define   WORDSIZE  20
 
 /******** vars ********/
-int iloc = 0;
-int dloc = 0;
-int traceflag = FALSE;
-int icountflag = FALSE;
-
-INSTRUCTION iMem[IADDR_SIZE];
-int dMem[DADDR_SIZE];
-int reg[NO_REGS];
-
-char * opCodeTab[]
-= { "HALT", "IN", "OUT","MOV","NEG","ADD", "SUB", "MUL", "DIV","MOD","LABEL","GO", "????",
-/* RR opcodes */
-"LD", "ST","PUSH","POP","????", /* RM opcodes */
-"LDA", "LDC", "JLT", "JLE", "JGT", "JGE", "JEQ", "JNE", "RETURN", "????",
-/* RA opcodes */
- "MALLOC","FREE", "????"
-/*system instruction*/
-   };
+static const INSTRUCTION haltInstruction = { opHALT, 0, 0, 0 };
+static TMContext * defaultMachine = NULL;
+
+#define TM_FOLDED "tm.folded" /* the call stacks of the 'f' command */
+
+OPINFO opCodeTab[] =
+{
+	/* RR opcodes */
+	{ "HALT", opclRR }, { "IN", opclRR }, { "OUT", opclRR }, { "MOV", opclRR },
+	{ "NEG", opclRR }, { "ADD", opclRR }, { "SUB", opclRR }, { "MUL", opclRR },
+	{ "DIV", opclRR }, { "MOD", opclRR }, { "LABEL", opclRR }, { "GO", opclRR },
+	{ "ADDF", opclRR }, { "SUBF", opclRR }, { "MULF", opclRR }, { "DIVF", opclRR },
+	{ "MODF", opclRR }, { "NEGF", opclRR }, { "CVTIF", opclRR }, { "CVTFI", opclRR },
+	{ "????", opclRR },
+	/* RM opcodes */
+	{ "LD", opclRM }, { "ST", opclRM }, { "PUSH", opclRM }, { "POP", opclRM },
+	{ "????", opclRM },
+	/* RA opcodes */
+	{ "LDA", opclRA }, { "LDC", opclRA }, { "JLT", opclRA }, { "JLE", opclRA },
+	{ "JGT", opclRA }, { "JGE", opclRA }, { "JEQ", opclRA }, { "JNE", opclRA },
+	{ "JLTF", opclRA }, { "JLEF", opclRA }, { "JGTF", opclRA }, { "JGEF", opclRA },
+	{ "JEQF", opclRA }, { "JNEF", opclRA },
+	{ "JIDX", opclRA }, { "RETURN", opclRA }, { "????", opclRA },
+	/* system instructions */
+	{ "MALLOC", opclSYS }, { "FREE", opclSYS }, { "MEMCPY", opclSYS },
+	{ "MEMSET", opclSYS }, { "MEMMOVE", opclSYS }, { "????", opclSYS }
+};
 
 char * stepResultTab[] = 
 { "OK", "Halted", "Instruction Memory Fault",
-  "Data Memory Fault", "Division by 0"
+  "Data Memory Fault", "Division by 0",
+  "Instruction Budget Exhausted", "End of Input"
 };
 
 char pgmName[20];
 
-char in_Line[LINESIZE];
-int lineLen;
-int inCol;
-int num;
-float flt_num;
-char word[WORDSIZE];
-char ch;
-
-// macro used to DRY
-#define operand_proc(op,func) do{\
-	switch (op)\
-{\
-	case '+': reg[r] = func(lhs + rhs); break; \
-	case '-': reg[r] = func(lhs - rhs); break; \
-	case '*': reg[r] = func(lhs * rhs); break; \
-	case '/':\
-			if (rhs == 0) return srZERODIVIDE; \
-			else reg[r] = func(lhs / rhs); \
-			break; \
-	case '%':reg[r] = ((int)lhs % (int)rhs);break;\
-}\
-				return srOKAY;\
-				}while(0)
 
 /********************************************/
 
 
 
-static int reg_type(int reg){
-	if (reg == ac || reg == ac1) return ac;
-	if (reg == fac || reg == fac1) return fac;
+int reg_type(int r){
+	if (r == ac || r == ac1) return ac;
+	if (r == fac || r == fac1) return fac;
+	if (r >= itmp && r < itmp + NUM_TMP) return ac;
+	if (r >= ftmp && r < ftmp + NUM_TMP) return fac;
 	return -1;
 }
 
@@ -90,42 +69,58 @@ static int same_reg_type(int reg1, int reg2);
 
 static float flt_from_integer(int c);
 
-static float flt_from_reg(int r);
+static float flt_from_reg(TMContext * tm, int r);
 
 static int int_from_flt(float x);
 
-static void convert(int reg1, int reg2);
-
-static STEPRESULT operand(int r, int s, int t, char op);
-
-static STEPRESULT do_operand_flt(int r, float lhs, float rhs, char op);
+int opClass(int c)
+{
+	if (c < 0 || c >= opEND) return opclSYS;
+	return opCodeTab[c].opclass;
+} /* opClass */
 
-static STEPRESULT do_operand_int(int r, int lhs, int rhs, char op);
+int opcodeOf(char * name)
+{
+	int op;
+	for (op = opHALT; op < opEND; op++)
+		if (strcmp(opCodeTab[op].name, name) == 0) return op;
+	return opEND;
+} /* opcodeOf */
 
-static STEPRESULT do_neg_op(int r);
+/********************************************/
+/* the instruction at loc, cells after the loaded code hold HALT */
+static INSTRUCTION fetch(TMContext * tm, int loc)
+{
+	return loc < tm->iMemSize ? tm->iMem[loc] : haltInstruction;
+}
 
-int opClass(int c)
+/* where OUT prints */
+static FILE * output(TMContext * tm)
 {
+	return tm->out != NULL ? tm->out : listing;
+}
 
-	if (c <= opRRLim) return (opclRR);
-	else if (c <= opRMLim) return (opclRM);
-	else if (c <= opRALim) return (opclRA);
-	else return opclSYS;
-} /* opClass */
+/* n words from addr are all in dMem */
+static int blockInMem(int addr, int n)
+{
+	return n >= 0 && addr >= 0 && addr <= DADDR_SIZE - n;
+}
 
 /********************************************/
-void writeInstruction(int loc)
+void writeInstruction(TMContext * tm, int loc)
 {
 	printf("%5d: ", loc);
 	if ((loc >= 0) && (loc < IADDR_SIZE))
 	{
-		printf("%6s%3d,", opCodeTab[iMem[loc].iop], iMem[loc].iarg1);
-		switch (opClass(iMem[loc].iop))
+		INSTRUCTION in = fetch(tm, loc);
+		printf("%6s%3d,", opCodeTab[in.iop].name, in.iarg1);
+		switch (opClass(in.iop))
 		{
-		case opclRR: printf("%1d,%1d", iMem[loc].iarg2, iMem[loc].iarg3);
+		case opclRR: printf("%1d,%1d", in.iarg2, in.iarg3);
 			break;
 		case opclRM:
-		case opclRA: printf("%3d(%1d)", iMem[loc].iarg2, iMem[loc].iarg3);
+		case opclRA:
+		case opclSYS: printf("%3d(%1d)", in.iarg2, in.iarg3);
 			break;
 		}
 		printf("\n");
@@ -133,115 +128,115 @@ void writeInstruction(int loc)
 } /* writeInstruction */
 
 /********************************************/
-void getCh(void)
+void getCh(TMContext * tm)
 {
-	if (++inCol < lineLen)
-		ch = in_Line[inCol];
-	else ch = ' ';
+	if (++tm->inCol < tm->lineLen)
+		tm->ch = tm->in_Line[tm->inCol];
+	else tm->ch = ' ';
 } /* getCh */
 
 /********************************************/
-int nonBlank(void)
+int nonBlank(TMContext * tm)
 {
-	while ((inCol < lineLen)
-		&& (in_Line[inCol] == ' '))
-		inCol++;
-	if (inCol < lineLen)
+	while ((tm->inCol < tm->lineLen)
+		&& (tm->in_Line[tm->inCol] == ' '))
+		tm->inCol++;
+	if (tm->inCol < tm->lineLen)
 	{
-		ch = in_Line[inCol];
+		tm->ch = tm->in_Line[tm->inCol];
 		return TRUE;
 	}
 	else
 	{
-		ch = ' ';
+		tm->ch = ' ';
 		return FALSE;
 	}
 } /* nonBlank */
 
 /********************************************/
-int getNum(void)
+int getNum(TMContext * tm)
 {
 	int sign;
 	int term;
 	int temp = FALSE;
-	num = 0;
+	tm->num = 0;
 	do
 	{
 		sign = 1;
-		while (nonBlank() && ((ch == '+') || (ch == '-')))
+		while (nonBlank(tm) && ((tm->ch == '+') || (tm->ch == '-')))
 		{
 			temp = FALSE;
-			if (ch == '-')  sign = -sign;
-			getCh();
+			if (tm->ch == '-')  sign = -sign;
+			getCh(tm);
 		}
 		term = 0;
-		nonBlank();
-		while (isdigit(ch))
+		nonBlank(tm);
+		while (isdigit(tm->ch))
 		{
 			temp = TRUE;
-			term = term * 10 + (ch - '0');
-			getCh();
+			term = term * 10 + (tm->ch - '0');
+			getCh(tm);
 		}
-		num = num + (term * sign);
-	} while ((nonBlank()) && ((ch == '+') || (ch == '-')));
+		tm->num = tm->num + (term * sign);
+	} while ((nonBlank(tm)) && ((tm->ch == '+') || (tm->ch == '-')));
 	return temp;
 } /* getNum */
 
-float getFloat()
+float getFloat(TMContext * tm)
 {
 	int retry_times = 2;
 	char * str_head = (char*)malloc(30 * sizeof(char));
 	char * str_tail = str_head;
 
-	nonBlank();
+	nonBlank(tm);
 	while (retry_times > 0){
-		if (ch == '+' || ch == '-') *str_tail++ = ch;
-		else if (ch == '.') { retry_times -= 1; *str_tail++ = ch;}
-		else if (isdigit(ch)) { *str_tail++ = ch;}
+		if (tm->ch == '+' || tm->ch == '-') *str_tail++ = tm->ch;
+		else if (tm->ch == '.') { retry_times -= 1; *str_tail++ = tm->ch;}
+		else if (isdigit(tm->ch)) { *str_tail++ = tm->ch;}
 		else { retry_times = 0; break; }
-		getCh();
+		getCh(tm);
 	}
 	*str_tail = '\0';
-	flt_num = atof(str_head);
+	tm->flt_num = atof(str_head);
 	free(str_head);
 	return TRUE;
 }
 
 
 /********************************************/
-int getWord(void)
+int getWord(TMContext * tm)
 {
 	int temp = FALSE;
 	int length = 0;
-	if (nonBlank())
+	if (nonBlank(tm))
 	{
-		while (isalnum(ch))
+		while (isalnum(tm->ch))
 		{
-			if (length < WORDSIZE - 1) word[length++] = ch;
-			getCh();
+			if (length < WORDSIZE - 1) tm->word[length++] = tm->ch;
+			getCh(tm);
 		}
-		word[length] = '\0';
+		tm->word[length] = '\0';
 		temp = (length != 0);
 	}
 	return temp;
 } /* getWord */
 
 /********************************************/
-int skipCh(char c)
+int skipCh(TMContext * tm, char c)
 {
 	int temp = FALSE;
-	if (nonBlank() && (ch == c))
+	if (nonBlank(tm) && (tm->ch == c))
 	{
-		getCh();
+		getCh(tm);
 		temp = TRUE;
 	}
 	return temp;
 } /* skipCh */
 
 /********************************************/
-int atEOL(void)
+int atEOL(TMContext * tm)
 {
-	return (!nonBlank());
+	return (!nonBlank(tm));
 } /* atEOL */
 
 /********************************************/
@@ -254,54 +249,209 @@ int error(char * msg, int lineNo, int instNo)
 } /* error */
 
 /********************************************/
-int readInstructions(FILE *pgm)
+/* record the location of label num, the table
+ * grows so the number of labels is not limited
+ */
+static void setLabelLoc(TMContext * tm, int label, int loc)
 {
-	OPCODE op;
-	int arg1 = -1, arg2 = -1, arg3 = -1;
-	int loc, regNo, lineNo;
-	for (regNo = 0; regNo < NO_REGS; regNo++)
-		reg[regNo] = 0;
+	if (label >= tm->labelCap)
+	{
+		int i, cap = tm->labelCap == 0 ? 1024 : tm->labelCap;
+		while (cap <= label) cap *= 2;
+		tm->labelLocMap = (int *)realloc(tm->labelLocMap, cap * sizeof(int));
+		for (i = tm->labelCap; i < cap; i++)
+			tm->labelLocMap[i] = -1;
+		tm->labelCap = cap;
+	}
+	tm->labelLocMap[label] = loc;
+	objAddLabel(tm, label, loc, lbDEF);
+} /* setLabelLoc */
 
-	dMem[0] = MP_ADRESS;
-	dMem[1] = GP_ADRESS;
-	dMem[2] = FIRST_FP;
-	
-	for (loc = 3; loc < DADDR_SIZE; loc++)
-		dMem[loc] = 0;
-	for (loc = 0; loc < IADDR_SIZE; loc++)
+/********************************************/
+/* link pass: every GO n is rewritten into the
+ * absolute jump LDC pc,target where target is the
+ * first real instruction after label n, so neither
+ * the label lookup nor the LABEL itself is executed
+ */
+static int linkInstructions(TMContext * tm)
+{
+	int loc, target;
+	for (loc = 0; loc < tm->iMemSize; loc++)
 	{
-		iMem[loc].iop = opHALT;
-		iMem[loc].iarg1 = 0;
-		iMem[loc].iarg2 = 0;
-		iMem[loc].iarg3 = 0;
+		if (tm->iMem[loc].iop != opGO) continue;
+		target = tm->iMem[loc].iarg1 < tm->labelCap ? tm->labelLocMap[tm->iMem[loc].iarg1] : -1;
+		if (target < 0)
+			return error("Undefined label", 0, loc);
+		while (target < tm->iMemSize && tm->iMem[target].iop == opLAEBL)
+			target++;
+		objAddLabel(tm, tm->iMem[loc].iarg1, loc, lbREF);
+		tm->iMem[loc].iop = opLDC;
+		tm->iMem[loc].iarg1 = PC_REG;
+		tm->iMem[loc].iarg2 = target;
+		tm->iMem[loc].iarg3 = 0;
 	}
+	return TRUE;
+} /* linkInstructions */
+
+/********************************************/
+/* .DATA adress w0,w1,...   constant pool entry
+ * .FILE name               module of the following lines
+ * .LINE loc line           debug line table entry
+ */
+static int readDirective(TMContext * tm, int lineNo)
+{
+	int words[LINESIZE];
+	int n = 0, addr, loc;
+	tm->inCol++;
+	if (!getWord(tm))
+		return error("Missing directive", lineNo, -1);
+	if (strcmp(tm->word, "DATA") == 0)
+	{
+		if (!getNum(tm))
+			return error("Bad data adress", lineNo, -1);
+		addr = tm->num;
+		while (!atEOL(tm))
+		{
+			if (!getNum(tm))
+				return error("Bad data", lineNo, -1);
+			words[n++] = tm->num;
+			skipCh(tm, ',');
+		}
+		if ((addr < 0) || (addr + n > DADDR_SIZE))
+			return error("Data out of memory", lineNo, -1);
+		objAddData(tm, addr, words, n);
+	}
+	else if (strcmp(tm->word, "LINE") == 0)
+	{
+		if (!getNum(tm))
+			return error("Bad line location", lineNo, -1);
+		loc = tm->num;
+		if (!getNum(tm))
+			return error("Bad line number", lineNo, -1);
+		objAddLine(tm, loc, tm->num);
+	}
+	else if (strcmp(tm->word, "FILE") == 0)
+	{
+		nonBlank(tm);
+		objSetFile(tm, tm->in_Line + tm->inCol);
+	}
+	else
+		return error("Unknown directive", lineNo, -1);
+	return TRUE;
+} /* readDirective */
+
+/********************************************/
+/* the code generator marks every function with the comments
+ * "function entry:", its name, and "function end:", they
+ * become the function table used by the profiler
+ */
+static void readComment(TMContext * tm, int * funcName)
+{
+	char * text = tm->in_Line + tm->inCol + 1;
+	char * last = text + strlen(text);
+	while (*text == ' ') text++;
+	while (last > text && isspace((unsigned char)last[-1])) *--last = '\0';
+	if (*funcName)
+	{
+		objBeginFunc(tm, text);
+		*funcName = FALSE;
+	}
+	else if (strcmp(text, "function entry:") == 0) *funcName = TRUE;
+	else if (strcmp(text, "function end:") == 0) objEndFunc(tm);
+} /* readComment */
+
+/********************************************/
+/* registers and data memory of a fresh machine */
+void resetMachine(TMContext * tm)
+{
+	memset(tm->reg, 0, sizeof(tm->reg));
+	memset(tm->dMem, 0, sizeof(tm->dMem));
+	memset(tm->dirty, 1, sizeof(tm->dirty));
+	tm->dMem[0] = MP_ADRESS;
+	tm->dMem[1] = GP_ADRESS;
+	tm->dMem[2] = FIRST_FP;
+	heapReset(tm);
+} /* resetMachine */
+
+/********************************************/
+void tm_beginCode(TMContext * tm)
+{
+	int i;
+	resetMachine(tm);
+	objReset(tm);
+	profFree(tm);
+	jitFree(tm);
+	/* a fresh buffer is all HALT (0), a used one only up to the
+	 * size of the last program put into it
+	 */
+	if (tm->iMemBuf == NULL)
+	{
+		tm->iMemBuf = (INSTRUCTION *)calloc(IADDR_SIZE, sizeof(INSTRUCTION));
+		tm->iMemBufSize = 0;
+	}
+	memset(tm->iMemBuf, 0, tm->iMemBufSize * sizeof(INSTRUCTION));
+	tm->iMem = tm->iMemBuf;
+	tm->iMemSize = 0;
+	for (i = 0; i < tm->labelCap; i++)
+		tm->labelLocMap[i] = -1;
+} /* tm_beginCode */
+
+void tm_putInstr(TMContext * tm, int loc, int op, int r, int s, int t)
+{
+	if (op == opLAEBL) setLabelLoc(tm, r, loc);
+	tm->iMem[loc].iop = op;
+	tm->iMem[loc].iarg1 = r;
+	tm->iMem[loc].iarg2 = s;
+	tm->iMem[loc].iarg3 = t;
+	if (loc >= tm->iMemSize) tm->iMemSize = loc + 1;
+} /* tm_putInstr */
+
+int tm_endCode(TMContext * tm)
+{
+	tm->iMemBufSize = tm->iMemSize;
+	objApplyData(tm);
+	return linkInstructions(tm);
+} /* tm_endCode */
+
+/********************************************/
+int readInstructions(TMContext * tm, FILE *pgm)
+{
+	OPCODE op;
+	int arg1 = -1, arg2 = -1, arg3 = -1;
+	int loc, lineNo;
+	int funcName = FALSE;
+
+	tm_beginCode(tm);
 	lineNo = 0;
 	while (!feof(pgm))
 	{
-		fgets(in_Line, LINESIZE - 2, pgm);
-		inCol = 0;
+		fgets(tm->in_Line, LINESIZE - 2, pgm);
+		tm->inCol = 0;
 		lineNo++;
-		lineLen = (int)strlen(in_Line) - 1;
-		if (in_Line[lineLen] == '\n') in_Line[lineLen] = '\0';
-		else in_Line[++lineLen] = '\0';
-		if ((nonBlank()) && (in_Line[inCol] != '*'))
+		tm->lineLen = (int)strlen(tm->in_Line) - 1;
+		if (tm->in_Line[tm->lineLen] == '\n') tm->in_Line[tm->lineLen] = '\0';
+		else tm->in_Line[++tm->lineLen] = '\0';
+		if ((nonBlank(tm)) && (tm->in_Line[tm->inCol] == '.'))
+		{
+			if (!readDirective(tm, lineNo))
+				return FALSE;
+		}
+		else if ((nonBlank(tm)) && (tm->in_Line[tm->inCol] == '*'))
+			readComment(tm, &funcName);
+		else if ((nonBlank(tm)) && (tm->in_Line[tm->inCol] != '*'))
 		{
-			if (!getNum())
+			if (!getNum(tm))
 				return error("Bad location", lineNo, -1);
-			loc = num;
+			loc = tm->num;
 			if (loc > IADDR_SIZE)
 				return error("Location too large", lineNo, loc);
-			if (!skipCh(':'))
+			if (!skipCh(tm, ':'))
 				return error("Missing colon", lineNo, loc);
-			if (!getWord())
+			if (!getWord(tm))
 				return error("Missing opcode", lineNo, loc);
 			// get the instruction type op
-			op = opHALT;
-			while ((op < opEND)
-				&& (strncmp(opCodeTab[op], word, 4) != 0))
-				op++;
-
-			if (strncmp(opCodeTab[op], word, 4) != 0)
+			op = opcodeOf(tm->word);
+			if (op == opEND)
 				return error("Illegal opcode", lineNo, loc);
 			
 			switch (opClass(op))
@@ -309,78 +459,76 @@ int readInstructions(FILE *pgm)
 			case opclRR:
 				/***********************************/
 				// process the label related
-				if (strncmp("LABEL", word, 5) == 0)
+				if (op == opLAEBL)
 				{
-					getNum();
-					labelLocMap[num] = loc;
+					if (!getNum(tm) || tm->num < 0)
+						return error("Bad label", lineNo, loc);
 				}
-				else if ((!getNum()) || (num < 0) || (strcmp("GO", word) != 0 && num >= NO_REGS))
+				else if ((!getNum(tm)) || (tm->num < 0) || (op != opGO && tm->num >= NO_REGS))
 					return error("Bad first register", lineNo, loc);
-				arg1 = num;
-				if (!skipCh(','))
+				arg1 = tm->num;
+				if (!skipCh(tm, ','))
 					return error("Missing comma", lineNo, loc);
-				if ((!getNum()) || (num < 0) || (num >= NO_REGS))
+				if ((!getNum(tm)) || (tm->num < 0) || (tm->num >= NO_REGS))
 					return error("Bad second register", lineNo, loc);
-				arg2 = num;
-				if (!skipCh(','))
+				arg2 = tm->num;
+				if (!skipCh(tm, ','))
 					return error("Missing comma", lineNo, loc);
-				if ((!getNum()) || (num < 0) || (num >= NO_REGS))
+				if ((!getNum(tm)) || (tm->num < 0) || (tm->num >= NO_REGS))
 					return error("Bad third register", lineNo, loc);
-				arg3 = num;
+				arg3 = tm->num;
 				break;
 
 			case opclRM:
 			case opclRA:
+			case opclSYS:
 				/***********************************/
-				if ((!getNum()) || (num < 0) || (num >= NO_REGS))
+				if ((!getNum(tm)) || (tm->num < 0) || (tm->num >= NO_REGS))
 					return error("Bad first register", lineNo, loc);
-				arg1 = num;
-				if (!skipCh(','))
+				arg1 = tm->num;
+				if (!skipCh(tm, ','))
 					return error("Missing comma", lineNo, loc);
 				/*
 					load float , load integer	
 				*/
 				if (op == opLDC && same_reg_type(arg1,fac))
 				{
-					getFloat();
-					arg2 = *(int *)(&flt_num);
+					getFloat(tm);
+					arg2 = *(int *)(&tm->flt_num);
 				}
 				else{
-					if (!getNum())	return error("Bad displacement", lineNo, loc);
-					arg2 = num;
+					if (!getNum(tm))	return error("Bad displacement", lineNo, loc);
+					arg2 = tm->num;
 				}
 				
-				if (!skipCh('(') && !skipCh(','))
+				if (!skipCh(tm, '(') && !skipCh(tm, ','))
 					return error("Missing LParen", lineNo, loc);
-				if ((!getNum()) || (num < 0) || (num >= NO_REGS))
+				if ((!getNum(tm)) || (tm->num < 0) || (tm->num >= NO_REGS))
 					return error("Bad second register", lineNo, loc);
-				arg3 = num;
+				arg3 = tm->num;
 				break;
-			case opclSYS:
-				if (strncmp(word, "MALLOC", 6) == 0){}// nothing need to process
-				if (strncmp(word, "FREE", 6) == 0){}// nothing need to process
-
 			}
-			iMem[loc].iop = op;
-			iMem[loc].iarg1 = arg1;
-			iMem[loc].iarg2 = arg2;
-			iMem[loc].iarg3 = arg3;
+			tm_putInstr(tm, loc, op, arg1, arg2, arg3);
 		}
 	}
-	return TRUE;
+	return tm_endCode(tm);
 } /* readInstructions */
 
 
 /********************************************/
-STEPRESULT stepTM(void)
+STEPRESULT stepTM(TMContext * tm)
 {
 
 	INSTRUCTION currentinstruction;
 	int pc_pos;
-	int r, s, t, m;
+	int r, s, t = 0, m;
 	int ok;
 
-	pc_pos = reg[PC_REG];
+	pc_pos = tm->reg[PC_REG];
+
+	/* LABEL is a pseudo op, it is skipped instead of executed */
+	while ((pc_pos >= 0) && (pc_pos < tm->iMemSize) && (tm->iMem[pc_pos].iop == opLAEBL))
+		pc_pos++;
 
 	//printf("run ins:%d\n", pc_pos);
 
@@ -391,8 +539,8 @@ STEPRESULT stepTM(void)
 
     if ((pc_pos < 0) || (pc_pos > IADDR_SIZE)) {return srIMEM_ERR;}
     
-	reg[PC_REG] = pc_pos + 1;
-	currentinstruction = iMem[pc_pos];
+	tm->reg[PC_REG] = pc_pos + 1;
+	currentinstruction = fetch(tm, pc_pos);
 	switch (opClass(currentinstruction.iop))
 	{
 	case opclRR:
@@ -406,8 +554,8 @@ STEPRESULT stepTM(void)
 		/***********************************/
 		r = currentinstruction.iarg1;
 		s = currentinstruction.iarg3;
-		m = currentinstruction.iarg2 + reg[s];
-		if ((m < 0) || (m > DADDR_SIZE))
+		m = currentinstruction.iarg2 + tm->reg[s];
+		if ((m < 0) || (m >= DADDR_SIZE))
 			return srDMEM_ERR;
 		break;
 
@@ -415,7 +563,7 @@ STEPRESULT stepTM(void)
 		/***********************************/
 		r = currentinstruction.iarg1;
 		s = currentinstruction.iarg3;
-		m = currentinstruction.iarg2 + reg[s];
+		m = currentinstruction.iarg2 + tm->reg[s];
 		break;
 	case opclSYS:
 		r = currentinstruction.iarg1;
@@ -432,7 +580,7 @@ STEPRESULT stepTM(void)
 	{ /* RR instructions */
 	case opHALT:
 		/***********************************/
-		if(traceflag) printf("HALT: %1d,%1d,%1d\n", r, s, t);
+		if(tm->traceflag) printf("HALT: %1d,%1d,%1d\n", r, s, t);
 		return srHALT;
 		/* break; */
 
@@ -440,22 +588,28 @@ STEPRESULT stepTM(void)
 		/***********************************/
 		do
 		{
-			printf("Enter value for IN instruction: ");
-			fflush(stdin);
-			fflush(stdout);
-			gets(in_Line);
-			lineLen = (int)strlen(in_Line);
-			inCol = 0;
+			if (tm->in == NULL)
+			{
+				printf("Enter value for IN instruction: ");
+				fflush(stdin);
+				fflush(stdout);
+				gets(tm->in_Line);
+			}
+			else if (fgets(tm->in_Line, LINESIZE, tm->in) == NULL)
+				return srIN_EOF;
+			else tm->in_Line[strcspn(tm->in_Line, "\n")] = '\0';
+			tm->lineLen = (int)strlen(tm->in_Line);
+			tm->inCol = 0;
 			/*
 				deal with the float number
 			*/
 			if (same_reg_type(r, ac)) { 
-				ok = getNum(); 
-				reg[r] = num;
+				ok = getNum(tm); 
+				tm->reg[r] = tm->num;
 			}
 			else if (same_reg_type(r,fac)) {
-				ok = getFloat();
-				reg[r] = flt_num;
+				ok = getFloat(tm);
+				tm->reg[r] = tm->flt_num;
 			}
 			else{
 				assert(!"undefined type");
@@ -466,66 +620,102 @@ STEPRESULT stepTM(void)
 
 	case opOUT:
 		if (same_reg_type(r, ac)) {
-			if (s == 0) fprintf(listing,"OUT instruction prints int: %d\n", reg[r]);
-			else if (s == 1){ fprintf(listing,"OUT instruction prints char: %c\n", reg[r]); }
-			else if (s == 2){ int p = reg[r]; while (dMem[p] != '\0') putc(dMem[p++], listing); putc('\n',listing); }
+			if (s == 0) fprintf(output(tm),"OUT instruction prints int: %d\n", tm->reg[r]);
+			else if (s == 1){ fprintf(output(tm),"OUT instruction prints char: %c\n", tm->reg[r]); }
+			else if (s == 2){ int p = tm->reg[r]; if (p < 0) return srDMEM_ERR; while (p < DADDR_SIZE && tm->dMem[p] != '\0') putc(tm->dMem[p++], output(tm)); putc('\n',output(tm)); }
 		}
 		else if (same_reg_type(r, fac)) {
-			flt_num = flt_from_reg(r);
-			fprintf(listing,"OUT instruction prints float: %f\n", flt_num);
+			tm->flt_num = flt_from_reg(tm, r);
+			fprintf(output(tm),"OUT instruction prints float: %f\n", tm->flt_num);
 		}
 		break;
-	case opMOV:	 
-		/*deal  with the conversion of different format*/
-		convert(s,r);// s -> r
-		break;
-	case opNEG:	 do_neg_op(r);break;
-			
-	case opADD:  operand(r, s, t, '+'); break;
-	case opSUB:  operand(r, s, t, '-');  break;
-	case opMUL:  operand(r, s, t, '*'); break;
-
+	case opMOV:   tm->reg[r] = tm->reg[s]; break;
+	case opNEG:   tm->reg[r] = -tm->reg[r]; break;
+	case opADD:   tm->reg[r] = tm->reg[s] + tm->reg[t]; break;
+	case opSUB:   tm->reg[r] = tm->reg[s] - tm->reg[t]; break;
+	case opMUL:   tm->reg[r] = tm->reg[s] * tm->reg[t]; break;
 	case opDIV:
 		/***********************************/
-		if (operand(r, s, t, '/') != srOKAY) return srZERODIVIDE;
+		if (tm->reg[t] == 0) return srZERODIVIDE;
+		tm->reg[r] = TM_DIV(tm->reg[s], tm->reg[t]);
 		break;
 	case opMOD:
-		operand(r, s, t, '%');
+		if (tm->reg[t] == 0) return srZERODIVIDE;
+		tm->reg[r] = TM_MOD(tm->reg[s], tm->reg[t]);
+		break;
+
+	case opADDF:  tm->reg[r] = int_from_flt(flt_from_reg(tm, s) + flt_from_reg(tm, t)); break;
+	case opSUBF:  tm->reg[r] = int_from_flt(flt_from_reg(tm, s) - flt_from_reg(tm, t)); break;
+	case opMULF:  tm->reg[r] = int_from_flt(flt_from_reg(tm, s) * flt_from_reg(tm, t)); break;
+	case opDIVF:
+		/***********************************/
+		if (flt_from_reg(tm, t) == 0) return srZERODIVIDE;
+		tm->reg[r] = int_from_flt(flt_from_reg(tm, s) / flt_from_reg(tm, t));
 		break;
-	case opGO:	   reg[PC_REG] = labelLocMap[r]; break;
+	case opMODF:
+		if ((int)flt_from_reg(tm, t) == 0) return srZERODIVIDE;
+		tm->reg[r] = TM_MOD((int)flt_from_reg(tm, s), (int)flt_from_reg(tm, t));
+		break;
+	case opNEGF:  tm->reg[r] = int_from_flt(-flt_from_reg(tm, r)); break;
+	case opCVTIF: tm->reg[r] = int_from_flt((float)tm->reg[s]); break;
+	case opCVTFI: tm->reg[r] = (int)flt_from_reg(tm, s); break;
+	case opGO:	   tm->reg[PC_REG] = tm->labelLocMap[r]; break;// linked into LDC pc by the loader
 	case opLAEBL: break;
 
 		/*************** RM instructions ********************/
-	case opLD:    reg[r] = dMem[m];  break;
-	case opST:    dMem[m] = reg[r];  break;// no need to convert float,integer
+	case opLD:    tm->reg[r] = tm->dMem[m];  break;
+	case opST:    tm->dMem[m] = tm->reg[r]; TM_DIRTY(tm, m); break;// no need to convert float,integer
 	case opPUSH:  
-		dMem[m] = reg[r];
-		reg[s]--;
+		tm->dMem[m] = tm->reg[r];
+		TM_DIRTY(tm, m);
+		tm->reg[s]--;
 		break;
 	case opPOP:
-		reg[r] = dMem[m + 1];
-		reg[s]++;
+		if (m + 1 >= DADDR_SIZE) return srDMEM_ERR;
+		tm->reg[r] = tm->dMem[m + 1];
+		tm->reg[s]++;
 		break;
 		/*************** RA instructions ********************/
-	case opLDA:    reg[r] = m; break;
-	case opLDC:    reg[r] = currentinstruction.iarg2; break;
-	case opJLT:    if (reg[r] <  0) reg[PC_REG] = m; break;
-	case opJLE:    if (reg[r] <= 0) reg[PC_REG] = m; break;
-	case opJGT:    if (reg[r] >  0) reg[PC_REG] = m; break;
-	case opJGE:    if (reg[r] >= 0) reg[PC_REG] = m; break;
-	case opJEQ:    if (reg[r] == 0) reg[PC_REG] = m; break;
-	case opJNE:    if (reg[r] != 0) reg[PC_REG] = m; break;
-	case opRETURN: reg[PC_REG] = dMem[m];	break;
+	case opLDA:    tm->reg[r] = m; break;
+	case opLDC:    tm->reg[r] = currentinstruction.iarg2; break;
+	case opJLT:    if (tm->reg[r] <  0) tm->reg[PC_REG] = m; break;
+	case opJLE:    if (tm->reg[r] <= 0) tm->reg[PC_REG] = m; break;
+	case opJGT:    if (tm->reg[r] >  0) tm->reg[PC_REG] = m; break;
+	case opJGE:    if (tm->reg[r] >= 0) tm->reg[PC_REG] = m; break;
+	case opJEQ:    if (tm->reg[r] == 0) tm->reg[PC_REG] = m; break;
+	case opJNE:    if (tm->reg[r] != 0) tm->reg[PC_REG] = m; break;
+	case opJLTF:   if (flt_from_reg(tm, r) <  0) tm->reg[PC_REG] = m; break;
+	case opJLEF:   if (flt_from_reg(tm, r) <= 0) tm->reg[PC_REG] = m; break;
+	case opJGTF:   if (flt_from_reg(tm, r) >  0) tm->reg[PC_REG] = m; break;
+	case opJGEF:   if (flt_from_reg(tm, r) >= 0) tm->reg[PC_REG] = m; break;
+	case opJEQF:   if (flt_from_reg(tm, r) == 0) tm->reg[PC_REG] = m; break;
+	case opJNEF:   if (flt_from_reg(tm, r) != 0) tm->reg[PC_REG] = m; break;
+	case opJIDX:   tm->reg[PC_REG] = m + tm->reg[r]; break;
+	case opRETURN:
+		if ((m < 0) || (m >= DADDR_SIZE)) return srDMEM_ERR;
+		tm->reg[PC_REG] = tm->dMem[m];
+		break;
 	/*sys instructions*/
 	case opMALLOC: 
-		m = pMalloc(reg[ac]);
-		if (m >= reg[sp]) {
-			assert(!"stack/heap overlap !!!"); 
-		}
-		dMem[reg[mp]--] = m;
+		m = pMalloc(tm, tm->reg[ac]);
+		/* the heap ran into the stack, the program stops instead of the host */
+		if (m >= tm->reg[sp] || tm->reg[mp] < 0 || tm->reg[mp] >= DADDR_SIZE)
+			return srDMEM_ERR;
+		TM_DIRTY(tm, tm->reg[mp]);
+		tm->dMem[tm->reg[mp]--] = m;
 		break;
 	case opFREE:
-		pFree(dMem + reg[ac]);
+		pFree(tm, tm->reg[ac]);
+		break;
+	case opMEMCPY:
+	case opMEMSET:
+	case opMEMMOVE:
+		if (!blockInMem(tm->reg[r], m) || (currentinstruction.iop != opMEMSET && !blockInMem(tm->reg[s], m)))
+			return srDMEM_ERR;
+		if (currentinstruction.iop == opMEMCPY) memcpy(tm->dMem + tm->reg[r], tm->dMem + tm->reg[s], m * sizeof(int));
+		else if (currentinstruction.iop == opMEMMOVE) memmove(tm->dMem + tm->reg[r], tm->dMem + tm->reg[s], m * sizeof(int));
+		else for (t = 0; t < m; t++) tm->dMem[tm->reg[r] + t] = tm->reg[s];
+		for (t = tm->reg[r] >> TM_PAGE_SHIFT; t <= (tm->reg[r] + m - 1) >> TM_PAGE_SHIFT; t++) tm->dirty[t] = 1;
 		break;
     default:        assert(!"unknown op type");break;
 		/* end of legal instructions */
@@ -534,12 +724,25 @@ STEPRESULT stepTM(void)
 } /* stepTM */
 
 /********************************************/
+static void reportProfile(TMContext * tm)
+{
+	FILE * folded = fopen(TM_FOLDED, "w");
+	printProfile(tm, stdout);
+	if (folded == NULL)
+	{
+		printf("can not write %s\n", TM_FOLDED);
+		return;
+	}
+	writeFoldedStacks(tm, folded);
+	fclose(folded);
+} /* reportProfile */
 
 int executeCommand(void){
 	char cmd = 'g';
 }
 
-int doCommand(char cmd){
+int tm_command(TMContext * tm, char cmd)
+{
 	int stepcnt = 0, i;
 	int printcnt;
 	int stepResult;
@@ -549,9 +752,9 @@ int doCommand(char cmd){
 	{
 	case 't':
 		/***********************************/
-		traceflag = !traceflag;
+		tm->traceflag = !tm->traceflag;
 		printf("Tracing now ");
-		if (traceflag) printf("on.\n"); else printf("off.\n");
+		if (tm->traceflag) printf("on.\n"); else printf("off.\n");
 		break;
 
 	case 'h':
@@ -572,6 +775,13 @@ int doCommand(char cmd){
 		printf("   p(rint         "\
 			"Toggle print of total instructions executed"\
 			" ('go' only)\n");
+		printf("   f(old          "\
+			"Toggle the profile of 'go', the call stacks\n"\
+			"                  are written to " TM_FOLDED "\n");
+		printf("   j(it           "\
+			"Toggle the compilation of hot code into machine code\n");
+		printf("   m(alloc        "\
+			"Print the heap statistics\n");
 		printf("   c(lear         "\
 			"Reset simulator for new execution of program\n");
 		printf("   h(elp          "\
@@ -580,17 +790,36 @@ int doCommand(char cmd){
 			"Terminate the simulation\n");
 		break;
 
+	case 'm':
+		/***********************************/
+		printHeapStats(tm);
+		break;
+
 	case 'p':
 		/***********************************/
-		icountflag = !icountflag;
+		tm->icountflag = !tm->icountflag;
 		printf("Printing instruction count now ");
-		if (icountflag) printf("on.\n"); else printf("off.\n");
+		if (tm->icountflag) printf("on.\n"); else printf("off.\n");
+		break;
+
+	case 'f':
+		/***********************************/
+		tm->profileflag = !tm->profileflag;
+		printf("Profiling now ");
+		if (tm->profileflag) printf("on.\n"); else printf("off.\n");
+		break;
+
+	case 'j':
+		/***********************************/
+		tm->jitflag = !tm->jitflag;
+		printf("JIT now ");
+		if (tm->jitflag) printf("on.\n"); else printf("off.\n");
 		break;
 
 	case 's':
 		/***********************************/
-		if (atEOL())  stepcnt = 1;
-		else if (getNum())  stepcnt = abs(num);
+		if (atEOL(tm))  stepcnt = 1;
+		else if (getNum(tm))  stepcnt = abs(tm->num);
 		else   printf("Step count?\n");
 		break;
 
@@ -600,7 +829,7 @@ int doCommand(char cmd){
 		/***********************************/
 		for (i = 0; i < NO_REGS; i++)
 		{
-			printf("%1d: %4d    ", i, reg[i]);
+			printf("%1d: %4d    ", i, tm->reg[i]);
 			if ((i % 4) == 3) printf("\n");
 		}
 		break;
@@ -608,20 +837,20 @@ int doCommand(char cmd){
 	case 'i':
 		/***********************************/
 		printcnt = 1;
-		if (getNum())
+		if (getNum(tm))
 		{
-			iloc = num;
-			if (getNum()) printcnt = num;
+			tm->iloc = tm->num;
+			if (getNum(tm)) printcnt = tm->num;
 		}
-		if (!atEOL())
+		if (!atEOL(tm))
 			printf("Instruction locations?\n");
 		else
 		{
-			while ((iloc >= 0) && (iloc < IADDR_SIZE)
+			while ((tm->iloc >= 0) && (tm->iloc < IADDR_SIZE)
 				&& (printcnt > 0))
 			{
-				writeInstruction(iloc);
-				iloc++;
+				writeInstruction(tm, tm->iloc);
+				tm->iloc++;
 				printcnt--;
 			}
 		}
@@ -630,20 +859,20 @@ int doCommand(char cmd){
 	case 'd':
 		/***********************************/
 		printcnt = 1;
-		if (getNum())
+		if (getNum(tm))
 		{
-			dloc = num;
-			if (getNum()) printcnt = num;
+			tm->dloc = tm->num;
+			if (getNum(tm)) printcnt = tm->num;
 		}
-		if (!atEOL())
+		if (!atEOL(tm))
 			printf("Data locations?\n");
 		else
 		{
-			while ((dloc >= 0) && (dloc < DADDR_SIZE)
+			while ((tm->dloc >= 0) && (tm->dloc < DADDR_SIZE)
 				&& (printcnt > 0))
 			{
-				printf("%5d: %5d\n", dloc, dMem[dloc]);
-				dloc++;
+				printf("%5d: %5d\n", tm->dloc, tm->dMem[tm->dloc]);
+				tm->dloc++;
 				printcnt--;
 			}
 		}
@@ -651,14 +880,17 @@ int doCommand(char cmd){
 
 	case 'c':
 		/***********************************/
-		iloc = 0;
-		dloc = 0;
+		tm->iloc = 0;
+		tm->dloc = 0;
 		stepcnt = 0;
 		for (regNo = 0; regNo < NO_REGS; regNo++)
-			reg[regNo] = 0;
-		dMem[0] = DADDR_SIZE - 1;
+			tm->reg[regNo] = 0;
+		tm->dMem[0] = DADDR_SIZE - 1;
 		for (loc = 1; loc < DADDR_SIZE; loc++)
-			dMem[loc] = 0;
+			tm->dMem[loc] = 0;
+		memset(tm->dirty, 1, sizeof(tm->dirty));
+		heapReset(tm);
+		objApplyData(tm);
 		break;
 
 	case 'q': return FALSE;  /* break; */
@@ -672,201 +904,143 @@ int doCommand(char cmd){
 		if (cmd == 'g')
 		{
 			stepcnt = 0;
-			while (stepResult == srOKAY)
-			{
-				iloc = reg[PC_REG];
-				if (traceflag) writeInstruction(iloc);
-				stepResult = stepTM();
-				stepcnt++;
-			}
-			if (icountflag)
+			stepResult = tm_run(tm, &stepcnt);
+			if (tm->icountflag)
 				printf("Number of instructions executed = %d\n", stepcnt);
+			if (tm->profileflag) reportProfile(tm);
 		}
 		else
 		{
 			while ((stepcnt > 0) && (stepResult == srOKAY))
 			{
-				iloc = reg[PC_REG];
-				if (traceflag) writeInstruction(iloc);
-				stepResult = stepTM();
+				tm->iloc = tm->reg[PC_REG];
+				if (tm->traceflag) writeInstruction(tm, tm->iloc);
+				stepResult = stepTM(tm);
 				stepcnt--;
 			}
 		}
-		if(traceflag) printf("%s\n", stepResultTab[stepResult]);
+		if(tm->traceflag) printf("%s\n", stepResultTab[stepResult]);
 	}
 	return TRUE;
-}
+} /* tm_command */
 
+/********************************************/
+/* the commands of the simulator work on one machine */
+int doCommand(char cmd)
+{
+	return tm_command(tm_default(), cmd);
+} /* doCommand */
 
 int doCommand2(void)
 {
-	char cmd;
-	int stepcnt = 0, i;
-	int printcnt;
-	int stepResult;
-	int regNo, loc;
+	TMContext * tm = tm_default();
 	do
 	{
 		printf("Enter command: ");
 		fflush(stdin);
 		fflush(stdout);
-		gets(in_Line);
-		lineLen = (int)strlen(in_Line);
-		inCol = 0;
-	} while (!getWord());
+		gets(tm->in_Line);
+		tm->lineLen = (int)strlen(tm->in_Line);
+		tm->inCol = 0;
+	} while (!getWord(tm));
+	return tm_command(tm, tm->word[0]);
+} /* doCommand2 */
 
-	cmd = word[0];
-	switch (cmd)
-	{
-	case 't':
-		/***********************************/
-		traceflag = !traceflag;
-		printf("Tracing now ");
-		if (traceflag) printf("on.\n"); else printf("off.\n");
-		break;
-
-	case 'h':
-		/***********************************/
-		printf("Commands are:\n");
-		printf("   s(tep <n>      "\
-			"Execute n (default 1) TM instructions\n");
-		printf("   g(o            "\
-			"Execute TM instructions until HALT\n");
-		printf("   r(egs          "\
-			"Print the contents of the registers\n");
-		printf("   i(Mem <b <n>>  "\
-			"Print n iMem locations starting at b\n");
-		printf("   d(Mem <b <n>>  "\
-			"Print n dMem locations starting at b\n");
-		printf("   t(race         "\
-			"Toggle instruction trace\n");
-		printf("   p(rint         "\
-			"Toggle print of total instructions executed"\
-			" ('go' only)\n");
-		printf("   c(lear         "\
-			"Reset simulator for new execution of program\n");
-		printf("   h(elp          "\
-			"Cause this list of commands to be printed\n");
-		printf("   q(uit          "\
-			"Terminate the simulation\n");
-		break;
-
-	case 'p':
-		/***********************************/
-		icountflag = !icountflag;
-		printf("Printing instruction count now ");
-		if (icountflag) printf("on.\n"); else printf("off.\n");
-		break;
-
-	case 's':
-		/***********************************/
-		if (atEOL())  stepcnt = 1;
-		else if (getNum())  stepcnt = abs(num);
-		else   printf("Step count?\n");
-		break;
-
-	case 'g':   stepcnt = 1;     break;
-
-	case 'r':
-		/***********************************/
-		for (i = 0; i < NO_REGS; i++)
-		{
-			printf("%1d: %4d    ", i, reg[i]);
-			if ((i % 4) == 3) printf("\n");
-		}
-		break;
-
-	case 'i':
-		/***********************************/
-		printcnt = 1;
-		if (getNum())
-		{
-			iloc = num;
-			if (getNum()) printcnt = num;
-		}
-		if (!atEOL())
-			printf("Instruction locations?\n");
-		else
-		{
-			while ((iloc >= 0) && (iloc < IADDR_SIZE)
-				&& (printcnt > 0))
-			{
-				writeInstruction(iloc);
-				iloc++;
-				printcnt--;
-			}
-		}
-		break;
-
-	case 'd':
-		/***********************************/
-		printcnt = 1;
-		if (getNum())
-		{
-			dloc = num;
-			if (getNum()) printcnt = num;
-		}
-		if (!atEOL())
-			printf("Data locations?\n");
-		else
-		{
-			while ((dloc >= 0) && (dloc < DADDR_SIZE)
-				&& (printcnt > 0))
-			{
-				printf("%5d: %5d\n", dloc, dMem[dloc]);
-				dloc++;
-				printcnt--;
-			}
-		}
-		break;
-
-	case 'c':
-		/***********************************/
-		iloc = 0;
-		dloc = 0;
-		stepcnt = 0;
-		for (regNo = 0; regNo < NO_REGS; regNo++)
-			reg[regNo] = 0;
-		dMem[0] = DADDR_SIZE - 1;
-		for (loc = 1; loc < DADDR_SIZE; loc++)
-			dMem[loc] = 0;
-		break;
+/********************************************/
+/* the location stepTM executes next, past the labels */
+static void profileStep(TMContext * tm)
+{
+	int loc = tm->reg[PC_REG];
+	while (loc >= 0 && loc < tm->iMemSize && tm->iMem[loc].iop == opLAEBL)
+		loc++;
+	profStep(tm, loc);
+}
 
-	case 'q': return FALSE;  /* break; */
+STEPRESULT tm_run(TMContext * tm, int * stepcnt)
+{
+	STEPRESULT stepResult = srOKAY;
+	int steps = 0;
+	if (tm->profileflag) profBegin(tm);
+	/* the stepper is only needed for tracing */
+	if (!tm->traceflag)
+		return runTM(tm, stepcnt);
+	while (stepResult == srOKAY)
+	{
+		if (tm->budget > 0 && steps >= tm->budget)
+			return srBUDGET;
+		tm->iloc = tm->reg[PC_REG];
+		writeInstruction(tm, tm->iloc);
+		if (tm->profileflag) profileStep(tm);
+		stepResult = stepTM(tm);
+		steps++;
+		(*stepcnt)++;
+	}
+	return stepResult;
+} /* tm_run */
 
-	default: printf("Command %c unknown.\n", cmd); break;
-	}  /* case */
-	
-	stepResult = srOKAY;
-	if (stepcnt > 0)
+TMContext * tm_create(void)
+{
+	TMContext * tm = (TMContext *)calloc(1, sizeof(TMContext));
+	if (tm == NULL) return NULL;
+	objReset(tm);
+	resetMachine(tm);
+	return tm;
+} /* tm_create */
+
+void tm_destroy(TMContext * tm)
+{
+	if (tm == NULL) return;
+	if (tm == defaultMachine) defaultMachine = NULL;
+	objFree(tm);
+	gcFree(tm);
+	profFree(tm);
+	jitFree(tm);
+	free(tm->iMemBuf);
+	free(tm->snapMem);
+	free(tm->labelLocMap);
+	free(tm->code);
+	free(tm->addrMap);
+	free(tm);
+} /* tm_destroy */
+
+void tm_snapshot(TMContext * tm)
+{
+	if (tm->snapMem == NULL)
+		tm->snapMem = (int *)malloc(sizeof(tm->dMem));
+	memcpy(tm->snapMem, tm->dMem, sizeof(tm->dMem));
+	memcpy(tm->snapReg, tm->reg, sizeof(tm->reg));
+	tm->snapHeap = tm->heap;
+	memset(tm->dirty, 0, sizeof(tm->dirty));
+} /* tm_snapshot */
+
+int tm_restore(TMContext * tm)
+{
+	int page, last;
+	if (tm->snapMem == NULL) return FALSE;
+	/* the allocators write below heap.high without marking pages */
+	last = ((tm->heap.high > HEAP_BASE ? tm->heap.high : HEAP_BASE + 1) - 1) >> TM_PAGE_SHIFT;
+	for (page = HEAP_BASE >> TM_PAGE_SHIFT; page <= last; page++)
+		tm->dirty[page] = 1;
+	for (page = 0; page < TM_PAGES; page++)
 	{
-		if (cmd == 'g')
-		{
-			stepcnt = 0;
-			while (stepResult == srOKAY)
-			{
-				iloc = reg[PC_REG];
-				if (traceflag) writeInstruction(iloc);
-				stepResult = stepTM();
-				stepcnt++;
-			}
-			if (icountflag)
-				printf("Number of instructions executed = %d\n", stepcnt);
-		}
-		else
-		{
-			while ((stepcnt > 0) && (stepResult == srOKAY))
-			{
-				iloc = reg[PC_REG];
-				if (traceflag) writeInstruction(iloc);
-				stepResult = stepTM();
-				stepcnt--;
-			}
-		}
-		printf("%s\n", stepResultTab[stepResult]);
+		int from = page << TM_PAGE_SHIFT, n = 1 << TM_PAGE_SHIFT;
+		if (!tm->dirty[page]) continue;
+		if (from + n > DADDR_SIZE) n = DADDR_SIZE - from;
+		memcpy(tm->dMem + from, tm->snapMem + from, n * sizeof(int));
+		tm->dirty[page] = 0;
 	}
+	memcpy(tm->reg, tm->snapReg, sizeof(tm->reg));
+	tm->heap = tm->snapHeap;
+	gcReset(tm);
 	return TRUE;
-} /* doCommand */
+} /* tm_restore */
+
+TMContext * tm_default(void)
+{
+	if (defaultMachine == NULL)
+		defaultMachine = tm_create();
+	return defaultMachine;
+} /* tm_default */
 
 
  float flt_from_integer(int c){
@@ -874,9 +1048,9 @@ int doCommand2(void)
 	return ret;
 }
 
- float flt_from_reg(int r)
+ float flt_from_reg(TMContext * tm, int r)
 {
-	float flt = flt_from_integer(reg[r]);
+	float flt = flt_from_integer(tm->reg[r]);
 	return flt;
 }
 
@@ -886,90 +1060,6 @@ int doCommand2(void)
 	 return ret;
  }
 
-   STEPRESULT do_operand_flt(int r, float lhs, float rhs, char op){
-	  operand_proc(op, int_from_flt);
-  }
-
-   STEPRESULT do_operand_int(int r, int lhs, int rhs, char op){
-	  operand_proc(op, (int));
-  }
-
-
-   STEPRESULT do_neg_op(int r)
-   {
-	   float flt;
-	   switch (r)
-	   {
-	   case ac:
-	   case ac1:
-		   reg[r] = -reg[r];
-		   break;
-	   case fac:
-	   case fac1:
-		   flt = flt_from_reg(r);
-		   reg[r] = int_from_flt(-flt);
-		   break;
-	   }
-	   return srOKAY;
-   }
-
-    STEPRESULT operand(int r, int s, int t, char op)
-   {
-	   assert(same_reg_type(r, s) && same_reg_type(s, t));
-	   float flt_s, flt_t;
-	   switch (r)
-	   {
-	   case ac:
-	   case ac1:
-		   //int operation
-		   return do_operand_int(r, reg[s], reg[t], op);
-		   break;
-	   case fac:
-	   case fac1:
-		   //float to int
-		   flt_s = flt_from_reg(s);
-		   flt_t = flt_from_reg(t);
-		   return do_operand_flt(r, flt_s, flt_t, op);
-		   break;
-	   default:
-               assert(!"undefined type for operand");
-               return  srHALT;
-               break;
-       }
-
-}
-
-void convert(int reg1, int reg2 )
-{
-		if (same_reg_type(reg1, reg2))
-		{
-			reg[reg2] = reg[reg1];
-			return;
-		}
-		float flt;
-		switch (reg1)
-		{
-		case ac:
-		case ac1:
-			assert(reg2 == fac || reg2 == fac1);
-			//int to float
-			flt = reg[reg1];
-			reg[reg2] = int_from_flt(flt);
-			break;
-		case fac:
-		case fac1:
-			assert(reg2 == ac || reg2 == ac1);
-			//float to int
-			flt = flt_from_reg(reg1);
-			reg[reg2] = flt;
-			break;
-		default:
-			reg[reg2] = reg[reg1];
-			break;
-		}
-  }
-
-
  int same_reg_type(int reg1, int reg2)
 {
 	return reg_type(reg1) == reg_type(reg2);
@@ -5,7 +5,30 @@
 #include <string.h>
 #include <ctype.h>
 #include "globals.h"
-
+#include "vmmemory.h"
+#include "vmgc.h"
+#include "tmobj.h"
+#include "tmprof.h"
+#include "tmjit.h"
+
+/******* const *******/
+#define IADDR_SIZE 65535 /* increase for large programs */
+#define NO_REGS 20
+#define PC_REG  7
+#define LINESIZE  121
+#define WORDSIZE  20
+#define TM_PAGE_SHIFT 8 /* dMem is tracked in pages of 256 words */
+#define TM_PAGES ((DADDR_SIZE >> TM_PAGE_SHIFT) + 1)
+
+/* the page of adress a was written */
+#define TM_DIRTY(tm, a) ((tm)->dirty[(unsigned)(a) >> TM_PAGE_SHIFT] = 1)
+
+/* the int division of every engine, a zero divisor is srZERODIVIDE
+ * before these; INT_MIN / -1 wraps to INT_MIN and INT_MIN % -1 is 0
+ * instead of trapping on the host
+ */
+#define TM_DIV(a, b) ((b) == -1 ? (int)(0u - (unsigned)(a)) : (a) / (b))
+#define TM_MOD(a, b) ((b) == -1 ? 0 : (a) % (b))
 
 /******* type  *******/
 
@@ -21,7 +44,7 @@ typedef enum {
 	opHALT,    /* RR     halt, operands are ignored */
 	opIN,      /* RR     read into reg(r); s and t are ignored */
 	opOUT,     /* RR     write from reg(r), s and t are ignored */
-	opMOV,     /* RR	 move register from one to another*/
+	opMOV,     /* RR	 move register from one to another, the bits are copied */
 	opNEG,     /*RR      reg[r] = -reg[r]             */
 	opADD,    /* RR     reg(r) = reg(s)+reg(t) */
 	opSUB,    /* RR     reg(r) = reg(s)-reg(t) */
@@ -31,6 +54,16 @@ typedef enum {
 	opLAEBL,    /* RR   label num*/
 	opGO,    /* RR     go to the label num*/
 
+	/* the float forms, the registers hold the bits of a float */
+	opADDF,    /* RR     reg(r) = reg(s)+reg(t) */
+	opSUBF,    /* RR     reg(r) = reg(s)-reg(t) */
+	opMULF,    /* RR     reg(r) = reg(s)*reg(t) */
+	opDIVF,    /* RR     reg(r) = reg(s)/reg(t) */
+	opMODF,    /* RR     reg(r) = (int)reg(s) % (int)reg(t), an int */
+	opNEGF,    /* RR     reg(r) = -reg(r) */
+	opCVTIF,   /* RR     reg(r) = (float)reg(s) */
+	opCVTFI,   /* RR     reg(r) = (int)reg(s) */
+
 	opRRLim,   /* limit of RR opcodes */
 
 	/* RM instructions */
@@ -49,11 +82,22 @@ typedef enum {
 	opJGE,     /* RA     if reg(r)>=0 then reg(7) = d+reg(s) */
 	opJEQ,     /* RA     if reg(r)==0 then reg(7) = d+reg(s) */
 	opJNE,     /* RA     if reg(r)!=0 then reg(7) = d+reg(s) */
+	/* the float forms test reg(r) as a float, -0 is 0 and NaN is only != 0 */
+	opJLTF,    /* RA     if reg(r)<0 then reg(7) = d+reg(s) */
+	opJLEF,    /* RA     if reg(r)<=0 then reg(7) = d+reg(s) */
+	opJGTF,    /* RA     if reg(r)>0 then reg(7) = d+reg(s) */
+	opJGEF,    /* RA     if reg(r)>=0 then reg(7) = d+reg(s) */
+	opJEQF,    /* RA     if reg(r)==0 then reg(7) = d+reg(s) */
+	opJNEF,    /* RA     if reg(r)!=0 then reg(7) = d+reg(s) */
+	opJIDX,    /* RA     reg(7) = d+reg(s)+reg(r), indexed jump into a table of GO */
 	opRETURN,  /* RA     reg[pc] = dMem[a]; */
 	opRALim,    /* Limit of RA opcodes */
 	/*SYSTEM instructions*/
 	opMALLOC,
 	opFREE,
+	opMEMCPY,  /* SYS    copy d words from mem(reg(s)) to mem(reg(r)), they do not overlap */
+	opMEMSET,  /* SYS    store reg(s) into d words from mem(reg(r)) */
+	opMEMMOVE, /* SYS    copy d words from mem(reg(s)) to mem(reg(r)), they may overlap */
 	opEND
 } OPCODE;
 
@@ -62,7 +106,9 @@ typedef enum {
 	srHALT,
 	srIMEM_ERR,
 	srDMEM_ERR,
-	srZERODIVIDE
+	srZERODIVIDE,
+	srBUDGET,   /* the instruction budget of the run is used up */
+	srIN_EOF    /* IN found no more input */
 } STEPRESULT;
 
 typedef struct {
@@ -72,9 +118,121 @@ typedef struct {
 	int iarg3;
 } INSTRUCTION;
 
-
-int readInstructions(FILE *pgm);
+/* everything a machine owns, each program runs in a context
+ * of its own, so several of them may run side by side (one
+ * per thread), nothing below is shared between contexts
+ */
+typedef struct TMContext {
+	INSTRUCTION * iMem;    /* the text buffer or the mapped object */
+	INSTRUCTION * iMemBuf; /* iMem of a program read from text */
+	int iMemBufSize;       /* the part of iMemBuf that is not HALT */
+	int iMemSize;          /* highest loaded location + 1 */
+	int reg[NO_REGS];
+	int dMem[DADDR_SIZE];
+	int * labelLocMap;     /* the label and location mapping, grows on demand */
+	int labelCap;
+	TMHEAP heap;
+	TMGC gc;
+	TMOBJTAB obj;
+
+	/* the state saved by tm_snapshot, dirty marks the pages of
+	 * dMem written since then (the heap is covered by heap.high)
+	 */
+	int * snapMem;
+	int snapReg[NO_REGS];
+	TMHEAP snapHeap;
+	unsigned char dirty[TM_PAGES];
+
+	/* the pre-decoded code of runTM */
+	struct txinstr * code;
+	int * addrMap;         /* iMem location -> index in code */
+	int codeCap;
+
+	FILE * out;            /* OUT prints here, NULL is listing */
+	FILE * in;             /* IN reads here, NULL asks on stdin */
+	int budget;            /* instructions a tm_run may execute, 0 is no limit */
+	int traceflag;
+	int icountflag;
+	int profileflag;       /* tm_run profiles into prof */
+	TMPROF * prof;
+	int jitflag;           /* tm_run compiles the hot code */
+	TMJIT * jit;
+	int iloc;              /* next location of the i and d commands */
+	int dloc;
+
+	/* the line read by the loader, IN and the commands */
+	char in_Line[LINESIZE];
+	int lineLen;
+	int inCol;
+	int num;
+	float flt_num;
+	char word[WORDSIZE];
+	char ch;
+} TMContext;
+
+/* the opcode table shared by the compiler and the machine:
+ * the name in the text and the operand class, indexed by OPCODE
+ */
+typedef struct {
+	char * name;
+	OPCLASS opclass;
+} OPINFO;
+
+extern OPINFO opCodeTab[];
+extern char * stepResultTab[];
+
+/* a fresh machine with nothing loaded, NULL if out of memory */
+TMContext * tm_create(void);
+
+/* run from reg[PC_REG] until HALT, an error or the end of the
+ * budget, the number of executed instructions is added to stepcnt
+ */
+STEPRESULT tm_run(TMContext * tm, int * stepcnt);
+
+/* the interactive command cmd, its arguments are read from
+ * in_Line, FALSE for quit
+ */
+int tm_command(TMContext * tm, char cmd);
+
+void tm_destroy(TMContext * tm);
+
+/* save the state of the machine, usually right after tm_load,
+ * tm_restore brings it back by copying only the pages of dMem
+ * written in between, so a program can be run again and again
+ * without loading it or clearing the whole memory
+ */
+void tm_snapshot(TMContext * tm);
+int tm_restore(TMContext * tm);
+
+/* the machine behind doCommand, loadObject and clearVmem */
+TMContext * tm_default(void);
+
+int readInstructions(TMContext * tm, FILE *pgm);
+
+/* a program put into the machine without text: tm_beginCode
+ * clears it, tm_putInstr stores an instruction (a LABEL
+ * defines its label) and tm_endCode links the GOs and
+ * applies the constant pool, FALSE for an undefined label
+ */
+void tm_beginCode(TMContext * tm);
+void tm_putInstr(TMContext * tm, int loc, int op, int r, int s, int t);
+int tm_endCode(TMContext * tm);
+void resetMachine(TMContext * tm);
 int doCommand(char);
+int opClass(int c);
+
+/* the opcode named name, opEND if there is none */
+int opcodeOf(char * name);
+
+int reg_type(int r);
+void writeInstruction(TMContext * tm, int loc);
+STEPRESULT stepTM(TMContext * tm);
+
+/* run from reg[PC_REG] until HALT or an error with the
+ * pre-decoded threaded engine (tmexec.c), the number of
+ * executed instructions is added to stepcnt
+ */
+STEPRESULT runTM(TMContext * tm, int * stepcnt);
 
 
 
@@ -0,0 +1,346 @@
+/****************************************************/
+/* File: tm2c.c                                     */
+/* translates a TM program into one C function: the */
+/* registers become locals, dMem stays the array of */
+/* the machine, every decoded instruction is a few  */
+/* lines of C and the static jumps are gotos. The   */
+/* code adresses the program may jump to at run     */
+/* time go through a switch. IN, OUT, MALLOC, FREE  */
+/* and the other instructions the engine leaves to  */
+/* stepTM call it, so they behave as in the VM      */
+/****************************************************/
+
+#include "tm2c.h"
+#include "tmexec.h"
+#include "code.h"
+
+/* the C text of register r read by the instruction at loc,
+ * pc reads as the location of the next instruction
+ */
+static char * regText(int r, int loc)
+{
+	static char buf[4][16];
+	static int next = 0;
+	char * s = buf[next++ & 3];
+	if (r == PC_REG) sprintf(s, "%d", loc + 1);
+	else sprintf(s, "r%d", r);
+	return s;
+}
+#define R(r) regText((r), x->loc)
+
+/* the functions of the file are named after it */
+static void baseName(char * file, char * name, int size)
+{
+	char * p = strrchr(file, '/');
+	int n = 0;
+	p = p == NULL ? file : p + 1;
+	for (; *p != '\0' && *p != '.' && n < size - 1; p++)
+		name[n++] = isalnum((unsigned char)*p) ? *p : '_';
+	name[n] = '\0';
+}
+
+/********************************************/
+/* the code adresses that may reach the dynamic dispatch: the
+ * constants that fall inside the code (return adresses, function
+ * adresses), the entries of the jump tables, the instruction after
+ * one left to stepTM and the start
+ */
+static void findTargets(TXINSTR * prog, int n, int top, char * target)
+{
+	int i, j;
+	memset(target, 0, top + 1);
+	target[0] = TRUE;
+	for (i = 0; i < n; i++)
+	{
+		TXINSTR * x = &prog[i];
+		if ((x->op == txLDC || x->op == txJMPD) && x->d >= 0 && x->d <= top)
+			target[x->d] = TRUE;
+		else if (x->op == txGENERIC)
+			target[x->loc + 1] = TRUE;
+		else if (x->op == txJIDX)
+		{
+			for (j = i + 1; j < n && (prog[j].op == txJMP || prog[j].op == txJMPD); j++)
+				target[prog[j].loc] = TRUE;
+		}
+	}
+}
+
+static void writeOp(FILE * out, TXINSTR * x, TXINSTR * prog)
+{
+	int d = x->d;
+	switch (x->op)
+	{
+	case txHALT:
+		fprintf(out, "\tFINISH(%d, srHALT);\n", x->loc + 1);
+		break;
+	case txGENERIC:
+		fprintf(out, "\tGENERIC(%d);\n", x->loc);
+		break;
+	case txNOP:
+		break;
+	case txMOVE: fprintf(out, "\t%s = %s;\n", R(x->r), R(x->s)); break;
+	case txMOVIF: fprintf(out, "\t%s = as_int((float)%s);\n", R(x->r), R(x->s)); break;
+	case txMOVFI: fprintf(out, "\t%s = (int)as_flt(%s);\n", R(x->r), R(x->s)); break;
+	case txNEGI: fprintf(out, "\t%s = -%s;\n", R(x->r), R(x->r)); break;
+	case txNEGF: fprintf(out, "\t%s = as_int(-as_flt(%s));\n", R(x->r), R(x->r)); break;
+	case txADDI: fprintf(out, "\t%s = %s + %s;\n", R(x->r), R(x->s), R(x->t)); break;
+	case txSUBI: fprintf(out, "\t%s = %s - %s;\n", R(x->r), R(x->s), R(x->t)); break;
+	case txMULI: fprintf(out, "\t%s = %s * %s;\n", R(x->r), R(x->s), R(x->t)); break;
+	case txDIVI:
+		fprintf(out, "\tif (%s == 0) FAIL(%d, srZERODIVIDE);\n", R(x->t), x->loc);
+		fprintf(out, "\t%s = TM_DIV(%s, %s);\n", R(x->r), R(x->s), R(x->t));
+		break;
+	case txMODI:
+		fprintf(out, "\tif (%s == 0) FAIL(%d, srZERODIVIDE);\n", R(x->t), x->loc);
+		fprintf(out, "\t%s = TM_MOD(%s, %s);\n", R(x->r), R(x->s), R(x->t));
+		break;
+	case txADDF: fprintf(out, "\t%s = as_int(as_flt(%s) + as_flt(%s));\n", R(x->r), R(x->s), R(x->t)); break;
+	case txSUBF: fprintf(out, "\t%s = as_int(as_flt(%s) - as_flt(%s));\n", R(x->r), R(x->s), R(x->t)); break;
+	case txMULF: fprintf(out, "\t%s = as_int(as_flt(%s) * as_flt(%s));\n", R(x->r), R(x->s), R(x->t)); break;
+	case txDIVF:
+		fprintf(out, "\tif (as_flt(%s) == 0) FAIL(%d, srZERODIVIDE);\n", R(x->t), x->loc);
+		fprintf(out, "\t%s = as_int(as_flt(%s) / as_flt(%s));\n", R(x->r), R(x->s), R(x->t));
+		break;
+	case txMODF:
+		fprintf(out, "\tif ((int)as_flt(%s) == 0) FAIL(%d, srZERODIVIDE);\n", R(x->t), x->loc);
+		fprintf(out, "\t%s = TM_MOD((int)as_flt(%s), (int)as_flt(%s));\n", R(x->r), R(x->s), R(x->t));
+		break;
+
+	case txJMP: fprintf(out, "\tJUMP(%d, %d);\n", d, prog[d].loc); break;
+	case txJMPD: fprintf(out, "\tJUMP_ADDR(%d);\n", d); break;
+
+	case txLD:
+		fprintf(out, "\tm = %d + %s; CHECK_MEM(m, %d);\n", d, R(x->s), x->loc);
+		fprintf(out, "\t%s = dMem[m];\n", R(x->r));
+		break;
+	case txST:
+		fprintf(out, "\tm = %d + %s; CHECK_MEM(m, %d);\n", d, R(x->s), x->loc);
+		fprintf(out, "\tdMem[m] = %s; DIRTY(m);\n", R(x->r));
+		break;
+	case txPUSH:
+		fprintf(out, "\tm = %d + %s; CHECK_MEM(m, %d);\n", d, R(x->s), x->loc);
+		fprintf(out, "\tdMem[m] = %s; DIRTY(m); %s--;\n", R(x->r), R(x->s));
+		break;
+	case txPOP:
+		fprintf(out, "\tm = %d + %s; CHECK_MEM(m, %d); CHECK_MEM(m + 1, %d);\n", d, R(x->s), x->loc, x->loc);
+		fprintf(out, "\t%s = dMem[m + 1]; %s++;\n", R(x->r), R(x->s));
+		break;
+	case txLDPC:
+		fprintf(out, "\tm = %d + %s; CHECK_MEM(m, %d);\n", d, R(x->s), x->loc);
+		fprintf(out, "\tJUMP_ADDR(dMem[m]);\n");
+		break;
+	case txPOPPC:
+		fprintf(out, "\tm = %d + %s; CHECK_MEM(m, %d); CHECK_MEM(m + 1, %d);\n", d, R(x->s), x->loc, x->loc);
+		fprintf(out, "\t%s++; JUMP_ADDR(dMem[m + 1]);\n", R(x->s));
+		break;
+
+	case txLDA: fprintf(out, "\t%s = %d + %s;\n", R(x->r), d, R(x->s)); break;
+	case txLDC: fprintf(out, "\t%s = %d;\n", R(x->r), d); break;
+	case txLDAPC: fprintf(out, "\tJUMP_ADDR(%d + %s);\n", d, R(x->s)); break;
+
+	case txJLT: fprintf(out, "\tif (%s < 0) JUMP(%d, %d);\n", R(x->r), d, prog[d].loc); break;
+	case txJLE: fprintf(out, "\tif (%s <= 0) JUMP(%d, %d);\n", R(x->r), d, prog[d].loc); break;
+	case txJGT: fprintf(out, "\tif (%s > 0) JUMP(%d, %d);\n", R(x->r), d, prog[d].loc); break;
+	case txJGE: fprintf(out, "\tif (%s >= 0) JUMP(%d, %d);\n", R(x->r), d, prog[d].loc); break;
+	case txJEQ: fprintf(out, "\tif (%s == 0) JUMP(%d, %d);\n", R(x->r), d, prog[d].loc); break;
+	case txJNE: fprintf(out, "\tif (%s != 0) JUMP(%d, %d);\n", R(x->r), d, prog[d].loc); break;
+	case txJLTF: fprintf(out, "\tif (as_flt(%s) < 0) JUMP(%d, %d);\n", R(x->r), d, prog[d].loc); break;
+	case txJLEF: fprintf(out, "\tif (as_flt(%s) <= 0) JUMP(%d, %d);\n", R(x->r), d, prog[d].loc); break;
+	case txJGTF: fprintf(out, "\tif (as_flt(%s) > 0) JUMP(%d, %d);\n", R(x->r), d, prog[d].loc); break;
+	case txJGEF: fprintf(out, "\tif (as_flt(%s) >= 0) JUMP(%d, %d);\n", R(x->r), d, prog[d].loc); break;
+	case txJEQF: fprintf(out, "\tif (as_flt(%s) == 0) JUMP(%d, %d);\n", R(x->r), d, prog[d].loc); break;
+	case txJNEF: fprintf(out, "\tif (as_flt(%s) != 0) JUMP(%d, %d);\n", R(x->r), d, prog[d].loc); break;
+	case txJIDX: fprintf(out, "\tJUMP_ADDR(%d + %s);\n", d, R(x->r)); break;
+	case txRETURN:
+		fprintf(out, "\tm = %d + %s; CHECK_MEM(m, %d);\n", d, R(x->s), x->loc);
+		fprintf(out, "\tJUMP_ADDR(dMem[m]);\n");
+		break;
+
+	case txMEMCPY:
+	case txMEMMOVE:
+		fprintf(out, "\tCHECK_BLOCK(%s, %d, %d); CHECK_BLOCK(%s, %d, %d);\n",
+			R(x->r), d, x->loc, R(x->s), d, x->loc);
+		fprintf(out, "\t%s(dMem + %s, dMem + %s, %d * sizeof(int)); DIRTY_BLOCK(%s, %d);\n",
+			x->op == txMEMCPY ? "memcpy" : "memmove", R(x->r), R(x->s), d, R(x->r), d);
+		break;
+	case txMEMSET:
+		fprintf(out, "\tCHECK_BLOCK(%s, %d, %d);\n", R(x->r), d, x->loc);
+		fprintf(out, "\tfor (m = 0; m < %d; m++) dMem[%s + m] = %s;\n", d, R(x->r), R(x->s));
+		fprintf(out, "\tDIRTY_BLOCK(%s, %d);\n", R(x->r), d);
+		break;
+	default:
+		fprintf(out, "\tGENERIC(%d);\n", x->loc);
+		break;
+	}
+}
+
+/* the fixed part of the file, the macros used by the instructions */
+static void writePrologue(FILE * out, char * name)
+{
+	int r;
+	fprintf(out, "/* %s: translated from a TM program by tm2c, do not edit */\n", name);
+	fprintf(out, "#include \"tm.h\"\n\n");
+	fprintf(out, "typedef union { int i; float f; } TMWORD;\n");
+	fprintf(out, "static inline float as_flt(int x){ TMWORD w; w.i = x; return w.f; }\n");
+	fprintf(out, "static inline int as_int(float x){ TMWORD w; w.f = x; return w.i; }\n\n");
+
+	fprintf(out, "#define SAVE() do {");
+	for (r = 0; r < NO_REGS; r++)
+		if (r != PC_REG) fprintf(out, " reg[%d] = r%d;", r, r);
+	fprintf(out, " } while (0)\n#define LOAD() do {");
+	for (r = 0; r < NO_REGS; r++)
+		if (r != PC_REG) fprintf(out, " r%d = reg[%d];", r, r);
+	fprintf(out, " } while (0)\n");
+	fprintf(out,
+		"#define FINISH(pc, res) do { reg[PC_REG] = (pc); result = (res); goto done; } while (0)\n"
+		"#define FAIL(loc, res) FINISH((loc) + 1, res)\n"
+		"#define CHECK_MEM(m, loc) do { if ((m) < 0 || (m) >= DADDR_SIZE) FAIL(loc, srDMEM_ERR); } while (0)\n"
+		"#define CHECK_BLOCK(a, n, loc) do { if ((a) < 0 || (a) > DADDR_SIZE - (n)) FAIL(loc, srDMEM_ERR); } while (0)\n"
+		"#define DIRTY(m) (dirty[(m) >> TM_PAGE_SHIFT] = 1)\n"
+		"#define DIRTY_BLOCK(a, n) do { for (m = (a) >> TM_PAGE_SHIFT; m <= ((a) + (n) - 1) >> TM_PAGE_SHIFT; m++) dirty[m] = 1; } while (0)\n"
+		"/* the budget is checked at the jumps, as in runTM */\n"
+		"#define JUMP(i, loc) do { if (steps >= limit) FINISH(loc, srBUDGET); goto L##i; } while (0)\n"
+		"#define JUMP_ADDR(a) do { target = (a); goto dispatch; } while (0)\n"
+		"#define GENERIC(loc) do { SAVE(); reg[PC_REG] = (loc); result = stepTM(tm); LOAD(); \\\n"
+		"\t\tif (result != srOKAY) goto done; \\\n"
+		"\t\tJUMP_ADDR(reg[PC_REG]); } while (0)\n\n");
+}
+
+/* the code and the constant pool, stepTM and the engine
+ * of the fallback read the code from iMem
+ */
+static void writeImage(FILE * out, TMContext * tm, char * name)
+{
+	TMOBJTAB * o = &tm->obj;
+	int i;
+	fprintf(out, "static INSTRUCTION tmCode[%d] = {\n", tm->iMemSize + 1);
+	for (i = 0; i < tm->iMemSize; i++)
+	{
+		INSTRUCTION * in = &tm->iMem[i];
+		fprintf(out, "\t{ %d, %d, %d, %d },%s", in->iop, in->iarg1, in->iarg2, in->iarg3,
+			i % 4 == 3 ? "\n" : "");
+	}
+	fprintf(out, "\t{ opHALT, 0, 0, 0 }\n};\n\n");
+	fprintf(out, "static const int tmData[%d] = {", o->dataSize + 1);
+	for (i = 0; i < o->dataSize; i++)
+		fprintf(out, "%s%d,", i % 16 == 0 ? "\n\t" : " ", o->dataPool[i]);
+	fprintf(out, "\n\t0\n};\n\n");
+
+	fprintf(out, "void %s_load(TMContext * tm)\n{\n", name);
+	fprintf(out, "\tint i = 0;\n");
+	fprintf(out, "\ttm->iMem = tmCode;\n\ttm->iMemSize = %d;\n\tresetMachine(tm);\n", tm->iMemSize);
+	fprintf(out, "\twhile (i < %d)\n\t{\n", o->dataSize);
+	fprintf(out, "\t\tmemcpy(tm->dMem + tmData[i], tmData + i + 2, tmData[i + 1] * sizeof(int));\n");
+	fprintf(out, "\t\ti += tmData[i + 1] + 2;\n\t}\n}\n\n");
+}
+
+static void writeMain(FILE * out, char * name)
+{
+	fprintf(out, "#ifdef TM_NATIVE_MAIN\n");
+	fprintf(out, "FILE * listing;\n\n");
+	fprintf(out, "int main(void)\n{\n");
+	fprintf(out, "\tint steps = 0;\n\tSTEPRESULT result;\n");
+	fprintf(out, "\tTMContext * tm = tm_create();\n");
+	fprintf(out, "\tif (tm == NULL) return 1;\n");
+	fprintf(out, "\tlisting = stdout;\n");
+	fprintf(out, "\t%s_load(tm);\n", name);
+	fprintf(out, "\tresult = %s(tm, &steps);\n", name);
+	fprintf(out, "\tfprintf(stderr, \"%%s, %%d instructions\\n\", stepResultTab[result], steps);\n");
+	fprintf(out, "\ttm_destroy(tm);\n");
+	fprintf(out, "\treturn result == srHALT ? 0 : 1;\n}\n#endif\n");
+}
+
+/********************************************/
+int translateProgram(TMContext * tm, FILE * out, char * name)
+{
+	int top = tm->iMemSize;
+	int n = decodeProgram(tm);
+	TXINSTR * prog = tm->code;
+	char * target = (char *)malloc(top + 1);
+	char * label = (char *)calloc(n + 1, 1);
+	int i, r, loc;
+
+	findTargets(prog, n, top, target);
+	for (loc = 0; loc < top; loc++)
+		if (target[loc]) label[tm->addrMap[loc]] = TRUE;
+	for (i = 0; i < n; i++)
+	{
+		int op = prog[i].op;
+		if (op == txJMP || (op >= txJLT && op <= txJNEF)) label[prog[i].d] = TRUE;
+	}
+
+	writePrologue(out, name);
+	writeImage(out, tm, name);
+
+	fprintf(out, "STEPRESULT %s(TMContext * tm, int * stepcnt)\n{\n", name);
+	fprintf(out, "\tint * const reg = tm->reg;\n");
+	fprintf(out, "\tint * const dMem = tm->dMem;\n");
+	fprintf(out, "\tunsigned char * const dirty = tm->dirty;\n");
+	fprintf(out, "\tint limit = tm->budget > 0 ? tm->budget : 0x7fffffff;\n");
+	fprintf(out, "\tint steps = 0, target = reg[PC_REG], m, budget;\n");
+	fprintf(out, "\tSTEPRESULT result;\n\tint");
+	for (r = 0; r < NO_REGS; r++)
+		if (r != PC_REG) fprintf(out, " r%d%s", r, r == NO_REGS - 1 ? ";\n" : ",");
+	fprintf(out, "\tLOAD();\n\tgoto dispatch;\n\n");
+
+	for (i = 0; i <= n; i++)
+	{
+		TXINSTR * x = &prog[i];
+		INSTRUCTION * in = x->loc < top ? &tm->iMem[x->loc] : NULL;
+		if (label[i]) fprintf(out, "L%d:\n", i);
+		if (in != NULL)
+			fprintf(out, "\t/* %d: %s %d,%d,%d */\n", x->loc, opCodeTab[in->iop].name, in->iarg1, in->iarg2, in->iarg3);
+		fprintf(out, "\tsteps++;\n");
+		writeOp(out, x, prog);
+	}
+
+	/* a jump whose target is only known at run time */
+	fprintf(out, "\ndispatch:\n");
+	fprintf(out, "\tif (target < 0 || target > IADDR_SIZE) { steps++; FINISH(target, srIMEM_ERR); }\n");
+	fprintf(out, "\tif (target >= %d) { steps++; FINISH(target + 1, srHALT); }\n", top);
+	fprintf(out, "\tif (steps >= limit) FINISH(target, srBUDGET);\n");
+	fprintf(out, "\tswitch (target)\n\t{\n");
+	for (loc = 0; loc < top; loc++)
+		if (target[loc]) fprintf(out, "\tcase %d: goto L%d;\n", loc, tm->addrMap[loc]);
+	fprintf(out, "\tdefault: break;\n\t}\n");
+	/* an adress the translation did not expect, the engine goes on from there */
+	fprintf(out, "\tSAVE();\n\treg[PC_REG] = target;\n");
+	fprintf(out, "\tbudget = tm->budget;\n");
+	fprintf(out, "\tif (budget > 0) tm->budget = budget - steps;\n");
+	fprintf(out, "\tresult = runTM(tm, &steps);\n");
+	fprintf(out, "\ttm->budget = budget;\n");
+	fprintf(out, "\t*stepcnt += steps;\n\treturn result;\n\n");
+	fprintf(out, "done:\n\tSAVE();\n\t*stepcnt += steps;\n\treturn result;\n}\n\n");
+
+	writeMain(out, name);
+	free(target);
+	free(label);
+	return TRUE;
+} /* translateProgram */
+
+int tm2c(char * program, char * cFile)
+{
+	char name[64];
+	int ok;
+	FILE * out;
+	TMContext * tm = tm_create();
+	if (tm == NULL) return FALSE;
+	if (!tm_loadFile(tm, program))
+	{
+		tm_destroy(tm);
+		return FALSE;
+	}
+	out = fopen(cFile, "w");
+	if (out == NULL)
+	{
+		printf("can not write %s\n", cFile);
+		tm_destroy(tm);
+		return FALSE;
+	}
+	strcpy(name, "tm_");
+	baseName(cFile, name + 3, sizeof(name) - 3);
+	ok = translateProgram(tm, out, name);
+	fclose(out);
+	tm_destroy(tm);
+	return ok;
+} /* tm2c */
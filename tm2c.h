@@ -0,0 +1,26 @@
+#ifndef TM2C_HEAD
+#define TM2C_HEAD
+/****************************************************/
+/* File: tm2c.h                                     */
+/* ahead of time translation of a TM program into C */
+/****************************************************/
+#include "tm.h"
+
+/* write the program loaded in tm as C source to out, it defines
+ *
+ *   void NAME_load(TMContext * tm)       the code and the constant pool
+ *   STEPRESULT NAME(TMContext * tm, int * stepcnt)
+ *                                        runs like tm_run without tracing
+ *
+ * and a main running the program with OUT on stdout when compiled
+ * with -DTM_NATIVE_MAIN. The file is built with the system compiler
+ * against tm.c tmexec.c tmjit.c tmobj.c tmprof.c vmmemory.c vmgc.c
+ */
+int translateProgram(TMContext * tm, FILE * out, char * name);
+
+/* translate a .tm text or a .tmo object into the C file cFile,
+ * the functions are named after cFile
+ */
+int tm2c(char * program, char * cFile);
+
+#endif
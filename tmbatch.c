@@ -0,0 +1,287 @@
+/****************************************************/
+/* File: tmbatch.c                                  */
+/* batch runner of the TM: the jobs are dealt to a  */
+/* queue per machine, a machine takes its own jobs  */
+/* from the back and steals from the front of the   */
+/* other queues, so the cores stay busy when the    */
+/* jobs differ in length                            */
+/****************************************************/
+
+#include "tmbatch.h"
+#include <time.h>
+
+/* windows builds run the jobs on the calling thread */
+#ifdef _WIN32
+#define TMBATCH_NO_THREADS 1
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+typedef struct {
+	int * jobs;      /* indices into the job array */
+	int head, tail;  /* the owner takes at tail, thieves at head */
+#ifndef TMBATCH_NO_THREADS
+	pthread_mutex_t lock;
+#endif
+} JOBQUEUE;
+
+typedef struct {
+	TMJOB * jobs;
+	JOBQUEUE * queues;
+	int nqueues;
+	int id;
+	TMContext * tm;
+	char * loaded;   /* the program in tm, its snapshot is taken after loading */
+} WORKER;
+
+static int takeJob(JOBQUEUE * q, int owner)
+{
+	int j = -1;
+#ifndef TMBATCH_NO_THREADS
+	pthread_mutex_lock(&q->lock);
+#endif
+	if (q->head < q->tail)
+		j = owner ? q->jobs[--q->tail] : q->jobs[q->head++];
+#ifndef TMBATCH_NO_THREADS
+	pthread_mutex_unlock(&q->lock);
+#endif
+	return j;
+}
+
+/* the next job of worker w, -1 when every queue is empty */
+static int nextJob(WORKER * w)
+{
+	int i, j = takeJob(&w->queues[w->id], TRUE);
+	for (i = 1; j == -1 && i < w->nqueues; i++)
+		j = takeJob(&w->queues[(w->id + i) % w->nqueues], FALSE);
+	return j;
+}
+
+/********************************************/
+/* what OUT printed into the temporary file */
+static void takeOutput(TMJOB * job, FILE * out)
+{
+	long n;
+	fflush(out);
+	n = ftell(out);
+	job->output = (char *)malloc(n + 1);
+	rewind(out);
+	job->outLen = (long)fread(job->output, 1, n, out);
+	job->output[job->outLen] = '\0';
+}
+
+/* a program run again on the same machine is not loaded
+ * again, the machine goes back to its snapshot
+ */
+static int prepare(WORKER * w, char * program)
+{
+	if (w->loaded != NULL && strcmp(w->loaded, program) == 0)
+		return tm_restore(w->tm);
+	w->loaded = NULL;
+	if (!tm_loadFile(w->tm, program)) return FALSE;
+	tm_snapshot(w->tm);
+	w->loaded = program;
+	return TRUE;
+}
+
+static void runJob(WORKER * w, TMJOB * job)
+{
+	TMContext * tm = w->tm;
+	FILE * in = NULL;
+	FILE * out = tmpfile();
+	job->result = -1;
+	job->steps = 0;
+	if (out == NULL) return;
+	/* a job without input reads an empty stream, IN on a worker
+	 * must never fall back to the prompt on the runner's stdin
+	 */
+	if (job->input == NULL) in = tmpfile();
+	else in = fopen(job->input, "r");
+	if (in == NULL)
+		fprintf(out, "can not open input %s\n", job->input != NULL ? job->input : "-");
+	else if (prepare(w, job->program))
+	{
+		tm->in = in;
+		tm->out = out;
+		tm->budget = job->budget;
+		job->result = tm_run(tm, &job->steps);
+		tm->in = tm->out = NULL;
+	}
+	else fprintf(out, "can not load %s\n", job->program);
+	if (in != NULL) fclose(in);
+	takeOutput(job, out);
+	fclose(out);
+}
+
+static void * work(void * arg)
+{
+	WORKER * w = (WORKER *)arg;
+	int j;
+	w->tm = tm_create();
+	if (w->tm == NULL) return NULL;
+	while ((j = nextJob(w)) != -1)
+		runJob(w, &w->jobs[j]);
+	tm_destroy(w->tm);
+	return NULL;
+}
+
+/********************************************/
+void runJobs(TMJOB * jobs, int njobs, int nthreads)
+{
+	JOBQUEUE * queues;
+	WORKER * workers;
+	int i;
+
+	if (njobs <= 0) return;
+#ifdef TMBATCH_NO_THREADS
+	nthreads = 1;
+#else
+	if (nthreads <= 0) nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (nthreads > njobs) nthreads = njobs;
+	if (nthreads < 1) nthreads = 1;
+
+	queues = (JOBQUEUE *)calloc(nthreads, sizeof(JOBQUEUE));
+	workers = (WORKER *)calloc(nthreads, sizeof(WORKER));
+	for (i = 0; i < nthreads; i++)
+	{
+		queues[i].jobs = (int *)malloc((njobs / nthreads + 1) * sizeof(int));
+#ifndef TMBATCH_NO_THREADS
+		pthread_mutex_init(&queues[i].lock, NULL);
+#endif
+		workers[i].jobs = jobs;
+		workers[i].queues = queues;
+		workers[i].nqueues = nthreads;
+		workers[i].id = i;
+	}
+	/* dealt round robin backwards, an owner starts with its first job
+	 * and the thieves take the last ones
+	 */
+	for (i = njobs - 1; i >= 0; i--)
+	{
+		JOBQUEUE * q = &queues[i % nthreads];
+		q->jobs[q->tail++] = i;
+	}
+
+#ifdef TMBATCH_NO_THREADS
+	work(&workers[0]);
+#else
+	{
+		pthread_t * threads = (pthread_t *)malloc(nthreads * sizeof(pthread_t));
+		for (i = 1; i < nthreads; i++)
+			pthread_create(&threads[i], NULL, work, &workers[i]);
+		work(&workers[0]);
+		for (i = 1; i < nthreads; i++)
+			pthread_join(threads[i], NULL);
+		free(threads);
+	}
+#endif
+
+	for (i = 0; i < nthreads; i++)
+	{
+#ifndef TMBATCH_NO_THREADS
+		pthread_mutex_destroy(&queues[i].lock);
+#endif
+		free(queues[i].jobs);
+	}
+	free(queues);
+	free(workers);
+} /* runJobs */
+
+/********************************************/
+static double wallTime(void)
+{
+#ifdef TMBATCH_NO_THREADS
+	return (double)clock() / CLOCKS_PER_SEC;
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+#endif
+}
+
+static char * copyWord(char * s, int n)
+{
+	char * w = (char *)malloc(n + 1);
+	memcpy(w, s, n);
+	w[n] = '\0';
+	return w;
+}
+
+/* the jobs of the file, NULL if it can not be read */
+static TMJOB * readJobs(char * jobFile, int budget, int * njobs)
+{
+	char line[512];
+	TMJOB * jobs = NULL;
+	int cap = 0;
+	FILE * f = fopen(jobFile, "r");
+	if (f == NULL) return NULL;
+	*njobs = 0;
+	while (fgets(line, sizeof(line), f) != NULL)
+	{
+		char * field[3];
+		int len[3], n = 0;
+		char * p = line;
+		while (n < 3)
+		{
+			while (*p == ' ' || *p == '\t') p++;
+			if (*p == '\0' || *p == '\n' || *p == '\r' || *p == '#') break;
+			field[n] = p;
+			while (*p != '\0' && !isspace((unsigned char)*p)) p++;
+			len[n] = (int)(p - field[n]);
+			n++;
+		}
+		if (n == 0) continue;
+		if (*njobs == cap)
+		{
+			cap = cap == 0 ? 64 : cap * 2;
+			jobs = (TMJOB *)realloc(jobs, cap * sizeof(TMJOB));
+		}
+		memset(&jobs[*njobs], 0, sizeof(TMJOB));
+		jobs[*njobs].program = copyWord(field[0], len[0]);
+		if (n > 1 && !(len[1] == 1 && field[1][0] == '-'))
+			jobs[*njobs].input = copyWord(field[1], len[1]);
+		jobs[*njobs].budget = n > 2 ? atoi(field[2]) : budget;
+		(*njobs)++;
+	}
+	fclose(f);
+	if (jobs == NULL) jobs = (TMJOB *)malloc(sizeof(TMJOB));
+	return jobs;
+}
+
+int runBatch(char * jobFile, int nthreads, int budget, FILE * out)
+{
+	int njobs = 0, failed = 0, i;
+	long long steps = 0;
+	double start, seconds;
+	TMJOB * jobs = readJobs(jobFile, budget, &njobs);
+	if (jobs == NULL)
+	{
+		fprintf(out, "can not open %s\n", jobFile);
+		return 1;
+	}
+
+	start = wallTime();
+	runJobs(jobs, njobs, nthreads);
+	seconds = wallTime() - start;
+
+	for (i = 0; i < njobs; i++)
+	{
+		TMJOB * job = &jobs[i];
+		fprintf(out, "job %d: %s", i, job->program);
+		if (job->input != NULL) fprintf(out, " < %s", job->input);
+		fprintf(out, "\n  result: %s\n  instructions: %d\n  output:\n",
+			job->result < 0 ? "Not Started" : stepResultTab[job->result], job->steps);
+		if (job->output != NULL) fwrite(job->output, 1, job->outLen, out);
+		if (job->result != srHALT) failed++;
+		steps += job->steps;
+		free(job->program);
+		free(job->input);
+		free(job->output);
+	}
+	fprintf(out, "%d jobs, %d failed, %lld instructions in %.3f s (%.1f M instructions/s)\n",
+		njobs, failed, steps, seconds, seconds > 0 ? steps / seconds / 1e6 : 0.0);
+	free(jobs);
+	return failed;
+} /* runBatch */
@@ -0,0 +1,35 @@
+#ifndef TMBATCH_HEAD
+#define TMBATCH_HEAD
+/****************************************************/
+/* File: tmbatch.h                                  */
+/* runs many TM programs on a pool of machines,     */
+/* one thread and one TMContext per machine         */
+/****************************************************/
+#include "tm.h"
+
+typedef struct {
+	char * program;  /* a .tmo object or a .tm text */
+	char * input;    /* the lines read by IN, NULL for none (IN finds the end of input) */
+	int budget;      /* instructions, 0 is no limit */
+
+	/* filled by the run */
+	int result;      /* STEPRESULT, -1 when the job could not start */
+	int steps;       /* instructions executed */
+	char * output;   /* what OUT printed, malloced */
+	long outLen;
+} TMJOB;
+
+/* run the jobs on nthreads machines (the number of cores
+ * when nthreads <= 0), every machine starts with a share of
+ * the jobs and steals from the others when it runs dry
+ */
+void runJobs(TMJOB * jobs, int njobs, int nthreads);
+
+/* run the jobs of jobFile and write the report to out, a line
+ * of the file is "program [input|-] [budget]", '#' starts a
+ * comment, budget is the default of the lines without one.
+ * returns the number of jobs that did not halt
+ */
+int runBatch(char * jobFile, int nthreads, int budget, FILE * out);
+
+#endif
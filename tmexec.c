@@ -0,0 +1,557 @@
+/****************************************************/
+/* File: tmexec.c                                   */
+/* direct-threaded execution engine for the TM      */
+/* iMem is pre-decoded into an array of handlers    */
+/* whose operands are already resolved, the engine  */
+/* then runs until HALT without calling stepTM.     */
+/* LABEL pseudo ops are dropped from the stream, so */
+/* jump targets go through addrMap                  */
+/****************************************************/
+
+#include "tmexec.h"
+#include "tmjit.h"
+#include "code.h"
+#include <limits.h>
+
+typedef union {
+	int i;
+	float f;
+} TMWORD;
+
+static float as_flt(int x){ TMWORD w; w.i = x; return w.f; }
+static int as_int(float x){ TMWORD w; w.f = x; return w.i; }
+
+/********************************************/
+/* a static jump target is usable only when it lands
+ * in the decoded area, otherwise the jump goes through
+ * the dynamic dispatch which handles the bounds
+ */
+static int static_target(int target, int top)
+{
+	return target >= 0 && target < top;
+}
+
+static int is_static_jump(int op)
+{
+	return op == txJMP || (op >= txJLT && op <= txJNEF);
+}
+
+/* the handler of a typed register op */
+static int typed_op(int op)
+{
+	switch (op)
+	{
+	case opCVTIF: return txMOVIF;
+	case opCVTFI: return txMOVFI;
+	case opNEG: return txNEGI;
+	case opNEGF: return txNEGF;
+	case opADD: return txADDI;
+	case opSUB: return txSUBI;
+	case opMUL: return txMULI;
+	case opDIV: return txDIVI;
+	case opMOD: return txMODI;
+	case opADDF: return txADDF;
+	case opSUBF: return txSUBF;
+	case opMULF: return txMULF;
+	case opDIVF: return txDIVF;
+	default: return txMODF;
+	}
+}
+
+/********************************************/
+/* decode one instruction, anything unusual (io, system
+ * calls, pc used as an operand) is left to stepTM
+ */
+static void decode(TMContext * tm, TXINSTR * x, int loc, int top)
+{
+	INSTRUCTION * in = &tm->iMem[loc];
+	int r = in->iarg1, s = in->iarg2, t = in->iarg3;
+
+	x->op = txGENERIC;
+	x->loc = loc;
+	x->r = r;
+	x->s = s;
+	x->t = t;
+	x->d = 0;
+
+	switch (in->iop)
+	{
+	case opHALT: x->op = txHALT; break;
+	case opLAEBL: x->op = txNOP; break;
+	case opGO:
+		x->d = tm->labelLocMap[r];
+		x->op = static_target(x->d, top) ? txJMP : txJMPD;
+		break;
+	case opMOV:
+		if (r != PC_REG && s != PC_REG) x->op = txMOVE;
+		break;
+	case opCVTIF:
+	case opCVTFI:
+	case opNEG:
+	case opNEGF:
+	case opADD:
+	case opSUB:
+	case opMUL:
+	case opDIV:
+	case opMOD:
+	case opADDF:
+	case opSUBF:
+	case opMULF:
+	case opDIVF:
+	case opMODF:
+		/* a result in pc is a jump, left to stepTM */
+		if (r != PC_REG) x->op = typed_op(in->iop);
+		break;
+
+	/* RM and RA: r, d(s) */
+	case opLD:
+	case opST:
+	case opPUSH:
+	case opPOP:
+	case opLDA:
+	case opLDC:
+	case opJLT:
+	case opJLE:
+	case opJGT:
+	case opJGE:
+	case opJEQ:
+	case opJNE:
+	case opJLTF:
+	case opJLEF:
+	case opJGTF:
+	case opJGEF:
+	case opJEQF:
+	case opJNEF:
+	case opJIDX:
+	case opRETURN:
+		x->s = t;
+		x->d = s;
+		if (in->iop == opLDC)
+		{
+			x->op = (r == PC_REG) ? (static_target(s, top) ? txJMP : txJMPD) : txLDC;
+			break;
+		}
+		if (t == PC_REG)
+		{
+			/* pc relative: reg[pc] is already loc + 1 */
+			x->d = s + loc + 1;
+			if (in->iop == opLDA)
+				x->op = (r == PC_REG) ? (static_target(x->d, top) ? txJMP : txJMPD) : txLDC;
+			else if (in->iop >= opJLT && in->iop <= opJNEF && r != PC_REG && static_target(x->d, top))
+				x->op = txJLT + (in->iop - opJLT);
+			else if (in->iop == opJIDX && r != PC_REG)
+				x->op = txJIDX;
+			break;
+		}
+		if (in->iop >= opJLT && in->iop <= opJIDX) break;
+		if (r == PC_REG)
+		{
+			if (in->iop == opLD) x->op = txLDPC;
+			else if (in->iop == opPOP && t != PC_REG) x->op = txPOPPC;
+			else if (in->iop == opLDA) x->op = txLDAPC;
+			break;
+		}
+		switch (in->iop)
+		{
+		case opLD: x->op = txLD; break;
+		case opST: x->op = txST; break;
+		case opPUSH: x->op = txPUSH; break;
+		case opPOP: x->op = txPOP; break;
+		case opLDA: x->op = txLDA; break;
+		case opRETURN: x->op = txRETURN; break;
+		}
+		break;
+
+	/* SYS block ops: r, d(s) with d the number of words */
+	case opMEMCPY:
+	case opMEMSET:
+	case opMEMMOVE:
+		if (r == PC_REG || t == PC_REG || s < 0) break;
+		x->s = t;
+		x->d = s;
+		x->op = in->iop == opMEMCPY ? txMEMCPY : (in->iop == opMEMSET ? txMEMSET : txMEMMOVE);
+		break;
+	default:
+		break;
+	}
+}
+
+/********************************************/
+int decodeProgram(TMContext * tm)
+{
+	int top = tm->iMemSize;
+	int loc, n = 0;
+	TXINSTR * prog;
+	if (top + 1 > tm->codeCap)
+	{
+		tm->codeCap = top + 1;
+		tm->code = (TXINSTR *)realloc(tm->code, tm->codeCap * sizeof(TXINSTR));
+		tm->addrMap = (int *)realloc(tm->addrMap, tm->codeCap * sizeof(int));
+	}
+	prog = tm->code;
+	for (loc = 0; loc < top; loc++)
+	{
+		/* a label maps to the instruction that follows it */
+		tm->addrMap[loc] = n;
+		if (tm->iMem[loc].iop != opLAEBL)
+			decode(tm, &prog[n++], loc, top);
+	}
+	/* falling off the loaded code runs into HALT */
+	tm->addrMap[top] = n;
+	prog[n].op = txHALT;
+	prog[n].loc = top;
+	for (loc = 0; loc <= n; loc++)
+	{
+		if (is_static_jump(prog[loc].op))
+			prog[loc].d = tm->addrMap[prog[loc].d];
+		prog[loc].fused = prog[loc].op;
+	}
+	return n;
+} /* decodeProgram */
+
+/* an instruction followed by the second of a pair starts the
+ * superinstruction. The next one stays as it is, a jump into
+ * the middle of a pair runs it alone
+ */
+static void fuseProgram(TXINSTR * prog, int n)
+{
+#define TX_SUPER_ROW(name, first, second) { tx##first, tx##second, tx##name },
+	static const int pairs[][3] = { TX_SUPERS(TX_SUPER_ROW) };
+	int i, k;
+	for (i = 0; i + 1 < n; i++)
+	{
+		for (k = 0; k < (int)(sizeof(pairs) / sizeof(pairs[0])); k++)
+		{
+			if (prog[i].op == pairs[k][0] && prog[i + 1].op == pairs[k][1])
+			{
+				prog[i].fused = pairs[k][2];
+				break;
+			}
+		}
+	}
+#undef TX_SUPER_ROW
+}
+
+/********************************************/
+STEPRESULT runTM(TMContext * tm, int * stepcnt)
+{
+#ifdef TM_THREADED
+#define TX_LABEL(name) &&L_##name,
+#define TX_SUPER_LABEL(name, first, second) &&L_##name,
+	static const void * const handlers[] = { TX_HANDLERS(TX_LABEL) TX_SUPERS(TX_SUPER_LABEL) };
+#define HANDLER(name) L_##name
+#define DISPATCH() do { steps++; goto *ip->handler; } while (0)
+#define EXECUTE() goto *handlers[ip->fused]
+/* the second half of a superinstruction, its handler is known */
+#define SECOND(name) do { ip++; steps++; goto L_##name; } while (0)
+#define BIND_HANDLERS() do { int i; for (i = 0; i <= n; i++) \
+	prog[i].handler = profiling ? &&L_PROFILE : HOOKED(i) ? &&jit_enter : handlers[prog[i].fused]; } while (0)
+#else
+#define HANDLER(name) case tx##name
+#define DISPATCH() do { steps++; goto dispatch; } while (0)
+#define EXECUTE() goto execute
+#define SECOND(name) do { ip++; steps++; goto execute; } while (0)
+#define BIND_HANDLERS() do { } while (0)
+#endif
+#define NEXT() do { ip++; DISPATCH(); } while (0)
+/* the instruction goes through the JIT first */
+#define HOOKED(i) (jit != NULL && (jit->native[i] != NULL || jit->hits[i] >= 0))
+#define JUMP(a) do { ip = prog + (a); if (steps >= limit) goto budget; DISPATCH(); } while (0)
+#define JUMP_ADDR(a) do { target = (a); goto dynamic; } while (0)
+#define FAIL(res) do { reg[PC_REG] = ip->loc + 1; result = (res); goto done; } while (0)
+#define CHECK_MEM(m) do { if ((m) < 0 || (m) >= DADDR_SIZE) FAIL(srDMEM_ERR); } while (0)
+#define CHECK_BLOCK(a, n) do { if ((a) < 0 || (a) > DADDR_SIZE - (n)) FAIL(srDMEM_ERR); } while (0)
+#define DIRTY_BLOCK(a, n) do { for (m = (a) >> TM_PAGE_SHIFT; m <= ((a) + (n) - 1) >> TM_PAGE_SHIFT; m++) dirty[m] = 1; } while (0)
+/* the bodies of the handlers that start a superinstruction */
+#define DO_LD() do { m = ip->d + reg[ip->s]; CHECK_MEM(m); reg[ip->r] = dMem[m]; } while (0)
+#define DO_ST() do { m = ip->d + reg[ip->s]; CHECK_MEM(m); dMem[m] = reg[ip->r]; \
+	dirty[m >> TM_PAGE_SHIFT] = 1; } while (0)
+#define DO_PUSH() do { DO_ST(); reg[ip->s]--; } while (0)
+#define DO_POP() do { m = ip->d + reg[ip->s]; CHECK_MEM(m); CHECK_MEM(m + 1); reg[ip->r] = dMem[m + 1]; \
+	reg[ip->s]++; } while (0)
+#define DO_LDA() (reg[ip->r] = ip->d + reg[ip->s])
+#define DO_LDC() (reg[ip->r] = ip->d)
+#define TX_SUPER_HANDLER(name, first, second) HANDLER(name): DO_##first(); SECOND(second);
+
+	/* the registers and the memory of the machine */
+	int * const reg = tm->reg;
+	int * const dMem = tm->dMem;
+	unsigned char * const dirty = tm->dirty;
+	int * addr_map;
+	TXINSTR * prog;
+	TXINSTR * ip;
+	STEPRESULT result;
+	int top = tm->iMemSize;
+	int steps = 0;
+	int limit = tm->budget > 0 ? tm->budget : INT_MAX;
+	/* the profile goes through a handler of its own, a run
+	 * without it dispatches exactly as before
+	 */
+	const int profiling = tm->profileflag && tm->prof != NULL;
+	TMJIT * jit = NULL;
+	int target, m, loc, n;
+
+	n = decodeProgram(tm);
+	prog = tm->code;
+	addr_map = tm->addrMap;
+	/* the JIT counts whole instructions, it is off while profiling */
+	if (tm->jitflag && !profiling) jit = jitBegin(tm, n);
+	if (!profiling) fuseProgram(prog, n);
+	BIND_HANDLERS();
+
+	target = reg[PC_REG];
+	goto dynamic;
+
+#ifdef TM_THREADED
+	{
+	L_PROFILE:
+		profStep(tm, ip->loc);
+		goto *handlers[ip->op];
+#else
+dispatch:
+	if (profiling) profStep(tm, ip->loc);
+	else if (HOOKED(ip - prog)) goto jit_enter;
+execute:
+	switch (ip->fused)
+	{
+#endif
+	HANDLER(HALT):
+		reg[PC_REG] = ip->loc + 1;
+		result = srHALT;
+		goto done;
+
+	HANDLER(GENERIC):
+		reg[PC_REG] = ip->loc;
+		result = stepTM(tm);
+		if (result != srOKAY) goto done;
+		JUMP_ADDR(reg[PC_REG]);
+
+	HANDLER(NOP):
+		NEXT();
+
+	HANDLER(MOVE):
+		reg[ip->r] = reg[ip->s];
+		NEXT();
+	HANDLER(MOVIF):
+		reg[ip->r] = as_int((float)reg[ip->s]);
+		NEXT();
+	HANDLER(MOVFI):
+		reg[ip->r] = (int)as_flt(reg[ip->s]);
+		NEXT();
+	HANDLER(NEGI):
+		reg[ip->r] = -reg[ip->r];
+		NEXT();
+	HANDLER(NEGF):
+		reg[ip->r] = as_int(-as_flt(reg[ip->r]));
+		NEXT();
+
+	HANDLER(ADDI):
+		reg[ip->r] = reg[ip->s] + reg[ip->t];
+		NEXT();
+	HANDLER(SUBI):
+		reg[ip->r] = reg[ip->s] - reg[ip->t];
+		NEXT();
+	HANDLER(MULI):
+		reg[ip->r] = reg[ip->s] * reg[ip->t];
+		NEXT();
+	HANDLER(DIVI):
+		if (reg[ip->t] == 0) FAIL(srZERODIVIDE);
+		reg[ip->r] = TM_DIV(reg[ip->s], reg[ip->t]);
+		NEXT();
+	HANDLER(MODI):
+		if (reg[ip->t] == 0) FAIL(srZERODIVIDE);
+		reg[ip->r] = TM_MOD(reg[ip->s], reg[ip->t]);
+		NEXT();
+	HANDLER(ADDF):
+		reg[ip->r] = as_int(as_flt(reg[ip->s]) + as_flt(reg[ip->t]));
+		NEXT();
+	HANDLER(SUBF):
+		reg[ip->r] = as_int(as_flt(reg[ip->s]) - as_flt(reg[ip->t]));
+		NEXT();
+	HANDLER(MULF):
+		reg[ip->r] = as_int(as_flt(reg[ip->s]) * as_flt(reg[ip->t]));
+		NEXT();
+	HANDLER(DIVF):
+		if (as_flt(reg[ip->t]) == 0) FAIL(srZERODIVIDE);
+		reg[ip->r] = as_int(as_flt(reg[ip->s]) / as_flt(reg[ip->t]));
+		NEXT();
+	HANDLER(MODF):
+		if ((int)as_flt(reg[ip->t]) == 0) FAIL(srZERODIVIDE);
+		reg[ip->r] = TM_MOD((int)as_flt(reg[ip->s]), (int)as_flt(reg[ip->t]));
+		NEXT();
+
+	HANDLER(JMP):
+		JUMP(ip->d);
+	HANDLER(JMPD):
+		JUMP_ADDR(ip->d);
+
+	HANDLER(LD):
+		DO_LD();
+		NEXT();
+	HANDLER(ST):
+		DO_ST();
+		NEXT();
+	HANDLER(PUSH):
+		DO_PUSH();
+		NEXT();
+	HANDLER(POP):
+		DO_POP();
+		NEXT();
+	HANDLER(LDPC):
+		m = ip->d + reg[ip->s];
+		CHECK_MEM(m);
+		JUMP_ADDR(dMem[m]);
+	HANDLER(POPPC):
+		m = ip->d + reg[ip->s];
+		CHECK_MEM(m);
+		CHECK_MEM(m + 1);
+		reg[ip->s]++;
+		JUMP_ADDR(dMem[m + 1]);
+
+	HANDLER(LDA):
+		DO_LDA();
+		NEXT();
+	HANDLER(LDC):
+		DO_LDC();
+		NEXT();
+	HANDLER(LDAPC):
+		JUMP_ADDR(ip->d + reg[ip->s]);
+
+	HANDLER(JLT):
+		if (reg[ip->r] < 0) JUMP(ip->d);
+		NEXT();
+	HANDLER(JLE):
+		if (reg[ip->r] <= 0) JUMP(ip->d);
+		NEXT();
+	HANDLER(JGT):
+		if (reg[ip->r] > 0) JUMP(ip->d);
+		NEXT();
+	HANDLER(JGE):
+		if (reg[ip->r] >= 0) JUMP(ip->d);
+		NEXT();
+	HANDLER(JEQ):
+		if (reg[ip->r] == 0) JUMP(ip->d);
+		NEXT();
+	HANDLER(JNE):
+		if (reg[ip->r] != 0) JUMP(ip->d);
+		NEXT();
+	HANDLER(JLTF):
+		if (as_flt(reg[ip->r]) < 0) JUMP(ip->d);
+		NEXT();
+	HANDLER(JLEF):
+		if (as_flt(reg[ip->r]) <= 0) JUMP(ip->d);
+		NEXT();
+	HANDLER(JGTF):
+		if (as_flt(reg[ip->r]) > 0) JUMP(ip->d);
+		NEXT();
+	HANDLER(JGEF):
+		if (as_flt(reg[ip->r]) >= 0) JUMP(ip->d);
+		NEXT();
+	HANDLER(JEQF):
+		if (as_flt(reg[ip->r]) == 0) JUMP(ip->d);
+		NEXT();
+	HANDLER(JNEF):
+		if (as_flt(reg[ip->r]) != 0) JUMP(ip->d);
+		NEXT();
+	HANDLER(JIDX):
+		JUMP_ADDR(ip->d + reg[ip->r]);
+	HANDLER(RETURN):
+		m = ip->d + reg[ip->s];
+		CHECK_MEM(m);
+		JUMP_ADDR(dMem[m]);
+
+	HANDLER(MEMCPY):
+		CHECK_BLOCK(reg[ip->r], ip->d);
+		CHECK_BLOCK(reg[ip->s], ip->d);
+		memcpy(dMem + reg[ip->r], dMem + reg[ip->s], ip->d * sizeof(int));
+		DIRTY_BLOCK(reg[ip->r], ip->d);
+		NEXT();
+	HANDLER(MEMSET):
+		CHECK_BLOCK(reg[ip->r], ip->d);
+		for (m = 0; m < ip->d; m++) dMem[reg[ip->r] + m] = reg[ip->s];
+		DIRTY_BLOCK(reg[ip->r], ip->d);
+		NEXT();
+	HANDLER(MEMMOVE):
+		CHECK_BLOCK(reg[ip->r], ip->d);
+		CHECK_BLOCK(reg[ip->s], ip->d);
+		memmove(dMem + reg[ip->r], dMem + reg[ip->s], ip->d * sizeof(int));
+		DIRTY_BLOCK(reg[ip->r], ip->d);
+		NEXT();
+
+	TX_SUPERS(TX_SUPER_HANDLER)
+
+#ifndef TM_THREADED
+	default:
+		break;
+#endif
+	}
+
+	/* an instruction with machine code or the head of a region,
+	 * the machine code comes back with the next instruction to
+	 * interpret, which runs in its own handler
+	 */
+jit_enter:
+	loc = (int)(ip - prog);
+	if (jit->native[loc] == NULL)
+	{
+		if (++jit->hits[loc] < TM_JIT_HOT) EXECUTE();
+		jitCompile(tm, loc);
+		BIND_HANDLERS();
+		if (jit->native[loc] == NULL) EXECUTE();
+	}
+	steps--; /* counted again in the machine code */
+	m = jitRun(tm, loc, &steps, limit);
+	ip = prog + JIT_EXIT_INDEX(m);
+	if (JIT_EXIT_JUMPED(m) && steps >= limit) goto budget;
+	steps++;
+	EXECUTE();
+
+	/* a jump whose target is only known at run time */
+dynamic:
+	if (target < 0 || target > IADDR_SIZE)
+	{
+		steps++;
+		reg[PC_REG] = target;
+		result = srIMEM_ERR;
+		goto done;
+	}
+	if (target >= top)
+	{
+		/* nothing was loaded there, the cell holds HALT */
+		steps++;
+		reg[PC_REG] = target + 1;
+		result = srHALT;
+		goto done;
+	}
+	JUMP(addr_map[target]);
+
+	/* the budget is checked at the jumps, every loop goes through one */
+budget:
+	reg[PC_REG] = ip->loc;
+	result = srBUDGET;
+
+done:
+	*stepcnt += steps;
+	return result;
+
+#undef HANDLER
+#undef DISPATCH
+#undef EXECUTE
+#undef SECOND
+#undef HOOKED
+#undef BIND_HANDLERS
+#undef NEXT
+#undef JUMP
+#undef JUMP_ADDR
+#undef FAIL
+#undef CHECK_MEM
+#undef CHECK_BLOCK
+#undef DIRTY_BLOCK
+#undef DO_LD
+#undef DO_ST
+#undef DO_PUSH
+#undef DO_POP
+#undef DO_LDA
+#undef DO_LDC
+#undef TX_SUPER_HANDLER
+}
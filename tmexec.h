@@ -0,0 +1,70 @@
+#ifndef TMEXEC_HEAD
+#define TMEXEC_HEAD
+/****************************************************/
+/* File: tmexec.h                                   */
+/* the pre-decoded form of a TM program, run by the */
+/* threaded engine and read by the translators      */
+/****************************************************/
+#include "tm.h"
+
+/* computed goto is a gcc/clang extension, other compilers
+ * get the same handlers dispatched through a switch
+ */
+#if defined(__GNUC__) && !defined(TM_NO_THREADED)
+#define TM_THREADED 1
+#endif
+
+/* the handlers, each one is an opcode specialised by
+ * the form of its operands
+ */
+#define TX_HANDLERS(X) \
+	X(HALT) X(GENERIC) X(NOP) \
+	X(MOVE) X(MOVIF) X(MOVFI) X(NEGI) X(NEGF) \
+	X(ADDI) X(SUBI) X(MULI) X(DIVI) X(MODI) \
+	X(ADDF) X(SUBF) X(MULF) X(DIVF) X(MODF) \
+	X(JMP) X(JMPD) \
+	X(LD) X(ST) X(PUSH) X(POP) X(LDPC) X(POPPC) \
+	X(LDA) X(LDC) X(LDAPC) \
+	X(JLT) X(JLE) X(JGT) X(JGE) X(JEQ) X(JNE) \
+	X(JLTF) X(JLEF) X(JGTF) X(JGEF) X(JEQF) X(JNEF) X(JIDX) X(RETURN) \
+	X(MEMCPY) X(MEMSET) X(MEMMOVE)
+
+/* the superinstructions: (name, first, second) runs two
+ * handlers with one dispatch. The pairs are the ones the
+ * corpus executes most, the operand loads and pushes of
+ * the expressions, the env walk and the binary ops
+ */
+#define TX_SUPERS(X) \
+	X(LD_PUSH, LD, PUSH) X(LD_LDA, LD, LDA) X(LD_LD, LD, LD) \
+	X(PUSH_LD, PUSH, LD) X(PUSH_LDA, PUSH, LDA) X(PUSH_LDC, PUSH, LDC) \
+	X(LDA_LD, LDA, LD) X(LDA_POP, LDA, POP) X(LDA_LDA, LDA, LDA) X(LDA_PUSH, LDA, PUSH) \
+	X(POP_ST, POP, ST) X(POP_ADDI, POP, ADDI) X(POP_SUBI, POP, SUBI) \
+	X(LDC_PUSH, LDC, PUSH) X(ST_LD, ST, LD)
+
+#define TX_ENUM(name) tx##name,
+#define TX_SUPER_ENUM(name, first, second) tx##name,
+typedef enum { TX_HANDLERS(TX_ENUM) TX_SUPERS(TX_SUPER_ENUM) txLIM } TXOP;
+
+typedef struct txinstr {
+#ifdef TM_THREADED
+	const void * handler; /* address of the handler label */
+#endif
+	int op;  /* TXOP */
+	int fused; /* the handler runTM dispatches, op or a superinstruction */
+	int r;
+	int s;
+	int t;
+	int d;   /* displacement, constant or resolved jump target */
+	int loc; /* the iMem location it was decoded from */
+} TXINSTR;
+
+/* decode iMem into tm->code, LABELs are dropped and tm->addrMap
+ * maps every location to its index in tm->code. The static jumps
+ * (JMP and the conditional ones) hold that index, the GENERIC
+ * instructions are left to stepTM. Nothing is fused. Returns
+ * the number of instructions, a HALT follows them for falling
+ * off the code
+ */
+int decodeProgram(TMContext * tm);
+
+#endif
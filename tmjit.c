@@ -0,0 +1,560 @@
+/****************************************************/
+/* File: tmjit.c                                    */
+/* x86-64 template JIT of the TM. The registers of  */
+/* the machine stay in reg[], so every instruction  */
+/* of a compiled region is an entry of its own and  */
+/* the interpreter may leave and enter the machine  */
+/* code anywhere. Instructions without a template   */
+/* (GENERIC ones like IN, OUT, MALLOC, the dynamic  */
+/* jumps, the block copies) return to runTM, so do  */
+/* the faults, runTM reports them                   */
+/*                                                  */
+/* in the machine code: rbx = reg, r12 = dMem,      */
+/* r13 = dirty, r14d = steps, r15d = limit          */
+/****************************************************/
+
+#include "tmjit.h"
+#include "tmexec.h"
+#include "code.h"
+
+#ifdef TM_JIT
+#include <sys/mman.h>
+
+typedef int (*JITENTRY)(TMJITARGS * args, void * code);
+
+/* the bytes of a region being compiled */
+typedef struct {
+	unsigned char * code;
+	int len;
+} JITASM;
+
+/* a rel32 jump to the machine code of instruction index */
+typedef struct {
+	int pos;
+	int index;
+} JITFIXUP;
+
+#define JIT_MAX_TEMPLATE 64 /* bytes of the longest template */
+
+static void byte1(JITASM * a, int b)
+{
+	a->code[a->len++] = (unsigned char)b;
+}
+
+static void bytes(JITASM * a, const char * s, int n)
+{
+	memcpy(a->code + a->len, s, n);
+	a->len += n;
+}
+
+static void imm32(JITASM * a, int v)
+{
+	memcpy(a->code + a->len, &v, 4);
+	a->len += 4;
+}
+
+/* host register h (eax 0, ecx 1, edx 2) = reg[r], pc reads
+ * as the location of the next instruction like in stepTM
+ */
+static void loadReg(JITASM * a, int h, int r, int loc)
+{
+	if (r == PC_REG)
+	{
+		byte1(a, 0xB8 + h);                 /* mov h, loc+1 */
+		imm32(a, loc + 1);
+		return;
+	}
+	byte1(a, 0x8B);                         /* mov h, [rbx+4r] */
+	byte1(a, 0x43 | h << 3);
+	byte1(a, r * 4);
+}
+
+static void storeReg(JITASM * a, int h, int r)
+{
+	byte1(a, 0x89);                         /* mov [rbx+4r], h */
+	byte1(a, 0x43 | h << 3);
+	byte1(a, r * 4);
+}
+
+/* back to runTM at instruction index */
+static void exitTo(JITASM * a, int index, int jumped)
+{
+	byte1(a, 0xB8);                         /* mov eax, code */
+	imm32(a, index << 1 | jumped);
+	byte1(a, 0xC3);                         /* ret */
+}
+
+/* skip the exit when the condition holds (short jcc opcode) */
+static void exitUnless(JITASM * a, int jcc, int index)
+{
+	byte1(a, jcc);
+	byte1(a, 6);
+	exitTo(a, index, 0);
+}
+
+static void countStep(JITASM * a)
+{
+	bytes(a, "\x41\xFF\xC6", 3);            /* inc r14d */
+}
+
+/* eax = d + reg[s], an address of n words not all in dMem
+ * goes back to runTM
+ */
+static void memAddress(JITASM * a, TXINSTR * x, int index, int n)
+{
+	loadReg(a, 0, x->s, x->loc);
+	byte1(a, 0x05);                         /* add eax, d */
+	imm32(a, x->d);
+	byte1(a, 0x3D);                         /* cmp eax, DADDR_SIZE - n + 1 */
+	imm32(a, DADDR_SIZE - n + 1);
+	exitUnless(a, 0x72, index);             /* jb */
+}
+
+static void markDirty(JITASM * a)
+{
+	bytes(a, "\xC1\xE8", 2);                /* shr eax, TM_PAGE_SHIFT */
+	byte1(a, TM_PAGE_SHIFT);
+	bytes(a, "\x41\xC6\x44\x05\x00\x01", 6);/* mov byte [r13+rax], 1 */
+}
+
+/* a static jump to index d, the budget is checked first */
+static void jumpTo(JITASM * a, int d, int lo, int hi, void ** native, JITFIXUP * fix, int * nfix)
+{
+	if (d < lo || d >= hi || native[d] == NULL)
+	{
+		exitTo(a, d, 1);
+		return;
+	}
+	bytes(a, "\x45\x39\xFE", 3);            /* cmp r14d, r15d */
+	byte1(a, 0x7C);                         /* jl over the exit */
+	byte1(a, 6);
+	exitTo(a, d, 1);
+	byte1(a, 0xE9);                         /* jmp rel32 */
+	fix[*nfix].pos = a->len;
+	fix[*nfix].index = d;
+	(*nfix)++;
+	imm32(a, 0);
+}
+
+static int jumpSize(int d, int lo, int hi, void ** native)
+{
+	return (d < lo || d >= hi || native[d] == NULL) ? 6 : 16;
+}
+
+/* the arithmetic of the float ops in xmm0, xmm1 */
+static void floatOperands(JITASM * a, TXINSTR * x)
+{
+	loadReg(a, 0, x->s, x->loc);
+	loadReg(a, 1, x->t, x->loc);
+	bytes(a, "\x66\x0F\x6E\xC0", 4);        /* movd xmm0, eax */
+	bytes(a, "\x66\x0F\x6E\xC9", 4);        /* movd xmm1, ecx */
+}
+
+static int hasTemplate(int op)
+{
+	switch (op)
+	{
+	case txMOVE: case txMOVIF: case txMOVFI: case txNEGI: case txNEGF:
+	case txADDI: case txSUBI: case txMULI: case txDIVI: case txMODI:
+	case txADDF: case txSUBF: case txMULF: case txDIVF: case txMODF:
+	case txJMP: case txLD: case txST: case txPUSH: case txPOP:
+	case txLDA: case txLDC:
+	case txJLT: case txJLE: case txJGT: case txJGE: case txJEQ: case txJNE:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/* the template of x, the instruction at index i of [lo, hi) */
+static void emitInstr(JITASM * a, TXINSTR * x, int i, int lo, int hi,
+	void ** native, JITFIXUP * fix, int * nfix)
+{
+	/* short jcc that skips the taken jump of JLT..JNE */
+	static const unsigned char notTaken[] = { 0x7D, 0x7F, 0x7E, 0x7C, 0x75, 0x74 };
+
+	switch (x->op)
+	{
+	case txMOVE:
+		countStep(a);
+		loadReg(a, 0, x->s, x->loc);
+		storeReg(a, 0, x->r);
+		break;
+	case txMOVIF:
+		countStep(a);
+		loadReg(a, 0, x->s, x->loc);
+		bytes(a, "\xF3\x0F\x2A\xC0", 4);    /* cvtsi2ss xmm0, eax */
+		bytes(a, "\x66\x0F\x7E\xC0", 4);    /* movd eax, xmm0 */
+		storeReg(a, 0, x->r);
+		break;
+	case txMOVFI:
+		countStep(a);
+		loadReg(a, 0, x->s, x->loc);
+		bytes(a, "\x66\x0F\x6E\xC0", 4);    /* movd xmm0, eax */
+		bytes(a, "\xF3\x0F\x2C\xC0", 4);    /* cvttss2si eax, xmm0 */
+		storeReg(a, 0, x->r);
+		break;
+	case txNEGI:
+		countStep(a);
+		bytes(a, "\xF7\x5B", 2);            /* neg dword [rbx+4r] */
+		byte1(a, x->r * 4);
+		break;
+	case txNEGF:
+		countStep(a);
+		bytes(a, "\x81\x73", 2);            /* xor dword [rbx+4r], sign */
+		byte1(a, x->r * 4);
+		imm32(a, (int)0x80000000u);
+		break;
+
+	case txADDI:
+	case txSUBI:
+	case txMULI:
+		countStep(a);
+		loadReg(a, 0, x->s, x->loc);
+		loadReg(a, 1, x->t, x->loc);
+		if (x->op == txADDI) bytes(a, "\x01\xC8", 2);       /* add eax, ecx */
+		else if (x->op == txSUBI) bytes(a, "\x29\xC8", 2);  /* sub eax, ecx */
+		else bytes(a, "\x0F\xAF\xC1", 3);                   /* imul eax, ecx */
+		storeReg(a, 0, x->r);
+		break;
+	case txDIVI:
+	case txMODI:
+		/* a zero divisor and -1 are left to runTM */
+		loadReg(a, 1, x->t, x->loc);
+		bytes(a, "\x85\xC9", 2);            /* test ecx, ecx */
+		exitUnless(a, 0x75, i);             /* jnz */
+		bytes(a, "\x83\xF9\xFF", 3);        /* cmp ecx, -1 */
+		exitUnless(a, 0x75, i);
+		countStep(a);
+		loadReg(a, 0, x->s, x->loc);
+		bytes(a, "\x99\xF7\xF9", 3);        /* cdq; idiv ecx */
+		storeReg(a, x->op == txDIVI ? 0 : 2, x->r);
+		break;
+
+	case txADDF:
+	case txSUBF:
+	case txMULF:
+		countStep(a);
+		floatOperands(a, x);
+		bytes(a, x->op == txADDF ? "\xF3\x0F\x58\xC1"       /* addss xmm0, xmm1 */
+			: x->op == txSUBF ? "\xF3\x0F\x5C\xC1"          /* subss */
+			: "\xF3\x0F\x59\xC1", 4);                       /* mulss */
+		bytes(a, "\x66\x0F\x7E\xC0", 4);    /* movd eax, xmm0 */
+		storeReg(a, 0, x->r);
+		break;
+	case txDIVF:
+		/* +0 and -0 are left to runTM */
+		loadReg(a, 1, x->t, x->loc);
+		bytes(a, "\xF7\xC1", 2);            /* test ecx, 0x7fffffff */
+		imm32(a, 0x7fffffff);
+		exitUnless(a, 0x75, i);
+		countStep(a);
+		floatOperands(a, x);
+		bytes(a, "\xF3\x0F\x5E\xC1", 4);    /* divss xmm0, xmm1 */
+		bytes(a, "\x66\x0F\x7E\xC0", 4);
+		storeReg(a, 0, x->r);
+		break;
+	case txMODF:
+		floatOperands(a, x);
+		bytes(a, "\xF3\x0F\x2C\xC0", 4);    /* cvttss2si eax, xmm0 */
+		bytes(a, "\xF3\x0F\x2C\xC9", 4);    /* cvttss2si ecx, xmm1 */
+		bytes(a, "\x85\xC9", 2);
+		exitUnless(a, 0x75, i);
+		bytes(a, "\x83\xF9\xFF", 3);        /* cmp ecx, -1 */
+		exitUnless(a, 0x75, i);
+		countStep(a);
+		bytes(a, "\x99\xF7\xF9", 3);
+		storeReg(a, 2, x->r);
+		break;
+
+	case txJMP:
+		countStep(a);
+		jumpTo(a, x->d, lo, hi, native, fix, nfix);
+		break;
+	case txJLT:
+	case txJLE:
+	case txJGT:
+	case txJGE:
+	case txJEQ:
+	case txJNE:
+		countStep(a);
+		loadReg(a, 0, x->r, x->loc);
+		bytes(a, "\x85\xC0", 2);            /* test eax, eax */
+		byte1(a, notTaken[x->op - txJLT]);
+		byte1(a, jumpSize(x->d, lo, hi, native));
+		jumpTo(a, x->d, lo, hi, native, fix, nfix);
+		break;
+
+	case txLD:
+		memAddress(a, x, i, 1);
+		countStep(a);
+		bytes(a, "\x41\x8B\x0C\x84", 4);    /* mov ecx, [r12+rax*4] */
+		storeReg(a, 1, x->r);
+		break;
+	case txST:
+	case txPUSH:
+		memAddress(a, x, i, 1);
+		countStep(a);
+		loadReg(a, 1, x->r, x->loc);
+		bytes(a, "\x41\x89\x0C\x84", 4);    /* mov [r12+rax*4], ecx */
+		markDirty(a);
+		if (x->op == txPUSH)
+		{
+			bytes(a, "\xFF\x4B", 2);        /* dec dword [rbx+4s] */
+			byte1(a, x->s * 4);
+		}
+		break;
+	case txPOP:
+		memAddress(a, x, i, 2);             /* dMem[eax + 1] is read */
+		countStep(a);
+		bytes(a, "\x41\x8B\x4C\x84\x04", 5);/* mov ecx, [r12+rax*4+4] */
+		storeReg(a, 1, x->r);
+		bytes(a, "\xFF\x43", 2);            /* inc dword [rbx+4s] */
+		byte1(a, x->s * 4);
+		break;
+	case txLDA:
+		countStep(a);
+		loadReg(a, 0, x->s, x->loc);
+		byte1(a, 0x05);                     /* add eax, d */
+		imm32(a, x->d);
+		storeReg(a, 0, x->r);
+		break;
+	case txLDC:
+		countStep(a);
+		bytes(a, "\xC7\x43", 2);            /* mov dword [rbx+4r], d */
+		byte1(a, x->r * 4);
+		imm32(a, x->d);
+		break;
+	default:
+		exitTo(a, i, 0);
+		break;
+	}
+}
+
+/********************************************/
+static TMJITBLOCK * newBlock(TMJIT * jit, unsigned long size)
+{
+	TMJITBLOCK * b;
+	size = (size + sizeof(TMJITBLOCK) + 4095) & ~4095UL;
+	b = (TMJITBLOCK *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (b == MAP_FAILED) return NULL;
+	b->len = size;
+	b->next = jit->blocks;
+	jit->blocks = b;
+	return b;
+}
+
+/* the code is never written again once it may run */
+static int sealBlock(TMJITBLOCK * b)
+{
+	return mprotect(b, b->len, PROT_READ | PROT_EXEC) == 0;
+}
+
+/* saves the registers of the host, loads the machine from
+ * the TMJITARGS in rdi and calls the code in rsi, whose
+ * ret comes back here with the result in eax
+ */
+static int makeTrampoline(TMJIT * jit)
+{
+	static const char code[] =
+		"\x53\x41\x54\x41\x55\x41\x56\x41\x57"  /* push rbx, r12, r13, r14, r15 */
+		"\x57"                                  /* push rdi */
+		"\x48\x8B\x1F"                          /* mov rbx, [rdi] */
+		"\x4C\x8B\x67\x08"                      /* mov r12, [rdi+8] */
+		"\x4C\x8B\x6F\x10"                      /* mov r13, [rdi+16] */
+		"\x44\x8B\x77\x18"                      /* mov r14d, [rdi+24] */
+		"\x44\x8B\x7F\x1C"                      /* mov r15d, [rdi+28] */
+		"\xFF\xD6"                              /* call rsi */
+		"\x5F"                                  /* pop rdi */
+		"\x44\x89\x77\x18"                      /* mov [rdi+24], r14d */
+		"\x41\x5F\x41\x5E\x41\x5D\x41\x5C\x5B"  /* pop r15, r14, r13, r12, rbx */
+		"\xC3";                                 /* ret */
+	TMJITBLOCK * b = newBlock(jit, sizeof(code));
+	if (b == NULL) return FALSE;
+	jit->trampoline = (unsigned char *)(b + 1);
+	memcpy(jit->trampoline, code, sizeof(code) - 1);
+	return sealBlock(b);
+}
+
+/* the innermost function around loc, -1 if none */
+static int functionOf(TMContext * tm, int loc)
+{
+	TMOBJTAB * o = &tm->obj;
+	int f, best = -1;
+	for (f = 0; f < o->funcSize; f++)
+	{
+		TMFUNC * fn = &o->funcTab[f];
+		int end = fn->end == -1 || fn->end > tm->iMemSize ? tm->iMemSize : fn->end;
+		if (fn->start <= loc && loc < end && (best == -1 || fn->start >= o->funcTab[best].start))
+			best = f;
+	}
+	return best;
+}
+
+static int isStaticJump(int op)
+{
+	return op == txJMP || (op >= txJLT && op <= txJNEF);
+}
+
+/********************************************/
+TMJIT * jitBegin(TMContext * tm, int n)
+{
+	TMJIT * jit = tm->jit;
+	TXINSTR * prog = tm->code;
+	TMOBJTAB * o = &tm->obj;
+	int i;
+	if (jit != NULL && jit->size == n && jit->iMem == tm->iMem) return jit;
+	jitFree(tm);
+
+	jit = (TMJIT *)calloc(1, sizeof(TMJIT));
+	jit->size = n;
+	jit->iMem = tm->iMem;
+	jit->native = (void **)calloc(n + 1, sizeof(void *));
+	jit->hits = (int *)malloc((n + 1) * sizeof(int));
+	tm->jit = jit;
+	if (!makeTrampoline(jit))
+	{
+		jitFree(tm);
+		return NULL;
+	}
+	/* the heads: the function entries and the targets of the jumps back */
+	for (i = 0; i <= n; i++)
+		jit->hits[i] = -1;
+	for (i = 0; i < o->funcSize; i++)
+	{
+		int entry = o->funcTab[i].entry;
+		if (entry >= 0 && entry < tm->iMemSize)
+			jit->hits[tm->addrMap[entry]] = 0;
+	}
+	for (i = 0; i < n; i++)
+	{
+		if (isStaticJump(prog[i].op) && prog[i].d <= i)
+			jit->hits[prog[i].d] = 0;
+	}
+	return jit;
+} /* jitBegin */
+
+void jitFree(TMContext * tm)
+{
+	TMJIT * jit = tm->jit;
+	if (jit == NULL) return;
+	while (jit->blocks != NULL)
+	{
+		TMJITBLOCK * b = jit->blocks;
+		jit->blocks = b->next;
+		munmap(b, b->len);
+	}
+	free(jit->native);
+	free(jit->hits);
+	free(jit);
+	tm->jit = NULL;
+} /* jitFree */
+
+int jitCompile(TMContext * tm, int at)
+{
+	TMJIT * jit = tm->jit;
+	TXINSTR * prog = tm->code;
+	int lo, hi, i, f, nfix = 0;
+	int * offset;
+	JITFIXUP * fix;
+	JITASM a;
+	TMJITBLOCK * b;
+
+	/* the region: the function of at, else the loop it heads */
+	f = functionOf(tm, prog[at].loc);
+	if (f != -1)
+	{
+		TMFUNC * fn = &tm->obj.funcTab[f];
+		lo = tm->addrMap[fn->start];
+		hi = tm->addrMap[fn->end == -1 || fn->end > tm->iMemSize ? tm->iMemSize : fn->end];
+	}
+	else
+	{
+		lo = at;
+		hi = at + 1;
+		for (i = at; i < jit->size; i++)
+		{
+			if (isStaticJump(prog[i].op) && prog[i].d == at) hi = i + 1;
+		}
+	}
+	if (at < lo || at >= hi) lo = hi = at;
+	for (i = lo; i < hi; i++)
+		jit->hits[i] = -1;
+	jit->hits[at] = -1;
+	if (lo == hi) return FALSE;
+
+	b = newBlock(jit, (unsigned long)(hi - lo + 1) * JIT_MAX_TEMPLATE);
+	if (b == NULL) return FALSE;
+	a.code = (unsigned char *)(b + 1);
+	a.len = 0;
+	offset = (int *)malloc((hi - lo) * sizeof(int));
+	fix = (JITFIXUP *)malloc((hi - lo) * sizeof(JITFIXUP));
+
+	/* an instruction has machine code if it has a template, the
+	 * jumps below know their targets before they are emitted
+	 */
+	for (i = lo; i < hi; i++)
+		jit->native[i] = hasTemplate(prog[i].op) ? a.code : NULL;
+	for (i = lo; i < hi; i++)
+	{
+		offset[i - lo] = a.len;
+		emitInstr(&a, &prog[i], i, lo, hi, jit->native, fix, &nfix);
+	}
+	exitTo(&a, hi, 0);
+	for (i = 0; i < nfix; i++)
+	{
+		int rel = offset[fix[i].index - lo] - (fix[i].pos + 4);
+		memcpy(a.code + fix[i].pos, &rel, 4);
+	}
+	for (i = lo; i < hi; i++)
+	{
+		if (jit->native[i] != NULL) jit->native[i] = a.code + offset[i - lo];
+	}
+	free(offset);
+	free(fix);
+	if (!sealBlock(b))
+	{
+		for (i = lo; i < hi; i++)
+			jit->native[i] = NULL;
+		return FALSE;
+	}
+	return jit->native[at] != NULL;
+} /* jitCompile */
+
+int jitRun(TMContext * tm, int at, int * steps, int limit)
+{
+	TMJIT * jit = tm->jit;
+	TMJITARGS args;
+	int r;
+	args.reg = tm->reg;
+	args.dMem = tm->dMem;
+	args.dirty = tm->dirty;
+	args.steps = *steps;
+	args.limit = limit;
+	r = ((JITENTRY)jit->trampoline)(&args, jit->native[at]);
+	*steps = args.steps;
+	return r;
+} /* jitRun */
+
+#else
+
+TMJIT * jitBegin(TMContext * tm, int n)
+{
+	return NULL;
+}
+
+void jitFree(TMContext * tm)
+{
+}
+
+int jitCompile(TMContext * tm, int at)
+{
+	return FALSE;
+}
+
+int jitRun(TMContext * tm, int at, int * steps, int limit)
+{
+	return at << 1;
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef TMJIT_HEAD
+#define TMJIT_HEAD
+/****************************************************/
+/* File: tmjit.h                                    */
+/* template JIT of the TM: the hot regions of the   */
+/* decoded code are compiled into x86-64 machine    */
+/* code, one fixed template per instruction         */
+/****************************************************/
+
+struct TMContext;
+
+/* machine code needs x86-64 and mmap, elsewhere runTM
+ * interprets everything
+ */
+#if defined(__x86_64__) && !defined(_WIN32) && !defined(TM_NO_JIT)
+#define TM_JIT 1
+#endif
+
+/* entries of a region head before its region is compiled */
+#ifndef TM_JIT_HOT
+#define TM_JIT_HOT 8
+#endif
+
+/* what the machine code works on, the trampoline reads
+ * it at fixed offsets
+ */
+typedef struct {
+	int * reg;
+	int * dMem;
+	unsigned char * dirty;
+	int steps;     /* instructions executed, updated on the way out */
+	int limit;     /* the budget, checked at the jumps */
+} TMJITARGS;
+
+typedef struct tmjitblock {
+	struct tmjitblock * next;
+	unsigned long len;      /* bytes mapped, this header included */
+} TMJITBLOCK;
+
+typedef struct TMJIT {
+	int size;               /* decoded instructions, code[size] is the HALT */
+	const void * iMem;      /* the program the code belongs to */
+	void ** native;         /* machine code of each instruction, NULL is interpreted */
+	int * hits;             /* entries of a region head, -1 for the others */
+	unsigned char * trampoline;
+	TMJITBLOCK * blocks;
+} TMJIT;
+
+/* the machine code returns the index of the next instruction
+ * the interpreter executes and whether it got there by a jump
+ * (so the budget is checked as in runTM)
+ */
+#define JIT_EXIT_INDEX(r) ((r) >> 1)
+#define JIT_EXIT_JUMPED(r) ((r) & 1)
+
+/* the JIT of the program decoded into tm->code (n instructions),
+ * made on the first call and kept until the program changes,
+ * NULL where there is no JIT
+ */
+TMJIT * jitBegin(struct TMContext * tm, int n);
+void jitFree(struct TMContext * tm);
+
+/* compile the region of head at: the function around it, or
+ * the loop from it to the last jump back to it. The heads in
+ * the region stop counting, FALSE if at got no machine code
+ */
+int jitCompile(struct TMContext * tm, int at);
+
+/* run the machine code of instruction at, steps is the count
+ * of runTM and goes on in the machine code
+ */
+int jitRun(struct TMContext * tm, int at, int * steps, int limit);
+
+#endif
@@ -0,0 +1,404 @@
+/****************************************************/
+/* File: tmobj.c                                    */
+/* binary object files of the TM: the text .tm is   */
+/* assembled once, afterwards the VM maps the       */
+/* object straight into iMem                        */
+/****************************************************/
+
+#include "tm.h"
+
+#ifdef _WIN32
+#define TMOBJ_NO_MMAP 1
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/* grow a table so that n more entries fit */
+#define GROW(tab, size, cap, n, type) do{\
+	if ((size) + (n) > (cap)){\
+		(cap) = (cap) == 0 ? 256 : (cap);\
+		while ((size) + (n) > (cap)) (cap) *= 2;\
+		(tab) = (type *)realloc((tab), (cap) * sizeof(type));\
+	}\
+}while(0)
+
+static void unmapObject(char * base, size_t len)
+{
+#ifdef TMOBJ_NO_MMAP
+	free(base);
+#else
+	munmap(base, len);
+#endif
+}
+
+/********************************************/
+void objReset(TMContext * tm)
+{
+	TMOBJTAB * o = &tm->obj;
+	if (o->base != NULL)
+	{
+		unmapObject(o->base, o->len);
+		o->base = NULL;
+		o->len = 0;
+		o->dataPool = NULL; o->labelTab = NULL; o->lineTab = NULL; o->funcTab = NULL; o->fileTab = NULL;
+		o->dataCap = o->labelTabCap = o->lineCap = o->funcCap = o->fileCap = 0;
+	}
+	o->dataSize = o->labelSize = o->lineSize = o->funcSize = o->fileSize = 0;
+	o->curFile = -1;
+} /* objReset */
+
+void objFree(TMContext * tm)
+{
+	TMOBJTAB * o = &tm->obj;
+	objReset(tm);
+	free(o->dataPool);
+	free(o->labelTab);
+	free(o->lineTab);
+	free(o->funcTab);
+	free(o->fileTab);
+	o->dataPool = NULL; o->labelTab = NULL; o->lineTab = NULL; o->funcTab = NULL; o->fileTab = NULL;
+	o->dataCap = o->labelTabCap = o->lineCap = o->funcCap = o->fileCap = 0;
+} /* objFree */
+
+void objAddData(TMContext * tm, int addr, int * words, int n)
+{
+	TMOBJTAB * o = &tm->obj;
+	GROW(o->dataPool, o->dataSize, o->dataCap, n + 2, int);
+	o->dataPool[o->dataSize++] = addr;
+	o->dataPool[o->dataSize++] = n;
+	memcpy(o->dataPool + o->dataSize, words, n * sizeof(int));
+	o->dataSize += n;
+} /* objAddData */
+
+void objAddLabel(TMContext * tm, int label, int loc, int kind)
+{
+	TMOBJTAB * o = &tm->obj;
+	GROW(o->labelTab, o->labelSize, o->labelTabCap, 1, TMLABEL);
+	o->labelTab[o->labelSize].label = label;
+	o->labelTab[o->labelSize].loc = loc;
+	o->labelTab[o->labelSize].kind = kind;
+	o->labelSize++;
+} /* objAddLabel */
+
+/* offset of a copy of name in the name table */
+static int addName(TMOBJTAB * o, char * name)
+{
+	int len = (int)strlen(name) + 1;
+	int at = o->fileSize;
+	GROW(o->fileTab, o->fileSize, o->fileCap, len, char);
+	memcpy(o->fileTab + o->fileSize, name, len);
+	o->fileSize += len;
+	return at;
+}
+
+void objSetFile(TMContext * tm, char * filename)
+{
+	tm->obj.curFile = addName(&tm->obj, filename);
+} /* objSetFile */
+
+void objBeginFunc(TMContext * tm, char * name)
+{
+	TMOBJTAB * o = &tm->obj;
+	GROW(o->funcTab, o->funcSize, o->funcCap, 1, TMFUNC);
+	o->funcTab[o->funcSize].start = tm->iMemSize;
+	o->funcTab[o->funcSize].entry = tm->iMemSize;
+	o->funcTab[o->funcSize].end = -1;
+	o->funcTab[o->funcSize].name = addName(o, name);
+	o->funcSize++;
+} /* objBeginFunc */
+
+void objEndFunc(TMContext * tm)
+{
+	TMOBJTAB * o = &tm->obj;
+	int i = o->funcSize - 1, loc;
+	while (i >= 0 && o->funcTab[i].end != -1) i--;
+	if (i < 0) return;
+	o->funcTab[i].end = tm->iMemSize;
+	/* the body follows the jump to the end of the function */
+	for (loc = o->funcTab[i].start; loc < tm->iMemSize; loc++)
+	{
+		if (tm->iMem[loc].iop == opGO)
+		{
+			o->funcTab[i].entry = loc + 1;
+			break;
+		}
+	}
+} /* objEndFunc */
+
+void objAddLine(TMContext * tm, int loc, int line)
+{
+	TMOBJTAB * o = &tm->obj;
+	/* a line without instructions is replaced by the next one */
+	if (o->lineSize > 0 && o->lineTab[o->lineSize - 1].loc == loc)
+		o->lineSize--;
+	GROW(o->lineTab, o->lineSize, o->lineCap, 1, TMLINE);
+	o->lineTab[o->lineSize].loc = loc;
+	o->lineTab[o->lineSize].file = o->curFile;
+	o->lineTab[o->lineSize].line = line;
+	o->lineSize++;
+} /* objAddLine */
+
+void objApplyData(TMContext * tm)
+{
+	TMOBJTAB * o = &tm->obj;
+	int i = 0;
+	while (i < o->dataSize)
+	{
+		int addr = o->dataPool[i], n = o->dataPool[i + 1];
+		memcpy(tm->dMem + addr, o->dataPool + i + 2, n * sizeof(int));
+		i += n + 2;
+	}
+} /* objApplyData */
+
+int objSourceLine(TMContext * tm, int loc, char ** file)
+{
+	TMOBJTAB * o = &tm->obj;
+	int i, best = -1;
+	for (i = 0; i < o->lineSize; i++)
+	{
+		if (o->lineTab[i].loc <= loc && (best == -1 || o->lineTab[i].loc >= o->lineTab[best].loc))
+			best = i;
+	}
+	if (best == -1) return 0;
+	if (file != NULL)
+		*file = o->lineTab[best].file >= 0 ? o->fileTab + o->lineTab[best].file : "?";
+	return o->lineTab[best].line;
+} /* objSourceLine */
+
+/********************************************/
+int writeObject(TMContext * tm, char * objFile)
+{
+	TMOBJTAB * o = &tm->obj;
+	TMOBJHEADER h;
+	FILE * out = fopen(objFile, "wb");
+	if (out == NULL)
+	{
+		printf("can not write object %s\n", objFile);
+		return FALSE;
+	}
+	h.magic = TMOBJ_MAGIC;
+	h.version = TMOBJ_VERSION;
+	h.ninstr = tm->iMemSize;
+	h.ndata = o->dataSize;
+	h.nlabel = o->labelSize;
+	h.nline = o->lineSize;
+	h.nfunc = o->funcSize;
+	h.nstr = o->fileSize;
+	h.instr_off = sizeof(TMOBJHEADER);
+	h.data_off = h.instr_off + h.ninstr * sizeof(INSTRUCTION);
+	h.label_off = h.data_off + h.ndata * sizeof(int);
+	h.line_off = h.label_off + h.nlabel * sizeof(TMLABEL);
+	h.func_off = h.line_off + h.nline * sizeof(TMLINE);
+	h.str_off = h.func_off + h.nfunc * sizeof(TMFUNC);
+
+	fwrite(&h, sizeof(h), 1, out);
+	fwrite(tm->iMem, sizeof(INSTRUCTION), h.ninstr, out);
+	fwrite(o->dataPool, sizeof(int), h.ndata, out);
+	fwrite(o->labelTab, sizeof(TMLABEL), h.nlabel, out);
+	fwrite(o->lineTab, sizeof(TMLINE), h.nline, out);
+	fwrite(o->funcTab, sizeof(TMFUNC), h.nfunc, out);
+	fwrite(o->fileTab, sizeof(char), h.nstr, out);
+	fclose(out);
+	return TRUE;
+} /* writeObject */
+
+/********************************************/
+/* the file is mapped MAP_PRIVATE and read only,
+ * iMem and the tables are used in place
+ */
+static char * mapObject(char * objFile, size_t * len)
+{
+	char * base;
+#ifdef TMOBJ_NO_MMAP
+	FILE * in = fopen(objFile, "rb");
+	if (in == NULL) return NULL;
+	fseek(in, 0, SEEK_END);
+	*len = (size_t)ftell(in);
+	fseek(in, 0, SEEK_SET);
+	base = (char *)malloc(*len);
+	if (fread(base, 1, *len, in) != *len)
+	{
+		free(base);
+		base = NULL;
+	}
+	fclose(in);
+#else
+	struct stat st;
+	int fd = open(objFile, O_RDONLY);
+	if (fd < 0) return NULL;
+	if (fstat(fd, &st) < 0 || st.st_size == 0)
+	{
+		close(fd);
+		return NULL;
+	}
+	*len = (size_t)st.st_size;
+	base = (char *)mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) base = NULL;
+#endif
+	return base;
+}
+
+/* a section of n entries of size bytes at off lies in the file */
+static int sectionOk(int off, int n, size_t size, size_t len)
+{
+	return off >= 0 && n >= 0 && (size_t)off <= len && (size_t)n <= (len - off) / size;
+}
+
+/* the operands index reg[] as readInstructions checks them,
+ * GO must already be linked into LDC pc
+ */
+static int instructionOk(INSTRUCTION * in)
+{
+	int rOk = in->iarg1 >= 0 && in->iarg1 < NO_REGS;
+	int tOk = in->iarg3 >= 0 && in->iarg3 < NO_REGS;
+	if (in->iop < 0 || in->iop >= opEND || in->iop == opGO) return FALSE;
+	if (opClass(in->iop) != opclRR) return rOk && tOk;
+	if (in->iop == opLAEBL) return TRUE;
+	return rOk && tOk && in->iarg2 >= 0 && in->iarg2 < NO_REGS;
+}
+
+/* a mapped object is trusted no further than the text: every
+ * section and name lies in the file, every instruction decodes,
+ * lines and functions lie in the code and every constant pool
+ * entry lies in dMem
+ */
+static int objectOk(char * base, size_t len)
+{
+	TMOBJHEADER * h = (TMOBJHEADER *)base;
+	INSTRUCTION * instr;
+	TMLINE * lines;
+	TMFUNC * funcs;
+	int * pool;
+	int i;
+	if (len < sizeof(TMOBJHEADER) || h->magic != TMOBJ_MAGIC || h->version != TMOBJ_VERSION
+		|| h->ninstr > IADDR_SIZE
+		|| !sectionOk(h->instr_off, h->ninstr, sizeof(INSTRUCTION), len)
+		|| !sectionOk(h->data_off, h->ndata, sizeof(int), len)
+		|| !sectionOk(h->label_off, h->nlabel, sizeof(TMLABEL), len)
+		|| !sectionOk(h->line_off, h->nline, sizeof(TMLINE), len)
+		|| !sectionOk(h->func_off, h->nfunc, sizeof(TMFUNC), len)
+		|| !sectionOk(h->str_off, h->nstr, 1, len)
+		|| (h->nstr > 0 && base[h->str_off + h->nstr - 1] != '\0'))
+		return FALSE;
+	instr = (INSTRUCTION *)(base + h->instr_off);
+	for (i = 0; i < h->ninstr; i++)
+		if (!instructionOk(&instr[i])) return FALSE;
+	lines = (TMLINE *)(base + h->line_off);
+	for (i = 0; i < h->nline; i++)
+		if (lines[i].file < 0 || lines[i].file >= h->nstr
+			|| lines[i].loc < 0 || lines[i].loc > h->ninstr)
+			return FALSE;
+	funcs = (TMFUNC *)(base + h->func_off);
+	for (i = 0; i < h->nfunc; i++)
+	{
+		TMFUNC * fn = &funcs[i];
+		if (fn->start < 0 || fn->start > h->ninstr
+			|| (fn->end != -1 && (fn->end < fn->start || fn->end > h->ninstr))
+			|| fn->entry < 0 || fn->entry >= h->ninstr
+			|| fn->name < 0 || fn->name >= h->nstr)
+			return FALSE;
+	}
+	pool = (int *)(base + h->data_off);
+	for (i = 0; i < h->ndata; i += pool[i + 1] + 2)
+	{
+		if (i + 2 > h->ndata || pool[i + 1] < 0 || pool[i + 1] > h->ndata - i - 2
+			|| pool[i] < 0 || pool[i] > DADDR_SIZE - pool[i + 1])
+			return FALSE;
+	}
+	return TRUE;
+}
+
+int tm_load(TMContext * tm, char * objFile)
+{
+	TMOBJTAB * o = &tm->obj;
+	size_t len;
+	TMOBJHEADER * h;
+	char * base = mapObject(objFile, &len);
+	if (base == NULL)
+	{
+		printf("can not load object %s\n", objFile);
+		return FALSE;
+	}
+	h = (TMOBJHEADER *)base;
+	if (!objectOk(base, len))
+	{
+		printf("%s is not a TM object\n", objFile);
+		unmapObject(base, len);
+		return FALSE;
+	}
+
+	objFree(tm);
+	profFree(tm);
+	jitFree(tm);
+	o->base = base;
+	o->len = len;
+	o->dataPool = (int *)(base + h->data_off);
+	o->dataSize = h->ndata;
+	o->labelTab = (TMLABEL *)(base + h->label_off);
+	o->labelSize = h->nlabel;
+	o->lineTab = (TMLINE *)(base + h->line_off);
+	o->lineSize = h->nline;
+	o->funcTab = (TMFUNC *)(base + h->func_off);
+	o->funcSize = h->nfunc;
+	o->fileTab = base + h->str_off;
+	o->fileSize = h->nstr;
+
+	tm->iMem = (INSTRUCTION *)(base + h->instr_off);
+	tm->iMemSize = h->ninstr;
+	resetMachine(tm);
+	objApplyData(tm);
+	return TRUE;
+} /* tm_load */
+
+int loadObject(char * objFile)
+{
+	return tm_load(tm_default(), objFile);
+}
+
+static int hasSuffix(char * s, char * suffix)
+{
+	size_t n = strlen(s), m = strlen(suffix);
+	return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+int tm_loadFile(TMContext * tm, char * program)
+{
+	FILE * pgm;
+	int ok;
+	if (hasSuffix(program, ".tmo")) return tm_load(tm, program);
+	pgm = fopen(program, "r");
+	if (pgm == NULL)
+	{
+		printf("can not open %s\n", program);
+		return FALSE;
+	}
+	ok = readInstructions(tm, pgm);
+	fclose(pgm);
+	return ok;
+} /* tm_loadFile */
+
+/********************************************/
+/* the text is read into a machine of its own, so assembling
+ * does not disturb the program that is loaded
+ */
+int assemble(char * tmFile, char * objFile)
+{
+	int ok;
+	TMContext * tm;
+	FILE * pgm = fopen(tmFile, "r");
+	if (pgm == NULL)
+	{
+		printf("can not open %s\n", tmFile);
+		return FALSE;
+	}
+	tm = tm_create();
+	ok = readInstructions(tm, pgm);
+	fclose(pgm);
+	ok = ok && writeObject(tm, objFile);
+	tm_destroy(tm);
+	return ok;
+} /* assemble */
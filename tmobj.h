@@ -0,0 +1,127 @@
+#ifndef TMOBJ_HEAD
+#define TMOBJ_HEAD
+/****************************************************/
+/* File: tmobj.h                                    */
+/* binary object format of the TM                   */
+/*                                                  */
+/*   header                                         */
+/*   instructions   INSTRUCTION[ninstr], linked     */
+/*   constant pool  [adress, n, word * n] ...       */
+/*   label table    TMLABEL[nlabel]                 */
+/*   line table     TMLINE[nline]                   */
+/*   function table TMFUNC[nfunc]                   */
+/*   names          '\0' separated strings          */
+/*                                                  */
+/* every section is made of ints, so the file can   */
+/* be mapped and used in place without parsing      */
+/****************************************************/
+#include <stddef.h>
+
+struct TMContext;
+
+#define TMOBJ_MAGIC 0x4F4D5450 /* "PTMO" */
+#define TMOBJ_VERSION 6
+
+typedef struct {
+	int magic;
+	int version;
+	int ninstr;
+	int ndata;     /* ints in the constant pool */
+	int nlabel;
+	int nline;
+	int nfunc;
+	int nstr;      /* bytes of file and function names */
+	int instr_off; /* byte offsets of the sections */
+	int data_off;
+	int label_off;
+	int line_off;
+	int func_off;
+	int str_off;
+} TMOBJHEADER;
+
+typedef enum {
+	lbDEF,  /* LABEL n sits at loc */
+	lbREF   /* loc was GO n before linking */
+} LABELKIND;
+
+typedef struct {
+	int label;
+	int loc;
+	int kind;
+} TMLABEL;
+
+typedef struct {
+	int loc;   /* first instruction of the line */
+	int file;  /* offset in the file name table */
+	int line;
+} TMLINE;
+
+/* a P function, taken from the "function entry:" and
+ * "function end:" comments of the text, nested functions
+ * lie inside the range of the enclosing one
+ */
+typedef struct {
+	int start; /* first instruction */
+	int entry; /* where the calls land, after the jump over the body */
+	int end;   /* first instruction after the function, -1 while open */
+	int name;  /* offset in the name table */
+} TMFUNC;
+
+/* tables of the loaded program, filled by the text loader
+ * or pointing into the mapped object
+ */
+typedef struct {
+	int * dataPool;
+	int dataSize, dataCap;
+	TMLABEL * labelTab;
+	int labelSize, labelTabCap;
+	TMLINE * lineTab;
+	int lineSize, lineCap;
+	TMFUNC * funcTab;
+	int funcSize, funcCap;
+	char * fileTab;      /* file and function names */
+	int fileSize, fileCap;
+	int curFile;
+	char * base; /* the object in use, the tables point into it */
+	size_t len;
+} TMOBJTAB;
+
+void objReset(struct TMContext * tm);
+void objAddData(struct TMContext * tm, int addr, int * words, int n);
+void objAddLabel(struct TMContext * tm, int label, int loc, int kind);
+void objSetFile(struct TMContext * tm, char * filename);
+void objAddLine(struct TMContext * tm, int loc, int line);
+
+/* the function name starts at the next instruction, the
+ * innermost open function ends at the next instruction
+ */
+void objBeginFunc(struct TMContext * tm, char * name);
+void objEndFunc(struct TMContext * tm);
+
+/* release the tables and the object */
+void objFree(struct TMContext * tm);
+
+/* copy the constant pool into dMem */
+void objApplyData(struct TMContext * tm);
+
+/* source line of instruction loc, 0 if unknown,
+ * the module is returned through file when not NULL
+ */
+int objSourceLine(struct TMContext * tm, int loc, char ** file);
+
+/* write the loaded program as an object file */
+int writeObject(struct TMContext * tm, char * objFile);
+
+/* map an object file into iMem of tm and reset the machine */
+int tm_load(struct TMContext * tm, char * objFile);
+
+/* tm_load into the machine behind doCommand */
+int loadObject(char * objFile);
+
+/* load a .tmo object with tm_load or a .tm text */
+int tm_loadFile(struct TMContext * tm, char * program);
+
+/* translate a text .tm into an object file */
+int assemble(char * tmFile, char * objFile);
+
+#endif
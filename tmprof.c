@@ -0,0 +1,276 @@
+/****************************************************/
+/* File: tmprof.c                                   */
+/* execution profiler of the TM. The calls of the   */
+/* code generator are dynamic jumps to the entry of */
+/* a function, so a shadow stack is kept by         */
+/* watching the entries and the RETURNs, each       */
+/* distinct stack is a node of a calling context    */
+/* tree that counts its own instructions            */
+/****************************************************/
+
+#include "tm.h"
+#include "code.h"
+
+#define PROF_TOP_LINES 15
+#define PROF_TOP_INSTR 10
+
+static char * funcName(TMContext * tm, int f)
+{
+	return f < 0 ? "[toplevel]" : tm->obj.fileTab + tm->obj.funcTab[f].name;
+}
+
+/* the callee f of node parent, made on the first call */
+static int childNode(TMPROF * p, int parent, int f)
+{
+	int n = parent < 0 ? -1 : p->nodes[parent].child;
+	for (; n != -1; n = p->nodes[n].sibling)
+	{
+		if (p->nodes[n].func == f) return n;
+	}
+	if (p->nodeNum == p->nodeCap)
+	{
+		p->nodeCap = p->nodeCap == 0 ? 64 : p->nodeCap * 2;
+		p->nodes = (TMCALLNODE *)realloc(p->nodes, p->nodeCap * sizeof(TMCALLNODE));
+	}
+	n = p->nodeNum++;
+	p->nodes[n].func = f;
+	p->nodes[n].parent = parent;
+	p->nodes[n].child = -1;
+	p->nodes[n].sibling = -1;
+	p->nodes[n].self = 0;
+	if (parent >= 0)
+	{
+		p->nodes[n].sibling = p->nodes[parent].child;
+		p->nodes[parent].child = n;
+	}
+	return n;
+}
+
+static void pushFrame(TMPROF * p, int node, int at)
+{
+	if (p->depth == p->stackCap)
+	{
+		p->stackCap = p->stackCap == 0 ? 64 : p->stackCap * 2;
+		p->stack = (TMFRAME *)realloc(p->stack, p->stackCap * sizeof(TMFRAME));
+	}
+	p->stack[p->depth].node = node;
+	p->stack[p->depth].entrySp = at;
+	p->stack[p->depth].enter = p->clock;
+	p->depth++;
+}
+
+/* a recursive function is inclusive only once, in its outermost frame */
+static void popFrame(TMPROF * p)
+{
+	TMFRAME * top = &p->stack[--p->depth];
+	int f = p->nodes[top->node].func;
+	if (--p->active[f] == 0) p->inclusive[f] += p->clock - top->enter;
+}
+
+/********************************************/
+TMPROF * profBegin(TMContext * tm)
+{
+	TMPROF * p = tm->prof;
+	TMOBJTAB * o = &tm->obj;
+	int f, loc, size = tm->iMemSize;
+	if (p != NULL) return p;
+
+	p = (TMPROF *)calloc(1, sizeof(TMPROF));
+	p->size = size;
+	p->count = (long long *)calloc(size + 1, sizeof(long long));
+	p->event = (int *)malloc((size + 1) * sizeof(int));
+	p->funcOf = (int *)malloc((size + 1) * sizeof(int));
+	for (loc = 0; loc < size; loc++)
+	{
+		p->event[loc] = tm->iMem[loc].iop == opRETURN ? PROF_RETURN : PROF_NONE;
+		p->funcOf[loc] = -1;
+	}
+	/* an inner function comes after the enclosing one and
+	 * overwrites its part of the range
+	 */
+	p->nfunc = o->funcSize;
+	for (f = 0; f < o->funcSize; f++)
+	{
+		TMFUNC * fn = &o->funcTab[f];
+		int end = fn->end == -1 || fn->end > size ? size : fn->end;
+		for (loc = fn->start < 0 ? 0 : fn->start; loc < end; loc++)
+			p->funcOf[loc] = f;
+		if (fn->entry >= 0 && fn->entry < size)
+			p->event[fn->entry] = f;
+	}
+	p->inclusive = (long long *)calloc(p->nfunc + 1, sizeof(long long));
+	p->calls = (long long *)calloc(p->nfunc + 1, sizeof(long long));
+	p->active = (int *)calloc(p->nfunc + 1, sizeof(int));
+
+	pushFrame(p, childNode(p, -1, -1), 0);
+	tm->prof = p;
+	return p;
+} /* profBegin */
+
+void profFree(TMContext * tm)
+{
+	TMPROF * p = tm->prof;
+	if (p == NULL) return;
+	free(p->count);
+	free(p->event);
+	free(p->funcOf);
+	free(p->inclusive);
+	free(p->calls);
+	free(p->active);
+	free(p->nodes);
+	free(p->stack);
+	free(p);
+	tm->prof = NULL;
+} /* profFree */
+
+void profStep(TMContext * tm, int loc)
+{
+	TMPROF * p = tm->prof;
+	int e;
+	if (loc < 0 || loc >= p->size) return;
+	e = p->event[loc];
+	if (e >= 0)
+	{
+		TMFRAME * top = &p->stack[p->depth - 1];
+		int parent = top->node;
+		if (p->depth > 1 && top->entrySp == tm->reg[sp])
+		{
+			/* a tail call, the callee takes the place of the frame */
+			parent = p->nodes[top->node].parent;
+			popFrame(p);
+		}
+		pushFrame(p, childNode(p, parent, e), tm->reg[sp]);
+		p->active[e]++;
+		p->calls[e]++;
+	}
+	p->count[loc]++;
+	p->clock++;
+	p->nodes[p->stack[p->depth - 1].node].self++;
+	if (e == PROF_RETURN && p->depth > 1) popFrame(p);
+} /* profStep */
+
+/********************************************/
+/* indices of the k largest positive values of v, largest first */
+static int topN(long long * v, int n, int * out, int k)
+{
+	int i, j, m = 0;
+	if (k <= 0) return 0;
+	for (i = 0; i < n; i++)
+	{
+		if (v[i] <= 0 || (m == k && v[i] <= v[out[m - 1]])) continue;
+		if (m < k) m++;
+		for (j = m - 1; j > 0 && v[out[j - 1]] < v[i]; j--)
+			out[j] = out[j - 1];
+		out[j] = i;
+	}
+	return m;
+}
+
+/* index of the line table entry of loc, -1 if none */
+static int lineIndex(TMOBJTAB * o, int loc)
+{
+	int i, best = -1;
+	for (i = 0; i < o->lineSize; i++)
+	{
+		if (o->lineTab[i].loc <= loc && (best == -1 || o->lineTab[i].loc >= o->lineTab[best].loc))
+			best = i;
+	}
+	return best;
+}
+
+static double percent(long long n, long long total)
+{
+	return total == 0 ? 0.0 : n * 100.0 / total;
+}
+
+void printProfile(TMContext * tm, FILE * out)
+{
+	TMPROF * p = tm->prof;
+	TMOBJTAB * o = &tm->obj;
+	long long * self, * inclusive, * lines;
+	int * order, * seen;
+	int i, n, f, loc;
+	if (p == NULL) return;
+
+	self = (long long *)calloc(p->nfunc + 1, sizeof(long long));
+	inclusive = (long long *)malloc((p->nfunc + 1) * sizeof(long long));
+	seen = (int *)calloc(p->nfunc + 1, sizeof(int));
+	order = (int *)malloc((p->size + p->nfunc + o->lineSize + 1) * sizeof(int));
+	for (i = 1; i < p->nodeNum; i++)
+		self[p->nodes[i].func] += p->nodes[i].self;
+	/* the frames still open count up to now */
+	memcpy(inclusive, p->inclusive, p->nfunc * sizeof(long long));
+	for (i = 1; i < p->depth; i++)
+	{
+		f = p->nodes[p->stack[i].node].func;
+		if (!seen[f]) inclusive[f] += p->clock - p->stack[i].enter;
+		seen[f] = TRUE;
+	}
+
+	fprintf(out, "profile: %lld instructions, %lld outside the functions\n",
+		p->clock, p->nodes[0].self);
+	fprintf(out, "%12s %6s %12s %6s %10s  function\n", "self", "%", "inclusive", "%", "calls");
+	n = topN(self, p->nfunc, order, p->nfunc);
+	for (i = 0; i < n; i++)
+	{
+		f = order[i];
+		fprintf(out, "%12lld %6.2f %12lld %6.2f %10lld  %s\n",
+			self[f], percent(self[f], p->clock), inclusive[f], percent(inclusive[f], p->clock),
+			p->calls[f], funcName(tm, f));
+	}
+
+	if (o->lineSize > 0)
+	{
+		lines = (long long *)calloc(o->lineSize, sizeof(long long));
+		for (loc = 0; loc < p->size; loc++)
+		{
+			if (p->count[loc] == 0 || (i = lineIndex(o, loc)) == -1) continue;
+			lines[i] += p->count[loc];
+		}
+		fprintf(out, "hottest lines:\n");
+		n = topN(lines, o->lineSize, order, PROF_TOP_LINES);
+		for (i = 0; i < n; i++)
+		{
+			TMLINE * l = &o->lineTab[order[i]];
+			fprintf(out, "%12lld %6.2f  %s:%d  %s\n", lines[order[i]], percent(lines[order[i]], p->clock),
+				l->file >= 0 ? o->fileTab + l->file : "?", l->line, funcName(tm, l->loc < p->size ? p->funcOf[l->loc] : -1));
+		}
+		free(lines);
+	}
+
+	fprintf(out, "hottest instructions:\n");
+	n = topN(p->count, p->size, order, PROF_TOP_INSTR);
+	for (i = 0; i < n; i++)
+	{
+		INSTRUCTION * in = &tm->iMem[order[i]];
+		fprintf(out, "%12lld %6.2f  %5d: %-6s %d,%d,%d  %s\n", p->count[order[i]],
+			percent(p->count[order[i]], p->clock), order[i], opCodeTab[in->iop].name,
+			in->iarg1, in->iarg2, in->iarg3, funcName(tm, p->funcOf[order[i]]));
+	}
+	free(self);
+	free(inclusive);
+	free(seen);
+	free(order);
+} /* printProfile */
+
+void writeFoldedStacks(TMContext * tm, FILE * out)
+{
+	TMPROF * p = tm->prof;
+	int * path;
+	int i, n, k;
+	if (p == NULL) return;
+	path = (int *)malloc(p->nodeNum * sizeof(int));
+	if (p->nodes[0].self > 0)
+		fprintf(out, "%s %lld\n", funcName(tm, -1), p->nodes[0].self);
+	for (i = 1; i < p->nodeNum; i++)
+	{
+		if (p->nodes[i].self == 0) continue;
+		n = 0;
+		for (k = i; k > 0; k = p->nodes[k].parent)
+			path[n++] = p->nodes[k].func;
+		while (n-- > 0)
+			fprintf(out, "%s%c", funcName(tm, path[n]), n > 0 ? ';' : ' ');
+		fprintf(out, "%lld\n", p->nodes[i].self);
+	}
+	free(path);
+} /* writeFoldedStacks */
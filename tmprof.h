@@ -0,0 +1,69 @@
+#ifndef TMPROF_HEAD
+#define TMPROF_HEAD
+/****************************************************/
+/* File: tmprof.h                                   */
+/* execution profiler of the TM: counts per         */
+/* instruction, self and inclusive counts per P     */
+/* function and the call stacks in folded form      */
+/****************************************************/
+#include <stdio.h>
+
+struct TMContext;
+
+/* a node of the calling context tree, one per distinct
+ * call stack, the root is the code outside the functions
+ */
+typedef struct {
+	int func;      /* index in the function table, -1 for the root */
+	int parent;
+	int child;     /* first callee, then through sibling */
+	int sibling;
+	long long self;
+} TMCALLNODE;
+
+typedef struct {
+	int node;
+	int entrySp;   /* reg[sp] when the function was entered */
+	long long enter;
+} TMFRAME;
+
+typedef struct {
+	int size;             /* iMem locations covered */
+	long long * count;    /* executions per location */
+	int * event;          /* per location: entry of function n, PROF_RETURN or PROF_NONE */
+	int * funcOf;         /* innermost function of each location, -1 outside */
+	int nfunc;
+	long long * inclusive; /* per function */
+	long long * calls;
+	int * active;         /* frames of the function on the stack */
+	long long clock;      /* instructions counted */
+	TMCALLNODE * nodes;
+	int nodeNum, nodeCap;
+	TMFRAME * stack;      /* the shadow call stack, stack[0] is the root */
+	int depth, stackCap;
+} TMPROF;
+
+#define PROF_NONE (-1)
+#define PROF_RETURN (-2)
+
+/* the profile of the loaded program, made when the first
+ * profiled run starts and kept until the program changes
+ */
+TMPROF * profBegin(struct TMContext * tm);
+void profFree(struct TMContext * tm);
+
+/* account the instruction at loc before it executes: a function
+ * entry pushes a frame (or replaces it on a tail call, the caller
+ * frame is gone and sp is back where it was), RETURN pops one
+ */
+void profStep(struct TMContext * tm, int loc);
+
+/* functions by self count, the hottest source lines and
+ * instructions
+ */
+void printProfile(struct TMContext * tm, FILE * out);
+
+/* "main;f;g count" per call stack, the input of flamegraph.pl */
+void writeFoldedStacks(struct TMContext * tm, FILE * out);
+
+#endif
@@ -0,0 +1,144 @@
+/****************************************************/
+/* File: vmgc.c                                     */
+/* an optional mark-sweep collector for the heap of */
+/* the TM. The words of dMem carry no type, so the  */
+/* collector is conservative: a word that points    */
+/* into the payload of a block keeps it alive       */
+/****************************************************/
+
+#include "tm.h"
+#include "code.h"
+#include <time.h>
+
+#define GC_MIN_THRESHOLD 4096 /* live words that start the first collection */
+
+int GcEnabled = FALSE;
+
+/* index of the used block whose payload holds adress w, -1 if none */
+static int findBlock(TMContext * tm, int w)
+{
+	TMGC * gc = &tm->gc;
+	int lo = 0, hi = gc->blockNum - 1;
+	if (w <= HEAP_BASE || w >= heapEnd(tm)) return -1;
+	while (lo <= hi)
+	{
+		int mid = (lo + hi) / 2;
+		int a = gc->blockAt[mid];
+		if (w <= a) hi = mid - 1;
+		else if (w >= a + heapBlockSize(tm, a) - 1) lo = mid + 1;
+		else return mid;
+	}
+	return -1;
+}
+
+static void markWord(TMContext * tm, int w)
+{
+	TMGC * gc = &tm->gc;
+	int b = findBlock(tm, w);
+	if (b == -1 || gc->marked[b]) return;
+	gc->marked[b] = TRUE;
+	gc->markStack[gc->markTop++] = b;
+}
+
+static void markRange(TMContext * tm, int from, int to)
+{
+	for (int i = from; i < to; i++)
+		markWord(tm, tm->dMem[i]);
+}
+
+/********************************************/
+/* the roots are the registers, everything below the heap
+ * (constants, display and globals) and the stack up to the
+ * temporaries of mp
+ */
+void gcCollect(TMContext * tm)
+{
+	TMGC * gc = &tm->gc;
+	clock_t start = clock();
+	int a, b, end = heapEnd(tm);
+
+	gc->blockNum = 0;
+	for (a = HEAP_BASE; a < end; a += heapBlockSize(tm, a))
+	{
+		if (!heapBlockUsed(tm, a)) continue;
+		if (gc->blockNum == gc->blockCap)
+		{
+			gc->blockCap = gc->blockCap == 0 ? 256 : gc->blockCap * 2;
+			gc->blockAt = (int *)realloc(gc->blockAt, gc->blockCap * sizeof(int));
+			gc->marked = (char *)realloc(gc->marked, gc->blockCap);
+			gc->markStack = (int *)realloc(gc->markStack, gc->blockCap * sizeof(int));
+		}
+		gc->blockAt[gc->blockNum++] = a;
+	}
+	if (gc->blockNum > 0) memset(gc->marked, 0, gc->blockNum);
+	gc->markTop = 0;
+
+	for (int r = 0; r < NO_REGS; r++)
+		markWord(tm, tm->reg[r]);
+	markRange(tm, 0, HEAP_BASE);
+	markRange(tm, tm->reg[sp] + 1 > end ? tm->reg[sp] + 1 : end, DADDR_SIZE);
+	while (gc->markTop > 0)
+	{
+		a = gc->blockAt[gc->markStack[--gc->markTop]];
+		markRange(tm, a + 1, a + heapBlockSize(tm, a) - 1);
+	}
+
+	/* releasing a block may merge it with the next one, the
+	 * adresses were taken before
+	 */
+	for (b = 0; b < gc->blockNum; b++)
+	{
+		if (!gc->marked[b]) gc->freedWords += heapRelease(tm, gc->blockAt[b] + 1);
+	}
+
+	HEAPSTATS s;
+	heapStats(tm, &s);
+	gc->threshold = s.live * 2 > GC_MIN_THRESHOLD ? s.live * 2 : GC_MIN_THRESHOLD;
+	gc->collections++;
+
+	double pause = (double)(clock() - start) / CLOCKS_PER_SEC;
+	gc->pauseTotal += pause;
+	if (pause > gc->pauseMax) gc->pauseMax = pause;
+} /* gcCollect */
+
+int gcMalloc(TMContext * tm, unsigned n)
+{
+	HEAPSTATS s;
+	int ap;
+	heapStats(tm, &s);
+	if (s.live >= tm->gc.threshold) gcCollect(tm);
+	ap = heapAlloc(tm, n);
+	if (ap == 0)
+	{
+		gcCollect(tm);
+		ap = heapAlloc(tm, n);
+	}
+	return ap;
+} /* gcMalloc */
+
+void gcReset(TMContext * tm)
+{
+	TMGC * gc = &tm->gc;
+	gc->threshold = GC_MIN_THRESHOLD;
+	gc->collections = 0;
+	gc->freedWords = 0;
+	gc->pauseTotal = gc->pauseMax = 0;
+}
+
+void gcFree(TMContext * tm)
+{
+	TMGC * gc = &tm->gc;
+	free(gc->blockAt);
+	free(gc->marked);
+	free(gc->markStack);
+	gc->blockAt = gc->markStack = NULL;
+	gc->marked = NULL;
+	gc->blockNum = gc->blockCap = gc->markTop = 0;
+}
+
+void printGcStats(TMContext * tm)
+{
+	TMGC * gc = &tm->gc;
+	printf("gc: %d collections, %d bytes freed, pause total %.0f us, max %.0f us\n",
+		gc->collections, gc->freedWords * (int)sizeof(int), gc->pauseTotal * 1e6, gc->pauseMax * 1e6);
+}
@@ -0,0 +1,49 @@
+#ifndef VMGC_HEAD
+#define VMGC_HEAD
+/****************************************************/
+/* File: vmgc.h                                     */
+/* an optional mark-sweep collector for the TM heap */
+/****************************************************/
+
+struct TMContext;
+
+/* the collector of one machine, the tables are kept between
+ * collections
+ */
+typedef struct {
+	int enabled;
+	int * blockAt;   /* the used blocks of the heap in adress order while collecting */
+	char * marked;
+	int * markStack;
+	int blockNum, blockCap, markTop;
+	int threshold;
+	int collections;
+	int freedWords;
+	double pauseTotal, pauseMax;// seconds
+} TMGC;
+
+/* GcEnabled = TRUE turns the collector on when the machine
+ * is reset: malloc collects when the heap has grown enough
+ * and free is only a hint
+ */
+extern int GcEnabled;
+
+/* pMalloc with the collector, collects before the block
+ * is taken when the live words passed the threshold or
+ * when the heap is full
+ */
+int gcMalloc(struct TMContext * tm, unsigned n);
+
+/* collect now */
+void gcCollect(struct TMContext * tm);
+
+/* forget the counters and the threshold */
+void gcReset(struct TMContext * tm);
+
+/* release the tables */
+void gcFree(struct TMContext * tm);
+
+/* collections, words freed and the pause times */
+void printGcStats(struct TMContext * tm);
+
+#endif
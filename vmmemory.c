@@ -1,14 +1,21 @@
-#include "vmmemory.h"
-#include "globals.h"
+/****************************************************/
+/* File: vmmemory.c                                 */
+/* the heap of the TM, two allocators for malloc    */
+/* and free of the programs, selected by HeapKind   */
+/****************************************************/
+#include "tm.h"
 
-int dMem[DADDR_SIZE];//extern variable
-static Header *memptr = NULL;// the last pointer to used memory
-static Header * mem = (Header *)(dMem + 4096);
+int HeapKind = heapSegregated;
+
+/**************  first fit  **************/
+#define memptr (tm->heap.memptr)
 static const int INTSIZE = sizeof(int);
 static const int HADERSIZE = sizeof(Header);
-int pMalloc(unsigned n_int_bytes)
+
+static int ffMalloc(TMContext * tm, unsigned n_int_bytes, int * block)
 {
 	Header *p, *newp;
+	Header * mem = (Header *)(tm->dMem + HEAP_BASE);
 	int nbytes = n_int_bytes * INTSIZE;
 	unsigned nunits = ((nbytes + HADERSIZE - 1) / HADERSIZE) + 1;
 	if (memptr == NULL)
@@ -19,7 +26,7 @@ int pMalloc(unsigned n_int_bytes)
 	}
 	p = memptr;
 	while (p->next != memptr && (p->freesize < nunits)) { p = p->next;}
-	if (p->freesize < nunits) return NULL; // no available block
+	if (p->freesize < nunits) return 0; // no available block
 
 	newp = p + p->usedsize;
 	newp->usedsize = nunits;
@@ -28,27 +35,258 @@ int pMalloc(unsigned n_int_bytes)
 	p->next = newp;
 	p->freesize = 0;
 	memptr = newp;
-	
-	return ((newp + 1) - mem) * (HADERSIZE / INTSIZE) + 4096;
+
+	*block = nunits * (HADERSIZE / INTSIZE);
+	return ((newp + 1) - mem) * (HADERSIZE / INTSIZE) + HEAP_BASE;
 }
 
-void pFree(Header *ap)
+/* returns the words of the freed block, 0 if ap is not one */
+static int ffFree(TMContext * tm, Header *ap)
 {
 	Header *bp, *p, *prev;
+	if (memptr == NULL) return 0;
 	bp = ap - 1;
 	prev = memptr, p = memptr->next;
 	while ((p != bp) && (p != memptr)){
 		prev = p;
 		p = p->next;
 	}
-	if (p != bp) return;
+	if (p != bp) return 0;
 
+	int words = p->usedsize * (HADERSIZE / INTSIZE);
 	prev->freesize += p->usedsize + p->freesize;
 	prev->next = p->next;
 	memptr = prev;
+	return words;
+}
+
+/* end of the highest block of the list */
+static int ffExtent(TMContext * tm)
+{
+	Header * mem = (Header *)(tm->dMem + HEAP_BASE);
+	Header * p = memptr;
+	int end = 0;
+	if (p == NULL) return 0;
+	do{
+		int e = (int)(p + p->usedsize - mem);
+		if (e > end) end = e;
+		p = p->next;
+	} while (p != memptr);
+	return end * (HADERSIZE / INTSIZE);
+}
+
+/**************  segregated lists  **************/
+/* a block is [size|used] payload... [size|used], the tags at both
+ * ends let free find the neighbours without a search. A free block
+ * keeps the adresses of the next and previous free blocks of its
+ * list in its first two payload words. Blocks up to SEG_SMALL_MAX
+ * words have a list per size, the larger ones share a first fit
+ * list, and the space above segTop has never been used
+ */
+#define SEG_MIN_BLOCK 4   /* two tags and two links */
+#define SEG_USED 1
+#define TAG_SIZE(a) ((unsigned)dMem[a] >> 1)
+#define TAG_USED(a) (dMem[a] & SEG_USED)
+
+/* the functions below work on the machine tm */
+#define dMem (tm->dMem)
+#define segTop (tm->heap.segTop)
+#define segSmall (tm->heap.segSmall)
+#define segMask (tm->heap.segMask)
+#define segLarge (tm->heap.segLarge)
+#define stats (tm->heap.stats)
+#define activeKind (tm->heap.kind)
+
+static int lowestBit(unsigned long long x)
+{
+#ifdef __GNUC__
+	return __builtin_ctzll(x);
+#else
+	int i = 0;
+	while (!(x & 1)) { x >>= 1; i++; }
+	return i;
+#endif
+}
+
+static void setTags(TMContext * tm, int a, int size, int used)
+{
+	dMem[a] = dMem[a + size - 1] = (size << 1) | used;
+}
+
+static int * listOf(TMContext * tm, int size)
+{
+	return size <= SEG_SMALL_MAX ? &segSmall[size] : &segLarge;
+}
+
+static void linkFree(TMContext * tm, int a, int size)
+{
+	int * head = listOf(tm, size);
+	setTags(tm, a, size, 0);
+	dMem[a + 1] = *head;
+	dMem[a + 2] = 0;
+	if (*head != 0) dMem[*head + 2] = a;
+	*head = a;
+	if (size <= SEG_SMALL_MAX) segMask |= 1ULL << (size - 1);
+}
+
+static void unlinkFree(TMContext * tm, int a)
+{
+	int size = TAG_SIZE(a);
+	int next = dMem[a + 1], prev = dMem[a + 2];
+	if (prev != 0) dMem[prev + 1] = next;
+	else *listOf(tm, size) = next;
+	if (next != 0) dMem[next + 2] = prev;
+	if (size <= SEG_SMALL_MAX && segSmall[size] == 0) segMask &= ~(1ULL << (size - 1));
+}
+
+static int segMalloc(TMContext * tm, unsigned n, int * block)
+{
+	int size = (int)n + 2, a = 0;
+	if (n > (unsigned)(FIRST_FP - HEAP_BASE)) return 0;
+	if (size < SEG_MIN_BLOCK) size = SEG_MIN_BLOCK;
+
+	/* the smallest list that fits, then the large blocks */
+	if (size <= SEG_SMALL_MAX)
+	{
+		unsigned long long fits = segMask & ~((1ULL << (size - 1)) - 1);
+		if (fits != 0) a = segSmall[lowestBit(fits) + 1];
+	}
+	for (int b = segLarge; a == 0 && b != 0; b = dMem[b + 1])
+	{
+		if ((int)TAG_SIZE(b) >= size) a = b;
+	}
+
+	if (a != 0)
+	{
+		int have = TAG_SIZE(a);
+		unlinkFree(tm, a);
+		if (have - size >= SEG_MIN_BLOCK) linkFree(tm, a + size, have - size);
+		else size = have;
+	}
+	else
+	{
+		if (segTop + size > FIRST_FP) return 0;
+		a = segTop;
+		segTop += size;
+	}
+	setTags(tm, a, size, SEG_USED);
+	*block = size;
+	return a + 1;
+}
+
+static int segFree(TMContext * tm, int ap)
+{
+	int a = ap - 1;
+	if (a < HEAP_BASE || a >= segTop || !TAG_USED(a)) return 0;
+	int size = TAG_SIZE(a);
+	if (size < SEG_MIN_BLOCK || a + size > segTop || dMem[a + size - 1] != dMem[a]) return 0;
+	int words = size;
+
+	/* coalesce with the free neighbours */
+	if (a > HEAP_BASE && !TAG_USED(a - 1))
+	{
+		int prev = a - TAG_SIZE(a - 1);
+		unlinkFree(tm, prev);
+		size += a - prev;
+		a = prev;
+	}
+	if (a + size < segTop && !TAG_USED(a + size))
+	{
+		int next = a + size;
+		size += TAG_SIZE(next);
+		unlinkFree(tm, next);
+	}
+
+	if (a + size == segTop) segTop = a;// back to the unused space
+	else linkFree(tm, a, size);
+	return words;
+}
+
+/********************************************/
+void heapReset(TMContext * tm)
+{
+	memptr = NULL;
+	segTop = HEAP_BASE;
+	segLarge = 0;
+	segMask = 0;
+	memset(segSmall, 0, sizeof(segSmall));
+	memset(&stats, 0, sizeof(stats));
+	tm->heap.high = HEAP_BASE;
+	tm->gc.enabled = GcEnabled;
+	activeKind = GcEnabled ? heapSegregated : HeapKind;// the collector walks the tags
+	gcReset(tm);
+}
+
+int heapAlloc(TMContext * tm, unsigned n)
+{
+	int block = 0, ap;
+	ap = activeKind == heapFirstFit ? ffMalloc(tm, n, &block) : segMalloc(tm, n, &block);
+	if (ap == 0) return 0;
+	if (ap + block > tm->heap.high) tm->heap.high = ap + block;
+	stats.nmalloc++;
+	stats.live += block;
+	if (stats.live > stats.peak) stats.peak = stats.live;
+	return ap;
+}
+
+int heapRelease(TMContext * tm, int ap)
+{
+	int words;
+	if (ap <= HEAP_BASE || ap >= DADDR_SIZE) return 0;
+	words = activeKind == heapFirstFit ? ffFree(tm, (Header *)(dMem + ap)) : segFree(tm, ap);
+	if (words == 0) return 0;
+	stats.nfree++;
+	stats.live -= words;
+	return words;
+}
+
+int pMalloc(TMContext * tm, unsigned n)
+{
+	return tm->gc.enabled ? gcMalloc(tm, n) : heapAlloc(tm, n);
+}
+
+void pFree(TMContext * tm, int ap)
+{
+	/* with the collector free is only a hint, the block may still be reachable */
+	if (!tm->gc.enabled) heapRelease(tm, ap);
+}
+
+int heapEnd(TMContext * tm)
+{
+	return activeKind == heapSegregated ? segTop : HEAP_BASE;
+}
+
+int heapBlockSize(TMContext * tm, int a)
+{
+	return TAG_SIZE(a);
+}
+
+int heapBlockUsed(TMContext * tm, int a)
+{
+	return TAG_USED(a);
+}
+
+void heapStats(TMContext * tm, HEAPSTATS * s)
+{
+	*s = stats;
+	s->extent = activeKind == heapFirstFit ? ffExtent(tm) : segTop - HEAP_BASE;
+}
+
+void printHeapStats(TMContext * tm)
+{
+	HEAPSTATS s;
+	heapStats(tm, &s);
+	printf("heap (%s): live %d bytes, peak %d bytes, extent %d bytes, fragmentation %d%%, %d malloc, %d free\n",
+		activeKind == heapFirstFit ? "first fit" : "segregated",
+		s.live * (int)sizeof(int), s.peak * (int)sizeof(int), s.extent * (int)sizeof(int),
+		s.extent == 0 ? 0 : (int)((long long)(s.extent - s.live) * 100 / s.extent),
+		s.nmalloc, s.nfree);
+	if (tm->gc.enabled) printGcStats(tm);
 }
 
 void clearVmem(){
+	TMContext * tm = tm_default();
 	memset(dMem, 0, sizeof(dMem));
-	memptr = NULL;
-}
\ No newline at end of file
+	memset(tm->dirty, 1, sizeof(tm->dirty));
+	heapReset(tm);
+}
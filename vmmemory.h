@@ -1,5 +1,16 @@
+#ifndef VMMEMORY_HEAD
+#define VMMEMORY_HEAD
+/****************************************************/
+/* File: vmmemory.h                                 */
+/* the heap of the TM, malloc and free of the       */
+/* programs are served from dMem above HEAP_BASE    */
+/****************************************************/
 #define MEMSIZE (65536 - 4096 - 1)
 #define DADDR_SIZE (65536)
+#define HEAP_BASE 4096
+#define SEG_SMALL_MAX 64 /* blocks up to this size have a list per size */
+
+struct TMContext;
 
 typedef struct header{
 	struct header * next;
@@ -7,6 +18,69 @@ typedef struct header{
 	unsigned freesize;
 } Header;
 
-extern int dMem[DADDR_SIZE];
-int pMalloc(unsigned nbytes);
-void pFree(void *ap);
+/* the allocators behind pMalloc and pFree */
+typedef enum {
+	heapFirstFit,   /* circular first fit list, free searches the list */
+	heapSegregated  /* size class lists and boundary tags, free is O(1) */
+} HEAPKIND;
+
+/* counters of the heap, in words of dMem */
+typedef struct {
+	int live;    /* words of the allocated blocks, headers included */
+	int peak;    /* highest live */
+	int extent;  /* words from HEAP_BASE to the end of the highest live block */
+	int nmalloc;
+	int nfree;
+} HEAPSTATS;
+
+/* the heap of one machine, it lives in the dMem of its context */
+typedef struct {
+	int kind;          /* the allocator of the current heap */
+	int high;          /* the allocators have written below this adress */
+	HEAPSTATS stats;
+	Header * memptr;   /* first fit: the last pointer to used memory */
+	int segTop;        /* segregated: the space above has never been used */
+	int segSmall[SEG_SMALL_MAX + 1];// list heads, 0 is the empty list
+	unsigned long long segMask;// bit size-1 is set when segSmall[size] is not empty
+	int segLarge;
+} TMHEAP;
+
+/* HeapKind selects the allocator, it is read when the heap
+ * is reset, so it takes effect with the next program
+ */
+extern int HeapKind;
+
+/* returns the adress of n free words, 0 if there is no room */
+int pMalloc(struct TMContext * tm, unsigned n);
+
+/* ap is an adress returned by pMalloc, anything else is ignored */
+void pFree(struct TMContext * tm, int ap);
+
+/* forget every block, the next pMalloc starts an empty heap */
+void heapReset(struct TMContext * tm);
+
+void heapStats(struct TMContext * tm, HEAPSTATS * s);
+
+/* pMalloc and pFree without the collector, heapRelease
+ * returns the words of the freed block, 0 if ap is not one
+ */
+int heapAlloc(struct TMContext * tm, unsigned n);
+int heapRelease(struct TMContext * tm, int ap);
+
+/* the blocks of the segregated heap lie one after the other
+ * from HEAP_BASE to heapEnd(), the block at a has heapBlockSize(a)
+ * words, its payload starts at a + 1 and ends before the last word
+ */
+int heapEnd(struct TMContext * tm);
+int heapBlockSize(struct TMContext * tm, int a);
+int heapBlockUsed(struct TMContext * tm, int a);
+
+/* print the counters and the fragmentation (the part of
+ * the extent not taken by live blocks)
+ */
+void printHeapStats(struct TMContext * tm);
+
+/* clear the memory of the machine behind doCommand */
+void clearVmem();
+
+#endif